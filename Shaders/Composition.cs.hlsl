@@ -44,7 +44,7 @@ void main( int2 pixelPos : SV_DispatchThreadId )
         return;
 
     // ViewZ
-    float viewZ = gIn_ViewZ[ pixelPos ];
+    float viewZ = DecodeViewZ( gIn_ViewZ[ pixelPos ] );
     float3 Lemi = gIn_DirectEmission[ pixelPos ];
 
     // Normal, roughness and material ID
@@ -123,10 +123,10 @@ void main( int2 pixelPos : SV_DispatchThreadId )
             float3 Nn = NRD_FrontEnd_UnpackNormalAndRoughness( gIn_Normal_Roughness[ pixelPos + int2(  0,  1 ) ] ).xyz;
             float3 Ns = NRD_FrontEnd_UnpackNormalAndRoughness( gIn_Normal_Roughness[ pixelPos + int2(  0, -1 ) ] ).xyz;
 
-            float Ze = gIn_ViewZ[ pixelPos + int2(  1,  0 ) ];
-            float Zw = gIn_ViewZ[ pixelPos + int2( -1,  0 ) ];
-            float Zn = gIn_ViewZ[ pixelPos + int2(  0,  1 ) ];
-            float Zs = gIn_ViewZ[ pixelPos + int2(  0, -1 ) ];
+            float Ze = DecodeViewZ( gIn_ViewZ[ pixelPos + int2(  1,  0 ) ] );
+            float Zw = DecodeViewZ( gIn_ViewZ[ pixelPos + int2( -1,  0 ) ] );
+            float Zn = DecodeViewZ( gIn_ViewZ[ pixelPos + int2(  0,  1 ) ] );
+            float Zs = DecodeViewZ( gIn_ViewZ[ pixelPos + int2(  0, -1 ) ] );
 
             float2 scale = NRD_SG_ReJitter( diffSg, specSg, Rf0, V, roughness, viewZ, Ze, Zw, Zn, Zs, N, Ne, Nw, Nn, Ns );
 
@@ -161,10 +161,10 @@ void main( int2 pixelPos : SV_DispatchThreadId )
             float3 Nn = NRD_FrontEnd_UnpackNormalAndRoughness( gIn_Normal_Roughness[ pixelPos + int2( 0, 1 ) ] ).xyz;
             float3 Ns = NRD_FrontEnd_UnpackNormalAndRoughness( gIn_Normal_Roughness[ pixelPos + int2( 0, -1 ) ] ).xyz;
 
-            float Ze = gIn_ViewZ[ pixelPos + int2(  1,  0 ) ];
-            float Zw = gIn_ViewZ[ pixelPos + int2( -1,  0 ) ];
-            float Zn = gIn_ViewZ[ pixelPos + int2(  0,  1 ) ];
-            float Zs = gIn_ViewZ[ pixelPos + int2(  0, -1 ) ];
+            float Ze = DecodeViewZ( gIn_ViewZ[ pixelPos + int2(  1,  0 ) ] );
+            float Zw = DecodeViewZ( gIn_ViewZ[ pixelPos + int2( -1,  0 ) ] );
+            float Zn = DecodeViewZ( gIn_ViewZ[ pixelPos + int2(  0,  1 ) ] );
+            float Zs = DecodeViewZ( gIn_ViewZ[ pixelPos + int2(  0, -1 ) ] );
 
             float scale = NRD_SG_ReJitter( sg, sg, 0.0, V, 0.0, viewZ, Ze, Zw, Zn, Zs, N, Ne, Nw, Nn, Ns ).x;
 
@@ -279,7 +279,7 @@ void main( int2 pixelPos : SV_DispatchThreadId )
             sharcHitData.normalWorld = N;
 
             HashMapData hashMapData;
-            hashMapData.capacity = SHARC_CAPACITY;
+            hashMapData.capacity = gSharcCapacity;
             hashMapData.hashEntriesBuffer = gInOut_SharcHashEntriesBuffer;
 
             SharcParameters sharcParams;
@@ -289,7 +289,7 @@ void main( int2 pixelPos : SV_DispatchThreadId )
             sharcParams.voxelDataBuffer = gInOut_SharcVoxelDataBuffer;
             sharcParams.voxelDataBufferPrev = gInOut_SharcVoxelDataBufferPrev;
 
-            bool isValid = SharcGetCachedRadiance( sharcParams, sharcHitData, Ldiff, true );
+            bool isValid = SharcCountQuery( SHARC_STAT_COMPOSITION_QUERIES, SharcGetCachedRadiance( sharcParams, sharcHitData, Ldiff, true ) );
 
             // Highlight invalid cells
             #if 0
@@ -29,7 +29,7 @@ void main( uint2 pixelPos : SV_DispatchThreadId )
     if( pixelUv.x > 1.0 || pixelUv.y > 1.0 )
         return;
 
-    float viewZ = gInOut_ViewZ[ pixelPos ];
+    float viewZ = DecodeViewZ( gInOut_ViewZ[ pixelPos ] );
     float3 Xv = Geometry::ReconstructViewPosition( pixelUv, gCameraFrustum, viewZ, gOrthoMode );
 
     // Recalculate viewZ to depth ( needed for SR )
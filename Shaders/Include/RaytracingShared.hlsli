@@ -5,11 +5,20 @@ NRI_RESOURCE( StructuredBuffer<InstanceData>, gIn_InstanceData, t, 2, SET_RAY_TR
 NRI_RESOURCE( StructuredBuffer<PrimitiveData>, gIn_PrimitiveData, t, 3, SET_RAY_TRACING );
 NRI_RESOURCE( StructuredBuffer<MorphedPrimitivePrevPositions>, gIn_MorphedPrimitivePrevPositions, t, 4, SET_RAY_TRACING );
 NRI_RESOURCE( Texture2D<float4>, gIn_Textures[], t, 5, SET_RAY_TRACING );
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_TextureFeedback, u, 0, SET_RAY_TRACING );
 
 NRI_RESOURCE( RWStructuredBuffer<uint64_t>, gInOut_SharcHashEntriesBuffer, u, 0, SET_SHARC );
 NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_SharcHashCopyOffsetBuffer, u, 1, SET_SHARC );
 NRI_RESOURCE( RWStructuredBuffer<uint4>, gInOut_SharcVoxelDataBuffer, u, 2, SET_SHARC );
 NRI_RESOURCE( RWStructuredBuffer<uint4>, gInOut_SharcVoxelDataBufferPrev, u, 3, SET_SHARC );
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_SharcStatsBuffer, u, 4, SET_SHARC );
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_SharcLiveBuckets, u, 5, SET_SHARC ); // [ 0 ] - bucket num, [ 1+ ] - bucket indices
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_SharcLiveBucketsNext, u, 6, SET_SHARC );
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_SharcLiveArgs, u, 7, SET_SHARC ); // dispatch indirect args for "gInOut_SharcLiveBuckets"
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_SharcLiveArgsNext, u, 8, SET_SHARC );
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_SharcBucketMask, u, 9, SET_SHARC ); // a bit per bucket listed in "gInOut_SharcLiveBuckets"
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_SharcHits, u, 10, SET_SHARC ); // [ 0 ] - hit num, [ 1+ ] - "SHARC_HIT_RECORD_STRIDE" per hit, only if "gSharcRecordHits != 0"
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_SharcUpdateLevels, u, 11, SET_SHARC ); // per "SharcUpdate" tile, a tile traces every "2 ^ level"-th path
 
 #if( USE_STOCHASTIC_SAMPLING == 1 )
     #define TEX_SAMPLER gNearestMipmapNearestSampler
@@ -100,6 +109,15 @@ float3 GetSamplingCoords( uint textureIndex, float2 uv, float mip, int mode )
     }
     else
         mip += gMipBias * ( mode == MIP_LESS_SHARP ? 0.5 : 1.0 );
+
+    // Texture streaming feedback: "log2( requested size ) + 1" ( 0 - not requested ), it doesn't depend on currently resident mips
+    if( gTextureFeedback != 0 )
+    {
+        uint requestedLevel = uint( clamp( ceil( mipNum - mip ), 0.0, 15.0 ) ) + 1;
+        if( gInOut_TextureFeedback[ textureIndex ] < requestedLevel )
+            InterlockedMax( gInOut_TextureFeedback[ textureIndex ], requestedLevel );
+    }
+
     mip = clamp( mip, 0.0, mipNum - 1.0 );
 
     #if( USE_STOCHASTIC_SAMPLING == 1 )
@@ -122,6 +140,57 @@ float3 GetSamplingCoords( uint textureIndex, float2 uv, float mip, int mode )
     return float3( uv, mip );
 }
 
+//====================================================================================================================================
+// SHARC LIVE BUCKETS
+//====================================================================================================================================
+
+// Appends a bucket and adds a group to the indirect dispatch per "LINEAR_BLOCK_SIZE / SHARC_BUCKET_SIZE" buckets
+void SharcAppendLiveBucket( RWStructuredBuffer<uint> liveBuckets, RWStructuredBuffer<uint> liveArgs, uint bucketIndex )
+{
+    uint listIndex;
+    InterlockedAdd( liveBuckets[ 0 ], 1, listIndex );
+
+    liveBuckets[ 1 + listIndex ] = bucketIndex;
+
+    if( listIndex % ( LINEAR_BLOCK_SIZE / SHARC_BUCKET_SIZE ) == 0 )
+        InterlockedAdd( liveArgs[ 0 ], 1 );
+}
+
+// Maps a thread of a maintenance pass to a hash table entry, entries of a bucket stay in one wave
+bool SharcGetLiveEntry( uint threadIndex, out uint entryIndex )
+{
+    uint listIndex = threadIndex / SHARC_BUCKET_SIZE;
+    entryIndex = 0;
+
+    if( listIndex >= gInOut_SharcLiveBuckets[ 0 ] )
+        return false;
+
+    entryIndex = gInOut_SharcLiveBuckets[ 1 + listIndex ] * SHARC_BUCKET_SIZE + threadIndex % SHARC_BUCKET_SIZE;
+
+    return true;
+}
+
+//====================================================================================================================================
+// SHARC STATISTICS
+//====================================================================================================================================
+
+// Adds to a "SHARC_STAT_*" counter, an atomic per wave
+void SharcAddStat( uint statIndex, uint value )
+{
+    uint sum = WaveActiveSum( value );
+    if( WaveIsFirstLane( ) && sum != 0 )
+        InterlockedAdd( gInOut_SharcStatsBuffer[ statIndex ], sum );
+}
+
+// Counts a "SharcGetCachedRadiance" query and its result ( "statIndex + 1" )
+bool SharcCountQuery( uint statIndex, bool isHit )
+{
+    SharcAddStat( statIndex, 1 );
+    SharcAddStat( statIndex + 1, isHit ? 1 : 0 );
+
+    return isHit;
+}
+
 //====================================================================================================================================
 // TRACER
 //====================================================================================================================================
@@ -378,6 +447,7 @@ MaterialProps GetMaterialProps( GeometryProps geometryProps, bool viewIndependen
     // Roughness and metalness
     coords = GetSamplingCoords( baseTexture + 1, geometryProps.uv, geometryProps.mip, MIP_SHARP );
     float3 materialProps = gIn_Textures[ NonUniformResourceIndex( baseTexture + 1 ) ].SAMPLE( coords ).xyz;
+    materialProps.yz = geometryProps.Has( FLAG_ROUGHNESS_METALNESS_XY ) ? materialProps.xy : materialProps.yz;
     float roughness = saturate( materialProps.y * instanceData.emissionAndRoughnessScale.w );
     float metalness = saturate( materialProps.z * instanceData.baseColorAndMetalnessScale.w );
 
@@ -12,7 +12,7 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 // SETTINGS
 //=============================================================================================
 
-// Fused or separate denoising selection
+// Fused or separate denoising selection (default, switchable at runtime)
 // 0 - DIFFUSE and SPECULAR
 // 1 - DIFFUSE_SPECULAR
 #define NRD_COMBINED                        1
@@ -21,7 +21,10 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 // SH - SH (spherical harmonics or spherical gaussian) denoisers
 // OCCLUSION - OCCLUSION (ambient or specular occlusion only) denoisers
 // DIRECTIONAL_OCCLUSION - DIRECTIONAL_OCCLUSION (ambient occlusion in SH mode) denoisers
-#define NRD_MODE                            NORMAL // NORMAL, SH, OCCLUSION, DIRECTIONAL_OCCLUSION
+// Shaders are compiled for all modes ("-D NRD_MODE=X" per output subfolder), the value below is the startup default
+#ifndef NRD_MODE
+    #define NRD_MODE                        NORMAL // NORMAL, SH, OCCLUSION, DIRECTIONAL_OCCLUSION
+#endif
 #define SIGMA_TRANSLUCENT                   1
 
 // Default = 1
@@ -110,6 +113,7 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 #define SET_RAY_TRACING                     2
 #define SET_MORPH                           3
 #define SET_SHARC                           4
+#define SET_WAVEFRONT                       5
 
 // Path tracing
 #define PT_THROUGHPUT_THRESHOLD             0.001
@@ -124,18 +128,49 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 #define PT_GLASS_MIN_F                      0.05 // adds a bit of stability and bias
 
 // Spatial HAsh-ased Radiance Cache
-#define SHARC_CAPACITY                      ( 1 << 22 )
+#define SHARC_CAPACITY_MIN                  ( 1 << 18 ) // the hash table capacity is adapted at runtime within this range ( power of 2 )
+#define SHARC_CAPACITY_MAX                  ( 1 << 22 )
+#define SHARC_BUCKET_SIZE                   32 // "HASH_GRID_HASH_MAP_BUCKET_SIZE", entries never leave their bucket, maintenance passes run over occupied buckets only
 #define SHARC_SCENE_SCALE                   50.0
 #define SHARC_DOWNSCALE                     5
 #define SHARC_NORMAL_DITHER                 0.003
 #define SHARC_POS_DITHER                    0.001
 #define SHARC_ANTI_FIREFLY                  true
 #define SHARC_STALE_FRAME_NUM_MIN           32 // new version uses 8 by default, old value offers more stability in voxels with low number of samples ( critical for glass )
+#define SHARC_HIT_RECORD_MAX_NUM            ( 1 << 20 ) // per frame, "--sharcRecordHits" drops the rest
+#define SHARC_HIT_RECORD_STRIDE             8 // uints: position, packed pixel, normal, packed bounce and LOD
+#define SHARC_UPDATE_TILE_SIZE              16 // "SharcUpdate" group size, update density is adapted per tile
+#define SHARC_UPDATE_TILE_ROW               128 // tiles per row in "gInOut_SharcUpdateLevels" ( up to 10K with "SHARC_DOWNSCALE = 5" )
+#define SHARC_UPDATE_TILE_MAX_NUM           ( SHARC_UPDATE_TILE_ROW * 96 )
+#define SHARC_UPDATE_LEVEL_MAX              3 // a tile traces at least "1 / 2 ^ level" paths
+#define SHARC_UPDATE_LEVEL_PERIOD           8 // frames, a converged tile halves density not more often than this
+#define SHARC_UPDATE_MISS_RATE_HIGH         64 // of 256, back to full density
+#define SHARC_UPDATE_MISS_RATE_LOW          16 // of 256, no lower density above this
+#define SHARC_LOD_LEVEL_MAX                 2 // coarse levels for paths with wide footprints ( voxels are "2 ^ lod" times larger, 0 - disabled )
+#define SHARC_LOD_UPDATE_PERIOD             4 // every N-th "SharcUpdate" path populates a coarse level
+#define SHARC_STAT_OCCUPIED                 0 // entries left by the previous frame
+#define SHARC_STAT_UPDATE_PATHS             1 // traced by "SharcUpdate"
+#define SHARC_STAT_UPDATE_HITS              2 // cache updates
+#define SHARC_STAT_UPDATE_FAILURES          3 // insertion failed ( the bucket is full )
+#define SHARC_STAT_UPDATE_PROBES            4 // sum of probe lengths of successful insertions
+#define SHARC_STAT_EVICTIONS                5 // stale entries ( "SHARC_STALE_FRAME_NUM_MIN" )
+#define SHARC_STAT_OPAQUE_QUERIES           6 // "+ 1" - hits
+#define SHARC_STAT_COMPOSITION_QUERIES      8 // "+ 1" - hits ( "USE_SHARC_DEBUG = 1" only )
+#define SHARC_STAT_TRANSPARENT_QUERIES      10 // "+ 1" - hits
+#define SHARC_STAT_OPAQUE_LOD_QUERIES       12 // "+ 1" - hits, queries at coarse levels ( "SHARC_LOD_LEVEL_MAX" )
+#define SHARC_STAT_OPAQUE_BOUNCES           14 // "+ 1" - paths, secondary bounces traced in "TraceOpaque"
+#define SHARC_STATS_NUM                     16
 
 // Blue noise
 #define BLUE_NOISE_SPATIAL_DIM              128 // see StaticTexture::ScramblingRanking
 #define BLUE_NOISE_TEMPORAL_DIM             4 // good values: 4-8 for shadows, 8-16 for occlusion, 8-32 for lighting
 
+// Wavefront ray binning ( secondary rays are sorted by direction, then by origin cell )
+#define WAVEFRONT_BIN_DIRECTION_RES         8 // octahedral, per axis
+#define WAVEFRONT_BIN_CELL_NUM              64 // origin cells get hashed into this number of bins
+#define WAVEFRONT_BIN_CELL_SIZE             2.0 // m
+#define WAVEFRONT_BIN_NUM                   ( WAVEFRONT_BIN_DIRECTION_RES * WAVEFRONT_BIN_DIRECTION_RES * WAVEFRONT_BIN_CELL_NUM ) // must be a multiple of "LINEAR_BLOCK_SIZE"
+
 // NVIDIA Image Scaler
 #define NIS_SCALER                          1
 #define NIS_HDR_MODE                        0
@@ -163,7 +198,7 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 #define MORPH_ROWS_NUM                      ( MORPH_MAX_ACTIVE_TARGETS_NUM / MORPH_ELEMENTS_PER_ROW_NUM )
 
 // Instance flags
-#define FLAG_FIRST_BIT                      25 // this + number of flags must be <= 32
+#define FLAG_FIRST_BIT                      24 // this + number of flags must be <= 32
 #define NON_FLAG_MASK                       ( ( 1 << FLAG_FIRST_BIT ) - 1 )
 
 #define FLAG_NON_TRANSPARENT                0x01 // geometry flag: non-transparent
@@ -173,6 +208,7 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 #define FLAG_DEFORMABLE                     0x10 // local animation
 #define FLAG_HAIR                           0x20 // hair
 #define FLAG_LEAF                           0x40 // leaf
+#define FLAG_ROUGHNESS_METALNESS_XY         0x80 // roughness and metalness are in "xy" ( "BC5" compressed ), otherwise in "yz"
 
 #define GEOMETRY_ALL                        ( FLAG_NON_TRANSPARENT | FLAG_TRANSPARENT )
 
@@ -240,6 +276,39 @@ struct InstanceData
     float scale;
 };
 
+// Wavefront path tracing ( see "TraceOpaqueWavefront.hlsli" )
+struct WavefrontSurface // "GeometryProps"
+{
+    float4 X_hitT;
+    float4 motion_curvature; // "Xprev - X"
+    uint4 V_N_T_uv; // half2 each, "V", "N" and "T" are octahedral
+    float4 mip_Tw_flags_instance; // "textureOffsetAndFlags" and "instanceIndex" are "asfloat"
+};
+
+struct WavefrontPixel
+{
+    WavefrontSurface surface; // paths start here ( after PSR )
+    float4 Lpsr;
+    float4 mirrorMatrix0_viewZ; // "viewZ" after PSR
+    float4 mirrorMatrix1_roughness; // "roughness" of "surface"
+    float4 mirrorMatrix2_bounceNum; // bounces left after PSR
+    float4 diffRadiance_hitDist; // accumulated over paths
+    float4 specRadiance_hitDist;
+    float4 diffDirection_pathNum; // number of diffuse paths
+    float4 specDirection_isActive; // 0 - the primary ray misses
+};
+
+struct WavefrontPath // "PathState"
+{
+    WavefrontSurface hit; // written by "Extend"
+    float4 Lsum_hitDist;
+    float4 throughput_diffuseLikeMotion;
+    float4 direction_curvature;
+    float4 rayOrigin_footprint;
+    float4 ray_mip;
+    float4 cone_bounceNum_flags_binKey; // flags: "isDiffusePath", "isDiffuse", "binKey" - ray binning only
+};
+
 //===============================================================
 // RESOURCES
 //===============================================================
@@ -296,7 +365,12 @@ NRI_RESOURCE( cbuffer, GlobalConstants, b, 0, SET_GLOBAL )
     float gExposure;
     float gMipBias;
     float gOrthoMode;
+    float gViewZScale; // "ViewZ" texture stores "viewZ * gViewZScale"
     uint32_t gSharcMaxAccumulatedFrameNum;
+    uint32_t gSharcCapacity;
+    uint32_t gTextureFeedback;
+    uint32_t gSharcRecordHits;
+    uint32_t gSharcUpdateLevelMax;
     uint32_t gDenoiserType;
     uint32_t gDisableShadowsAndEnableImportanceSampling; // TODO: remove - modify GetSunIntensity to return 0 if sun is below horizon
     uint32_t gOnScreen;
@@ -366,6 +440,13 @@ NRI_RESOURCE( cbuffer, MorphMeshUpdatePrimitivesConstants, b, 0, 3 )
     uint32_t gMorphedPrimitiveOffset;
 };
 
+NRI_RESOURCE( cbuffer, WavefrontConstants, b, 0, SET_WAVEFRONT )
+{
+    uint32_t gWavefrontPath;
+    uint32_t gWavefrontBounce; // 0 - starts paths at the surface
+    uint32_t gWavefrontBinning; // "Extend" consumes rays sorted by "Bin"
+};
+
 #if( !defined( __cplusplus ) )
 
 #include "ml.hlsli"
@@ -382,6 +463,20 @@ NRI_RESOURCE( SamplerState, gNearestMipmapNearestSampler, s, 2, SET_GLOBAL );
 // MISC
 //=============================================================================================
 
+// "ViewZ" texture can be FP16 ( see "GBufferProfile" )
+float EncodeViewZ( float viewZ )
+{
+    return viewZ * gViewZScale;
+}
+
+float DecodeViewZ( float z )
+{
+    float viewZ = z / gViewZScale;
+
+    // FP16 rounding moves sky away from INF
+    return abs( viewZ ) >= INF * 0.99 ? Math::Sign( viewZ ) * INF : viewZ;
+}
+
 // For SHARC
 float3 GetGlobalPos( float3 X )
 {
@@ -0,0 +1,528 @@
+/*
+Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+
+NVIDIA CORPORATION and its licensors retain all intellectual property
+and proprietary rights in and to this software, related documentation
+and any modifications thereto. Any use, reproduction, disclosure or
+distribution of this software and related documentation without an express
+license agreement from NVIDIA CORPORATION is strictly prohibited.
+*/
+
+/*
+Wavefront backend: "TraceOpaque" split into stages communicating through ray queues ( see "WAVEFRONT PATH TRACING" in README ):
+    - Generate ( per pixel ): primary ray, G-buffer, PSR, stores the path origin and queues sun shadow rays
+    - Shadow ( per queued pixel ): sun shadow of the primary surface ( shadow rays of secondary hits are traced inline by "Shade" )
+    - Shade ( per queued path or, if "gWavefrontBounce = 0", per pixel ): lighting at the hit, chooses the next ray and queues the path for "Extend"
+    - Bin ( optional, "gWavefrontBinning = 1" ): counting sort of rays queued by "Shade" by direction and origin cell ( "Scan" and "Scatter" )
+    - Extend ( per queued path ): traces to the next hit, rays are consumed in sorted order if binning is on
+
+A pixel has one path in flight, paths of a pixel are traced one after another ( "gWavefrontPath" ). Each stage
+re-initializes RNG, the megakernel and the wavefront backend converge to the same result, but are not bit-exact.
+*/
+
+#define TRACE_OPAQUE_GENERATE               0
+#define TRACE_OPAQUE_SHADOW                 1
+#define TRACE_OPAQUE_EXTEND                 2
+#define TRACE_OPAQUE_SHADE                  3
+#define TRACE_OPAQUE_BIN_SCAN               4
+#define TRACE_OPAQUE_BIN_SCATTER            5
+
+NRI_RESOURCE( RWStructuredBuffer<WavefrontPixel>, gInOut_WavefrontPixels, u, 0, SET_WAVEFRONT );
+NRI_RESOURCE( RWStructuredBuffer<WavefrontPath>, gInOut_WavefrontPaths, u, 1, SET_WAVEFRONT );
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_WavefrontQueue, u, 2, SET_WAVEFRONT ); // [ 0 ] - path num, [ 1+ ] - pixel indices
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_WavefrontQueueNext, u, 3, SET_WAVEFRONT );
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_WavefrontQueueArgs, u, 4, SET_WAVEFRONT ); // dispatch indirect args for "gInOut_WavefrontQueue"
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_WavefrontQueueNextArgs, u, 5, SET_WAVEFRONT );
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_WavefrontShadowQueue, u, 6, SET_WAVEFRONT ); // [ 0 ] - pixel num, [ 1+ ] - pixel indices
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_WavefrontShadowArgs, u, 7, SET_WAVEFRONT );
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_WavefrontBins, u, 8, SET_WAVEFRONT ); // ray num per bin, "Scan" clears it for the next bounce
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_WavefrontBinOffsets, u, 9, SET_WAVEFRONT ); // the first sorted ray of a bin, advanced by "Scatter"
+NRI_RESOURCE( RWStructuredBuffer<uint>, gInOut_WavefrontSortedQueue, u, 10, SET_WAVEFRONT ); // pixel indices of "gInOut_WavefrontQueue" in bin order
+
+//========================================================================================
+// MISC
+//========================================================================================
+
+uint PackHalf2( float2 v )
+{ return f32tof16( v.x ) | ( f32tof16( v.y ) << 16 ); }
+
+float2 UnpackHalf2( uint p )
+{ return float2( f16tof32( p ), f16tof32( p >> 16 ) ); }
+
+uint PackUnitVector( float3 v )
+{ return PackHalf2( Packing::EncodeUnitVector( v, true ) ); }
+
+float3 UnpackUnitVector( uint p )
+{ return Packing::DecodeUnitVector( UnpackHalf2( p ), true, true ); }
+
+WavefrontSurface PackSurface( GeometryProps geometryProps )
+{
+    WavefrontSurface surface;
+    surface.X_hitT = float4( geometryProps.X, geometryProps.hitT );
+    surface.motion_curvature = float4( geometryProps.Xprev - geometryProps.X, geometryProps.curvature );
+    surface.V_N_T_uv = uint4( PackUnitVector( geometryProps.V ), PackUnitVector( geometryProps.N ), PackUnitVector( geometryProps.T.xyz ), PackHalf2( geometryProps.uv ) );
+    surface.mip_Tw_flags_instance = float4( geometryProps.mip, geometryProps.T.w, asfloat( geometryProps.textureOffsetAndFlags ), asfloat( geometryProps.instanceIndex ) );
+
+    return surface;
+}
+
+GeometryProps UnpackSurface( WavefrontSurface surface )
+{
+    GeometryProps geometryProps;
+    geometryProps.X = surface.X_hitT.xyz;
+    geometryProps.Xprev = surface.X_hitT.xyz + surface.motion_curvature.xyz;
+    geometryProps.V = UnpackUnitVector( surface.V_N_T_uv.x );
+    geometryProps.T = float4( UnpackUnitVector( surface.V_N_T_uv.z ), surface.mip_Tw_flags_instance.y );
+    geometryProps.N = UnpackUnitVector( surface.V_N_T_uv.y );
+    geometryProps.uv = UnpackHalf2( surface.V_N_T_uv.w );
+    geometryProps.mip = surface.mip_Tw_flags_instance.x;
+    geometryProps.hitT = surface.X_hitT.w;
+    geometryProps.curvature = surface.motion_curvature.w;
+    geometryProps.textureOffsetAndFlags = asuint( surface.mip_Tw_flags_instance.z );
+    geometryProps.instanceIndex = asuint( surface.mip_Tw_flags_instance.w );
+
+    return geometryProps;
+}
+
+uint2 GetWavefrontPixelPos( uint pixelIndex )
+{
+    uint rectW = uint( gRectSize.x );
+
+    return uint2( pixelIndex % rectW, pixelIndex / rectW );
+}
+
+// Stages don't share RNG state, each path and bounce gets its own sequence
+void InitializeWavefrontRng( uint2 pixelPos, uint stage )
+{
+    uint salt = ( ( gWavefrontPath << 8 ) | ( gWavefrontBounce << 2 ) | stage ) + 1;
+
+    Rng::Hash::Initialize( pixelPos, gFrameIndex ^ ( salt * 0x9E3779B9 ) );
+}
+
+// Appends a pixel to a queue ( an atomic per wave ), a thread group is added to the indirect dispatch per "LINEAR_BLOCK_SIZE" entries
+// IMPORTANT: must be called by all active threads
+void AppendToQueue( RWStructuredBuffer<uint> queue, RWStructuredBuffer<uint> queueArgs, bool isAppended, uint pixelIndex )
+{
+    uint num = WaveActiveCountBits( isAppended );
+    uint base = 0;
+
+    if( WaveIsFirstLane( ) && num != 0 )
+    {
+        InterlockedAdd( queue[ 0 ], num, base );
+
+        uint groupNum = ( base + num + LINEAR_BLOCK_SIZE - 1 ) / LINEAR_BLOCK_SIZE - ( base + LINEAR_BLOCK_SIZE - 1 ) / LINEAR_BLOCK_SIZE;
+        if( groupNum != 0 )
+            InterlockedAdd( queueArgs[ 0 ], groupNum );
+    }
+
+    base = WaveReadLaneFirst( base );
+
+    if( isAppended )
+        queue[ 1 + base + WavePrefixCountBits( isAppended ) ] = pixelIndex;
+}
+
+// Direction major, rays sharing a direction bin traverse similar BVH nodes, origin cells split them further
+uint GetBinKey( float3 X, float3 ray )
+{
+    float2 octa = Packing::EncodeUnitVector( ray, true ) * 0.5 + 0.5;
+    uint2 directionCell = min( uint2( octa * WAVEFRONT_BIN_DIRECTION_RES ), WAVEFRONT_BIN_DIRECTION_RES - 1 );
+    uint directionBin = directionCell.y * WAVEFRONT_BIN_DIRECTION_RES + directionCell.x;
+
+    int3 originCell = int3( floor( X * gUnitToMetersMultiplier / WAVEFRONT_BIN_CELL_SIZE ) );
+    uint originBin = ( ( asuint( originCell.x ) * 73856093 ) ^ ( asuint( originCell.y ) * 19349663 ) ^ ( asuint( originCell.z ) * 83492791 ) ) % WAVEFRONT_BIN_CELL_NUM;
+
+    return directionBin * WAVEFRONT_BIN_CELL_NUM + originBin;
+}
+
+// Geometry and material properties of the primary surface are not stored, except roughness ( see "TraceOpaqueDesc" )
+TraceOpaqueDesc GetWavefrontDesc( WavefrontPixel pixel, uint2 pixelPos )
+{
+    TraceOpaqueDesc desc = ( TraceOpaqueDesc )0;
+    desc.pixelPos = pixelPos;
+    desc.checkerboard = Sequence::CheckerBoard( pixelPos, gFrameIndex ) != 0;
+    desc.pathNum = SAMPLE_NUM;
+    desc.bounceNum = uint( pixel.mirrorMatrix2_bounceNum.w );
+    desc.instanceInclusionMask = FLAG_NON_TRANSPARENT;
+    desc.rayFlags = 0;
+    desc.materialProps.roughness = pixel.mirrorMatrix1_roughness.w;
+
+    return desc;
+}
+
+//========================================================================================
+// GENERATE
+//========================================================================================
+
+#if( TRACE_OPAQUE_STAGE == TRACE_OPAQUE_GENERATE )
+
+[numthreads( 16, 16, 1 )]
+void main( uint2 pixelPos : SV_DispatchThreadId )
+{
+    // Pixel and sample UV
+    float2 pixelUv = float2( pixelPos + 0.5 ) * gInvRectSize;
+    float2 sampleUv = pixelUv + gJitter;
+
+    // Checkerboard
+    uint2 outPixelPos = pixelPos;
+    if( TRACING_MODE == RESOLUTION_HALF )
+        outPixelPos.x >>= 1;
+
+    uint checkerboard = Sequence::CheckerBoard( pixelPos, gFrameIndex ) != 0;
+
+    // Do not generate NANs for unused threads
+    if( pixelUv.x > 1.0 || pixelUv.y > 1.0 )
+    {
+        #if( USE_DRS_STRESS_TEST == 1 )
+            WriteResult( checkerboard, outPixelPos, GARBAGE, GARBAGE, GARBAGE, GARBAGE );
+        #endif
+
+        return;
+    }
+
+    uint pixelIndex = pixelPos.y * uint( gRectSize.x ) + pixelPos.x;
+
+    // Primary ray
+    Rng::Hash::Initialize( pixelPos, gFrameIndex );
+
+    GeometryProps geometryProps0;
+    MaterialProps materialProps0;
+    bool isActive = TracePrimary( pixelPos, sampleUv, checkerboard, outPixelPos, geometryProps0, materialProps0 );
+
+    // Path origin ( after potential PSR )
+    bool isShadowQueued = false;
+    if( isActive )
+    {
+        TraceOpaqueDesc desc = ( TraceOpaqueDesc )0;
+        desc.geometryProps = geometryProps0;
+        desc.materialProps = materialProps0;
+        desc.pixelPos = pixelPos;
+        desc.checkerboard = checkerboard;
+        desc.pathNum = SAMPLE_NUM;
+        desc.bounceNum = BOUNCE_NUM;
+        desc.instanceInclusionMask = FLAG_NON_TRANSPARENT;
+        desc.rayFlags = 0;
+
+        float viewZ = Geometry::AffineTransform( gWorldToView, desc.geometryProps.X ).z;
+        float4 Lpsr = 0;
+        float3x3 mirrorMatrix = Geometry::GetMirrorMatrix( 0 ); // identity
+
+        #if( USE_PSR_PERMUTATION == 1 )
+            Lpsr = ReplacePrimarySurface( desc, viewZ, mirrorMatrix );
+        #endif
+
+        WavefrontPixel pixel = ( WavefrontPixel )0;
+        pixel.surface = PackSurface( desc.geometryProps );
+        pixel.Lpsr = Lpsr;
+        pixel.mirrorMatrix0_viewZ = float4( mirrorMatrix[ 0 ], viewZ );
+        pixel.mirrorMatrix1_roughness = float4( mirrorMatrix[ 1 ], desc.materialProps.roughness );
+        pixel.mirrorMatrix2_bounceNum = float4( mirrorMatrix[ 2 ], desc.bounceNum );
+        pixel.specDirection_isActive.w = 1.0;
+
+        #if( NRD_MODE < OCCLUSION )
+            pixel.specRadiance_hitDist.w = NRD_FrontEnd_SpecHitDistAveraging_Begin( );
+        #endif
+
+        gInOut_WavefrontPixels[ pixelIndex ] = pixel;
+
+        // Sun shadow rays are traced by "Shadow", the rest writes outputs right away
+        float shadowTranslucency = ( Color::Luminance( desc.materialProps.Ldirect ) != 0.0 && !gDisableShadowsAndEnableImportanceSampling ) ? 1.0 : 0.0;
+        isShadowQueued = shadowTranslucency != 0.0;
+
+        if( !isShadowQueued )
+            TraceSunShadow( pixelPos, desc.geometryProps, 0.0 );
+    }
+    else
+        gInOut_WavefrontPixels[ pixelIndex ].specDirection_isActive = 0.0;
+
+    AppendToQueue( gInOut_WavefrontShadowQueue, gInOut_WavefrontShadowArgs, isShadowQueued, pixelIndex );
+}
+
+//========================================================================================
+// SHADOW
+//========================================================================================
+
+#elif( TRACE_OPAQUE_STAGE == TRACE_OPAQUE_SHADOW )
+
+[numthreads( LINEAR_BLOCK_SIZE, 1, 1 )]
+void main( uint threadIndex : SV_DispatchThreadId )
+{
+    if( threadIndex >= gInOut_WavefrontShadowQueue[ 0 ] )
+        return;
+
+    uint pixelIndex = gInOut_WavefrontShadowQueue[ 1 + threadIndex ];
+    uint2 pixelPos = GetWavefrontPixelPos( pixelIndex );
+
+    InitializeWavefrontRng( pixelPos, TRACE_OPAQUE_SHADOW );
+
+    GeometryProps geometryProps = UnpackSurface( gInOut_WavefrontPixels[ pixelIndex ].surface );
+    TraceSunShadow( pixelPos, geometryProps, 1.0 );
+}
+
+//========================================================================================
+// EXTEND
+//========================================================================================
+
+#elif( TRACE_OPAQUE_STAGE == TRACE_OPAQUE_EXTEND )
+
+[numthreads( LINEAR_BLOCK_SIZE, 1, 1 )]
+void main( uint threadIndex : SV_DispatchThreadId )
+{
+    if( threadIndex >= gInOut_WavefrontQueue[ 0 ] )
+        return;
+
+    uint pixelIndex = gWavefrontBinning ? gInOut_WavefrontSortedQueue[ threadIndex ] : gInOut_WavefrontQueue[ 1 + threadIndex ];
+    uint2 pixelPos = GetWavefrontPixelPos( pixelIndex );
+
+    InitializeWavefrontRng( pixelPos, TRACE_OPAQUE_EXTEND );
+
+    float4 rayOrigin_footprint = gInOut_WavefrontPaths[ pixelIndex ].rayOrigin_footprint;
+    float4 ray_mip = gInOut_WavefrontPaths[ pixelIndex ].ray_mip;
+    float cone = gInOut_WavefrontPaths[ pixelIndex ].cone_bounceNum_flags_binKey.x;
+
+    GeometryProps geometryProps = CastRay( rayOrigin_footprint.xyz, ray_mip.xyz, 0.0, INF, float2( ray_mip.w, cone ), gWorldTlas, FLAG_NON_TRANSPARENT, 0 );
+
+    gInOut_WavefrontPaths[ pixelIndex ].hit = PackSurface( geometryProps );
+}
+
+//========================================================================================
+// SHADE
+//========================================================================================
+
+#elif( TRACE_OPAQUE_STAGE == TRACE_OPAQUE_SHADE )
+
+[numthreads( LINEAR_BLOCK_SIZE, 1, 1 )]
+void main( uint threadIndex : SV_DispatchThreadId )
+{
+    // Bounce 0 starts paths of all pixels, next bounces process queued paths
+    uint pixelIndex = threadIndex;
+    if( gWavefrontBounce == 0 )
+    {
+        if( threadIndex >= uint( gRectSize.x ) * uint( gRectSize.y ) )
+            return;
+    }
+    else
+    {
+        if( threadIndex >= gInOut_WavefrontQueue[ 0 ] )
+            return;
+
+        pixelIndex = gInOut_WavefrontQueue[ 1 + threadIndex ];
+    }
+
+    WavefrontPixel pixel = gInOut_WavefrontPixels[ pixelIndex ];
+    if( pixel.specDirection_isActive.w == 0.0 )
+        return;
+
+    uint2 pixelPos = GetWavefrontPixelPos( pixelIndex );
+
+    InitializeWavefrontRng( pixelPos, TRACE_OPAQUE_SHADE );
+
+    TraceOpaqueDesc desc = GetWavefrontDesc( pixel, pixelPos );
+    float3x3 mirrorMatrix = float3x3( pixel.mirrorMatrix0_viewZ.xyz, pixel.mirrorMatrix1_roughness.xyz, pixel.mirrorMatrix2_bounceNum.xyz );
+    float viewZ = pixel.mirrorMatrix0_viewZ.w;
+
+    // Hit point
+    PathState pathState;
+    GeometryProps geometryProps;
+    MaterialProps materialProps;
+    bool isAlive = true;
+
+    if( gWavefrontBounce == 0 )
+    {
+        geometryProps = UnpackSurface( pixel.surface );
+        materialProps = GetMaterialProps( geometryProps );
+
+        desc.geometryProps = geometryProps;
+        desc.materialProps = materialProps;
+
+        pathState = BeginPath( desc, pixel.Lpsr, gWavefrontPath );
+    }
+    else
+    {
+        WavefrontPath path = gInOut_WavefrontPaths[ pixelIndex ];
+
+        pathState.Lsum = path.Lsum_hitDist.xyz;
+        pathState.throughput = path.throughput_diffuseLikeMotion.xyz;
+        pathState.direction = path.direction_curvature.xyz;
+        pathState.accumulatedHitDist = path.Lsum_hitDist.w;
+        pathState.accumulatedDiffuseLikeMotion = path.throughput_diffuseLikeMotion.w;
+        pathState.accumulatedCurvature = path.direction_curvature.w;
+        pathState.footprint = path.rayOrigin_footprint.w;
+        pathState.bounceNum = asuint( path.cone_bounceNum_flags_binKey.y );
+
+        uint flags = asuint( path.cone_bounceNum_flags_binKey.z );
+        pathState.isDiffusePath = ( flags & 0x1 ) != 0;
+        pathState.isDiffuse = ( flags & 0x2 ) != 0;
+
+        geometryProps = UnpackSurface( path.hit );
+        materialProps = GetMaterialProps( geometryProps ); // TODO: try to read metrials only if L1- and L2- lighting caches failed
+
+        isAlive = ShadeHit( pathState, geometryProps, materialProps, desc, gWavefrontBounce );
+    }
+
+    // Origin point of the next bounce
+    uint bounce = gWavefrontBounce + 1;
+    isAlive = isAlive && bounce <= desc.bounceNum && !geometryProps.IsSky( );
+
+    float3 ray = 0;
+    float2 mipAndCone = 0;
+    if( isAlive )
+        isAlive = SampleBounce( pathState, geometryProps, materialProps, desc, mirrorMatrix, gWavefrontPath, bounce, ray, mipAndCone );
+
+    if( isAlive )
+    {
+        WavefrontPath path;
+        path.hit = ( WavefrontSurface )0;
+        path.Lsum_hitDist = float4( pathState.Lsum, pathState.accumulatedHitDist );
+        path.throughput_diffuseLikeMotion = float4( pathState.throughput, pathState.accumulatedDiffuseLikeMotion );
+        path.direction_curvature = float4( pathState.direction, pathState.accumulatedCurvature );
+        path.rayOrigin_footprint = float4( geometryProps.GetXoffset( geometryProps.N ), pathState.footprint );
+        path.ray_mip = float4( ray, mipAndCone.x );
+
+        uint flags = ( pathState.isDiffusePath ? 0x1 : 0 ) | ( pathState.isDiffuse ? 0x2 : 0 );
+        uint binKey = 0;
+        if( gWavefrontBinning )
+        {
+            binKey = GetBinKey( geometryProps.X, ray );
+            InterlockedAdd( gInOut_WavefrontBins[ binKey ], 1 );
+        }
+
+        path.cone_bounceNum_flags_binKey = float4( mipAndCone.y, asfloat( pathState.bounceNum + 1 ), asfloat( flags ), asfloat( binKey ) );
+
+        gInOut_WavefrontPaths[ pixelIndex ] = path;
+    }
+    else
+    {
+        // The path is complete
+        TraceOpaqueResult result;
+        result.diffRadiance = pixel.diffRadiance_hitDist.xyz;
+        result.diffHitDist = pixel.diffRadiance_hitDist.w;
+        result.specRadiance = pixel.specRadiance_hitDist.xyz;
+        result.specHitDist = pixel.specRadiance_hitDist.w;
+        #if( NRD_MODE == SH || NRD_MODE == DIRECTIONAL_OCCLUSION )
+            result.diffDirection = pixel.diffDirection_pathNum.xyz;
+            result.specDirection = pixel.specDirection_isActive.xyz;
+        #endif
+
+        uint diffPathsNum = uint( pixel.diffDirection_pathNum.w );
+
+        EndPath( pathState, geometryProps, desc, viewZ, result, diffPathsNum );
+
+        uint pathNum = desc.pathNum << ( TRACING_MODE == RESOLUTION_FULL ? 1 : 0 );
+        if( gWavefrontPath + 1 == pathNum )
+        {
+            // All paths are complete
+            if( gWavefrontBounce != 0 )
+            {
+                desc.geometryProps = UnpackSurface( pixel.surface );
+                desc.materialProps = GetMaterialProps( desc.geometryProps );
+            }
+
+            ResolvePaths( desc, pathNum, diffPathsNum, result );
+
+            #if( USE_MOVING_EMISSION_FIX == 1 )
+                // Or emissives ( not having lighting in diffuse and specular ) can use a different material ID
+                result.diffRadiance += desc.materialProps.Lemi / Math::Pi( 2.0 );
+                result.specRadiance += desc.materialProps.Lemi / Math::Pi( 2.0 );
+            #endif
+
+            uint2 outPixelPos = pixelPos;
+            if( TRACING_MODE == RESOLUTION_HALF )
+                outPixelPos.x >>= 1;
+
+            PackAndWriteResult( desc.checkerboard, outPixelPos, result );
+        }
+        else
+        {
+            gInOut_WavefrontPixels[ pixelIndex ].diffRadiance_hitDist = float4( result.diffRadiance, result.diffHitDist );
+            gInOut_WavefrontPixels[ pixelIndex ].specRadiance_hitDist = float4( result.specRadiance, result.specHitDist );
+            #if( NRD_MODE == SH || NRD_MODE == DIRECTIONAL_OCCLUSION )
+                gInOut_WavefrontPixels[ pixelIndex ].diffDirection_pathNum = float4( result.diffDirection, diffPathsNum );
+                gInOut_WavefrontPixels[ pixelIndex ].specDirection_isActive.xyz = result.specDirection;
+            #else
+                gInOut_WavefrontPixels[ pixelIndex ].diffDirection_pathNum.w = diffPathsNum;
+            #endif
+        }
+    }
+
+    AppendToQueue( gInOut_WavefrontQueueNext, gInOut_WavefrontQueueNextArgs, isAlive, pixelIndex );
+}
+
+//========================================================================================
+// BIN
+//========================================================================================
+
+#elif( TRACE_OPAQUE_STAGE == TRACE_OPAQUE_BIN_SCAN )
+
+#define BINS_PER_THREAD ( WAVEFRONT_BIN_NUM / LINEAR_BLOCK_SIZE )
+
+groupshared uint s_WaveSums[ LINEAR_BLOCK_SIZE / 4 ];
+
+// A single group: exclusive prefix sum of ray numbers per bin
+[numthreads( LINEAR_BLOCK_SIZE, 1, 1 )]
+void main( uint threadIndex : SV_GroupIndex )
+{
+    uint binOffset = threadIndex * BINS_PER_THREAD;
+
+    uint counts[ BINS_PER_THREAD ];
+    uint sum = 0;
+
+    [unroll]
+    for( uint i = 0; i < BINS_PER_THREAD; i++ )
+    {
+        counts[ i ] = gInOut_WavefrontBins[ binOffset + i ];
+        sum += counts[ i ];
+    }
+
+    // Wave level, then group level ( a wave has at least 16 lanes, i.e. wave sums fit into a wave )
+    uint waveSize = WaveGetLaneCount( );
+    uint waveIndex = threadIndex / waveSize;
+    uint prefix = WavePrefixSum( sum );
+
+    if( WaveGetLaneIndex( ) == waveSize - 1 )
+        s_WaveSums[ waveIndex ] = prefix + sum;
+
+    GroupMemoryBarrierWithGroupSync( );
+
+    if( waveIndex == 0 )
+    {
+        uint waveNum = LINEAR_BLOCK_SIZE / waveSize;
+        uint waveSum = threadIndex < waveNum ? s_WaveSums[ threadIndex ] : 0;
+        uint wavePrefix = WavePrefixSum( waveSum );
+
+        if( threadIndex < waveNum )
+            s_WaveSums[ threadIndex ] = wavePrefix;
+    }
+
+    GroupMemoryBarrierWithGroupSync( );
+
+    uint offset = s_WaveSums[ waveIndex ] + prefix;
+
+    [unroll]
+    for( uint j = 0; j < BINS_PER_THREAD; j++ )
+    {
+        gInOut_WavefrontBinOffsets[ binOffset + j ] = offset;
+        gInOut_WavefrontBins[ binOffset + j ] = 0;
+
+        offset += counts[ j ];
+    }
+}
+
+#elif( TRACE_OPAQUE_STAGE == TRACE_OPAQUE_BIN_SCATTER )
+
+// Order within a bin is not deterministic, it doesn't affect the result
+[numthreads( LINEAR_BLOCK_SIZE, 1, 1 )]
+void main( uint threadIndex : SV_DispatchThreadId )
+{
+    if( threadIndex >= gInOut_WavefrontQueue[ 0 ] )
+        return;
+
+    uint pixelIndex = gInOut_WavefrontQueue[ 1 + threadIndex ];
+    uint binKey = asuint( gInOut_WavefrontPaths[ pixelIndex ].cone_bounceNum_flags_binKey.w );
+
+    uint sortedIndex;
+    InterlockedAdd( gInOut_WavefrontBinOffsets[ binKey ], 1, sortedIndex );
+
+    gInOut_WavefrontSortedQueue[ sortedIndex ] = pixelIndex;
+}
+
+#endif
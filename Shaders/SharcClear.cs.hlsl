@@ -11,8 +11,19 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 #include "Include/Shared.hlsli"
 #include "Include/RaytracingShared.hlsli"
 
+#include "SharcCommon.h"
+
 [numthreads( LINEAR_BLOCK_SIZE, 1, 1 )]
 void main( uint threadIndex : SV_DispatchThreadID )
 {
-    gInOut_SharcVoxelDataBuffer[ threadIndex ] = 0;
+    // Not listed buckets are empty and their voxel data is already zero ( see "SharcCompact" )
+    uint entryIndex;
+    if( !SharcGetLiveEntry( threadIndex, entryIndex ) )
+        return;
+
+    // Occupancy of the hash table left by the previous frame
+    bool isOccupied = gInOut_SharcHashEntriesBuffer[ entryIndex ] != HASH_GRID_INVALID_HASH_KEY;
+    SharcAddStat( SHARC_STAT_OCCUPIED, isOccupied ? 1 : 0 );
+
+    gInOut_SharcVoxelDataBuffer[ entryIndex ] = 0;
 }
@@ -0,0 +1,57 @@
+/*
+Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+
+NVIDIA CORPORATION and its licensors retain all intellectual property
+and proprietary rights in and to this software, related documentation
+and any modifications thereto. Any use, reproduction, disclosure or
+distribution of this software and related documentation without an express
+license agreement from NVIDIA CORPORATION is strictly prohibited.
+*/
+
+#include "Include/Shared.hlsli"
+#include "Include/RaytracingShared.hlsli"
+
+#include "SharcCommon.h"
+
+groupshared uint s_IsBucketOccupied[ LINEAR_BLOCK_SIZE / SHARC_BUCKET_SIZE ];
+
+[numthreads( LINEAR_BLOCK_SIZE, 1, 1 )]
+void main( uint threadIndex : SV_DispatchThreadID, uint localIndex : SV_GroupIndex )
+{
+    uint entryIndex;
+    bool isListed = SharcGetLiveEntry( threadIndex, entryIndex );
+
+    uint localBucketIndex = localIndex / SHARC_BUCKET_SIZE;
+    bool isFirstInBucket = ( localIndex % SHARC_BUCKET_SIZE ) == 0;
+
+    if( isFirstInBucket )
+        s_IsBucketOccupied[ localBucketIndex ] = 0;
+
+    GroupMemoryBarrierWithGroupSync( );
+
+    if( isListed && gInOut_SharcHashEntriesBuffer[ entryIndex ] != HASH_GRID_INVALID_HASH_KEY )
+        s_IsBucketOccupied[ localBucketIndex ] = 1;
+
+    GroupMemoryBarrierWithGroupSync( );
+
+    if( !isListed )
+        return;
+
+    uint bucketIndex = entryIndex / SHARC_BUCKET_SIZE;
+    if( s_IsBucketOccupied[ localBucketIndex ] != 0 )
+    {
+        // Still occupied after "Resolve" and "Hash copy", stays listed in the next frame
+        if( isFirstInBucket )
+            SharcAppendLiveBucket( gInOut_SharcLiveBucketsNext, gInOut_SharcLiveArgsNext, bucketIndex );
+    }
+    else
+    {
+        // Empty, voxel data must be zero when "Update" lists the bucket again ( "Clear" skips not listed buckets )
+        gInOut_SharcVoxelDataBuffer[ entryIndex ] = 0;
+        gInOut_SharcVoxelDataBufferPrev[ entryIndex ] = 0;
+        gInOut_SharcHashCopyOffsetBuffer[ entryIndex ] = 0;
+
+        if( isFirstInBucket )
+            InterlockedAnd( gInOut_SharcBucketMask[ bucketIndex / 32 ], ~( 1u << ( bucketIndex % 32 ) ) );
+    }
+}
@@ -16,9 +16,13 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 [numthreads( LINEAR_BLOCK_SIZE, 1, 1 )]
 void main( uint threadIndex : SV_DispatchThreadID )
 {
+    uint entryIndex;
+    if( !SharcGetLiveEntry( threadIndex, entryIndex ) )
+        return;
+
     HashMapData hashMapData;
-    hashMapData.capacity = SHARC_CAPACITY;
+    hashMapData.capacity = gSharcCapacity;
     hashMapData.hashEntriesBuffer = gInOut_SharcHashEntriesBuffer;
 
-    SharcCopyHashEntry( threadIndex, hashMapData, gInOut_SharcHashCopyOffsetBuffer );
+    SharcCopyHashEntry( entryIndex, hashMapData, gInOut_SharcHashCopyOffsetBuffer );
 }
@@ -16,6 +16,10 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 [numthreads( LINEAR_BLOCK_SIZE, 1, 1 )]
 void main( uint threadIndex : SV_DispatchThreadID )
 {
+    uint entryIndex;
+    if( !SharcGetLiveEntry( threadIndex, entryIndex ) )
+        return;
+
     HashGridParameters hashGridParams;
     hashGridParams.cameraPosition = gCameraGlobalPos.xyz;
     hashGridParams.sceneScale = SHARC_SCENE_SCALE;
@@ -23,7 +27,7 @@ void main( uint threadIndex : SV_DispatchThreadID )
     hashGridParams.levelBias = SHARC_GRID_LEVEL_BIAS;
 
     HashMapData hashMapData;
-    hashMapData.capacity = SHARC_CAPACITY;
+    hashMapData.capacity = gSharcCapacity;
     hashMapData.hashEntriesBuffer = gInOut_SharcHashEntriesBuffer;
 
     SharcParameters sharcParams;
@@ -39,5 +43,11 @@ void main( uint threadIndex : SV_DispatchThreadID )
     sharcResolveParameters.staleFrameNumMax = SHARC_STALE_FRAME_NUM_MIN;
     sharcResolveParameters.enableAntiFireflyFilter = SHARC_ANTI_FIREFLY;
 
-    SharcResolveEntry( threadIndex, sharcParams, sharcResolveParameters, gInOut_SharcHashCopyOffsetBuffer );
+    bool isOccupied = gInOut_SharcHashEntriesBuffer[ entryIndex ] != HASH_GRID_INVALID_HASH_KEY;
+
+    SharcResolveEntry( entryIndex, sharcParams, sharcResolveParameters, gInOut_SharcHashCopyOffsetBuffer );
+
+    // Stale entries get removed by "SharcResolveEntry"
+    bool isEvicted = isOccupied && gInOut_SharcHashEntriesBuffer[ entryIndex ] == HASH_GRID_INVALID_HASH_KEY;
+    SharcAddStat( SHARC_STAT_EVICTIONS, isEvicted ? 1 : 0 );
 }
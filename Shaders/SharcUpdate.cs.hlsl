@@ -34,17 +34,67 @@ float3 GetAmbientBRDF( GeometryProps geometryProps, MaterialProps materialProps,
     return ambBRDF;
 }
 
-void Trace( GeometryProps geometryProps )
+// Lists the bucket of a hit entry for maintenance passes
+void MarkLiveBucket( SharcParameters sharcParams, SharcHitData sharcHitData )
 {
-    // SHARC state
+    uint entryIndex = HashMapFindEntry( sharcParams.hashMapData, sharcHitData.positionWorld, sharcHitData.normalWorld, sharcParams.gridParameters );
+    bool isFound = entryIndex != HASH_GRID_INVALID_CACHE_INDEX;
+
+    // Probing starts at the beginning of the bucket
+    SharcAddStat( SHARC_STAT_UPDATE_HITS, 1 );
+    SharcAddStat( SHARC_STAT_UPDATE_FAILURES, isFound ? 0 : 1 );
+    SharcAddStat( SHARC_STAT_UPDATE_PROBES, isFound ? entryIndex % SHARC_BUCKET_SIZE + 1 : 0 );
+
+    if( !isFound )
+        return;
+
+    uint bucketIndex = entryIndex / SHARC_BUCKET_SIZE;
+    uint bit = 1u << ( bucketIndex % 32 );
+    if( gInOut_SharcBucketMask[ bucketIndex / 32 ] & bit )
+        return;
+
+    uint mask;
+    InterlockedOr( gInOut_SharcBucketMask[ bucketIndex / 32 ], bit, mask );
+
+    if( ( mask & bit ) == 0 )
+        SharcAppendLiveBucket( gInOut_SharcLiveBuckets, gInOut_SharcLiveArgs, bucketIndex );
+}
+
+// Appends a hit to the stream replayed by the CPU reference of the hash grid ( "--sharcRecordHits" )
+void RecordHit( SharcHitData sharcHitData, uint2 pixelPos, uint bounce, uint lod )
+{
+    if( gSharcRecordHits == 0 )
+        return;
+
+    uint hitIndex;
+    InterlockedAdd( gInOut_SharcHits[ 0 ], 1, hitIndex );
+
+    if( hitIndex >= SHARC_HIT_RECORD_MAX_NUM )
+        return;
+
+    uint offset = 1 + hitIndex * SHARC_HIT_RECORD_STRIDE;
+    gInOut_SharcHits[ offset + 0 ] = asuint( sharcHitData.positionWorld.x );
+    gInOut_SharcHits[ offset + 1 ] = asuint( sharcHitData.positionWorld.y );
+    gInOut_SharcHits[ offset + 2 ] = asuint( sharcHitData.positionWorld.z );
+    gInOut_SharcHits[ offset + 3 ] = pixelPos.x | ( pixelPos.y << 16 );
+    gInOut_SharcHits[ offset + 4 ] = asuint( sharcHitData.normalWorld.x );
+    gInOut_SharcHits[ offset + 5 ] = asuint( sharcHitData.normalWorld.y );
+    gInOut_SharcHits[ offset + 6 ] = asuint( sharcHitData.normalWorld.z );
+    gInOut_SharcHits[ offset + 7 ] = bounce | ( lod << 16 );
+}
+
+// Returns "true" if the primary hit lands in a voxel, which is not in the cache yet
+bool Trace( GeometryProps geometryProps, uint2 pixelPos, uint lod )
+{
+    // SHARC state ( a coarse level has "2 ^ lod" times larger voxels, keys match the native level "level + lod" )
     HashGridParameters hashGridParams;
     hashGridParams.cameraPosition = gCameraGlobalPos.xyz;
-    hashGridParams.sceneScale = SHARC_SCENE_SCALE;
+    hashGridParams.sceneScale = SHARC_SCENE_SCALE / exp2( lod );
     hashGridParams.logarithmBase = SHARC_GRID_LOGARITHM_BASE;
-    hashGridParams.levelBias = SHARC_GRID_LEVEL_BIAS;
+    hashGridParams.levelBias = SHARC_GRID_LEVEL_BIAS + lod;
 
     HashMapData hashMapData;
-    hashMapData.capacity = SHARC_CAPACITY;
+    hashMapData.capacity = gSharcCapacity;
     hashMapData.hashEntriesBuffer = gInOut_SharcHashEntriesBuffer;
 
     SharcParameters sharcParams;
@@ -67,9 +117,16 @@ void Trace( GeometryProps geometryProps )
         sharcHitData.positionWorld = GetGlobalPos( geometryProps.X ) + ( Rng::Hash::GetFloat4( ).xyz - 0.5 ) * SHARC_POS_DITHER;
         sharcHitData.normalWorld = normalize( geometryProps.N + ( Rng::Hash::GetFloat4( ).xyz - 0.5 ) * SHARC_NORMAL_DITHER );
 
+        bool isMiss = HashMapFindEntry( hashMapData, sharcHitData.positionWorld, sharcHitData.normalWorld, hashGridParams ) == HASH_GRID_INVALID_CACHE_INDEX;
+
         SharcSetThroughput( sharcState, 1.0 );
-        if( !SharcUpdateHit( sharcParams, sharcState, sharcHitData, L, 1.0 ) )
-            return;
+        bool isContinued = SharcUpdateHit( sharcParams, sharcState, sharcHitData, L, 1.0 );
+
+        MarkLiveBucket( sharcParams, sharcHitData );
+        RecordHit( sharcHitData, pixelPos, 0, lod );
+
+        if( !isContinued )
+            return isMiss;
     }
 
     // Secondary rays
@@ -229,25 +286,24 @@ void Trace( GeometryProps geometryProps )
             SharcSetThroughput( sharcState, throughput );
             if( geometryProps.IsSky( ) )
                 SharcUpdateMiss( sharcParams, sharcState, L );
-            else if( !SharcUpdateHit( sharcParams, sharcState, sharcHitData, L, Rng::Hash::GetFloat( ) ) )
-                break;
+            else
+            {
+                bool isContinued = SharcUpdateHit( sharcParams, sharcState, sharcHitData, L, Rng::Hash::GetFloat( ) );
+
+                MarkLiveBucket( sharcParams, sharcHitData );
+                RecordHit( sharcHitData, pixelPos, bounce, lod );
+
+                if( !isContinued )
+                    break;
+            }
         }
     }
+
+    return isMiss;
 }
 
-[numthreads( 16, 16, 1 )]
-void main( uint2 pixelPos : SV_DispatchThreadId )
+bool UpdatePath( uint2 pixelPos )
 {
-    /*
-    TODO: modify SHARC to support:
-    - material de-modulation
-    - 2 levels of detail: fine and coarse ( large voxels )
-    - firefly suppression
-    - anti-lag
-    - dynamic "sceneScale"
-    - auto "sceneScale" adjustment to guarantee desired number of samples in voxels on average
-    */
-
     // Initialize RNG
     Rng::Hash::Initialize( pixelPos, gFrameIndex );
 
@@ -268,6 +324,71 @@ void main( uint2 pixelPos : SV_DispatchThreadId )
     GeometryProps geometryProps = CastRay( cameraRayOrigin, cameraRayDirection, 0.0, INF, GetConeAngleFromAngularRadius( 0.0, gTanPixelAngularRadius * SHARC_DOWNSCALE ), gWorldTlas, FLAG_NON_TRANSPARENT, 0 );
 
     // Opaque path
-    if( !geometryProps.IsSky( ) )
-        Trace( geometryProps ); // looping this for 4-8 iterations helps to improve cache quality, but it's expensive
+    if( geometryProps.IsSky( ) )
+        return false;
+
+    // One of "SHARC_LOD_UPDATE_PERIOD" paths populates a coarse level queried by wide paths in "TraceOpaque"
+    uint lod = 0;
+    if( SHARC_LOD_LEVEL_MAX != 0 && Rng::Hash::GetFloat( ) < 1.0 / SHARC_LOD_UPDATE_PERIOD ) // random, a pattern would correlate with adaptive density
+        lod = min( 1 + uint( Rng::Hash::GetFloat( ) * SHARC_LOD_LEVEL_MAX ), SHARC_LOD_LEVEL_MAX );
+
+    return Trace( geometryProps, pixelPos, lod ); // looping this for 4-8 iterations helps to improve cache quality, but it's expensive
+}
+
+groupshared uint s_PathNum;
+groupshared uint s_MissNum;
+
+[numthreads( SHARC_UPDATE_TILE_SIZE, SHARC_UPDATE_TILE_SIZE, 1 )]
+void main( uint2 pixelPos : SV_DispatchThreadId, uint2 tilePos : SV_GroupId, uint threadIndex : SV_GroupIndex )
+{
+    /*
+    TODO: modify SHARC to support:
+    - material de-modulation
+    - firefly suppression
+    - anti-lag
+    - dynamic "sceneScale"
+    - auto "sceneScale" adjustment to guarantee desired number of samples in voxels on average
+    */
+
+    // Adaptive density: a tile traces every "2 ^ level"-th path, the selection rotates over frames
+    uint tileIndex = tilePos.y * SHARC_UPDATE_TILE_ROW + tilePos.x;
+    uint level = tileIndex < SHARC_UPDATE_TILE_MAX_NUM ? gInOut_SharcUpdateLevels[ tileIndex ] : 0;
+    uint effectiveLevel = min( level, gSharcUpdateLevelMax );
+
+    if( threadIndex == 0 )
+    {
+        s_PathNum = 0;
+        s_MissNum = 0;
+    }
+
+    GroupMemoryBarrierWithGroupSync( );
+
+    bool isTraced = ( ( threadIndex + gFrameIndex ) & ( ( 1u << effectiveLevel ) - 1 ) ) == 0;
+    bool isMiss = false;
+    if( isTraced )
+        isMiss = UpdatePath( pixelPos );
+
+    if( isTraced )
+        InterlockedAdd( s_PathNum, 1 );
+
+    if( isMiss )
+        InterlockedAdd( s_MissNum, 1 );
+
+    GroupMemoryBarrierWithGroupSync( );
+
+    if( threadIndex != 0 || tileIndex >= SHARC_UPDATE_TILE_MAX_NUM )
+        return;
+
+    InterlockedAdd( gInOut_SharcStatsBuffer[ SHARC_STAT_UPDATE_PATHS ], s_PathNum );
+
+    // Misses ( new voxels ) mean disocclusion or a fresh cache: get dense immediately. A converged tile gets sparser slowly
+    uint missRate = s_PathNum ? ( s_MissNum * 256 ) / s_PathNum : 0;
+    if( missRate > SHARC_UPDATE_MISS_RATE_HIGH )
+        level = 0;
+    else if( missRate > SHARC_UPDATE_MISS_RATE_LOW )
+        level = level ? level - 1 : 0;
+    else if( ( gFrameIndex % SHARC_UPDATE_LEVEL_PERIOD ) == 0 )
+        level = min( effectiveLevel + 1, SHARC_UPDATE_LEVEL_MAX );
+
+    gInOut_SharcUpdateLevels[ tileIndex ] = level;
 }
@@ -14,6 +14,38 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 #define SHARC_QUERY 1
 #include "SharcCommon.h"
 
+// Permutations ( "TraceOpaque*.cs.hlsl" ) bake settings of common configurations, the generic one reads them from constants
+#define TRACE_OPAQUE_GENERIC                0
+#define TRACE_OPAQUE_PROBABILISTIC          1 // "RESOLUTION_FULL_PROBABILISTIC", 1 path, 1 bounce
+#define TRACE_OPAQUE_HALF                   2 // "RESOLUTION_HALF" ( checkerboard ), 1 path, no PSR
+#define TRACE_OPAQUE_FULL                   3 // "RESOLUTION_FULL", 1 path per lobe
+
+#ifndef TRACE_OPAQUE_PERMUTATION
+    #define TRACE_OPAQUE_PERMUTATION        TRACE_OPAQUE_GENERIC
+#endif
+
+#if( TRACE_OPAQUE_PERMUTATION == TRACE_OPAQUE_PROBABILISTIC )
+    #define TRACING_MODE                    RESOLUTION_FULL_PROBABILISTIC
+    #define SAMPLE_NUM                      1
+    #define BOUNCE_NUM                      1
+    #define USE_PSR_PERMUTATION             USE_PSR
+#elif( TRACE_OPAQUE_PERMUTATION == TRACE_OPAQUE_HALF )
+    #define TRACING_MODE                    RESOLUTION_HALF
+    #define SAMPLE_NUM                      1
+    #define BOUNCE_NUM                      gBounceNum
+    #define USE_PSR_PERMUTATION             0 // "gPSR" is off in this mode
+#elif( TRACE_OPAQUE_PERMUTATION == TRACE_OPAQUE_FULL )
+    #define TRACING_MODE                    RESOLUTION_FULL
+    #define SAMPLE_NUM                      1
+    #define BOUNCE_NUM                      gBounceNum
+    #define USE_PSR_PERMUTATION             USE_PSR
+#else
+    #define TRACING_MODE                    gTracingMode
+    #define SAMPLE_NUM                      gSampleNum
+    #define BOUNCE_NUM                      gBounceNum
+    #define USE_PSR_PERMUTATION             USE_PSR
+#endif
+
 // Inputs
 NRI_RESOURCE( Texture2D<float3>, gIn_PrevComposedDiff, t, 0, 1 );
 NRI_RESOURCE( Texture2D<float4>, gIn_PrevComposedSpec_PrevViewZ, t, 1, 1 );
@@ -108,6 +140,9 @@ Derivation:
         ...
 */
 
+// IMPORTANT: after the primary hit ( "SampleBounce", "ShadeHit" and "EndPath" ) only "pixelPos", "checkerboard", "pathNum", "bounceNum",
+// "instanceInclusionMask", "rayFlags" and "materialProps.roughness" ( primary surface ) are read. The wavefront backend relies on it and
+// doesn't restore the rest between stages ( see "GetWavefrontDesc" )
 struct TraceOpaqueDesc
 {
     // Geometry properties
@@ -149,568 +184,597 @@ struct TraceOpaqueResult
     #endif
 };
 
-TraceOpaqueResult TraceOpaque( inout TraceOpaqueDesc desc )
+// The state of a path between bounces
+struct PathState
 {
-    // TODO: for RESOLUTION_FULL_PROBABILISTIC with 1 path per pixel the tracer can be significantly simplified
+    float3 Lsum;
+    float3 throughput;
+    float3 direction; // sampling direction of the 1st bounce ( in PSR space )
+    float accumulatedHitDist;
+    float accumulatedDiffuseLikeMotion;
+    float accumulatedCurvature;
+    float footprint;
+    uint bounceNum; // traced bounces
+    bool isDiffusePath;
+    bool isDiffuse; // the current bounce
+};
 
-    //=====================================================================================================================================================================
-    // Primary surface replacement ( PSR )
-    //=====================================================================================================================================================================
+//=====================================================================================================================================================================
+// Primary surface replacement ( PSR )
+//=====================================================================================================================================================================
 
-    float viewZ = Geometry::AffineTransform( gWorldToView, desc.geometryProps.X ).z;
+float4 ReplacePrimarySurface( inout TraceOpaqueDesc desc, inout float viewZ, inout float3x3 mirrorMatrix )
+{
     float4 Lpsr = 0;
-    float3x3 mirrorMatrix = Geometry::GetMirrorMatrix( 0 ); // identity
+    float3 psrThroughput = 1.0;
 
-    #if( USE_PSR == 1 )
-    {
-        float3 psrThroughput = 1.0;
+    GeometryProps geometryProps = desc.geometryProps;
+    MaterialProps materialProps = desc.materialProps;
 
-        GeometryProps geometryProps = desc.geometryProps;
-        MaterialProps materialProps = desc.materialProps;
+    float accumulatedHitDist = 0.0;
+    float accumulatedCurvature = 0.0;
+    bool isPSR = false;
 
-        float accumulatedHitDist = 0.0;
-        float accumulatedCurvature = 0.0;
-        bool isPSR = false;
+    [loop]
+    while( desc.bounceNum && !geometryProps.IsSky( ) && IsPsrAllowed( materialProps ) )
+    {
+        isPSR = true;
 
-        [loop]
-        while( desc.bounceNum && !geometryProps.IsSky( ) && IsPsrAllowed( materialProps ) )
+        // Origin point
         {
-            isPSR = true;
+            // Accumulate curvature
+            accumulatedCurvature += materialProps.curvature; // yes, before hit
 
-            // Origin point
-            {
-                // Accumulate curvature
-                accumulatedCurvature += materialProps.curvature; // yes, before hit
+            // Accumulate mirror matrix
+            mirrorMatrix = mul( Geometry::GetMirrorMatrix( materialProps.N ), mirrorMatrix );
 
-                // Accumulate mirror matrix
-                mirrorMatrix = mul( Geometry::GetMirrorMatrix( materialProps.N ), mirrorMatrix );
+            // Choose a ray
+            float3 ray = reflect( -geometryProps.V, materialProps.N );
 
-                // Choose a ray
-                float3 ray = reflect( -geometryProps.V, materialProps.N );
+            // Update throughput
+            #if( NRD_MODE < OCCLUSION )
+                float3 albedo, Rf0;
+                BRDF::ConvertBaseColorMetalnessToAlbedoRf0( materialProps.baseColor, materialProps.metalness, albedo, Rf0 );
 
-                // Update throughput
-                #if( NRD_MODE < OCCLUSION )
-                    float3 albedo, Rf0;
-                    BRDF::ConvertBaseColorMetalnessToAlbedoRf0( materialProps.baseColor, materialProps.metalness, albedo, Rf0 );
+                float NoV = abs( dot( materialProps.N, geometryProps.V ) );
+                float3 Fenv = BRDF::EnvironmentTerm_Rtg( Rf0, NoV, materialProps.roughness );
 
-                    float NoV = abs( dot( materialProps.N, geometryProps.V ) );
-                    float3 Fenv = BRDF::EnvironmentTerm_Rtg( Rf0, NoV, materialProps.roughness );
+                psrThroughput *= Fenv;
+            #endif
 
-                    psrThroughput *= Fenv;
-                #endif
+            // Abort if expected contribution of the current bounce is low
+            if( PT_PSR_THROUGHPUT_THRESHOLD != 0.0 && Color::Luminance( psrThroughput ) < PT_PSR_THROUGHPUT_THRESHOLD )
+                break;
 
-                // Abort if expected contribution of the current bounce is low
-                if( PT_PSR_THROUGHPUT_THRESHOLD != 0.0 && Color::Luminance( psrThroughput ) < PT_PSR_THROUGHPUT_THRESHOLD )
-                    break;
+            // Trace to the next hit
+            float2 mipAndCone = GetConeAngleFromRoughness( geometryProps.mip, materialProps.roughness );
+            geometryProps = CastRay( geometryProps.GetXoffset( geometryProps.N ), ray, 0.0, INF, mipAndCone, gWorldTlas, desc.instanceInclusionMask, desc.rayFlags );
+            materialProps = GetMaterialProps( geometryProps );
+        }
 
-                // Trace to the next hit
-                float2 mipAndCone = GetConeAngleFromRoughness( geometryProps.mip, materialProps.roughness );
-                geometryProps = CastRay( geometryProps.GetXoffset( geometryProps.N ), ray, 0.0, INF, mipAndCone, gWorldTlas, desc.instanceInclusionMask, desc.rayFlags );
-                materialProps = GetMaterialProps( geometryProps );
-            }
+        // Hit point
+        {
+            // Accumulate hit distance representing virtual point position ( see "README/NOISY INPUTS" )
+            accumulatedHitDist += ApplyThinLensEquation( geometryProps.hitT, accumulatedCurvature ) ;
+        }
 
-            // Hit point
-            {
-                // Accumulate hit distance representing virtual point position ( see "README/NOISY INPUTS" )
-                accumulatedHitDist += ApplyThinLensEquation( geometryProps.hitT, accumulatedCurvature ) ;
-            }
+        desc.bounceNum--;
+    }
 
-            desc.bounceNum--;
-        }
+    if( isPSR )
+    {
+        // Update materials, direct lighting and emission
+        float3 psrNormal = float3( 0, 0, 1 );
+        uint materialID = materialProps.metalness < 0.5 ? MATERIAL_ID_DEFAULT : MATERIAL_ID_METAL;
 
-        if( isPSR )
+        if( !geometryProps.IsSky( ) )
         {
-            // Update materials, direct lighting and emission
-            float3 psrNormal = float3( 0, 0, 1 );
-            uint materialID = materialProps.metalness < 0.5 ? MATERIAL_ID_DEFAULT : MATERIAL_ID_METAL;
+            psrNormal = Geometry::RotateVectorInverse( mirrorMatrix, materialProps.N );
 
-            if( !geometryProps.IsSky( ) )
-            {
-                psrNormal = Geometry::RotateVectorInverse( mirrorMatrix, materialProps.N );
+            gOut_BaseColor_Metalness[ desc.pixelPos ] = float4( Color::ToSrgb( materialProps.baseColor ), materialProps.metalness );
 
-                gOut_BaseColor_Metalness[ desc.pixelPos ] = float4( Color::ToSrgb( materialProps.baseColor ), materialProps.metalness );
+            // L1 cache - reproject previous frame, carefully treating specular
+            Lpsr = GetRadianceFromPreviousFrame( geometryProps, materialProps, desc.pixelPos, false );
 
-                // L1 cache - reproject previous frame, carefully treating specular
-                Lpsr = GetRadianceFromPreviousFrame( geometryProps, materialProps, desc.pixelPos, false );
+            // L2 cache - SHARC
+            HashGridParameters hashGridParams;
+            hashGridParams.cameraPosition = gCameraGlobalPos.xyz;
+            hashGridParams.sceneScale = SHARC_SCENE_SCALE;
+            hashGridParams.logarithmBase = SHARC_GRID_LOGARITHM_BASE;
+            hashGridParams.levelBias = SHARC_GRID_LEVEL_BIAS;
 
-                // L2 cache - SHARC
-                HashGridParameters hashGridParams;
-                hashGridParams.cameraPosition = gCameraGlobalPos.xyz;
-                hashGridParams.sceneScale = SHARC_SCENE_SCALE;
-                hashGridParams.logarithmBase = SHARC_GRID_LOGARITHM_BASE;
-                hashGridParams.levelBias = SHARC_GRID_LEVEL_BIAS;
+            float3 Xglobal = GetGlobalPos( geometryProps.X );
+            uint level = HashGridGetLevel( Xglobal, hashGridParams );
+            float voxelSize = HashGridGetVoxelSize( level, hashGridParams );
+            float smc = GetSpecMagicCurve( materialProps.roughness );
 
-                float3 Xglobal = GetGlobalPos( geometryProps.X );
-                uint level = HashGridGetLevel( Xglobal, hashGridParams );
-                float voxelSize = HashGridGetVoxelSize( level, hashGridParams );
-                float smc = GetSpecMagicCurve( materialProps.roughness );
+            float3x3 mBasis = Geometry::GetBasis( geometryProps.N );
+            float2 rndScaled = ( Rng::Hash::GetFloat2( ) - 0.5 ) * voxelSize * USE_SHARC_DITHERING;
+            Xglobal += mBasis[ 0 ] * rndScaled.x + mBasis[ 1 ] * rndScaled.y;
 
-                float3x3 mBasis = Geometry::GetBasis( geometryProps.N );
-                float2 rndScaled = ( Rng::Hash::GetFloat2( ) - 0.5 ) * voxelSize * USE_SHARC_DITHERING;
-                Xglobal += mBasis[ 0 ] * rndScaled.x + mBasis[ 1 ] * rndScaled.y;
+            SharcHitData sharcHitData;
+            sharcHitData.positionWorld = Xglobal;
+            sharcHitData.normalWorld = geometryProps.N;
 
-                SharcHitData sharcHitData;
-                sharcHitData.positionWorld = Xglobal;
-                sharcHitData.normalWorld = geometryProps.N;
+            HashMapData hashMapData;
+            hashMapData.capacity = gSharcCapacity;
+            hashMapData.hashEntriesBuffer = gInOut_SharcHashEntriesBuffer;
 
-                HashMapData hashMapData;
-                hashMapData.capacity = SHARC_CAPACITY;
-                hashMapData.hashEntriesBuffer = gInOut_SharcHashEntriesBuffer;
+            SharcParameters sharcParams;
+            sharcParams.gridParameters = hashGridParams;
+            sharcParams.hashMapData = hashMapData;
+            sharcParams.enableAntiFireflyFilter = SHARC_ANTI_FIREFLY;
+            sharcParams.voxelDataBuffer = gInOut_SharcVoxelDataBuffer;
+            sharcParams.voxelDataBufferPrev = gInOut_SharcVoxelDataBufferPrev;
 
-                SharcParameters sharcParams;
-                sharcParams.gridParameters = hashGridParams;
-                sharcParams.hashMapData = hashMapData;
-                sharcParams.enableAntiFireflyFilter = SHARC_ANTI_FIREFLY;
-                sharcParams.voxelDataBuffer = gInOut_SharcVoxelDataBuffer;
-                sharcParams.voxelDataBufferPrev = gInOut_SharcVoxelDataBufferPrev;
+            bool isSharcAllowed = gSHARC && NRD_MODE < OCCLUSION; // trivial
+            isSharcAllowed &= Rng::Hash::GetFloat( ) > Lpsr.w; // probabilistically estimate the need
+            isSharcAllowed &= geometryProps.hitT > voxelSize; // voxel angular size is acceptable
+            isSharcAllowed &= desc.bounceNum == 0; // allow only for the last bounce for PSR
 
-                bool isSharcAllowed = gSHARC && NRD_MODE < OCCLUSION; // trivial
-                isSharcAllowed &= Rng::Hash::GetFloat( ) > Lpsr.w; // probabilistically estimate the need
-                isSharcAllowed &= geometryProps.hitT > voxelSize; // voxel angular size is acceptable
-                isSharcAllowed &= desc.bounceNum == 0; // allow only for the last bounce for PSR
+            float3 sharcRadiance;
+            if (isSharcAllowed && SharcCountQuery( SHARC_STAT_OPAQUE_QUERIES, SharcGetCachedRadiance( sharcParams, sharcHitData, sharcRadiance, false) ))
+                Lpsr = float4( sharcRadiance, 1.0 );
 
-                float3 sharcRadiance;
-                if (isSharcAllowed && SharcGetCachedRadiance( sharcParams, sharcHitData, sharcRadiance, false))
-                    Lpsr = float4( sharcRadiance, 1.0 );
+            // TODO: add a macro switch for old mode ( with coupled direct lighting )
 
-                // TODO: add a macro switch for old mode ( with coupled direct lighting )
+            // Subtract direct lighting, process it separately
+            float3 L = GetShadowedLighting( geometryProps, materialProps );
 
-                // Subtract direct lighting, process it separately
-                float3 L = GetShadowedLighting( geometryProps, materialProps );
+            if( desc.bounceNum != 0 )
+                Lpsr.xyz *= Lpsr.w;
 
-                if( desc.bounceNum != 0 )
-                    Lpsr.xyz *= Lpsr.w;
+            Lpsr.xyz = max( Lpsr.xyz - L, 0.0 );
 
-                Lpsr.xyz = max( Lpsr.xyz - L, 0.0 );
+            gOut_DirectLighting[ desc.pixelPos ] = materialProps.Ldirect * psrThroughput;
+        }
 
-                gOut_DirectLighting[ desc.pixelPos ] = materialProps.Ldirect * psrThroughput;
-            }
+        gOut_DirectEmission[ desc.pixelPos ] = materialProps.Lemi * psrThroughput;
+        gOut_Normal_Roughness[ desc.pixelPos ] = NRD_FrontEnd_PackNormalAndRoughness( psrNormal, materialProps.roughness, materialID );
 
-            gOut_DirectEmission[ desc.pixelPos ] = materialProps.Lemi * psrThroughput;
-            gOut_Normal_Roughness[ desc.pixelPos ] = NRD_FrontEnd_PackNormalAndRoughness( psrNormal, materialProps.roughness, materialID );
+        // PSR - Update motion
+        float3 Xvirtual = desc.geometryProps.X - desc.geometryProps.V * accumulatedHitDist;
+        float3 XvirtualPrev = Xvirtual + geometryProps.Xprev - geometryProps.X;
+        float3 motion = GetMotion( Xvirtual, XvirtualPrev );
 
-            // PSR - Update motion
-            float3 Xvirtual = desc.geometryProps.X - desc.geometryProps.V * accumulatedHitDist;
-            float3 XvirtualPrev = Xvirtual + geometryProps.Xprev - geometryProps.X;
-            float3 motion = GetMotion( Xvirtual, XvirtualPrev );
+        gOut_Mv[ desc.pixelPos ].xyz = motion; // IMPORTANT: keep viewZ before PSR ( needed for glass )
 
-            gOut_Mv[ desc.pixelPos ].xyz = motion; // IMPORTANT: keep viewZ before PSR ( needed for glass )
+        // PSR - Update viewZ
+        viewZ = Geometry::AffineTransform( gWorldToView, Xvirtual ).z;
+        viewZ = geometryProps.IsSky( ) ? Math::Sign( viewZ ) * INF : viewZ;
 
-            // PSR - Update viewZ
-            viewZ = Geometry::AffineTransform( gWorldToView, Xvirtual ).z;
-            viewZ = geometryProps.IsSky( ) ? Math::Sign( viewZ ) * INF : viewZ;
+        gOut_ViewZ[ desc.pixelPos ] = EncodeViewZ( viewZ );
 
-            gOut_ViewZ[ desc.pixelPos ] = viewZ;
+        // PSR - Replace primary surface props with the replacement props
+        desc.geometryProps = geometryProps;
+        desc.materialProps = materialProps;
+    }
 
-            // PSR - Replace primary surface props with the replacement props
-            desc.geometryProps = geometryProps;
-            desc.materialProps = materialProps;
-        }
+    gOut_PsrThroughput[ desc.pixelPos ] = psrThroughput;
+
+    return Lpsr;
+}
+
+//=====================================================================================================================================================================
+// Tracing from the primary hit or PSR
+//=====================================================================================================================================================================
+
+PathState BeginPath( TraceOpaqueDesc desc, float4 Lpsr, uint path )
+{
+    PathState pathState = ( PathState )0;
+    pathState.isDiffusePath = TRACING_MODE == RESOLUTION_HALF ? desc.checkerboard : ( path & 0x1 );
+
+    float diffProb0 = EstimateDiffuseProbability( desc.geometryProps, desc.materialProps ) * float( !desc.geometryProps.Has( FLAG_HAIR ) );
+    pathState.Lsum = Lpsr.xyz * ( TRACING_MODE == RESOLUTION_FULL ? ( pathState.isDiffusePath ? diffProb0 : ( 1.0 - diffProb0 ) ) : 1.0 );
+    pathState.throughput = 1.0 - Lpsr.w;
+
+    return pathState;
+}
+
+// Origin point: chooses a lobe and a ray for the bounce, returns "false" if the path is terminated
+bool SampleBounce( inout PathState pathState, inout GeometryProps geometryProps, inout MaterialProps materialProps, TraceOpaqueDesc desc, float3x3 mirrorMatrix, uint path, uint bounce, out float3 ray, out float2 mipAndCone )
+{
+    uint2 blueNoisePos = desc.pixelPos + uint2( Sequence::Weyl2D( 0.0, path ) * ( BLUE_NOISE_SPATIAL_DIM - 1 ) );
+
+    ray = 0;
+    mipAndCone = 0;
+    pathState.isDiffuse = pathState.isDiffusePath;
 
-        gOut_PsrThroughput[ desc.pixelPos ] = psrThroughput;
+    // Estimate diffuse probability
+    float diffuseProbability = EstimateDiffuseProbability( geometryProps, materialProps ) * float( !geometryProps.Has( FLAG_HAIR ) );
+
+    // Clamp probability to a sane range to guarantee a sample in 3x3 ( or 5x5 ) area ( see NRD docs )
+    float rnd = Rng::Hash::GetFloat( );
+    if( TRACING_MODE == RESOLUTION_FULL_PROBABILISTIC && bounce == 1 && !gRR )
+    {
+        diffuseProbability = float( diffuseProbability != 0.0 ) * clamp( diffuseProbability, gMinProbability, 1.0 - gMinProbability );
+        rnd = Sequence::Bayer4x4( desc.pixelPos, gFrameIndex ) + rnd / 16.0;
     }
-    #endif
 
-    //=====================================================================================================================================================================
-    // Tracing from the primary hit or PSR
-    //=====================================================================================================================================================================
+    // Diffuse or specular path?
+    if( TRACING_MODE == RESOLUTION_FULL_PROBABILISTIC || bounce > 1 )
+    {
+        pathState.isDiffuse = rnd < diffuseProbability; // TODO: if "diffuseProbability" is clamped, "throughput" should be adjusted too
+        pathState.throughput /= abs( float( !pathState.isDiffuse ) - diffuseProbability );
 
-    TraceOpaqueResult result = ( TraceOpaqueResult )0;
+        if( bounce == 1 )
+            pathState.isDiffusePath = pathState.isDiffuse;
+    }
 
-    #if( NRD_MODE < OCCLUSION )
-        result.specHitDist = NRD_FrontEnd_SpecHitDistAveraging_Begin( );
-    #endif
+    mipAndCone = GetConeAngleFromRoughness( geometryProps.mip, pathState.isDiffuse ? 1.0 : materialProps.roughness );
 
-    uint pathNum = desc.pathNum << ( gTracingMode == RESOLUTION_FULL ? 1 : 0 );
-    uint diffPathsNum = 0;
+    // Choose a ray
+    float3x3 mLocalBasis = geometryProps.Has( FLAG_HAIR ) ? HairGetBasis( materialProps.N, materialProps.T ) : Geometry::GetBasis( materialProps.N );
 
-    [loop]
-    for( uint path = 0; path < pathNum; path++ )
+    float3 Vlocal = Geometry::RotateVector( mLocalBasis, geometryProps.V );
+    ray = 0;
+    uint samplesNum = 0;
+
+    // If IS is enabled, generate up to PT_IMPORTANCE_SAMPLES_NUM rays depending on roughness
+    // If IS is disabled, there is no need to generate up to PT_IMPORTANCE_SAMPLES_NUM rays for specular because VNDF v3 doesn't produce rays pointing inside the surface
+    uint maxSamplesNum = 0;
+    if( bounce == 1 && gDisableShadowsAndEnableImportanceSampling && NRD_MODE < OCCLUSION ) // TODO: use IS in each bounce?
+        maxSamplesNum = PT_IMPORTANCE_SAMPLES_NUM * ( pathState.isDiffuse ? 1.0 : materialProps.roughness );
+    maxSamplesNum = max( maxSamplesNum, 1 );
+
+    if( geometryProps.Has( FLAG_HAIR ) && NRD_MODE < OCCLUSION )
     {
-        GeometryProps geometryProps = desc.geometryProps;
-        MaterialProps materialProps = desc.materialProps;
+        if( pathState.isDiffuse )
+            return false;
 
-        float accumulatedHitDist = 0;
-        float accumulatedDiffuseLikeMotion = 0;
-        float accumulatedCurvature = 0;
+        HairSurfaceData hairSd = ( HairSurfaceData )0;
+        hairSd.N = float3( 0, 0, 1 );
+        hairSd.T = float3( 1, 0, 0 );
+        hairSd.V = Vlocal;
 
-        bool isDiffusePath = gTracingMode == RESOLUTION_HALF ? desc.checkerboard : ( path & 0x1 );
-        uint2 blueNoisePos = desc.pixelPos + uint2( Sequence::Weyl2D( 0.0, path ) * ( BLUE_NOISE_SPATIAL_DIM - 1 ) );
+        HairData hairData = ( HairData )0;
+        hairData.baseColor = materialProps.baseColor;
+        hairData.betaM = materialProps.roughness;
+        hairData.betaN = materialProps.metalness;
 
-        float diffProb0 = EstimateDiffuseProbability( geometryProps, materialProps ) * float( !geometryProps.Has( FLAG_HAIR ) );
-        float3 Lsum = Lpsr.xyz * ( gTracingMode == RESOLUTION_FULL ? ( isDiffusePath ? diffProb0 : ( 1.0 - diffProb0 ) ) : 1.0 );
-        float3 pathThroughput = 1.0 - Lpsr.w;
+        HairContext hairBrdf = HairContextInit( hairSd, hairData );
 
-        [loop]
-        for( uint bounce = 1; bounce <= desc.bounceNum && !geometryProps.IsSky( ); bounce++ )
+        float3 r;
+        float pdf = HairSampleRay( hairBrdf, Vlocal, Rng::Hash::GetFloat4( ), r );
+
+        float3 throughput = HairEval( hairBrdf, Vlocal, r ) / pdf;
+        pathState.throughput *= throughput;
+
+        ray = Geometry::RotateVectorInverse( mLocalBasis, r );
+    }
+    else
+    {
+        for( uint sampleIndex = 0; sampleIndex < maxSamplesNum; sampleIndex++ )
         {
-            //=============================================================================================================================================================
-            // Origin point
-            //=============================================================================================================================================================
+            #if( NRD_MODE < OCCLUSION )
+                float2 rnd = Rng::Hash::GetFloat2( );
+            #else
+                float2 rnd = GetBlueNoise( blueNoisePos, TRACING_MODE == RESOLUTION_HALF );
+            #endif
 
-            bool isDiffuse = isDiffusePath;
+            // Generate a ray in local space
+            float3 r;
+            if( pathState.isDiffuse )
+                r = ImportanceSampling::Cosine::GetRay( rnd );
+            else
             {
-                // Estimate diffuse probability
-                float diffuseProbability = EstimateDiffuseProbability( geometryProps, materialProps ) * float( !geometryProps.Has( FLAG_HAIR ) );
+                float3 Hlocal = ImportanceSampling::VNDF::GetRay( rnd, materialProps.roughness, Vlocal, gTrimLobe ? PT_SPEC_LOBE_ENERGY : 1.0 );
+                r = reflect( -Vlocal, Hlocal );
+            }
 
-                // Clamp probability to a sane range to guarantee a sample in 3x3 ( or 5x5 ) area ( see NRD docs )
-                float rnd = Rng::Hash::GetFloat( );
-                if( gTracingMode == RESOLUTION_FULL_PROBABILISTIC && bounce == 1 && !gRR )
-                {
-                    diffuseProbability = float( diffuseProbability != 0.0 ) * clamp( diffuseProbability, gMinProbability, 1.0 - gMinProbability );
-                    rnd = Sequence::Bayer4x4( desc.pixelPos, gFrameIndex ) + rnd / 16.0;
-                }
+            // Transform to world space
+            r = Geometry::RotateVectorInverse( mLocalBasis, r );
 
-                // Diffuse or specular path?
-                if( gTracingMode == RESOLUTION_FULL_PROBABILISTIC || bounce > 1 )
-                {
-                    isDiffuse = rnd < diffuseProbability; // TODO: if "diffuseProbability" is clamped, "pathThroughput" should be adjusted too
-                    pathThroughput /= abs( float( !isDiffuse ) - diffuseProbability );
+            // Importance sampling for direct lighting
+            // TODO: move direct lighting tracing into a separate pass:
+            // - currently AO and SO get replaced with useless distances to closest lights if IS is on
+            // - better separate direct and indirect lighting denoising
 
-                    if( bounce == 1 )
-                        isDiffusePath = isDiffuse;
-                }
+            //   1. If IS enabled, check the ray in LightBVH
+            bool isMiss = false;
+            if( gDisableShadowsAndEnableImportanceSampling && maxSamplesNum != 1 )
+                isMiss = CastVisibilityRay_AnyHit( geometryProps.GetXoffset( geometryProps.N ), r, 0.0, INF, mipAndCone, gLightTlas, desc.instanceInclusionMask, desc.rayFlags );
 
-                float2 mipAndCone = GetConeAngleFromRoughness( geometryProps.mip, isDiffuse ? 1.0 : materialProps.roughness );
+            //   2. Count rays hitting emissive surfaces
+            if( !isMiss )
+                samplesNum++;
 
-                // Choose a ray
-                float3x3 mLocalBasis = geometryProps.Has( FLAG_HAIR ) ? HairGetBasis( materialProps.N, materialProps.T ) : Geometry::GetBasis( materialProps.N );
+            //   3. Save either the first ray or the current ray hitting an emissive
+            if( !isMiss || sampleIndex == 0 )
+                ray = r;
+        }
+    }
 
-                float3 Vlocal = Geometry::RotateVector( mLocalBasis, geometryProps.V );
-                float3 ray = 0;
-                uint samplesNum = 0;
+    // Adjust throughput by percentage of rays hitting any emissive surface
+    // IMPORTANT: do not modify throughput if there is no a hit, it's needed to cast a non-IS ray and get correct AO / SO at least
+    if( samplesNum != 0 )
+        pathState.throughput *= float( samplesNum ) / float( maxSamplesNum );
 
-                // If IS is enabled, generate up to PT_IMPORTANCE_SAMPLES_NUM rays depending on roughness
-                // If IS is disabled, there is no need to generate up to PT_IMPORTANCE_SAMPLES_NUM rays for specular because VNDF v3 doesn't produce rays pointing inside the surface
-                uint maxSamplesNum = 0;
-                if( bounce == 1 && gDisableShadowsAndEnableImportanceSampling && NRD_MODE < OCCLUSION ) // TODO: use IS in each bounce?
-                    maxSamplesNum = PT_IMPORTANCE_SAMPLES_NUM * ( isDiffuse ? 1.0 : materialProps.roughness );
-                maxSamplesNum = max( maxSamplesNum, 1 );
+    // ( Optional ) Helpful insignificant fixes
+    float a = dot( geometryProps.N, ray );
+    if( !geometryProps.Has( FLAG_HAIR ) && a < 0.0 )
+    {
+        if( pathState.isDiffuse )
+        {
+            // Terminate diffuse paths pointing inside the surface
+            pathState.throughput = 0.0;
+        }
+        else
+        {
+            // Patch ray direction and shading normal to avoid self-intersections: https://arxiv.org/pdf/1705.01263.pdf ( Appendix 3 )
+            float b = abs( dot( geometryProps.N, materialProps.N ) ) * 0.99;
 
-                if( geometryProps.Has( FLAG_HAIR ) && NRD_MODE < OCCLUSION )
-                {
-                    if( isDiffuse )
-                        break;
+            ray = normalize( ray + geometryProps.N * abs( a ) * Math::PositiveRcp( b ) );
+            materialProps.N = normalize( geometryProps.V + ray );
+        }
+    }
 
-                    HairSurfaceData hairSd = ( HairSurfaceData )0;
-                    hairSd.N = float3( 0, 0, 1 );
-                    hairSd.T = float3( 1, 0, 0 );
-                    hairSd.V = Vlocal;
+    // ( Optional ) Save sampling direction for the 1st bounce
+    #if( NRD_MODE == SH || NRD_MODE == DIRECTIONAL_OCCLUSION )
+        if( bounce == 1 )
+        {
+            float3 psrRay = ray;
+            #if( USE_PSR_PERMUTATION == 1 )
+                psrRay = Geometry::RotateVectorInverse( mirrorMatrix, ray );
+            #endif
 
-                    HairData hairData = ( HairData )0;
-                    hairData.baseColor = materialProps.baseColor;
-                    hairData.betaM = materialProps.roughness;
-                    hairData.betaN = materialProps.metalness;
+            pathState.direction = psrRay;
+        }
+    #endif
 
-                    HairContext hairBrdf = HairContextInit( hairSd, hairData );
+    // Update path throughput
+    #if( NRD_MODE < OCCLUSION )
+        if( !geometryProps.Has( FLAG_HAIR ) )
+        {
+            float3 albedo, Rf0;
+            BRDF::ConvertBaseColorMetalnessToAlbedoRf0( materialProps.baseColor, materialProps.metalness, albedo, Rf0 );
 
-                    float3 r;
-                    float pdf = HairSampleRay( hairBrdf, Vlocal, Rng::Hash::GetFloat4( ), r );
+            float3 H = normalize( geometryProps.V + ray );
+            float VoH = abs( dot( geometryProps.V, H ) );
+            float NoL = saturate( dot( materialProps.N, ray ) );
 
-                    float3 throughput = HairEval( hairBrdf, Vlocal, r ) / pdf;
-                    pathThroughput *= throughput;
+            if( pathState.isDiffuse )
+            {
+                float NoV = abs( dot( materialProps.N, geometryProps.V ) );
+                pathState.throughput *= saturate( albedo * Math::Pi( 1.0 ) * BRDF::DiffuseTerm_Burley( materialProps.roughness, NoL, NoV, VoH ) );
+            }
+            else
+            {
+                float3 F = BRDF::FresnelTerm_Schlick( Rf0, VoH );
+                pathState.throughput *= F;
 
-                    ray = Geometry::RotateVectorInverse( mLocalBasis, r );
-                }
-                else
+                // See paragraph "Usage in Monte Carlo renderer" from http://jcgt.org/published/0007/04/01/paper.pdf
+                pathState.throughput *= BRDF::GeometryTerm_Smith( materialProps.roughness, NoL );
+            }
+
+            // Translucency
+            if( USE_TRANSLUCENCY && geometryProps.Has( FLAG_LEAF ) && pathState.isDiffuse )
+            {
+                if( Rng::Hash::GetFloat( ) < LEAF_TRANSLUCENCY )
                 {
-                    for( uint sampleIndex = 0; sampleIndex < maxSamplesNum; sampleIndex++ )
-                    {
-                        #if( NRD_MODE < OCCLUSION )
-                            float2 rnd = Rng::Hash::GetFloat2( );
-                        #else
-                            float2 rnd = GetBlueNoise( blueNoisePos, gTracingMode == RESOLUTION_HALF );
-                        #endif
-
-                        // Generate a ray in local space
-                        float3 r;
-                        if( isDiffuse )
-                            r = ImportanceSampling::Cosine::GetRay( rnd );
-                        else
-                        {
-                            float3 Hlocal = ImportanceSampling::VNDF::GetRay( rnd, materialProps.roughness, Vlocal, gTrimLobe ? PT_SPEC_LOBE_ENERGY : 1.0 );
-                            r = reflect( -Vlocal, Hlocal );
-                        }
-
-                        // Transform to world space
-                        r = Geometry::RotateVectorInverse( mLocalBasis, r );
-
-                        // Importance sampling for direct lighting
-                        // TODO: move direct lighting tracing into a separate pass:
-                        // - currently AO and SO get replaced with useless distances to closest lights if IS is on
-                        // - better separate direct and indirect lighting denoising
-
-                        //   1. If IS enabled, check the ray in LightBVH
-                        bool isMiss = false;
-                        if( gDisableShadowsAndEnableImportanceSampling && maxSamplesNum != 1 )
-                            isMiss = CastVisibilityRay_AnyHit( geometryProps.GetXoffset( geometryProps.N ), r, 0.0, INF, mipAndCone, gLightTlas, desc.instanceInclusionMask, desc.rayFlags );
-
-                        //   2. Count rays hitting emissive surfaces
-                        if( !isMiss )
-                            samplesNum++;
-
-                        //   3. Save either the first ray or the current ray hitting an emissive
-                        if( !isMiss || sampleIndex == 0 )
-                            ray = r;
-                    }
+                    ray = -ray;
+                    geometryProps.X -= LEAF_THICKNESS * geometryProps.N;
+                    pathState.throughput /= LEAF_TRANSLUCENCY;
                 }
+                else
+                    pathState.throughput /= 1.0 - LEAF_TRANSLUCENCY;
+            }
+        }
+    #endif
 
-                // Adjust throughput by percentage of rays hitting any emissive surface
-                // IMPORTANT: do not modify throughput if there is no a hit, it's needed to cast a non-IS ray and get correct AO / SO at least
-                if( samplesNum != 0 )
-                    pathThroughput *= float( samplesNum ) / float( maxSamplesNum );
+    // Abort if expected contribution of the current bounce is low
+    #if( USE_RUSSIAN_ROULETTE == 1 )
+        /*
+        BAD PRACTICE:
+        Russian Roulette approach is here to demonstrate that it's a bad practice for real time denoising for the following reasons:
+        - increases entropy of the signal
+        - transforms radiance into non-radiance, which is strictly speaking not allowed to be processed spatially (who wants to get a high energy firefly
+        redistributed around surrounding pixels?)
+        - not necessarily converges to the right image, because we do assumptions about the future and approximate the tail of the path via a scaling factor
+        - this approach breaks denoising, especially REBLUR, which has been designed to work with pure radiance
+        */
+
+        // Nevertheless, RR can be used with caution: the code below tuned for good IQ / PERF tradeoff
+        float russianRouletteProbability = Color::Luminance( pathState.throughput );
+        russianRouletteProbability = Math::Pow01( russianRouletteProbability, 0.25 );
+        russianRouletteProbability = max( russianRouletteProbability, 0.01 );
+
+        if( Rng::Hash::GetFloat( ) > russianRouletteProbability )
+            return false;
+
+        pathState.throughput /= russianRouletteProbability;
+    #else
+        /*
+        GOOD PRACTICE:
+        - terminate path if "throughput" is smaller than some threshold
+        - approximate ambient at the end of the path
+        - re-use data from the previous frame
+        */
+
+        if( PT_THROUGHPUT_THRESHOLD != 0.0 && Color::Luminance( pathState.throughput ) < PT_THROUGHPUT_THRESHOLD )
+            return false;
+    #endif
 
-                // ( Optional ) Helpful insignificant fixes
-                float a = dot( geometryProps.N, ray );
-                if( !geometryProps.Has( FLAG_HAIR ) && a < 0.0 )
-                {
-                    if( isDiffuse )
-                    {
-                        // Terminate diffuse paths pointing inside the surface
-                        pathThroughput = 0.0;
-                    }
-                    else
-                    {
-                        // Patch ray direction and shading normal to avoid self-intersections: https://arxiv.org/pdf/1705.01263.pdf ( Appendix 3 )
-                        float b = abs( dot( geometryProps.N, materialProps.N ) ) * 0.99;
-
-                        ray = normalize( ray + geometryProps.N * abs( a ) * Math::PositiveRcp( b ) );
-                        materialProps.N = normalize( geometryProps.V + ray );
-                    }
-                }
+    return true;
+}
 
-                // ( Optional ) Save sampling direction for the 1st bounce
-                #if( NRD_MODE == SH || NRD_MODE == DIRECTIONAL_OCCLUSION )
-                    if( bounce == 1 )
-                    {
-                        float3 psrRay = ray;
-                        #if( USE_PSR == 1 )
-                            psrRay = Geometry::RotateVectorInverse( mirrorMatrix, ray );
-                        #endif
-
-                        if( isDiffuse )
-                            result.diffDirection += psrRay;
-                        else
-                            result.specDirection += psrRay;
-                    }
-                #endif
-
-                // Update path throughput
-                #if( NRD_MODE < OCCLUSION )
-                    if( !geometryProps.Has( FLAG_HAIR ) )
-                    {
-                        float3 albedo, Rf0;
-                        BRDF::ConvertBaseColorMetalnessToAlbedoRf0( materialProps.baseColor, materialProps.metalness, albedo, Rf0 );
-
-                        float3 H = normalize( geometryProps.V + ray );
-                        float VoH = abs( dot( geometryProps.V, H ) );
-                        float NoL = saturate( dot( materialProps.N, ray ) );
-
-                        if( isDiffuse )
-                        {
-                            float NoV = abs( dot( materialProps.N, geometryProps.V ) );
-                            pathThroughput *= saturate( albedo * Math::Pi( 1.0 ) * BRDF::DiffuseTerm_Burley( materialProps.roughness, NoL, NoV, VoH ) );
-                        }
-                        else
-                        {
-                            float3 F = BRDF::FresnelTerm_Schlick( Rf0, VoH );
-                            pathThroughput *= F;
-
-                            // See paragraph "Usage in Monte Carlo renderer" from http://jcgt.org/published/0007/04/01/paper.pdf
-                            pathThroughput *= BRDF::GeometryTerm_Smith( materialProps.roughness, NoL );
-                        }
-
-                        // Translucency
-                        if( USE_TRANSLUCENCY && geometryProps.Has( FLAG_LEAF ) && isDiffuse )
-                        {
-                            if( Rng::Hash::GetFloat( ) < LEAF_TRANSLUCENCY )
-                            {
-                                ray = -ray;
-                                geometryProps.X -= LEAF_THICKNESS * geometryProps.N;
-                                pathThroughput /= LEAF_TRANSLUCENCY;
-                            }
-                            else
-                                pathThroughput /= 1.0 - LEAF_TRANSLUCENCY;
-                        }
-                    }
-                #endif
-
-                // Abort if expected contribution of the current bounce is low
-                #if( USE_RUSSIAN_ROULETTE == 1 )
-                    /*
-                    BAD PRACTICE:
-                    Russian Roulette approach is here to demonstrate that it's a bad practice for real time denoising for the following reasons:
-                    - increases entropy of the signal
-                    - transforms radiance into non-radiance, which is strictly speaking not allowed to be processed spatially (who wants to get a high energy firefly
-                    redistributed around surrounding pixels?)
-                    - not necessarily converges to the right image, because we do assumptions about the future and approximate the tail of the path via a scaling factor
-                    - this approach breaks denoising, especially REBLUR, which has been designed to work with pure radiance
-                    */
-
-                    // Nevertheless, RR can be used with caution: the code below tuned for good IQ / PERF tradeoff
-                    float russianRouletteProbability = Color::Luminance( pathThroughput );
-                    russianRouletteProbability = Math::Pow01( russianRouletteProbability, 0.25 );
-                    russianRouletteProbability = max( russianRouletteProbability, 0.01 );
-
-                    if( Rng::Hash::GetFloat( ) > russianRouletteProbability )
-                        break;
-
-                    pathThroughput /= russianRouletteProbability;
-                #else
-                    /*
-                    GOOD PRACTICE:
-                    - terminate path if "pathThroughput" is smaller than some threshold
-                    - approximate ambient at the end of the path
-                    - re-use data from the previous frame
-                    */
-
-                    if( PT_THROUGHPUT_THRESHOLD != 0.0 && Color::Luminance( pathThroughput ) < PT_THROUGHPUT_THRESHOLD )
-                        break;
-                #endif
-
-                //=========================================================================================================================================================
-                // Trace to the next hit
-                //=========================================================================================================================================================
-
-                geometryProps = CastRay( geometryProps.GetXoffset( geometryProps.N ), ray, 0.0, INF, mipAndCone, gWorldTlas, desc.instanceInclusionMask, desc.rayFlags );
-                materialProps = GetMaterialProps( geometryProps ); // TODO: try to read metrials only if L1- and L2- lighting caches failed
-            }
+// Hit point: lighting and path length, returns "false" if the rest of the path is not needed
+bool ShadeHit( inout PathState pathState, GeometryProps geometryProps, MaterialProps materialProps, TraceOpaqueDesc desc, uint bounce )
+{
+    //=============================================================================================================================================================
+    // Lighting
+    //=============================================================================================================================================================
+
+    float4 Lcached = 0;
+    bool isSharcHit = false;
+    bool isSharcLodHit = false;
+    if( !geometryProps.IsSky( ) )
+    {
+        // L1 cache - reproject previous frame, carefully treating specular
+        Lcached = GetRadianceFromPreviousFrame( geometryProps, materialProps, desc.pixelPos, false );
+
+        // L2 cache - SHARC
+        HashGridParameters hashGridParams;
+        hashGridParams.cameraPosition = gCameraGlobalPos.xyz;
+        hashGridParams.sceneScale = SHARC_SCENE_SCALE;
+        hashGridParams.logarithmBase = SHARC_GRID_LOGARITHM_BASE;
+        hashGridParams.levelBias = SHARC_GRID_LEVEL_BIAS;
+
+        float3 Xglobal = GetGlobalPos( geometryProps.X );
+        uint level = HashGridGetLevel( Xglobal, hashGridParams );
+        float voxelSize = HashGridGetVoxelSize( level, hashGridParams );
+        float smc = GetSpecMagicCurve( materialProps.roughness );
+
+        // Path footprint: the cone of the sampled lobe widens at each bounce
+        float footprint = geometryProps.hitT * ImportanceSampling::GetSpecularLobeTanHalfAngle( ( pathState.isDiffuse || bounce == desc.bounceNum ) ? 1.0 : materialProps.roughness, 0.5 );
+        pathState.footprint += footprint;
+
+        // LOD: the coarsest level with voxels not exceeding the footprint ( populated by "SharcUpdate" )
+        uint lod = uint( clamp( floor( log2( pathState.footprint / voxelSize ) ), 0.0, SHARC_LOD_LEVEL_MAX ) );
+        HashGridParameters hashGridParamsNative = hashGridParams;
+        hashGridParams.sceneScale = SHARC_SCENE_SCALE / exp2( lod ); // voxels are "2 ^ lod" times larger...
+        hashGridParams.levelBias = SHARC_GRID_LEVEL_BIAS + lod; // ... and keep keys of the native level "level + lod"
+
+        float3x3 mBasis = Geometry::GetBasis( geometryProps.N );
+        float2 rndScaled = ( Rng::Hash::GetFloat2( ) - 0.5 ) * voxelSize * USE_SHARC_DITHERING;
+        Xglobal += mBasis[ 0 ] * rndScaled.x + mBasis[ 1 ] * rndScaled.y;
+
+        SharcHitData sharcHitData;
+        sharcHitData.positionWorld = Xglobal;
+        sharcHitData.normalWorld = geometryProps.N;
+
+        HashMapData hashMapData;
+        hashMapData.capacity = gSharcCapacity;
+        hashMapData.hashEntriesBuffer = gInOut_SharcHashEntriesBuffer;
+
+        SharcParameters sharcParams;
+        sharcParams.gridParameters = hashGridParams;
+        sharcParams.hashMapData = hashMapData;
+        sharcParams.enableAntiFireflyFilter = SHARC_ANTI_FIREFLY;
+        sharcParams.voxelDataBuffer = gInOut_SharcVoxelDataBuffer;
+        sharcParams.voxelDataBufferPrev = gInOut_SharcVoxelDataBufferPrev;
+
+        bool isSharcAllowed = gSHARC && NRD_MODE < OCCLUSION; // trivial
+        isSharcAllowed &= Rng::Hash::GetFloat( ) > Lcached.w; // probabilistically estimate the need
+
+        // Coarse levels: the path footprint covers at least "2 ^ lod" native voxels
+        float3 sharcRadiance;
+        if( isSharcAllowed && lod != 0 )
+        {
+            isSharcLodHit = SharcCountQuery( SHARC_STAT_OPAQUE_LOD_QUERIES, SharcGetCachedRadiance( sharcParams, sharcHitData, sharcRadiance, false ) );
 
-            //=============================================================================================================================================================
-            // Hit point
-            //=============================================================================================================================================================
+            // Coarse voxels can be missing, fall back to the native level
+            sharcParams.gridParameters = hashGridParamsNative;
+        }
 
-            {
-                //=============================================================================================================================================================
-                // Lighting
-                //=============================================================================================================================================================
+        // Native level: voxel angular size is acceptable
+        isSharcHit = isSharcLodHit;
+        if( isSharcAllowed && !isSharcHit && footprint > voxelSize )
+            isSharcHit = SharcCountQuery( SHARC_STAT_OPAQUE_QUERIES, SharcGetCachedRadiance( sharcParams, sharcHitData, sharcRadiance, false ) );
 
-                float4 Lcached = 0;
-                if( !geometryProps.IsSky( ) )
-                {
-                    // L1 cache - reproject previous frame, carefully treating specular
-                    Lcached = GetRadianceFromPreviousFrame( geometryProps, materialProps, desc.pixelPos, false );
-
-                    // L2 cache - SHARC
-                    HashGridParameters hashGridParams;
-                    hashGridParams.cameraPosition = gCameraGlobalPos.xyz;
-                    hashGridParams.sceneScale = SHARC_SCENE_SCALE;
-                    hashGridParams.logarithmBase = SHARC_GRID_LOGARITHM_BASE;
-                    hashGridParams.levelBias = SHARC_GRID_LEVEL_BIAS;
-
-                    float3 Xglobal = GetGlobalPos( geometryProps.X );
-                    uint level = HashGridGetLevel( Xglobal, hashGridParams );
-                    float voxelSize = HashGridGetVoxelSize( level, hashGridParams );
-                    float smc = GetSpecMagicCurve( materialProps.roughness );
-
-                    float3x3 mBasis = Geometry::GetBasis( geometryProps.N );
-                    float2 rndScaled = ( Rng::Hash::GetFloat2( ) - 0.5 ) * voxelSize * USE_SHARC_DITHERING;
-                    Xglobal += mBasis[ 0 ] * rndScaled.x + mBasis[ 1 ] * rndScaled.y;
-
-                    SharcHitData sharcHitData;
-                    sharcHitData.positionWorld = Xglobal;
-                    sharcHitData.normalWorld = geometryProps.N;
-
-                    HashMapData hashMapData;
-                    hashMapData.capacity = SHARC_CAPACITY;
-                    hashMapData.hashEntriesBuffer = gInOut_SharcHashEntriesBuffer;
-
-                    SharcParameters sharcParams;
-                    sharcParams.gridParameters = hashGridParams;
-                    sharcParams.hashMapData = hashMapData;
-                    sharcParams.enableAntiFireflyFilter = SHARC_ANTI_FIREFLY;
-                    sharcParams.voxelDataBuffer = gInOut_SharcVoxelDataBuffer;
-                    sharcParams.voxelDataBufferPrev = gInOut_SharcVoxelDataBufferPrev;
-
-                    float footprint = geometryProps.hitT * ImportanceSampling::GetSpecularLobeTanHalfAngle( ( isDiffuse || bounce == desc.bounceNum ) ? 1.0 : materialProps.roughness, 0.5 );
-                    bool isSharcAllowed = gSHARC && NRD_MODE < OCCLUSION; // trivial
-                    isSharcAllowed &= Rng::Hash::GetFloat( ) > Lcached.w; // probabilistically estimate the need
-                    isSharcAllowed &= footprint > voxelSize; // voxel angular size is acceptable
-
-                    float3 sharcRadiance;
-                    if( isSharcAllowed && SharcGetCachedRadiance( sharcParams, sharcHitData, sharcRadiance, false ) )
-                        Lcached = float4( sharcRadiance, 1.0 );
-
-                    // Cache miss - compute lighting, if not found in caches
-                    if( Rng::Hash::GetFloat( ) > Lcached.w )
-                    {
-                        float3 L = GetShadowedLighting( geometryProps, materialProps );
-                        Lcached.xyz = bounce < desc.bounceNum ? L : max( Lcached.xyz, L );
-                    }
-                }
-                Lcached.xyz = max( Lcached.xyz, materialProps.Lemi );
-
-                //=============================================================================================================================================================
-                // Other
-                //=============================================================================================================================================================
-
-                // Accumulate lighting
-                float3 L = Lcached.xyz * pathThroughput;
-                Lsum += L;
-
-                // ( Biased ) Reduce contribution of next samples if previous frame is sampled, which already has multi-bounce information
-                pathThroughput *= 1.0 - Lcached.w;
-
-                // Accumulate path length for NRD ( see "README/NOISY INPUTS" )
-                float a = Color::Luminance( L );
-                float b = Color::Luminance( Lsum ); // already includes L
-                float importance = a / ( b + 1e-6 );
-
-                importance *= 1.0 - Color::Luminance( materialProps.Lemi ) / ( a + 1e-6 );
-
-                float diffuseLikeMotion = EstimateDiffuseProbability( geometryProps, materialProps, true );
-                diffuseLikeMotion = isDiffuse ? 1.0 : diffuseLikeMotion;
-
-                accumulatedHitDist += ApplyThinLensEquation( geometryProps.hitT, accumulatedCurvature ) * Math::SmoothStep( 0.2, 0.0, accumulatedDiffuseLikeMotion );
-                accumulatedDiffuseLikeMotion += 1.0 - importance * ( 1.0 - diffuseLikeMotion );
-                accumulatedCurvature += materialProps.curvature; // yes, after hit
-
-                #if( USE_CAMERA_ATTACHED_REFLECTION_TEST == 1 && NRD_NORMAL_ENCODING == NRD_NORMAL_ENCODING_R10G10B10A2_UNORM )
-                    // IMPORTANT: lazy ( no checkerboard support ) implementation of reflections masking for objects attached to the camera
-                    // TODO: better find a generic solution for tracking of reflections for objects attached to the camera
-                    if( bounce == 1 && !isDiffuse && desc.materialProps.roughness < 0.01 )
-                    {
-                        if( !geometryProps.IsSky( ) && !geometryProps.Has( FLAG_STATIC ) )
-                            gOut_Normal_Roughness[ desc.pixelPos ].w = MATERIAL_ID_SELF_REFLECTION;
-                    }
-                #endif
-            }
+        if( isSharcHit )
+            Lcached = float4( sharcRadiance, 1.0 );
+
+        // Cache miss - compute lighting, if not found in caches
+        if( Rng::Hash::GetFloat( ) > Lcached.w )
+        {
+            float3 L = GetShadowedLighting( geometryProps, materialProps );
+            Lcached.xyz = bounce < desc.bounceNum ? L : max( Lcached.xyz, L );
         }
+    }
+    Lcached.xyz = max( Lcached.xyz, materialProps.Lemi );
+
+    //=============================================================================================================================================================
+    // Other
+    //=============================================================================================================================================================
+
+    // Accumulate lighting
+    float3 L = Lcached.xyz * pathState.throughput;
+    pathState.Lsum += L;
+
+    // ( Biased ) Reduce contribution of next samples if previous frame is sampled, which already has multi-bounce information
+    pathState.throughput *= 1.0 - Lcached.w;
+
+    // Accumulate path length for NRD ( see "README/NOISY INPUTS" )
+    float a = Color::Luminance( L );
+    float b = Color::Luminance( pathState.Lsum ); // already includes L
+    float importance = a / ( b + 1e-6 );
+
+    importance *= 1.0 - Color::Luminance( materialProps.Lemi ) / ( a + 1e-6 );
+
+    float diffuseLikeMotion = EstimateDiffuseProbability( geometryProps, materialProps, true );
+    diffuseLikeMotion = pathState.isDiffuse ? 1.0 : diffuseLikeMotion;
+
+    pathState.accumulatedHitDist += ApplyThinLensEquation( geometryProps.hitT, pathState.accumulatedCurvature ) * Math::SmoothStep( 0.2, 0.0, pathState.accumulatedDiffuseLikeMotion );
+    pathState.accumulatedDiffuseLikeMotion += 1.0 - importance * ( 1.0 - diffuseLikeMotion );
+    pathState.accumulatedCurvature += materialProps.curvature; // yes, after hit
 
-        // Debug visualization: specular mip level at the end of the path
-        if( gOnScreen == SHOW_MIP_SPECULAR )
+    #if( USE_CAMERA_ATTACHED_REFLECTION_TEST == 1 && NRD_NORMAL_ENCODING == NRD_NORMAL_ENCODING_R10G10B10A2_UNORM )
+        // IMPORTANT: lazy ( no checkerboard support ) implementation of reflections masking for objects attached to the camera
+        // TODO: better find a generic solution for tracking of reflections for objects attached to the camera
+        if( bounce == 1 && !pathState.isDiffuse && desc.materialProps.roughness < 0.01 )
         {
-            float mipNorm = Math::Sqrt01( geometryProps.mip / MAX_MIP_LEVEL );
-            Lsum = Color::ColorizeZucconi( mipNorm );
+            if( !geometryProps.IsSky( ) && !geometryProps.Has( FLAG_STATIC ) )
+                gOut_Normal_Roughness[ desc.pixelPos ].w = MATERIAL_ID_SELF_REFLECTION;
         }
+    #endif
+
+    // Coarse SHARC voxels hold multi-bounce lighting, the rest of the path is not needed ( a native hit keeps the original path, the throughput is zeroed anyway )
+    return !isSharcLodHit;
+}
 
-        // Normalize hit distances for REBLUR and REFERENCE ( needed only for AO ) before averaging
-        float normHitDist = accumulatedHitDist;
-        if( gDenoiserType != DENOISER_RELAX )
-            normHitDist = REBLUR_FrontEnd_GetNormHitDist( accumulatedHitDist, viewZ, gHitDistParams, isDiffusePath ? 1.0 : desc.materialProps.roughness );
+void EndPath( PathState pathState, GeometryProps geometryProps, TraceOpaqueDesc desc, float viewZ, inout TraceOpaqueResult result, inout uint diffPathsNum )
+{
+    if( gSHARC )
+    {
+        SharcAddStat( SHARC_STAT_OPAQUE_BOUNCES, pathState.bounceNum );
+        SharcAddStat( SHARC_STAT_OPAQUE_BOUNCES + 1, 1 );
+    }
 
-        // Accumulate diffuse and specular separately for denoising
-        if( !USE_SANITIZATION || NRD_IsValidRadiance( Lsum ) )
+    // Debug visualization: specular mip level at the end of the path
+    if( gOnScreen == SHOW_MIP_SPECULAR )
+    {
+        float mipNorm = Math::Sqrt01( geometryProps.mip / MAX_MIP_LEVEL );
+        pathState.Lsum = Color::ColorizeZucconi( mipNorm );
+    }
+
+    // Normalize hit distances for REBLUR and REFERENCE ( needed only for AO ) before averaging
+    float normHitDist = pathState.accumulatedHitDist;
+    if( gDenoiserType != DENOISER_RELAX )
+        normHitDist = REBLUR_FrontEnd_GetNormHitDist( pathState.accumulatedHitDist, viewZ, gHitDistParams, pathState.isDiffusePath ? 1.0 : desc.materialProps.roughness );
+
+    // Accumulate diffuse and specular separately for denoising
+    if( !USE_SANITIZATION || NRD_IsValidRadiance( pathState.Lsum ) )
+    {
+        if( pathState.isDiffusePath )
         {
-            if( isDiffusePath )
-            {
-                result.diffRadiance += Lsum;
-                result.diffHitDist += normHitDist;
-                diffPathsNum++;
-            }
-            else
-            {
-                result.specRadiance += Lsum;
+            result.diffRadiance += pathState.Lsum;
+            result.diffHitDist += normHitDist;
+            diffPathsNum++;
+        }
+        else
+        {
+            result.specRadiance += pathState.Lsum;
 
-                #if( NRD_MODE < OCCLUSION )
-                    NRD_FrontEnd_SpecHitDistAveraging_Add( result.specHitDist, normHitDist );
-                #else
-                    result.specHitDist += normHitDist;
-                #endif
-            }
+            #if( NRD_MODE < OCCLUSION )
+                NRD_FrontEnd_SpecHitDistAveraging_Add( result.specHitDist, normHitDist );
+            #else
+                result.specHitDist += normHitDist;
+            #endif
         }
     }
 
+    // ( Optional ) Sampling direction of the 1st bounce
+    #if( NRD_MODE == SH || NRD_MODE == DIRECTIONAL_OCCLUSION )
+        if( pathState.isDiffusePath )
+            result.diffDirection += pathState.direction;
+        else
+            result.specDirection += pathState.direction;
+    #endif
+}
+
+void ResolvePaths( TraceOpaqueDesc desc, uint pathNum, uint diffPathsNum, inout TraceOpaqueResult result )
+{
     { // Material de-modulation ( convert irradiance into radiance )
         float3 albedo, Rf0;
         BRDF::ConvertBaseColorMetalnessToAlbedoRf0( desc.materialProps.baseColor, desc.materialProps.metalness, albedo, Rf0 );
@@ -753,6 +817,55 @@ TraceOpaqueResult TraceOpaque( inout TraceOpaqueDesc desc )
     #else
         result.specHitDist *= specNorm;
     #endif
+}
+
+TraceOpaqueResult TraceOpaque( inout TraceOpaqueDesc desc )
+{
+    float viewZ = Geometry::AffineTransform( gWorldToView, desc.geometryProps.X ).z;
+    float4 Lpsr = 0;
+    float3x3 mirrorMatrix = Geometry::GetMirrorMatrix( 0 ); // identity
+
+    #if( USE_PSR_PERMUTATION == 1 )
+        Lpsr = ReplacePrimarySurface( desc, viewZ, mirrorMatrix );
+    #endif
+
+    TraceOpaqueResult result = ( TraceOpaqueResult )0;
+
+    #if( NRD_MODE < OCCLUSION )
+        result.specHitDist = NRD_FrontEnd_SpecHitDistAveraging_Begin( );
+    #endif
+
+    uint pathNum = desc.pathNum << ( TRACING_MODE == RESOLUTION_FULL ? 1 : 0 );
+    uint diffPathsNum = 0;
+
+    [loop]
+    for( uint path = 0; path < pathNum; path++ )
+    {
+        GeometryProps geometryProps = desc.geometryProps;
+        MaterialProps materialProps = desc.materialProps;
+        PathState pathState = BeginPath( desc, Lpsr, path );
+
+        [loop]
+        for( uint bounce = 1; bounce <= desc.bounceNum && !geometryProps.IsSky( ); bounce++ )
+        {
+            float3 ray;
+            float2 mipAndCone;
+            if( !SampleBounce( pathState, geometryProps, materialProps, desc, mirrorMatrix, path, bounce, ray, mipAndCone ) )
+                break;
+
+            // Trace to the next hit
+            geometryProps = CastRay( geometryProps.GetXoffset( geometryProps.N ), ray, 0.0, INF, mipAndCone, gWorldTlas, desc.instanceInclusionMask, desc.rayFlags );
+            materialProps = GetMaterialProps( geometryProps ); // TODO: try to read metrials only if L1- and L2- lighting caches failed
+            pathState.bounceNum++;
+
+            if( !ShadeHit( pathState, geometryProps, materialProps, desc, bounce ) )
+                break;
+        }
+
+        EndPath( pathState, geometryProps, desc, viewZ, result, diffPathsNum );
+    }
+
+    ResolvePaths( desc, pathNum, diffPathsNum, result );
 
     return result;
 }
@@ -763,7 +876,7 @@ TraceOpaqueResult TraceOpaque( inout TraceOpaqueDesc desc )
 
 void WriteResult( uint checkerboard, uint2 outPixelPos, float4 diff, float4 spec, float4 diffSh, float4 specSh )
 {
-    if( gTracingMode == RESOLUTION_HALF )
+    if( TRACING_MODE == RESOLUTION_HALF )
     {
         if( checkerboard )
         {
@@ -791,50 +904,22 @@ void WriteResult( uint checkerboard, uint2 outPixelPos, float4 diff, float4 spec
     }
 }
 
-[numthreads( 16, 16, 1 )]
-void main( uint2 pixelPos : SV_DispatchThreadId )
+// Primary ray, G-buffer and debug visualizations, returns "false" for sky
+bool TracePrimary( uint2 pixelPos, float2 sampleUv, uint checkerboard, uint2 outPixelPos, out GeometryProps geometryProps0, out MaterialProps materialProps0 )
 {
-    // Pixel and sample UV
-    float2 pixelUv = float2( pixelPos + 0.5 ) * gInvRectSize;
-    float2 sampleUv = pixelUv + gJitter;
-
-    // Checkerboard
-    uint2 outPixelPos = pixelPos;
-    if( gTracingMode == RESOLUTION_HALF )
-        outPixelPos.x >>= 1;
-
-    uint checkerboard = Sequence::CheckerBoard( pixelPos, gFrameIndex ) != 0;
-
-    // Do not generate NANs for unused threads
-    if( pixelUv.x > 1.0 || pixelUv.y > 1.0 )
-    {
-        #if( USE_DRS_STRESS_TEST == 1 )
-            WriteResult( checkerboard, outPixelPos, GARBAGE, GARBAGE, GARBAGE, GARBAGE );
-        #endif
-
-        return;
-    }
-
-    //================================================================================================================================================================================
-    // Primary rays
-    //================================================================================================================================================================================
-
-    // Initialize RNG
-    Rng::Hash::Initialize( pixelPos, gFrameIndex );
-
     // Primary ray
     float3 cameraRayOrigin = ( float3 )0;
     float3 cameraRayDirection = ( float3 )0;
     GetCameraRay( cameraRayOrigin, cameraRayDirection, sampleUv );
 
-    GeometryProps geometryProps0 = CastRay( cameraRayOrigin, cameraRayDirection, 0.0, INF, GetConeAngleFromRoughness( 0.0, 0.0 ), gWorldTlas, ( gOnScreen == SHOW_INSTANCE_INDEX || gOnScreen == SHOW_NORMAL ) ? GEOMETRY_ALL : FLAG_NON_TRANSPARENT, 0 );
-    MaterialProps materialProps0 = GetMaterialProps( geometryProps0 );
+    geometryProps0 = CastRay( cameraRayOrigin, cameraRayDirection, 0.0, INF, GetConeAngleFromRoughness( 0.0, 0.0 ), gWorldTlas, ( gOnScreen == SHOW_INSTANCE_INDEX || gOnScreen == SHOW_NORMAL ) ? GEOMETRY_ALL : FLAG_NON_TRANSPARENT, 0 );
+    materialProps0 = GetMaterialProps( geometryProps0 );
 
     // ViewZ
     float viewZ = Geometry::AffineTransform( gWorldToView, geometryProps0.X ).z;
     viewZ = geometryProps0.IsSky( ) ? Math::Sign( viewZ ) * INF : viewZ;
 
-    gOut_ViewZ[ pixelPos ] = viewZ;
+    gOut_ViewZ[ pixelPos ] = EncodeViewZ( viewZ );
 
     // Motion
     float3 motion = GetMotion( geometryProps0.X, geometryProps0.Xprev );
@@ -853,7 +938,7 @@ void main( uint2 pixelPos : SV_DispatchThreadId )
             WriteResult( checkerboard, outPixelPos, GARBAGE, GARBAGE, GARBAGE, GARBAGE );
         #endif
 
-        return;
+        return false;
     }
 
     // G-buffer
@@ -909,51 +994,20 @@ void main( uint2 pixelPos : SV_DispatchThreadId )
     gOut_DirectLighting[ pixelPos ] = materialProps0.Ldirect;
     gOut_DirectEmission[ pixelPos ] = materialProps0.Lemi;
 
-    //================================================================================================================================================================================
-    // Secondary rays ( indirect and direct lighting from local light sources ) + potential PSR
-    //================================================================================================================================================================================
-
-    TraceOpaqueDesc desc = ( TraceOpaqueDesc )0;
-    desc.geometryProps = geometryProps0;
-    desc.materialProps = materialProps0;
-    desc.pixelPos = pixelPos;
-    desc.checkerboard = checkerboard;
-    desc.pathNum = gSampleNum;
-    desc.bounceNum = gBounceNum;
-    desc.instanceInclusionMask = FLAG_NON_TRANSPARENT; // TODO: glass should affect non-glass surfaces
-    desc.rayFlags = 0;
-
-    TraceOpaqueResult result = TraceOpaque( desc );
-
-    #if( USE_MOVING_EMISSION_FIX == 1 )
-        // Or emissives ( not having lighting in diffuse and specular ) can use a different material ID
-        result.diffRadiance += desc.materialProps.Lemi / Math::Pi( 2.0 );
-        result.specRadiance += desc.materialProps.Lemi / Math::Pi( 2.0 );
-    #endif
-
-    #if( USE_SIMULATED_MATERIAL_ID_TEST == 1 )
-        if( frac( geometryProps0.X ).x < 0.05 )
-            result.diffRadiance = float3( 0, 10, 0 ) * Color::Luminance( result.diffRadiance );
-    #endif
-
-    #if( USE_SIMULATED_FIREFLY_TEST == 1 )
-        const float maxFireflyEnergyScaleFactor = 10000.0;
-        result.diffRadiance /= lerp( 1.0 / maxFireflyEnergyScaleFactor, 1.0, Rng::Hash::GetFloat( ) );
-    #endif
-
-    //================================================================================================================================================================================
-    // Sun shadow ( after potential PSR )
-    //================================================================================================================================================================================
+    return true;
+}
 
+// Sun shadow ( after potential PSR ) with cheap translucency through glass
+void TraceSunShadow( uint2 pixelPos, GeometryProps geometryProps, float shadowTranslucency )
+{
     float2 rnd = GetBlueNoise( pixelPos, false );
     rnd = ImportanceSampling::Cosine::GetRay( rnd ).xy;
     rnd *= gTanSunAngularRadius;
 
     float3 sunDirection = normalize( gSunBasisX.xyz * rnd.x + gSunBasisY.xyz * rnd.y + gSunDirection.xyz );
-    float3 Xoffset = desc.geometryProps.GetXoffset( sunDirection, PT_SHADOW_RAY_OFFSET );
-    float2 mipAndCone = GetConeAngleFromAngularRadius( desc.geometryProps.mip, gTanSunAngularRadius );
+    float3 Xoffset = geometryProps.GetXoffset( sunDirection, PT_SHADOW_RAY_OFFSET );
+    float2 mipAndCone = GetConeAngleFromAngularRadius( geometryProps.mip, gTanSunAngularRadius );
 
-    float shadowTranslucency = ( Color::Luminance( desc.materialProps.Ldirect ) != 0.0 && !gDisableShadowsAndEnableImportanceSampling ) ? 1.0 : 0.0;
     float shadowHitDist = 0.0;
 
     while( shadowTranslucency > 0.01 )
@@ -980,11 +1034,10 @@ void main( uint2 pixelPos : SV_DispatchThreadId )
 
     gOut_ShadowData[ pixelPos ] = penumbra;
     gOut_Shadow_Translucency[ pixelPos ] = translucency;
+}
 
-    //================================================================================================================================================================================
-    // Output
-    //================================================================================================================================================================================
-
+void PackAndWriteResult( uint checkerboard, uint2 outPixelPos, TraceOpaqueResult result )
+{
     float4 outDiff = 0.0;
     float4 outSpec = 0.0;
     float4 outDiffSh = 0.0;
@@ -1016,5 +1069,94 @@ void main( uint2 pixelPos : SV_DispatchThreadId )
     #endif
     }
 
-    WriteResult( checkerboard, outPixelPos, outDiff, outSpec, outDiffSh, outSpecSh );
 }
+
+#ifdef TRACE_OPAQUE_STAGE
+
+#include "Include/TraceOpaqueWavefront.hlsli"
+
+#else
+
+[numthreads( 16, 16, 1 )]
+void main( uint2 pixelPos : SV_DispatchThreadId )
+{
+    // Pixel and sample UV
+    float2 pixelUv = float2( pixelPos + 0.5 ) * gInvRectSize;
+    float2 sampleUv = pixelUv + gJitter;
+
+    // Checkerboard
+    uint2 outPixelPos = pixelPos;
+    if( TRACING_MODE == RESOLUTION_HALF )
+        outPixelPos.x >>= 1;
+
+    uint checkerboard = Sequence::CheckerBoard( pixelPos, gFrameIndex ) != 0;
+
+    // Do not generate NANs for unused threads
+    if( pixelUv.x > 1.0 || pixelUv.y > 1.0 )
+    {
+        #if( USE_DRS_STRESS_TEST == 1 )
+            WriteResult( checkerboard, outPixelPos, GARBAGE, GARBAGE, GARBAGE, GARBAGE );
+        #endif
+
+        return;
+    }
+
+    //================================================================================================================================================================================
+    // Primary rays
+    //================================================================================================================================================================================
+
+    // Initialize RNG
+    Rng::Hash::Initialize( pixelPos, gFrameIndex );
+
+    GeometryProps geometryProps0;
+    MaterialProps materialProps0;
+    if( !TracePrimary( pixelPos, sampleUv, checkerboard, outPixelPos, geometryProps0, materialProps0 ) )
+        return;
+
+    //================================================================================================================================================================================
+    // Secondary rays ( indirect and direct lighting from local light sources ) + potential PSR
+    //================================================================================================================================================================================
+
+    TraceOpaqueDesc desc = ( TraceOpaqueDesc )0;
+    desc.geometryProps = geometryProps0;
+    desc.materialProps = materialProps0;
+    desc.pixelPos = pixelPos;
+    desc.checkerboard = checkerboard;
+    desc.pathNum = SAMPLE_NUM;
+    desc.bounceNum = BOUNCE_NUM;
+    desc.instanceInclusionMask = FLAG_NON_TRANSPARENT; // TODO: glass should affect non-glass surfaces
+    desc.rayFlags = 0;
+
+    TraceOpaqueResult result = TraceOpaque( desc );
+
+    #if( USE_MOVING_EMISSION_FIX == 1 )
+        // Or emissives ( not having lighting in diffuse and specular ) can use a different material ID
+        result.diffRadiance += desc.materialProps.Lemi / Math::Pi( 2.0 );
+        result.specRadiance += desc.materialProps.Lemi / Math::Pi( 2.0 );
+    #endif
+
+    #if( USE_SIMULATED_MATERIAL_ID_TEST == 1 )
+        if( frac( geometryProps0.X ).x < 0.05 )
+            result.diffRadiance = float3( 0, 10, 0 ) * Color::Luminance( result.diffRadiance );
+    #endif
+
+    #if( USE_SIMULATED_FIREFLY_TEST == 1 )
+        const float maxFireflyEnergyScaleFactor = 10000.0;
+        result.diffRadiance /= lerp( 1.0 / maxFireflyEnergyScaleFactor, 1.0, Rng::Hash::GetFloat( ) );
+    #endif
+
+    //================================================================================================================================================================================
+    // Sun shadow ( after potential PSR )
+    //================================================================================================================================================================================
+
+    float shadowTranslucency = ( Color::Luminance( desc.materialProps.Ldirect ) != 0.0 && !gDisableShadowsAndEnableImportanceSampling ) ? 1.0 : 0.0;
+    TraceSunShadow( pixelPos, desc.geometryProps, shadowTranslucency );
+
+    //================================================================================================================================================================================
+    // Output
+    //================================================================================================================================================================================
+
+    PackAndWriteResult( checkerboard, outPixelPos, result );
+}
+
+#endif
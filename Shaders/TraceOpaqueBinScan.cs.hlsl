@@ -0,0 +1,13 @@
+/*
+Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+
+NVIDIA CORPORATION and its licensors retain all intellectual property
+and proprietary rights in and to this software, related documentation
+and any modifications thereto. Any use, reproduction, disclosure or
+distribution of this software and related documentation without an express
+license agreement from NVIDIA CORPORATION is strictly prohibited.
+*/
+
+#define TRACE_OPAQUE_STAGE TRACE_OPAQUE_BIN_SCAN
+
+#include "TraceOpaque.cs.hlsl"
@@ -145,7 +145,7 @@ float3 TraceTransparent( TraceTransparentDesc desc )
                 sharcHitData.normalWorld = geometryProps.N;
 
                 HashMapData hashMapData;
-                hashMapData.capacity = SHARC_CAPACITY;
+                hashMapData.capacity = gSharcCapacity;
                 hashMapData.hashEntriesBuffer = gInOut_SharcHashEntriesBuffer;
 
                 SharcParameters sharcParams;
@@ -160,7 +160,7 @@ float3 TraceTransparent( TraceTransparentDesc desc )
                 isSharcAllowed &= geometryProps.hitT > voxelSize; // voxel angular size is acceptable // TODO: can be skipped to get flat ambient in some cases
 
                 float3 sharcRadiance;
-                if (isSharcAllowed && SharcGetCachedRadiance( sharcParams, sharcHitData, sharcRadiance, false))
+                if (isSharcAllowed && SharcCountQuery( SHARC_STAT_TRANSPARENT_QUERIES, SharcGetCachedRadiance( sharcParams, sharcHitData, sharcRadiance, false) ))
                     Lcached = float4( sharcRadiance, 1.0 );
 
                 // Cache miss - compute lighting, if not found in caches
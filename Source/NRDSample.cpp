@@ -23,6 +23,14 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 // NIS
 #include "NIS_Config.h"
 
+#include <map>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+
 #ifdef _WIN32
     #undef APIENTRY
     #include <windows.h>
@@ -35,6 +43,12 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 // NRD mode and other shared settings are here
 #include "../Shaders/Include/Shared.hlsli"
 
+// CPU reference of the SHARC hash grid
+#include "SharcCpu.h"
+
+// Render graph: pass culling and barriers
+#include "RenderGraph.h"
+
 constexpr uint32_t MAX_ANIMATED_INSTANCE_NUM        = 512;
 constexpr auto BLAS_RIGID_MESH_BUILD_BITS           = nri::AccelerationStructureBuildBits::PREFER_FAST_TRACE;
 constexpr auto BLAS_DEFORMABLE_MESH_BUILD_BITS      = nri::AccelerationStructureBuildBits::PREFER_FAST_BUILD | nri::AccelerationStructureBuildBits::ALLOW_UPDATE;
@@ -47,15 +61,45 @@ constexpr bool CAMERA_RELATIVE                      = true;
 constexpr bool ALLOW_BLAS_MERGING                   = true;
 constexpr bool ALLOW_HDR                            = false; // use "WIN + ALT + B" to switch HDR mode
 constexpr bool USE_LOW_PRECISION_FP_FORMATS         = true; // saves a bit of memory and performance
+constexpr bool ALLOW_TRANSIENT_ALIASING             = true; // textures with non-overlapping lifetimes within a frame share memory
+constexpr bool ALLOW_PLACED_RESOURCES               = true; // textures and buffers are sub-allocated from shared heaps instead of an allocation per resource
+constexpr uint64_t PLACED_HEAP_SIZE                 = 256 * 1024 * 1024; // 256MB, a bigger resource gets a heap of its own
 constexpr bool NRD_ALLOW_DESCRIPTOR_CACHING         = true;
 constexpr bool NRD_PROMOTE_FLOAT16_TO_32            = false;
 constexpr bool NRD_DEMOTE_FLOAT32_TO_16             = false;
 constexpr bool NRD_RESTORE_INITIAL_STATE            = false;
 constexpr int32_t MAX_HISTORY_FRAME_NUM             = (int32_t)std::min(60u, std::min(nrd::REBLUR_MAX_HISTORY_FRAME_NUM, nrd::RELAX_MAX_HISTORY_FRAME_NUM));
 constexpr uint32_t TEXTURES_PER_MATERIAL            = 4;
-constexpr uint32_t MAX_TEXTURE_TRANSITIONS_NUM      = 32;
 constexpr uint32_t DYNAMIC_CONSTANT_BUFFER_SIZE     = 1024 * 1024; // 1MB
 constexpr uint32_t MAX_ANIMATION_HISTORY_FRAME_NUM  = 2;
+constexpr uint32_t RECORDING_MAGIC                  = 0x5244524E; // "NRDR"
+constexpr uint32_t RECORDING_VERSION                = 1;
+constexpr uint8_t RECORDING_FLAG_HISTORY_RESET      = 0x1;
+constexpr uint32_t TEXTURE_CACHE_MAGIC              = 0x5443424E; // "NBCT"
+constexpr uint32_t TEXTURE_CACHE_VERSION            = 2; // bump if the encoder changes
+constexpr uint32_t SHARC_CACHE_MAGIC                = 0x4348534E; // "NSHC"
+constexpr uint32_t SHARC_CACHE_VERSION              = 2; // bump if the voxel data layout changes (grid constants are in the header)
+constexpr uint32_t SHARC_HITS_MAGIC                 = 0x5448534E; // "NSHT"
+constexpr uint32_t SHARC_HITS_VERSION               = 2;
+constexpr float DRS_HEADROOM                        = 0.9f; // target GPU frame time = budget * headroom
+constexpr float DRS_HYSTERESIS                      = 0.1f; // no upscaling while smoothed GPU frame time is within this fraction below the target
+constexpr float DRS_SMOOTHING                       = 0.1f; // EMA weight of a new GPU frame time
+constexpr float DRS_MAX_STEP_DOWN                   = 0.1f; // per decision, a single frame over the budget
+constexpr float DRS_MAX_STEP_DOWN_SMOOTHED          = 0.05f; // per decision, smoothed GPU frame time over the target
+constexpr float DRS_MAX_STEP_UP                     = 0.02f; // per decision
+constexpr float DRS_MIN_STEP                        = 0.01f; // smaller changes are not worth a history disturbance
+constexpr uint32_t DRS_UPSCALE_FRAME_NUM            = 30; // frames with headroom needed to upscale
+constexpr uint32_t SHARC_BUFFER_NUM                 = 4; // "SharcHashEntries", "SharcHashCopyOffset" and "SharcVoxelData" ping-pong depend on the capacity
+constexpr uint32_t SHARC_CAPACITY_DEFAULT           = 1 << 20; // initial capacity of the adaptive hash table
+constexpr float SHARC_LOAD_FACTOR_MAX               = 0.5f; // grow the hash table above this occupancy
+constexpr float SHARC_LOAD_FACTOR_MIN               = 0.125f; // shrink the hash table below this occupancy
+constexpr uint32_t SHARC_SHRINK_FRAME_NUM           = 120; // frames with low occupancy needed to shrink
+constexpr uint32_t SHARC_STATS_HISTORY_SIZE         = 256; // frames in SHARC statistics plots
+constexpr uint32_t TEXTURE_STREAMING_MIN_SIZE       = 128; // top mip size of not requested material textures
+constexpr uint32_t TEXTURE_STREAMING_PERIOD         = 16; // frames between residency updates, feedback is accumulated in-between
+constexpr uint64_t TEXTURE_STREAMING_UPLOAD_SIZE    = 64 * 1024 * 1024; // 64MB, max upload per residency update (bounds hitches)
+constexpr uint32_t WAVEFRONT_BUFFER_NUM             = 6; // "WavefrontPixels", "WavefrontPaths" and queues depend on the render resolution
+constexpr uint32_t WAVEFRONT_QUERY_MAX_NUM          = 512; // per frame, intervals of wavefront stages
 
 #if( SIGMA_TRANSLUCENT == 1 )
     #define SIGMA_VARIANT                           nrd::Denoiser::SIGMA_SHADOW_TRANSLUCENCY
@@ -138,6 +182,26 @@ enum class Buffer : uint32_t
     SharcHashCopyOffset,
     SharcVoxelDataPing,
     SharcVoxelDataPong,
+    SharcStats,
+    SharcLiveBucketsPing,
+    SharcLiveBucketsPong,
+    SharcLiveArgsPing,
+    SharcLiveArgsPong,
+    SharcBucketMask,
+    SharcHits,
+    SharcUpdateLevels,
+    TextureFeedback,
+    WavefrontArgsPing,
+    WavefrontArgsPong,
+    WavefrontShadowArgs,
+    WavefrontBins,
+    WavefrontBinOffsets,
+    WavefrontPixels,
+    WavefrontPaths,
+    WavefrontQueuePing,
+    WavefrontQueuePong,
+    WavefrontShadowQueue,
+    WavefrontSortedQueue,
 
     // DEVICE (scratch)
     WorldScratch,
@@ -183,13 +247,11 @@ enum class Texture : uint32_t
     // Window resolution
     Final,
 
-    // SH
-#if( NRD_MODE == SH )
+    // SH (optional, only in "SH" mode)
     Unfiltered_DiffSh,
     Unfiltered_SpecSh,
     DiffSh,
     SpecSh,
-#endif
 
     // Read-only
     NisData1,
@@ -205,7 +267,17 @@ enum class Pipeline : uint32_t
     SharcUpdate,
     SharcResolve,
     SharcHashCopy,
+    SharcCompact,
     TraceOpaque,
+    TraceOpaqueProbabilistic,
+    TraceOpaqueHalf,
+    TraceOpaqueFull,
+    TraceOpaqueGenerate,
+    TraceOpaqueShadow,
+    TraceOpaqueExtend,
+    TraceOpaqueShade,
+    TraceOpaqueBinScan,
+    TraceOpaqueBinScatter,
     Composition,
     TraceTransparent,
     Taa,
@@ -227,6 +299,7 @@ enum class Descriptor : uint32_t
     Global_ConstantBuffer,
     MorphTargetPose_ConstantBuffer,
     MorphTargetUpdatePrimitives_ConstantBuffer,
+    Wavefront_ConstantBuffer,
 
     InstanceData_Buffer,
     MorphMeshIndices_Buffer,
@@ -245,6 +318,26 @@ enum class Descriptor : uint32_t
     SharcHashCopyOffset_StorageBuffer,
     SharcVoxelDataPing_StorageBuffer,
     SharcVoxelDataPong_StorageBuffer,
+    SharcStats_StorageBuffer,
+    SharcLiveBucketsPing_StorageBuffer,
+    SharcLiveBucketsPong_StorageBuffer,
+    SharcLiveArgsPing_StorageBuffer,
+    SharcLiveArgsPong_StorageBuffer,
+    SharcBucketMask_StorageBuffer,
+    SharcHits_StorageBuffer,
+    SharcUpdateLevels_StorageBuffer,
+    TextureFeedback_StorageBuffer,
+    WavefrontArgsPing_StorageBuffer,
+    WavefrontArgsPong_StorageBuffer,
+    WavefrontShadowArgs_StorageBuffer,
+    WavefrontBins_StorageBuffer,
+    WavefrontBinOffsets_StorageBuffer,
+    WavefrontPixels_StorageBuffer,
+    WavefrontPaths_StorageBuffer,
+    WavefrontQueuePing_StorageBuffer,
+    WavefrontQueuePong_StorageBuffer,
+    WavefrontShadowQueue_StorageBuffer,
+    WavefrontSortedQueue_StorageBuffer,
 
     ViewZ_Texture,
     ViewZ_StorageTexture,
@@ -309,8 +402,7 @@ enum class Descriptor : uint32_t
     Final_Texture,
     Final_StorageTexture,
 
-    // SH
-#if( NRD_MODE == SH )
+    // SH (optional, only in "SH" mode)
     Unfiltered_DiffSh_Texture,
     Unfiltered_DiffSh_StorageTexture,
     Unfiltered_SpecSh_Texture,
@@ -319,7 +411,6 @@ enum class Descriptor : uint32_t
     DiffSh_StorageTexture,
     SpecSh_Texture,
     SpecSh_StorageTexture,
-#endif
 
     // Read-only
     NisData1,
@@ -346,10 +437,268 @@ enum class DescriptorSet : uint32_t
     MorphTargetUpdatePrimitives3,
     SharcPing4,
     SharcPong4,
+    WavefrontPing5,
+    WavefrontPong5,
+
+    MAX_NUM
+};
+
+// GPU timestamps are written at the end of each stage, stage time = "timestamp[i] - timestamp[i - 1]"
+enum class Timestamp : uint32_t
+{
+    Begin,
+    AccelerationStructures,
+    Sharc,
+    TraceOpaque,
+    ShadowDenoising,
+    OpaqueDenoising,
+    Composition,
+    TraceTransparent,
+    Reference,
+    Upscaling,
+    Nis,
+    Final,
+    Output,
+
+    MAX_NUM
+};
+
+const char* timestampNames[(size_t)Timestamp::MAX_NUM] =
+{
+    "Begin",
+    "AccelerationStructures",
+    "Sharc",
+    "TraceOpaque",
+    "ShadowDenoising",
+    "OpaqueDenoising",
+    "Composition",
+    "TraceTransparent",
+    "Reference",
+    "Upscaling",
+    "Nis",
+    "Final",
+    "Output",
+};
+
+// Wavefront stages are interleaved across paths and bounces, their intervals are labeled and accumulated per stage
+enum class WavefrontStage : uint32_t
+{
+    Generate,
+    Shadow,
+    Bin,
+    Extend,
+    Shade,
+
+    MAX_NUM
+};
+
+const char* wavefrontStageNames[(size_t)WavefrontStage::MAX_NUM] =
+{
+    "WavefrontGenerate",
+    "WavefrontShadow",
+    "WavefrontBin",
+    "WavefrontExtend",
+    "WavefrontShade",
+};
+
+// SHARC statistics plotted over time (see "UpdateSharcStats")
+enum class SharcPlot : uint32_t
+{
+    LOAD_FACTOR,
+    OPAQUE_HIT_RATE,
+    TRANSPARENT_HIT_RATE,
+    EVICTIONS,
+    FAILURES,
+    BOUNCES_PER_PATH,
+
+    MAX_NUM
+};
+
+const char* sharcPlotNames[(size_t)SharcPlot::MAX_NUM] =
+{
+    "Load factor, %",
+    "Opaque hit rate, %",
+    "Transparent hit rate, %",
+    "Evictions",
+    "Failed insertions",
+    "Opaque bounces per path",
+};
+
+// Sets of texture formats. "BANDWIDTH_SAVER" selects tighter encodings where they are valid (see "GetGBufferFormat")
+enum class GBufferProfile : uint32_t
+{
+    DEFAULT,
+    BANDWIDTH_SAVER,
+
+    MAX_NUM
+};
+
+const char* gbufferProfileNames[(size_t)GBufferProfile::MAX_NUM] =
+{
+    "default",
+    "bandwidth saver",
+};
+
+// Shaders are compiled for each "NRD_MODE" into a subfolder (see "CMakeLists.txt"), the mode can be switched at runtime
+constexpr uint32_t NRD_MODE_NUM = 4;
+
+const char* nrdModeNames[NRD_MODE_NUM] =
+{
+    "NORMAL",
+    "SH",
+    "OCCLUSION",
+    "DIRECTIONAL_OCCLUSION",
+};
+
+const char* nrdModeFolders[NRD_MODE_NUM] =
+{
+    "Normal/",
+    "Sh/",
+    "Occlusion/",
+    "DirectionalOcclusion/",
+};
+
+// Indexed by "NRD_MODE" and "DENOISER_X"
+const char* denoiserNames[NRD_MODE_NUM][3] =
+{
+    {"REBLUR", "RELAX", "REFERENCE"},
+    {"REBLUR_SH", "RELAX_SH", "REFERENCE"},
+    {"REBLUR_OCCLUSION", "(unsupported)", "REFERENCE"},
+    {"REBLUR_DIRECTIONAL_OCCLUSION", "(unsupported)", "REFERENCE"},
+};
+
+// Textures, which don't carry data across frames. A lifetime is a range of stages (see "Timestamp") from the first write to the last read
+struct TransientTexture
+{
+    Texture texture;
+    Timestamp firstStage;
+    Timestamp lastStage;
+};
+
+const TransientTexture transientTextures[] =
+{
+    {Texture::Unfiltered_Penumbra,          Timestamp::TraceOpaque,         Timestamp::ShadowDenoising},
+    {Texture::Unfiltered_Translucency,      Timestamp::TraceOpaque,         Timestamp::ShadowDenoising},
+    {Texture::Unfiltered_Diff,              Timestamp::TraceOpaque,         Timestamp::OpaqueDenoising},
+    {Texture::Unfiltered_Spec,              Timestamp::TraceOpaque,         Timestamp::Upscaling}, // "Before DLSS"
+    {Texture::Unfiltered_DiffSh,            Timestamp::TraceOpaque,         Timestamp::OpaqueDenoising},
+    {Texture::Unfiltered_SpecSh,            Timestamp::TraceOpaque,         Timestamp::OpaqueDenoising},
+    {Texture::Validation,                   Timestamp::ShadowDenoising,     Timestamp::Final},
+    {Texture::RRGuide_DiffAlbedo,           Timestamp::Upscaling,           Timestamp::Upscaling},
+    {Texture::RRGuide_SpecAlbedo,           Timestamp::Upscaling,           Timestamp::Upscaling},
+    {Texture::RRGuide_SpecHitDistance,      Timestamp::Upscaling,           Timestamp::Upscaling},
+    {Texture::RRGuide_Normal_Roughness,     Timestamp::Upscaling,           Timestamp::Upscaling},
+    {Texture::DlssOutput,                   Timestamp::Upscaling,           Timestamp::Nis},
+    {Texture::PreFinal,                     Timestamp::Nis,                 Timestamp::Final},
+};
+
+// A memory heap shared by transient textures. Heaps used only by optional textures are allocated on demand
+struct TransientHeap
+{
+    nri::Memory* memory;
+    uint64_t size;
+    nri::MemoryType type;
+};
+
+// Placed resources of different classes don't share heaps. Render targets are recreated together on output resolution change, leaving their heaps empty
+enum class PlacedClass : uint32_t
+{
+    BUFFER,
+    RENDER_TARGET,
+    READ_ONLY_TEXTURE
+};
+
+struct MemoryRange
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct PlacedHeap
+{
+    std::vector<MemoryRange> freeRanges; // sorted by offset, adjacent ranges are merged
+    nri::Memory* memory;
+    uint64_t size;
+    nri::MemoryType type;
+    PlacedClass placedClass;
+    uint32_t resourceNum;
+    bool isDedicated;
+};
+
+struct PlacedResource
+{
+    nri::MemoryDesc memoryDesc;
+    nri::Texture* texture;
+    nri::Buffer* buffer;
+    uint64_t offset;
+    uint32_t heapIndex; // "NOT_FOUND" until bound
+    PlacedClass placedClass;
+};
+
+// Features owning textures, which are needed only while the feature is enabled
+enum class OptionalFeature : uint32_t
+{
+    Taa,
+    Dlss,
+    Sh, // "NRD_MODE == SH"
 
     MAX_NUM
 };
 
+// Textures, which are created on first use of the feature and destroyed when the feature gets disabled.
+// "descriptor" is the "_Texture" view, the "_StorageTexture" view follows it
+struct OptionalTexture
+{
+    Texture texture;
+    Descriptor descriptor;
+    OptionalFeature feature;
+};
+
+const OptionalTexture optionalTextures[] =
+{
+    {Texture::TaaHistory,                   Descriptor::TaaHistory_Texture,                 OptionalFeature::Taa},
+    {Texture::TaaHistoryPrev,               Descriptor::TaaHistoryPrev_Texture,             OptionalFeature::Taa},
+    {Texture::RRGuide_DiffAlbedo,           Descriptor::RRGuide_DiffAlbedo_Texture,         OptionalFeature::Dlss},
+    {Texture::RRGuide_SpecAlbedo,           Descriptor::RRGuide_SpecAlbedo_Texture,         OptionalFeature::Dlss},
+    {Texture::RRGuide_SpecHitDistance,      Descriptor::RRGuide_SpecHitDistance_Texture,    OptionalFeature::Dlss},
+    {Texture::RRGuide_Normal_Roughness,     Descriptor::RRGuide_Normal_Roughness_Texture,   OptionalFeature::Dlss},
+    {Texture::DlssOutput,                   Descriptor::DlssOutput_Texture,                 OptionalFeature::Dlss},
+    {Texture::Unfiltered_DiffSh,            Descriptor::Unfiltered_DiffSh_Texture,          OptionalFeature::Sh},
+    {Texture::Unfiltered_SpecSh,            Descriptor::Unfiltered_SpecSh_Texture,          OptionalFeature::Sh},
+    {Texture::DiffSh,                       Descriptor::DiffSh_Texture,                     OptionalFeature::Sh},
+    {Texture::SpecSh,                       Descriptor::SpecSh_Texture,                     OptionalFeature::Sh},
+};
+
+struct OptionalTextureDesc
+{
+    nri::TextureDesc desc;
+    const char* debugName;
+};
+
+constexpr uint32_t NOT_FOUND = uint32_t(-1);
+
+inline uint32_t FindTransientTexture(Texture texture)
+{
+    for (uint32_t i = 0; i < helper::GetCountOf(transientTextures); i++)
+    {
+        if (transientTextures[i].texture == texture)
+            return i;
+    }
+
+    return NOT_FOUND;
+}
+
+inline uint32_t FindOptionalTexture(Texture texture)
+{
+    for (uint32_t i = 0; i < helper::GetCountOf(optionalTextures); i++)
+    {
+        if (optionalTextures[i].texture == texture)
+            return i;
+    }
+
+    return NOT_FOUND;
+}
+
 // NRD sample doesn't use several instances of the same denoiser in one NRD instance (like REBLUR_DIFFUSE x 3),
 // thus we can use fields of "nrd::Denoiser" enum as unique identifiers
 #define NRD_ID(x) nrd::Identifier(nrd::Denoiser::x)
@@ -367,6 +716,12 @@ struct Frame
 {
     nri::CommandAllocator* commandAllocator;
     nri::CommandBuffer* commandBuffer;
+    double inputTimeStamp; // ms, CPU
+    double presentTimeStamp; // ms, CPU
+    uint32_t sharcCapacity; // 0 if SHARC is not used in the frame
+    uint32_t wavefrontQueryNum; // 0 if the megakernel is used in the frame
+    std::array<uint8_t, WAVEFRONT_QUERY_MAX_NUM> wavefrontStages; // "WavefrontStage" ended by each query
+    bool rayBinning; // secondary rays were traced in sorted order
 };
 
 struct Settings
@@ -435,6 +790,142 @@ struct Settings
     bool        RR                                 = false;
 };
 
+struct BenchmarkResult
+{
+    std::array<double, (size_t)Timestamp::MAX_NUM> gpuTimes; // ms, per stage
+    std::array<double, (size_t)WavefrontStage::MAX_NUM> wavefrontGpuTimes; // ms, per stage, 0 if the megakernel is used
+    std::array<double, 2> traversalTimes; // ms, "WavefrontBin + WavefrontExtend" without and with ray binning
+    std::array<uint32_t, 2> traversalFrameNums;
+    double gpuFrameTime; // ms
+    double cpuFrameTime; // ms
+    uint2 outputResolution;
+    uint32_t test; // continuous across output resolutions
+};
+
+struct Benchmark
+{
+    std::vector<BenchmarkResult> results;
+    BenchmarkResult accumulated = {};
+    std::string reportPath;
+    std::string baselinePath;
+    float regressionThreshold = 5.0f; // %
+    float regressionMinDelta = 0.05f; // ms
+    uint32_t warmupFrameNum = 0;
+    uint32_t measuredFrameNum = 0;
+    uint32_t testNum = 0;
+    uint32_t test = 0;
+    uint32_t outputResolutionIndex = 0; // in "m_OutputResolutions"
+    uint32_t frame = 0;
+    bool isActive = false;
+};
+
+struct DynamicResolution
+{
+    double smoothedGpuFrameTime = 0.0; // ms, 0 - restart
+    uint32_t lastChangeFrameIndex = 0;
+    uint32_t headroomFrameNum = 0;
+    float budget = 16.67f; // ms
+    bool isEnabled = false;
+};
+
+struct FrameClock
+{
+    double timeStamp; // ms
+    float frameTime; // ms
+    float smoothedFrameTime; // ms
+    float verySmoothedFrameTime; // ms
+};
+
+struct Recording
+{
+    std::vector<uint8_t> state; // state of the previous frame, frames are stored as deltas against it
+    std::string path;
+    FILE* file = nullptr;
+    double gpuFrameTime = 0.0; // ms, replay: accumulated
+    double cpuFrameTime = 0.0; // ms, replay: accumulated
+    uint32_t frameNum = 0;
+    uint8_t flags = 0;
+    bool isReplay = false;
+};
+
+// Roles of material textures (see "TEXTURES_PER_MATERIAL"), a role selects the block compression format
+enum class TextureRole : uint8_t
+{
+    UNUSED,
+    BASE_COLOR,
+    ROUGHNESS_METALNESS,
+    NORMAL,
+    EMISSION,
+    MIXED // shared across roles, not compressed
+};
+
+struct CompressedTexture
+{
+    std::vector<uint8_t> data;
+    std::vector<nri::TextureSubresourceUploadDesc> subresources; // "layer * mipNum + mip", pointing into "data"
+    nri::Format format = nri::Format::UNKNOWN; // "UNKNOWN" - the original texture is used
+    bool isCached = false;
+};
+
+struct TextureCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t reserved;
+    uint64_t dataSize;
+};
+
+// SHARC warm start cache: followed by "capacity" hash entries (uint64_t) and "capacity" resolved voxels (uint4)
+struct SharcCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    float sceneScale;
+    float logarithmBase;
+    float levelBias;
+    uint32_t lodLevelMax;
+    uint32_t hashKeyLayoutVersion;
+    uint64_t sceneHash;
+};
+
+// Followed by frames: "SharcHitsFrame" and "hitNum * SHARC_HIT_RECORD_STRIDE" uints
+struct SharcHitsHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t downscale;
+    uint32_t stride;
+};
+
+struct SharcHitsFrame
+{
+    float cameraPosition[3];
+    uint32_t hitNum;
+};
+
+struct SharcReplayState
+{
+    SharcCpu::HashGrid hashGrid;
+    double loadFactorSum;
+    double loadFactorMax;
+    double liveBucketSum;
+    float sceneScale;
+    uint32_t capacity;
+    uint32_t downscale;
+};
+
+// Material texture streaming: mips "residentMip+" are in VRAM
+struct TextureResidency
+{
+    std::vector<uint64_t> sizes; // memory size if mips "i+" are resident
+    uint32_t residentMip;
+    uint32_t maxResidentMip; // the coarsest top mip: not smaller than "TEXTURE_STREAMING_MIN_SIZE" and block aligned
+    uint32_t requestedMip; // the finest mip requested since the last residency update
+    uint32_t lastRequestFrameIndex;
+};
+
 struct DescriptorDesc
 {
     const char* debugName;
@@ -445,12 +936,6 @@ struct DescriptorDesc
     bool isArray;
 };
 
-struct TextureState
-{
-    Texture texture;
-    nri::AccessLayoutStage after;
-};
-
 struct AnimatedInstance
 {
     float3 basePosition;
@@ -523,22 +1008,146 @@ public:
     {
         cmdLine.add<int32_t>("dlssQuality", 'd', "DLSS quality: [-1: 4]", false, -1, cmdline::range(-1, 4));
         cmdLine.add("debugNRD", 0, "enable NRD validation");
+        cmdLine.add("headless", 0, "offscreen rendering: no swapchain, no UI, no present (use with '--frameNum')");
+        cmdLine.add("nullDevice", 0, "headless mode on NRI NONE backend, CPU-side smoke test (requires 'NRI_ENABLE_NONE_SUPPORT=ON')");
+        cmdLine.add<std::string>("capture", 0, "headless mode: comma-separated frame indices to save", false, "");
+        cmdLine.add<std::string>("capturePrefix", 0, "headless mode: path prefix for captured frames (PNG for SDR, EXR for HDR)", false, "Capture");
+        cmdLine.add("benchmark", 0, "run all tests of the scene, write a JSON report and exit");
+        cmdLine.add<int32_t>("warmupFrameNum", 0, "benchmark: number of frames to let accumulation settle", false, 120, cmdline::range(1, 100000));
+        cmdLine.add<int32_t>("measuredFrameNum", 0, "benchmark: number of measured frames", false, 60, cmdline::range(1, 100000));
+        cmdLine.add<std::string>("benchmarkReport", 0, "benchmark: output JSON report", false, "Benchmark.json");
+        cmdLine.add<std::string>("benchmarkBaseline", 0, "benchmark: JSON report to compare with", false, "");
+        cmdLine.add<float>("regressionThreshold", 0, "benchmark: allowed slowdown vs baseline, %", false, 5.0f);
+        cmdLine.add<float>("regressionMinDelta", 0, "benchmark: slowdowns smaller than this are ignored, ms", false, 0.05f);
+        cmdLine.add<float>("fixedDt", 0, "fixed timestep for animation, motion and accumulation, ms (0 - wall clock)", false, 0.0f);
+        cmdLine.add<std::string>("record", 0, "record camera, settings and history resets of every frame into a file", false, "");
+        cmdLine.add<std::string>("replay", 0, "replay a recording made with '--record'", false, "");
+        cmdLine.add<std::string>("outputResolutions", 0, "comma-separated output resolutions, i.e. '1920x1080,2560x1440': the first one is used at startup, benchmark runs all tests at each", false, "");
+        cmdLine.add<int32_t>("nrdMode", 0, "NRD mode: [0: NORMAL, 1: SH, 2: OCCLUSION, 3: DIRECTIONAL_OCCLUSION]", false, NRD_MODE, cmdline::range(0, (int32_t)NRD_MODE_NUM - 1));
+        cmdLine.add<int32_t>("nrdCombined", 0, "NRD fused denoisers: [0: DIFFUSE and SPECULAR, 1: DIFFUSE_SPECULAR]", false, NRD_COMBINED, cmdline::range(0, 1));
+        cmdLine.add<int32_t>("gbufferProfile", 0, "G-buffer formats: [0: default, 1: bandwidth saver]", false, 0, cmdline::range(0, (int32_t)GBufferProfile::MAX_NUM - 1));
+        cmdLine.add<float>("drsBudget", 0, "dynamic resolution: GPU frame time ceiling, ms (0 - off)", false, 0.0f);
+        cmdLine.add<int32_t>("textureCompression", 0, "compress uncompressed material textures at load time: [0: off, 1: BC1/BC3/BC5]", false, 1, cmdline::range(0, 1));
+        cmdLine.add<std::string>("textureCache", 0, "folder for compressed material textures, repeat launches skip encoding (empty - no cache)", false, "TextureCache");
+        cmdLine.add<int32_t>("textureBudget", 0, "VRAM budget for streamed material textures, Mb (0 - no streaming, all mips are resident)", false, 0, cmdline::range(0, 65536));
+        cmdLine.add<int32_t>("sharcCapacity", 0, "SHARC hash table capacity, entries (rounded up to a power of 2, 0 - adaptive)", false, 0, cmdline::range(0, SHARC_CAPACITY_MAX));
+        cmdLine.add<std::string>("sharcCache", 0, "folder for SHARC warm start caches, keyed by scene and capacity", false, "SharcCache");
+        cmdLine.add<int32_t>("sharcWarmStart", 0, "load a SHARC warm start cache before the first frame (if exists)", false, 0, cmdline::range(0, 1));
+        cmdLine.add<std::string>("sharcRecordHits", 0, "record SHARC update hits of every frame into a file (stalls, use with '--replay' or '--benchmark')", false, "");
+        cmdLine.add<std::string>("sharcReplay", 0, "replay recorded SHARC hits on the CPU reference of the hash grid for a range of capacities and scales, write a JSON report ('--benchmarkReport'), compare with '--benchmarkBaseline' and exit", false, "");
+        cmdLine.add("wavefront", 0, "trace opaque geometry with the wavefront backend (generate, extend, shade and shadow stages) instead of the megakernel");
+        cmdLine.add<int32_t>("rayBinning", 0, "wavefront: sort secondary rays by direction and origin cell before tracing: [0: off, 1: on, 2: every other frame (benchmark reports traversal with and without)]", false, 0, cmdline::range(0, 2));
+        cmdLine.add<int32_t>("queuedFrameNum", 0, "max number of frames queued on GPU (lower - less latency, higher - more throughput)", false, (int32_t)BUFFERED_FRAME_MAX_NUM, cmdline::range(1, (int32_t)BUFFERED_FRAME_MAX_NUM));
     }
 
     inline void ReadCmdLine(cmdline::parser& cmdLine) override
     {
         m_DlssQuality = cmdLine.get<int32_t>("dlssQuality");
         m_DebugNRD = cmdLine.exist("debugNRD");
+        m_NullDevice = cmdLine.exist("nullDevice");
+        m_Headless = cmdLine.exist("headless") || m_NullDevice;
+        m_CapturePrefix = cmdLine.get<std::string>("capturePrefix");
+
+        m_Benchmark.isActive = cmdLine.exist("benchmark");
+        m_Benchmark.warmupFrameNum = std::max((uint32_t)cmdLine.get<int32_t>("warmupFrameNum"), (uint32_t)BUFFERED_FRAME_MAX_NUM); // GPU times lag behind
+        m_Benchmark.measuredFrameNum = (uint32_t)cmdLine.get<int32_t>("measuredFrameNum");
+        m_Benchmark.reportPath = cmdLine.get<std::string>("benchmarkReport");
+        m_Benchmark.baselinePath = cmdLine.get<std::string>("benchmarkBaseline");
+        m_Benchmark.regressionThreshold = cmdLine.get<float>("regressionThreshold");
+        m_Benchmark.regressionMinDelta = cmdLine.get<float>("regressionMinDelta");
+
+        m_FixedDt = std::max(cmdLine.get<float>("fixedDt"), 0.0f);
+        m_QueuedFrameNum = cmdLine.get<int32_t>("queuedFrameNum");
+        m_GBufferProfile = (GBufferProfile)cmdLine.get<int32_t>("gbufferProfile");
+
+        m_NrdMode = cmdLine.get<int32_t>("nrdMode");
+        m_NrdCombined = cmdLine.get<int32_t>("nrdCombined") != 0;
+        m_PendingNrdMode = m_NrdMode;
+        m_PendingNrdCombined = m_NrdCombined;
+
+        float drsBudget = cmdLine.get<float>("drsBudget");
+        m_DynamicResolution.isEnabled = drsBudget > 0.0f;
+        if (m_DynamicResolution.isEnabled)
+            m_DynamicResolution.budget = drsBudget;
+
+        m_TextureCompression = cmdLine.get<int32_t>("textureCompression") != 0;
+        m_TextureCacheFolder = cmdLine.get<std::string>("textureCache");
+        m_TextureBudget = uint64_t(cmdLine.get<int32_t>("textureBudget")) * 1024 * 1024;
+
+        uint32_t sharcCapacity = (uint32_t)cmdLine.get<int32_t>("sharcCapacity");
+        m_IsSharcAdaptive = sharcCapacity == 0;
+        if (!m_IsSharcAdaptive)
+        {
+            m_SharcCapacity = SHARC_CAPACITY_MIN;
+            while (m_SharcCapacity < sharcCapacity)
+                m_SharcCapacity <<= 1;
+        }
+        m_PendingSharcCapacity = m_SharcCapacity;
+
+        m_SharcCacheFolder = cmdLine.get<std::string>("sharcCache");
+        m_IsSharcLoadPending = cmdLine.get<int32_t>("sharcWarmStart") != 0;
+        m_SharcHitsPath = cmdLine.get<std::string>("sharcRecordHits");
+        m_SharcReplayPath = cmdLine.get<std::string>("sharcReplay");
+        m_Wavefront = cmdLine.exist("wavefront");
+        m_RayBinning = cmdLine.get<int32_t>("rayBinning");
+
+        m_Recording.isReplay = !cmdLine.get<std::string>("replay").empty();
+        m_Recording.path = cmdLine.get<std::string>(m_Recording.isReplay ? "replay" : "record");
+
+        std::string capture = cmdLine.get<std::string>("capture");
+        for (size_t pos = 0; pos < capture.size(); )
+        {
+            size_t end = capture.find(',', pos);
+            if (end == std::string::npos)
+                end = capture.size();
+
+            if (end != pos)
+                m_CaptureFrames.push_back((uint32_t)std::stoul(capture.substr(pos, end - pos)));
+
+            pos = end + 1;
+        }
+
+        std::string outputResolutions = cmdLine.get<std::string>("outputResolutions");
+        for (size_t pos = 0; pos < outputResolutions.size(); )
+        {
+            size_t end = outputResolutions.find(',', pos);
+            if (end == std::string::npos)
+                end = outputResolutions.size();
+
+            uint32_t w = 0;
+            uint32_t h = 0;
+            if (sscanf(outputResolutions.substr(pos, end - pos).c_str(), "%ux%u", &w, &h) == 2 && w && h)
+                m_OutputResolutions.push_back({w, h});
+            else
+                printf("Output resolution '%s' is invalid!\n", outputResolutions.substr(pos, end - pos).c_str());
+
+            pos = end + 1;
+        }
     }
 
+    // In fixed timestep and replay modes everything, which animates or accumulates over time, is driven by the emulated clock
+    inline float GetFrameTime()
+    { return m_IsClockEmulated ? m_Clock.frameTime : m_Timer.GetFrameTime(); }
+
+    inline float GetSmoothedFrameTime()
+    { return m_IsClockEmulated ? m_Clock.smoothedFrameTime : m_Timer.GetSmoothedFrameTime(); }
+
+    inline float GetVerySmoothedFrameTime()
+    { return m_IsClockEmulated ? m_Clock.verySmoothedFrameTime : m_Timer.GetVerySmoothedFrameTime(); }
+
+    inline double GetTimeStamp()
+    { return m_IsClockEmulated ? m_Clock.timeStamp : m_Timer.GetTimeStamp(); }
+
+    inline bool IsCapturedFrame(uint32_t frameIndex) const
+    { return m_Headless && !m_NullDevice && std::find(m_CaptureFrames.begin(), m_CaptureFrames.end(), frameIndex) != m_CaptureFrames.end(); }
+
     inline nrd::RelaxSettings GetDefaultRelaxSettings() const
     {
         nrd::RelaxSettings defaults = {};
         // Helps to mitigate fireflies emphasized by DLSS
 
-        #if( NRD_MODE < OCCLUSION )
-            //defaults.enableAntiFirefly = m_DlssQuality != -1 && IsDlssEnabled(); // TODO: currently doesn't help in this case, but makes the image darker
-        #endif
+        //if (m_NrdMode < OCCLUSION)
+        //    defaults.enableAntiFirefly = m_DlssQuality != -1 && IsDlssEnabled(); // TODO: currently doesn't help in this case, but makes the image darker
 
         return defaults;
     }
@@ -547,21 +1156,126 @@ public:
     {
         nrd::ReblurSettings defaults = {};
 
-        #if( NRD_MODE < OCCLUSION )
+        if (m_NrdMode < OCCLUSION)
+        {
             // Helps to mitigate fireflies emphasized by DLSS
             defaults.enableAntiFirefly = m_DlssQuality != -1 && IsDlssEnabled();
-        #else
+        }
+        else
+        {
             // Occlusion signal is cleaner by the definition
             defaults.historyFixFrameNum = 2;
 
             // TODO: experimental, but works well so far
             defaults.minBlurRadius = 5.0f;
             defaults.lobeAngleFraction = 0.5f;
-        #endif
+        }
 
         return defaults;
     }
 
+    // REBLUR denoisers of the current NRD mode: a fused one or diffuse and specular
+    inline uint32_t GetReblurDenoisers(nrd::Denoiser denoisers[2]) const
+    {
+        if (m_NrdMode == OCCLUSION)
+        {
+            if (m_NrdCombined)
+            {
+                denoisers[0] = nrd::Denoiser::REBLUR_DIFFUSE_SPECULAR_OCCLUSION;
+                return 1;
+            }
+
+            denoisers[0] = nrd::Denoiser::REBLUR_DIFFUSE_OCCLUSION;
+            denoisers[1] = nrd::Denoiser::REBLUR_SPECULAR_OCCLUSION;
+            return 2;
+        }
+        else if (m_NrdMode == SH)
+        {
+            if (m_NrdCombined)
+            {
+                denoisers[0] = nrd::Denoiser::REBLUR_DIFFUSE_SPECULAR_SH;
+                return 1;
+            }
+
+            denoisers[0] = nrd::Denoiser::REBLUR_DIFFUSE_SH;
+            denoisers[1] = nrd::Denoiser::REBLUR_SPECULAR_SH;
+            return 2;
+        }
+        else if (m_NrdMode == DIRECTIONAL_OCCLUSION)
+        {
+            denoisers[0] = nrd::Denoiser::REBLUR_DIFFUSE_DIRECTIONAL_OCCLUSION;
+            return 1;
+        }
+
+        if (m_NrdCombined)
+        {
+            denoisers[0] = nrd::Denoiser::REBLUR_DIFFUSE_SPECULAR;
+            return 1;
+        }
+
+        denoisers[0] = nrd::Denoiser::REBLUR_DIFFUSE;
+        denoisers[1] = nrd::Denoiser::REBLUR_SPECULAR;
+        return 2;
+    }
+
+    // RELAX denoisers of the current NRD mode (occlusion modes are not supported, common denoisers are used)
+    inline uint32_t GetRelaxDenoisers(nrd::Denoiser denoisers[2]) const
+    {
+        if (m_NrdMode == SH)
+        {
+            if (m_NrdCombined)
+            {
+                denoisers[0] = nrd::Denoiser::RELAX_DIFFUSE_SPECULAR_SH;
+                return 1;
+            }
+
+            denoisers[0] = nrd::Denoiser::RELAX_DIFFUSE_SH;
+            denoisers[1] = nrd::Denoiser::RELAX_SPECULAR_SH;
+            return 2;
+        }
+
+        if (m_NrdCombined)
+        {
+            denoisers[0] = nrd::Denoiser::RELAX_DIFFUSE_SPECULAR;
+            return 1;
+        }
+
+        denoisers[0] = nrd::Denoiser::RELAX_DIFFUSE;
+        denoisers[1] = nrd::Denoiser::RELAX_SPECULAR;
+        return 2;
+    }
+
+    inline std::string GetTestsPath() const
+    {
+        std::string sceneName = std::string( utils::GetFileName(m_SceneFile) );
+        size_t dotPos = sceneName.find_last_of(".");
+        if (dotPos != std::string::npos)
+            sceneName = sceneName.substr(0, dotPos) + ".bin";
+
+        return utils::GetFullPath(sceneName, utils::DataFolder::TESTS);
+    }
+
+    inline std::string GetRecordingPath() const
+    {
+        std::string path = GetTestsPath();
+        size_t dotPos = path.find_last_of(".");
+
+        return path.substr(0, dotPos) + ".rec";
+    }
+
+    // Everything needed to reproduce a frame: user input affects the sample only via these blocks and "m_ForceHistoryReset"
+    inline std::array<std::pair<void*, uint32_t>, 5> GetRecordedBlocks()
+    {
+        return
+        {{
+            {&m_Settings, (uint32_t)sizeof(m_Settings)},
+            {m_Camera.GetState(), (uint32_t)Camera::GetStateSize()},
+            {&m_ReblurSettings, (uint32_t)sizeof(m_ReblurSettings)},
+            {&m_RelaxSettings, (uint32_t)sizeof(m_RelaxSettings)},
+            {&m_SigmaSettings, (uint32_t)sizeof(m_SigmaSettings)},
+        }};
+    }
+
     inline float3 GetSunDirection() const
     {
         float3 sunDirection;
@@ -572,29 +1286,99 @@ public:
         return sunDirection;
     }
 
+    // Hide "SampleBase" versions called by "SAMPLE_MAIN": a headless run doesn't create a window and doesn't poll events
+    bool Create(int32_t argc, char** argv, const char* windowTitle);
+    void RenderLoop();
+
+    // Batch jobs (benchmark, SHARC replay) report regressions via the process exit code
+    inline int32_t GetExitCode() const
+    { return m_ExitCode; }
+
     bool Initialize(nri::GraphicsAPI graphicsAPI) override;
     void LatencySleep(uint32_t frameIndex) override;
     void PrepareFrame(uint32_t frameIndex) override;
     void RenderFrame(uint32_t frameIndex) override;
 
     void LoadScene();
+    void CompressMaterialTextures();
     void AddInnerGlassSurfaces();
     void GenerateAnimatedCubes();
     nri::Format CreateSwapChain();
+    void CreateReadbackBuffer(nri::Format finalFormat);
+    void SaveCapturedFrame(uint32_t frameIndex);
+    void CreateTimestampQueries();
+    void WriteTimestamp(nri::CommandBuffer& commandBuffer, uint32_t bufferedFrameIndex, Timestamp timestamp);
+    void WriteWavefrontTimestamp(nri::CommandBuffer& commandBuffer, uint32_t bufferedFrameIndex, WavefrontStage stage);
+    void UpdateGpuTimes(uint32_t bufferedFrameIndex);
+    void UpdateSharcStats(uint32_t bufferedFrameIndex);
+    Pipeline GetTraceOpaquePipeline() const;
+    void CreateSharcStatsBuffer();
+    void InitializeTextureStreaming();
+    void UpdateTextureFeedback(uint32_t frameIndex);
+    void UpdateTextureResidency(uint32_t frameIndex);
+    nri::TextureDesc GetMaterialTextureDesc(uint32_t textureIndex, uint32_t firstMip) const;
+    void GatherMaterialTextureSubresources(uint32_t textureIndex, uint32_t firstMip, std::vector<nri::TextureSubresourceUploadDesc>& subresources) const;
+    void UpdateMaterialTextureDescriptors();
+    void UpdateDynamicResolution(uint32_t frameIndex);
+    void UpdateLatency();
+    bool LoadTest(const std::string& path, uint32_t test);
+    void UpdateBenchmark();
+    void FinishBenchmark();
+    void StartRecording(const std::string& path, bool isReplay);
+    void StopRecording();
+    void RecordFrame();
+    bool ReplayFrame();
+    void ApplyReplayedFrame();
     void CreateCommandBuffers();
     void CreatePipelineLayoutAndDescriptorPool();
     void CreatePipelines();
     void CreateAccelerationStructures();
     void CreateSamplers();
+    void InitializeDlss();
+    void InitializeNrd();
+    void ChangeOutputResolution(const uint2& outputResolution);
+    void ChangeNrdMode(int32_t nrdMode, bool nrdCombined);
+    void ChangeSharcCapacity(uint32_t capacity);
+    void CreateSharcBuffers(std::vector<DescriptorDesc>& descriptorDescs);
+    void UpdateSharcDescriptorSets();
+    void ChangeWavefrontCapacity(uint32_t pixelNum);
+    void CreateWavefrontBuffers(std::vector<DescriptorDesc>& descriptorDescs);
+    void UpdateWavefrontDescriptorSets();
+    void DispatchWavefront(nri::CommandBuffer& commandBuffer, uint32_t bufferedFrameIndex);
+    void CopySharcCache(nri::CommandBuffer& commandBuffer, bool isEven);
+    void SaveSharcCache();
+    bool LoadSharcCache(uint32_t frameIndex);
+    std::string GetSharcCachePath(uint32_t capacity) const;
+    void StartSharcHitRecording();
+    void SaveSharcHits();
+    int32_t ReplaySharcHits();
     void CreateResources(nri::Format swapChainFormat);
+    void CreateRenderTargets(std::vector<DescriptorDesc>& descriptorDescs, nri::Format swapChainFormat);
+    void CreateViews(const std::vector<DescriptorDesc>& descriptorDescs);
+    nri::Format GetGBufferFormat(Texture texture, GBufferProfile profile) const;
+    void ReportGBufferProfileBandwidth();
     void CreateDescriptorSets();
     void CreateTexture(std::vector<DescriptorDesc>& descriptorDescs, const char* debugName, nri::Format format, nri::Dim_t width, nri::Dim_t height, nri::Mip_t mipNum, nri::Dim_t arraySize, nri::TextureUsageBits usage, nri::AccessBits state);
+    void BindTransientTextures();
+    void AllocateTransientHeap(uint32_t heapIndex);
+    bool IsTransientHeapUsed(uint32_t heapIndex);
+    void DiscardTransientTextures();
+    void AddPlacedTexture(nri::Texture* texture, const nri::TextureDesc& textureDesc);
+    void AddPlacedBuffer(nri::Buffer* buffer, const nri::BufferDesc& bufferDesc);
+    void BindPlacedResources();
+    void AllocatePlacedRange(PlacedResource& placedResource);
+    void ReleasePlacedResource(const void* resource);
+    void DefragmentPlacedHeaps();
+    void ReportPlacedHeaps();
+    void UpdateOptionalTextures();
+    void UpdateOptionalDescriptorSets(OptionalFeature feature);
     void CreateBuffer(std::vector<DescriptorDesc>& descriptorDescs, const char* debugName, nri::Format format, uint64_t elements, uint32_t stride, nri::BufferUsageBits usage);
     void UploadStaticData();
     void UpdateConstantBuffer(uint32_t frameIndex, float resetHistoryFactor);
     void RestoreBindings(nri::CommandBuffer& commandBuffer, bool isEven);
     void GatherInstanceData();
-    uint16_t BuildOptimizedTransitions(const TextureState* states, uint32_t stateNum, std::array<nri::TextureBarrierDesc, MAX_TEXTURE_TRANSITIONS_NUM>& transitions);
+    void AddRenderPass(RenderPassType type, const char* name, const TextureState* textures, uint32_t textureNum, std::function<void()>&& execute);
+    void ExecuteRenderPasses(nri::CommandBuffer& commandBuffer);
 
 private:
     // NRD
@@ -625,7 +1409,29 @@ private:
     std::vector<nri::DescriptorSet*> m_DescriptorSets;
     std::vector<nri::Pipeline*> m_Pipelines;
     std::vector<nri::AccelerationStructure*> m_AccelerationStructures;
+    std::vector<TransientHeap> m_TransientHeaps;
+    std::vector<PlacedHeap> m_PlacedHeaps;
+    std::vector<PlacedResource> m_PlacedResources;
+    std::vector<CompressedTexture> m_CompressedTextures; // parallel to "m_Scene.textures", released after upload if streaming is off
+    std::vector<bool> m_IsRoughnessMetalnessXy; // parallel to "m_Scene.materials", roughness and metalness are moved to "xy" by "BC5" compression
+    std::vector<TextureResidency> m_TextureResidency; // parallel to "m_Scene.textures", empty if streaming is off
+    std::vector<uint32_t> m_TransientHeapIndices; // parallel to "transientTextures"
+    std::vector<OptionalTextureDesc> m_OptionalTextureDescs; // parallel to "optionalTextures"
+    std::vector<Texture> m_AliasedTextures;
+    std::vector<RenderPass> m_RenderPasses;
+    std::vector<nri::TextureBarrierDesc> m_RenderPassBarriers;
+    std::vector<Texture> m_RenderPassMergedTextures;
     std::vector<BackBuffer> m_SwapChainBuffers;
+    nri::Buffer* m_ReadbackBuffer = nullptr;
+    nri::QueryPool* m_TimestampQueryPool = nullptr;
+    nri::Buffer* m_TimestampBuffer = nullptr;
+    nri::QueryPool* m_WavefrontQueryPool = nullptr;
+    nri::Buffer* m_WavefrontTimestampBuffer = nullptr;
+    nri::Buffer* m_SharcStatsBuffer = nullptr;
+    nri::Buffer* m_TextureFeedbackBuffer = nullptr;
+    nri::Buffer* m_SharcCacheReadbackBuffer = nullptr; // exists only while saving
+    nri::Buffer* m_SharcHitsReadbackBuffer = nullptr; // exists only while recording hits
+    FILE* m_SharcHitsFile = nullptr;
 
     // Data
     std::vector<InstanceData> m_InstanceData;
@@ -636,13 +1442,49 @@ private:
     Settings m_Settings = {};
     Settings m_SettingsPrev = {};
     Settings m_SettingsDefault = {};
+    Benchmark m_Benchmark = {};
+    Recording m_Recording = {};
+    DynamicResolution m_DynamicResolution = {};
+    FrameClock m_Clock = {};
+    std::array<double, (size_t)Timestamp::MAX_NUM> m_GpuTimes = {};
+    std::array<double, (size_t)WavefrontStage::MAX_NUM> m_WavefrontGpuTimes = {};
     const std::vector<uint32_t>* m_checkMeTests = nullptr;
     const std::vector<uint32_t>* m_improveMeTests = nullptr;
+    std::vector<uint32_t> m_CaptureFrames;
+    std::vector<uint2> m_OutputResolutions;
+    std::string m_CapturePrefix;
     float4 m_HairBaseColor = float4(0.510f, 0.395f, 0.218f, 1.0f);
     float3 m_PrevLocalPos = {};
     float2 m_HairBetas = float2(0.25f, 0.6f);
+    uint2 m_OutputResolution = {}; // "GetOutputResolution" at startup, can be changed at runtime ("Final" upsamples to the window)
+    uint2 m_PendingOutputResolution = {};
+    std::string m_TextureCacheFolder;
+    std::string m_SharcCacheFolder;
+    std::string m_SharcHitsPath;
+    std::string m_SharcReplayPath;
+    uint32_t m_SharcCapacity = SHARC_CAPACITY_DEFAULT;
+    uint32_t m_PendingSharcCapacity = SHARC_CAPACITY_DEFAULT;
+    uint32_t m_SharcOccupancy = 0; // occupied hash table entries, lags behind
+    uint32_t m_SharcUpdatePathNum = 0; // traced by "SharcUpdate" (adaptive density), lags behind
+    uint32_t m_SharcStatsHead = 0;
+    int32_t m_SharcPlot = (int32_t)SharcPlot::OPAQUE_HIT_RATE;
+    std::array<uint32_t, SHARC_STATS_NUM> m_SharcStats = {}; // the latest readback
+    std::array<std::array<float, SHARC_STATS_HISTORY_SIZE>, (size_t)SharcPlot::MAX_NUM> m_SharcStatsHistory = {};
+    uint32_t m_SharcLowLoadFrameNum = 0;
+    uint32_t m_SharcCacheCapacity = 0; // capacity of the table in "m_SharcCacheReadbackBuffer"
+    uint32_t m_WavefrontPixelNum = 0; // capacity of wavefront buffers, 0 if the megakernel is used
+    int32_t m_RayBinning = 0; // 0 - off, 1 - on, 2 - every other frame
+    bool m_Wavefront = false;
+    bool m_IsWavefrontGpuTimesBinned = false; // "m_WavefrontGpuTimes" belong to a frame with ray binning
+    bool m_IsSharcAdaptive = true;
+    bool m_TextureCompression = true;
+    bool m_IsSharcResetPending = true; // hash table buffers are not zero-initialized
+    bool m_IsSharcSavePending = false;
+    bool m_IsSharcLoadPending = false;
+    bool m_IsSharcHitsReadbackPending = false;
     uint2 m_RenderResolution = {};
     uint64_t m_MorphMeshScratchSize = 0;
+    uint64_t m_TextureBudget = 0; // bytes, 0 - all mips are resident
     uint64_t m_WorldTlasDataOffsetInDynamicBuffer = 0;
     uint64_t m_LightTlasDataOffsetInDynamicBuffer = 0;
     uint32_t m_GlobalConstantBufferOffset = 0;
@@ -652,16 +1494,29 @@ private:
     uint32_t m_ProxyInstancesNum = 0;
     uint32_t m_LastSelectedTest = uint32_t(-1);
     uint32_t m_TestNum = uint32_t(-1);
+    uint32_t m_ReadbackRowPitch = 0;
+    double m_GpuFrameTime = 0.0;
+    uint64_t m_LatencyFrameNum = 0;
     int32_t m_DlssQuality = int32_t(-1);
+    int32_t m_NrdMode = NRD_MODE; // startup default from "Shared.hlsli", selects the shader subfolder
+    int32_t m_PendingNrdMode = NRD_MODE;
+    int32_t m_QueuedFrameNum = (int32_t)BUFFERED_FRAME_MAX_NUM;
+    GBufferProfile m_GBufferProfile = GBufferProfile::DEFAULT;
     float m_SigmaTemporalStabilizationStrength = 1.0f;
     float m_UiWidth = 0.0f;
     float m_MinResolutionScale = 0.5f;
     float m_DofAperture = 0.0f;
     float m_DofFocalDistance = 1.0f;
     float m_SdrScale = 1.0f;
+    float m_FixedDt = 0.0f;
+    float m_InputToPresentLatency = 0.0f;
+    float m_InputToGpuLatency = 0.0f;
+    float m_ViewZScale = 1.0f;
     bool m_ShowUi = true;
     bool m_ForceHistoryReset = false;
     bool m_Resolve = true;
+    bool m_NrdCombined = NRD_COMBINED != 0;
+    bool m_PendingNrdCombined = NRD_COMBINED != 0;
     bool m_DebugNRD = false;
     bool m_ShowValidationOverlay = false;
     bool m_PositiveZ = true;
@@ -669,6 +1524,12 @@ private:
     bool m_IsSrgb = false;
     bool m_GlassObjects = false;
     bool m_IsReloadShadersSucceeded = true;
+    bool m_Headless = false;
+    bool m_NullDevice = false;
+    bool m_IsWindowless = false;
+    int32_t m_ExitCode = 0;
+    bool m_IsClockEmulated = false;
+    bool m_IsGBufferProfileReported = false;
 };
 
 Sample::~Sample()
@@ -678,6 +1539,8 @@ Sample::~Sample()
 
     NRI.WaitForIdle(*m_GraphicsQueue);
 
+    StopRecording();
+
     m_DLSS.Shutdown();
 
     m_NRD.Destroy();
@@ -692,13 +1555,28 @@ Sample::~Sample()
         NRI.DestroyDescriptor(*backBuffer.colorAttachment);
 
     for (uint32_t i = 0; i < m_Textures.size(); i++)
-        NRI.DestroyTexture(*m_Textures[i]);
+    {
+        if (m_Textures[i])
+            NRI.DestroyTexture(*m_Textures[i]);
+    }
+
+    for (const TransientHeap& transientHeap : m_TransientHeaps)
+    {
+        if (transientHeap.memory)
+            NRI.FreeMemory(*transientHeap.memory);
+    }
 
     for (uint32_t i = 0; i < m_Buffers.size(); i++)
         NRI.DestroyBuffer(*m_Buffers[i]);
 
+    for (const PlacedHeap& placedHeap : m_PlacedHeaps)
+        NRI.FreeMemory(*placedHeap.memory);
+
     for (uint32_t i = 0; i < m_Descriptors.size(); i++)
-        NRI.DestroyDescriptor(*m_Descriptors[i]);
+    {
+        if (m_Descriptors[i])
+            NRI.DestroyDescriptor(*m_Descriptors[i]);
+    }
 
     for (uint32_t i = 0; i < m_Pipelines.size(); i++)
         NRI.DestroyPipeline(*m_Pipelines[i]);
@@ -712,167 +1590,178 @@ Sample::~Sample()
     NRI.DestroyPipelineLayout(*m_PipelineLayout);
     NRI.DestroyDescriptorPool(*m_DescriptorPool);
     NRI.DestroyFence(*m_FrameFence);
-    NRI.DestroySwapChain(*m_SwapChain);
     NRI.DestroyStreamer(*m_Streamer);
 
-    DestroyUI(NRI);
+    if (m_ReadbackBuffer)
+        NRI.DestroyBuffer(*m_ReadbackBuffer);
+
+    NRI.DestroyBuffer(*m_TimestampBuffer);
+    NRI.DestroyBuffer(*m_WavefrontTimestampBuffer);
+    NRI.DestroyBuffer(*m_SharcStatsBuffer);
+
+    if (m_TextureFeedbackBuffer)
+        NRI.DestroyBuffer(*m_TextureFeedbackBuffer);
+
+    if (m_SharcCacheReadbackBuffer)
+        NRI.DestroyBuffer(*m_SharcCacheReadbackBuffer);
+
+    if (m_SharcHitsReadbackBuffer)
+        NRI.DestroyBuffer(*m_SharcHitsReadbackBuffer);
+
+    if (m_SharcHitsFile)
+        fclose(m_SharcHitsFile);
+
+    NRI.DestroyQueryPool(*m_TimestampQueryPool);
+    NRI.DestroyQueryPool(*m_WavefrontQueryPool);
+
+    if (!m_Headless)
+    {
+        NRI.DestroySwapChain(*m_SwapChain);
+        DestroyUI(NRI);
+    }
 
     nri::nriDestroyDevice(*m_Device);
 }
 
-bool Sample::Initialize(nri::GraphicsAPI graphicsAPI)
+bool Sample::Create(int32_t argc, char** argv, const char* windowTitle)
 {
-    Rng::Hash::Initialize(m_RngState, 106937, 69);
+    // SHARC hit replay is a CPU-only batch job, it doesn't need a window too
+    for (int32_t i = 1; i < argc; i++)
+        m_IsWindowless = m_IsWindowless || !strcmp(argv[i], "--headless") || !strcmp(argv[i], "--nullDevice") || !strncmp(argv[i], "--sharcReplay=", 14);
+
+    if (!m_IsWindowless)
+        return SampleBase::Create(argc, argv, windowTitle);
+
+    // Mirrors command line handling of "SampleBase::Create" without GLFW initialization and window creation. "Final" and captures
+    // get the output resolution
+    cmdline::parser cmdLine;
+    cmdLine.add("help", '?', "print this message");
+    cmdLine.add<std::string>("api", 'a', "graphics API: D3D12 or VULKAN", false, "VULKAN", cmdline::oneof<std::string>("D3D11", "D3D12", "VULKAN"));
+    cmdLine.add<std::string>("scene", 's', "scene", false, m_SceneFile);
+    cmdLine.add<uint32_t>("width", 'w', "output resolution width", false, SampleBase::m_OutputResolution.x);
+    cmdLine.add<uint32_t>("height", 'h', "output resolution height", false, SampleBase::m_OutputResolution.y);
+    cmdLine.add<uint32_t>("frameNum", 'f', "max frames to render", false, m_FrameNum);
+    cmdLine.add<uint32_t>("vsyncInterval", 'v', "vertical sync interval (ignored, no swapchain)", false, 0);
+    cmdLine.add<uint32_t>("dpiMode", 0, "DPI mode (ignored, no window)", false, 0);
+    cmdLine.add("debugAPI", 0, "enable graphics API validation layer");
+    cmdLine.add("debugNRI", 0, "enable NRI validation layer");
+    InitCmdLine(cmdLine);
+
+    bool parseStatus = cmdLine.parse(argc, argv);
+    if (cmdLine.exist("help"))
+    {
+        printf("\n%s", cmdLine.usage().c_str());
+        return false;
+    }
 
-    nri::AdapterDesc bestAdapterDesc = {};
-    uint32_t adapterDescsNum = 1;
-    NRI_ABORT_ON_FAILURE(nri::nriEnumerateAdapters(&bestAdapterDesc, adapterDescsNum));
+    if (!parseStatus)
+    {
+        printf("\n%s\n\n%s", cmdLine.error().c_str(), cmdLine.usage().c_str());
+        return false;
+    }
 
-    nri::DeviceCreationDesc deviceCreationDesc = {};
-    deviceCreationDesc.graphicsAPI = graphicsAPI;
-    deviceCreationDesc.enableGraphicsAPIValidation = m_DebugAPI;
-    deviceCreationDesc.enableNRIValidation = m_DebugNRI;
-    deviceCreationDesc.vkBindingOffsets = VK_BINDING_OFFSETS;
-    deviceCreationDesc.adapterDesc = &bestAdapterDesc;
-    if (bestAdapterDesc.vendor == nri::Vendor::NVIDIA)
-        DlssIntegration::SetupDeviceExtensions(deviceCreationDesc);
+    const std::string api = cmdLine.get<std::string>("api");
+    nri::GraphicsAPI graphicsAPI = nri::GraphicsAPI::VK;
+    if (api == "D3D12")
+        graphicsAPI = nri::GraphicsAPI::D3D12;
+    else if (api == "D3D11")
+        graphicsAPI = nri::GraphicsAPI::D3D11;
 
-    NRI_ABORT_ON_FAILURE( nri::nriCreateDevice(deviceCreationDesc, m_Device) );
+    m_SceneFile = cmdLine.get<std::string>("scene");
+    SampleBase::m_OutputResolution = {cmdLine.get<uint32_t>("width"), cmdLine.get<uint32_t>("height")};
+    m_WindowResolution = SampleBase::m_OutputResolution;
+    m_FrameNum = cmdLine.get<uint32_t>("frameNum");
+    m_DebugAPI = cmdLine.exist("debugAPI");
+    m_DebugNRI = cmdLine.exist("debugNRI");
 
-    NRI_ABORT_ON_FAILURE( nri::nriGetInterface(*m_Device, NRI_INTERFACE(nri::CoreInterface), (nri::CoreInterface*)&NRI) );
-    NRI_ABORT_ON_FAILURE( nri::nriGetInterface(*m_Device, NRI_INTERFACE(nri::HelperInterface), (nri::HelperInterface*)&NRI) );
-    NRI_ABORT_ON_FAILURE( nri::nriGetInterface(*m_Device, NRI_INTERFACE(nri::StreamerInterface), (nri::StreamerInterface*)&NRI) );
-    NRI_ABORT_ON_FAILURE( nri::nriGetInterface(*m_Device, NRI_INTERFACE(nri::SwapChainInterface), (nri::SwapChainInterface*)&NRI) );
-    NRI_ABORT_ON_FAILURE( nri::nriGetInterface(*m_Device, NRI_INTERFACE(nri::RayTracingInterface), (nri::RayTracingInterface*)&NRI) );
-    NRI_ABORT_ON_FAILURE( nri::nriGetInterface(*m_Device, NRI_INTERFACE(nri::ResourceAllocatorInterface), (nri::ResourceAllocatorInterface*)&NRI) );
+    ReadCmdLine(cmdLine);
 
-    NRI_ABORT_ON_FAILURE( NRI.GetQueue(*m_Device, nri::QueueType::GRAPHICS, 0, m_GraphicsQueue) );
-    NRI_ABORT_ON_FAILURE( NRI.CreateFence(*m_Device, 0, m_FrameFence) );
-
-    // Create streamer
-    nri::StreamerDesc streamerDesc = {};
-    streamerDesc.constantBufferMemoryLocation = nri::MemoryLocation::HOST_UPLOAD;
-    streamerDesc.constantBufferSize = DYNAMIC_CONSTANT_BUFFER_SIZE;
-    streamerDesc.dynamicBufferMemoryLocation = nri::MemoryLocation::HOST_UPLOAD;
-    streamerDesc.dynamicBufferUsageBits = nri::BufferUsageBits::VERTEX_BUFFER | nri::BufferUsageBits::INDEX_BUFFER | nri::BufferUsageBits::ACCELERATION_STRUCTURE_BUILD_INPUT;
-    streamerDesc.frameInFlightNum = BUFFERED_FRAME_MAX_NUM + 1; // TODO: "+1" for just in case?
-    NRI_ABORT_ON_FAILURE( NRI.CreateStreamer(*m_Device, streamerDesc, m_Streamer) );
-
-    // Initialize DLSS
-    m_RenderResolution = GetOutputResolution();
-
-    if (m_DlssQuality != -1 && m_DLSS.InitializeLibrary(*m_Device, ""))
+    // Runs before device creation, nothing is rendered
+    if (!m_SharcReplayPath.empty())
     {
-        DlssInitDesc dlssInitDesc = {};
-        dlssInitDesc.outputResolution = {GetOutputResolution().x, GetOutputResolution().y};
-        dlssInitDesc.quality = (DlssQuality)m_DlssQuality;
-        dlssInitDesc.hasHdrContent = NRD_MODE < OCCLUSION;
-        dlssInitDesc.allowAutoExposure = NIS_HDR_MODE == 1;
+        m_ExitCode = ReplaySharcHits();
+        m_FrameNum = 0;
 
-        DlssSettings dlssSettings = {};
-        bool result = m_DLSS.GetOptimalSettings(dlssInitDesc.outputResolution, (DlssQuality)m_DlssQuality, dlssSettings);
-        if (result)
-        {
-            float sx = float(dlssSettings.dynamicResolutionMin.Width) / float(dlssSettings.optimalResolution.Width);
-            float sy = float(dlssSettings.dynamicResolutionMin.Height) / float(dlssSettings.optimalResolution.Height);
+        return true;
+    }
 
-            m_RenderResolution = {dlssSettings.optimalResolution.Width, dlssSettings.optimalResolution.Height};
-            m_MinResolutionScale = sy > sx ? sy : sx;
+    printf("Loading...\n");
 
-            printf("Render resolution (%u, %u)\n", m_RenderResolution.x, m_RenderResolution.y);
+    return Initialize(graphicsAPI);
+}
 
-            result = m_DLSS.Initialize(m_GraphicsQueue, dlssInitDesc);
-        }
+void Sample::RenderLoop()
+{
+    if (!m_IsWindowless)
+    {
+        SampleBase::RenderLoop();
+        return;
+    }
 
-        if (!result)
-        {
-            printf("DLSS: initialization failed!\n");
-            m_DLSS.Shutdown();
-        }
+    // No window, no events. Frame time is updated as in "SampleBase::RenderLoop" (wall clock, unless "--fixedDt" is set)
+    for (uint32_t i = 0; i < m_FrameNum; i++)
+    {
+        m_Timer.UpdateFrameTime();
 
-        m_Settings.SR = m_DLSS.HasSR();
-        m_Settings.RR = m_DLSS.HasRR();
+        LatencySleep(i);
+        PrepareFrame(i);
+        RenderFrame(i);
     }
 
-    // Initialize NRD: REBLUR, RELAX and SIGMA in one instance
-    {
-        const nrd::DenoiserDesc denoisersDescs[] =
-        {
-            // REBLUR
-    #if( NRD_MODE == OCCLUSION )
-        #if( NRD_COMBINED == 1 )
-            { NRD_ID(REBLUR_DIFFUSE_SPECULAR_OCCLUSION), nrd::Denoiser::REBLUR_DIFFUSE_SPECULAR_OCCLUSION },
-        #else
-            { NRD_ID(REBLUR_DIFFUSE_OCCLUSION), nrd::Denoiser::REBLUR_DIFFUSE_OCCLUSION },
-            { NRD_ID(REBLUR_SPECULAR_OCCLUSION), nrd::Denoiser::REBLUR_SPECULAR_OCCLUSION },
-        #endif
-    #elif( NRD_MODE == SH )
-        #if( NRD_COMBINED == 1 )
-            { NRD_ID(REBLUR_DIFFUSE_SPECULAR_SH), nrd::Denoiser::REBLUR_DIFFUSE_SPECULAR_SH },
-        #else
-            { NRD_ID(REBLUR_DIFFUSE_SH), nrd::Denoiser::REBLUR_DIFFUSE_SH },
-            { NRD_ID(REBLUR_SPECULAR_SH), nrd::Denoiser::REBLUR_SPECULAR_SH },
-        #endif
-    #elif( NRD_MODE == DIRECTIONAL_OCCLUSION )
-            { NRD_ID(REBLUR_DIFFUSE_DIRECTIONAL_OCCLUSION), nrd::Denoiser::REBLUR_DIFFUSE_DIRECTIONAL_OCCLUSION },
-    #else
-        #if( NRD_COMBINED == 1 )
-            { NRD_ID(REBLUR_DIFFUSE_SPECULAR), nrd::Denoiser::REBLUR_DIFFUSE_SPECULAR },
-        #else
-            { NRD_ID(REBLUR_DIFFUSE), nrd::Denoiser::REBLUR_DIFFUSE },
-            { NRD_ID(REBLUR_SPECULAR), nrd::Denoiser::REBLUR_SPECULAR },
-        #endif
-    #endif
+    printf("Shutting down...\n");
+}
 
-            // RELAX
-    #if( NRD_MODE == SH )
-        #if( NRD_COMBINED == 1 )
-            { NRD_ID(RELAX_DIFFUSE_SPECULAR_SH), nrd::Denoiser::RELAX_DIFFUSE_SPECULAR_SH },
-        #else
-            { NRD_ID(RELAX_DIFFUSE_SH), nrd::Denoiser::RELAX_DIFFUSE_SH },
-            { NRD_ID(RELAX_SPECULAR_SH), nrd::Denoiser::RELAX_SPECULAR_SH },
-        #endif
-    #else
-        #if( NRD_COMBINED == 1 )
-            { NRD_ID(RELAX_DIFFUSE_SPECULAR), nrd::Denoiser::RELAX_DIFFUSE_SPECULAR },
-        #else
-            { NRD_ID(RELAX_DIFFUSE), nrd::Denoiser::RELAX_DIFFUSE },
-            { NRD_ID(RELAX_SPECULAR), nrd::Denoiser::RELAX_SPECULAR },
-        #endif
-    #endif
+bool Sample::Initialize(nri::GraphicsAPI graphicsAPI)
+{
+    Rng::Hash::Initialize(m_RngState, 106937, 69);
 
-            // SIGMA
-    #if( NRD_MODE < OCCLUSION )
-            { NRD_ID(SIGMA_SHADOW), SIGMA_VARIANT },
-    #endif
+    // NONE backend doesn't expose adapters, it's used to smoke test the CPU side of the frame loop
+    if (m_NullDevice)
+        graphicsAPI = nri::GraphicsAPI::NONE;
 
-            // REFERENCE
-            { NRD_ID(REFERENCE), nrd::Denoiser::REFERENCE },
-        };
+    nri::AdapterDesc bestAdapterDesc = {};
+    if (!m_NullDevice)
+    {
+        uint32_t adapterDescsNum = 1;
+        NRI_ABORT_ON_FAILURE(nri::nriEnumerateAdapters(&bestAdapterDesc, adapterDescsNum));
+    }
+
+    nri::DeviceCreationDesc deviceCreationDesc = {};
+    deviceCreationDesc.graphicsAPI = graphicsAPI;
+    deviceCreationDesc.enableGraphicsAPIValidation = m_DebugAPI;
+    deviceCreationDesc.enableNRIValidation = m_DebugNRI;
+    deviceCreationDesc.vkBindingOffsets = VK_BINDING_OFFSETS;
+    deviceCreationDesc.adapterDesc = m_NullDevice ? nullptr : &bestAdapterDesc;
+    if (bestAdapterDesc.vendor == nri::Vendor::NVIDIA)
+        DlssIntegration::SetupDeviceExtensions(deviceCreationDesc);
 
-        nrd::InstanceCreationDesc instanceCreationDesc = {};
-        instanceCreationDesc.denoisers = denoisersDescs;
-        instanceCreationDesc.denoisersNum = helper::GetCountOf(denoisersDescs);
+    NRI_ABORT_ON_FAILURE( nri::nriCreateDevice(deviceCreationDesc, m_Device) );
 
-        nrd::IntegrationCreationDesc desc = {};
-        desc.name = "NRD";
-        desc.bufferedFramesNum = BUFFERED_FRAME_MAX_NUM;
-        desc.enableDescriptorCaching = NRD_ALLOW_DESCRIPTOR_CACHING;
-        desc.promoteFloat16to32 = NRD_PROMOTE_FLOAT16_TO_32;
-        desc.demoteFloat32to16 = NRD_DEMOTE_FLOAT32_TO_16;
-        desc.resourceWidth = (uint16_t)m_RenderResolution.x;
-        desc.resourceHeight = (uint16_t)m_RenderResolution.y;
+    NRI_ABORT_ON_FAILURE( nri::nriGetInterface(*m_Device, NRI_INTERFACE(nri::CoreInterface), (nri::CoreInterface*)&NRI) );
+    NRI_ABORT_ON_FAILURE( nri::nriGetInterface(*m_Device, NRI_INTERFACE(nri::HelperInterface), (nri::HelperInterface*)&NRI) );
+    NRI_ABORT_ON_FAILURE( nri::nriGetInterface(*m_Device, NRI_INTERFACE(nri::StreamerInterface), (nri::StreamerInterface*)&NRI) );
+    NRI_ABORT_ON_FAILURE( nri::nriGetInterface(*m_Device, NRI_INTERFACE(nri::SwapChainInterface), (nri::SwapChainInterface*)&NRI) );
+    NRI_ABORT_ON_FAILURE( nri::nriGetInterface(*m_Device, NRI_INTERFACE(nri::RayTracingInterface), (nri::RayTracingInterface*)&NRI) );
+    NRI_ABORT_ON_FAILURE( nri::nriGetInterface(*m_Device, NRI_INTERFACE(nri::ResourceAllocatorInterface), (nri::ResourceAllocatorInterface*)&NRI) );
 
-        nri::VideoMemoryInfo videoMemoryInfo1 = {};
-        NRI.QueryVideoMemoryInfo(*m_Device, nri::MemoryLocation::DEVICE, videoMemoryInfo1);
+    NRI_ABORT_ON_FAILURE( NRI.GetQueue(*m_Device, nri::QueueType::GRAPHICS, 0, m_GraphicsQueue) );
+    NRI_ABORT_ON_FAILURE( NRI.CreateFence(*m_Device, 0, m_FrameFence) );
 
-        NRI_ABORT_ON_FALSE( m_NRD.Initialize(desc, instanceCreationDesc, *m_Device, NRI, NRI) );
+    // Create streamer
+    nri::StreamerDesc streamerDesc = {};
+    streamerDesc.constantBufferMemoryLocation = nri::MemoryLocation::HOST_UPLOAD;
+    streamerDesc.constantBufferSize = DYNAMIC_CONSTANT_BUFFER_SIZE;
+    streamerDesc.dynamicBufferMemoryLocation = nri::MemoryLocation::HOST_UPLOAD;
+    streamerDesc.dynamicBufferUsageBits = nri::BufferUsageBits::VERTEX_BUFFER | nri::BufferUsageBits::INDEX_BUFFER | nri::BufferUsageBits::ACCELERATION_STRUCTURE_BUILD_INPUT;
+    streamerDesc.frameInFlightNum = BUFFERED_FRAME_MAX_NUM + 1; // sized for the deepest queue, "m_QueuedFrameNum" only lowers the number of frames in flight
+    NRI_ABORT_ON_FAILURE( NRI.CreateStreamer(*m_Device, streamerDesc, m_Streamer) );
 
-        nri::VideoMemoryInfo videoMemoryInfo2 = {};
-        NRI.QueryVideoMemoryInfo(*m_Device, nri::MemoryLocation::DEVICE, videoMemoryInfo2);
+    // Initialize DLSS and NRD
+    m_OutputResolution = m_OutputResolutions.empty() ? GetOutputResolution() : m_OutputResolutions[0];
+    m_PendingOutputResolution = m_OutputResolution;
 
-        printf("NRD: allocated %.2f Mb for REBLUR, RELAX, SIGMA and REFERENCE denoisers\n", (videoMemoryInfo2.usageSize - videoMemoryInfo1.usageSize) / (1024.0f * 1024.0f));
-    }
+    InitializeDlss();
+    InitializeNrd();
 
     #if 0
         // README "Memory requirements" table generator
@@ -934,14 +1823,28 @@ bool Sample::Initialize(nri::GraphicsAPI graphicsAPI)
     #endif
 
     LoadScene();
+    CompressMaterialTextures();
 
     if (m_SceneFile.find("BistroInterior") != std::string::npos)
         AddInnerGlassSurfaces();
 
     GenerateAnimatedCubes();
 
-    nri::Format swapChainFormat = CreateSwapChain();
+    // Headless mode renders into "Texture::Final" only
+    nri::Format swapChainFormat = ALLOW_HDR ? nri::Format::RGBA16_SFLOAT : nri::Format::RGBA8_UNORM;
+    if (m_Headless)
+    {
+        m_IsSrgb = !ALLOW_HDR;
+        CreateReadbackBuffer(swapChainFormat);
+    }
+    else
+        swapChainFormat = CreateSwapChain();
+
     CreateCommandBuffers();
+    CreateTimestampQueries();
+    CreateSharcStatsBuffer();
+    StartSharcHitRecording();
+    InitializeTextureStreaming();
     CreatePipelineLayoutAndDescriptorPool();
     CreatePipelines();
     CreateAccelerationStructures();
@@ -952,7 +1855,10 @@ bool Sample::Initialize(nri::GraphicsAPI graphicsAPI)
     UploadStaticData();
 
     m_Camera.Initialize(m_Scene.aabb.GetCenter(), m_Scene.aabb.vMin, CAMERA_RELATIVE);
-    m_Scene.UnloadTextureData();
+    // Source texels of not block-compressed textures are streamed in later (see "GatherMaterialTextureSubresources")
+    if (m_TextureResidency.empty())
+        m_Scene.UnloadTextureData();
+
     m_Scene.UnloadGeometryData();
 
     m_SettingsDefault = m_Settings;
@@ -962,17 +1868,120 @@ bool Sample::Initialize(nri::GraphicsAPI graphicsAPI)
     NRI.QueryVideoMemoryInfo(*m_Device, nri::MemoryLocation::DEVICE, videoMemoryInfo);
     printf("Allocated %.2f Mb\n", videoMemoryInfo.usageSize / (1024.0f * 1024.0f));
 
+    if (!m_Recording.path.empty())
+        StartRecording(m_Recording.path, m_Recording.isReplay);
+
+    if (m_Headless)
+    {
+        m_ShowUi = false;
+
+        return true;
+    }
+
     return InitUI(NRI, NRI, *m_Device, swapChainFormat);
 }
 
+void Sample::InitializeDlss()
+{
+    m_RenderResolution = m_OutputResolution;
+
+    if (m_DlssQuality != -1 && m_DLSS.InitializeLibrary(*m_Device, ""))
+    {
+        DlssInitDesc dlssInitDesc = {};
+        dlssInitDesc.outputResolution = {m_OutputResolution.x, m_OutputResolution.y};
+        dlssInitDesc.quality = (DlssQuality)m_DlssQuality;
+        dlssInitDesc.hasHdrContent = m_NrdMode < OCCLUSION;
+        dlssInitDesc.allowAutoExposure = NIS_HDR_MODE == 1;
+
+        DlssSettings dlssSettings = {};
+        bool result = m_DLSS.GetOptimalSettings(dlssInitDesc.outputResolution, (DlssQuality)m_DlssQuality, dlssSettings);
+        if (result)
+        {
+            float sx = float(dlssSettings.dynamicResolutionMin.Width) / float(dlssSettings.optimalResolution.Width);
+            float sy = float(dlssSettings.dynamicResolutionMin.Height) / float(dlssSettings.optimalResolution.Height);
+
+            m_RenderResolution = {dlssSettings.optimalResolution.Width, dlssSettings.optimalResolution.Height};
+            m_MinResolutionScale = sy > sx ? sy : sx;
+
+            printf("Render resolution (%u, %u)\n", m_RenderResolution.x, m_RenderResolution.y);
+
+            result = m_DLSS.Initialize(m_GraphicsQueue, dlssInitDesc);
+        }
+
+        if (!result)
+        {
+            printf("DLSS: initialization failed!\n");
+            m_DLSS.Shutdown();
+        }
+
+        m_Settings.SR = m_DLSS.HasSR();
+        m_Settings.RR = m_DLSS.HasRR();
+    }
+}
+
+void Sample::InitializeNrd()
+{
+    // REBLUR, RELAX and SIGMA in one instance, denoisers depend on the current NRD mode
+    std::vector<nrd::DenoiserDesc> denoisersDescs;
+
+    nrd::Denoiser denoisers[2];
+    uint32_t denoiserNum = GetReblurDenoisers(denoisers);
+    for (uint32_t i = 0; i < denoiserNum; i++)
+        denoisersDescs.push_back( {nrd::Identifier(denoisers[i]), denoisers[i]} );
+
+    denoiserNum = GetRelaxDenoisers(denoisers);
+    for (uint32_t i = 0; i < denoiserNum; i++)
+        denoisersDescs.push_back( {nrd::Identifier(denoisers[i]), denoisers[i]} );
+
+    if (m_NrdMode < OCCLUSION)
+        denoisersDescs.push_back( {NRD_ID(SIGMA_SHADOW), SIGMA_VARIANT} );
+
+    denoisersDescs.push_back( {NRD_ID(REFERENCE), nrd::Denoiser::REFERENCE} );
+
+    nrd::InstanceCreationDesc instanceCreationDesc = {};
+    instanceCreationDesc.denoisers = denoisersDescs.data();
+    instanceCreationDesc.denoisersNum = (uint32_t)denoisersDescs.size();
+
+    nrd::IntegrationCreationDesc desc = {};
+    desc.name = "NRD";
+    desc.bufferedFramesNum = BUFFERED_FRAME_MAX_NUM;
+    desc.enableDescriptorCaching = NRD_ALLOW_DESCRIPTOR_CACHING;
+    desc.promoteFloat16to32 = NRD_PROMOTE_FLOAT16_TO_32;
+    desc.demoteFloat32to16 = NRD_DEMOTE_FLOAT32_TO_16;
+    desc.resourceWidth = (uint16_t)m_RenderResolution.x;
+    desc.resourceHeight = (uint16_t)m_RenderResolution.y;
+
+    nri::VideoMemoryInfo videoMemoryInfo1 = {};
+    NRI.QueryVideoMemoryInfo(*m_Device, nri::MemoryLocation::DEVICE, videoMemoryInfo1);
+
+    NRI_ABORT_ON_FALSE( m_NRD.Initialize(desc, instanceCreationDesc, *m_Device, NRI, NRI) );
+
+    nri::VideoMemoryInfo videoMemoryInfo2 = {};
+    NRI.QueryVideoMemoryInfo(*m_Device, nri::MemoryLocation::DEVICE, videoMemoryInfo2);
+
+    printf("NRD: allocated %.2f Mb for REBLUR, RELAX, SIGMA and REFERENCE denoisers\n", (videoMemoryInfo2.usageSize - videoMemoryInfo1.usageSize) / (1024.0f * 1024.0f));
+}
+
 void Sample::LatencySleep(uint32_t frameIndex)
 {
-    const Frame& frame = m_Frames[frameIndex % BUFFERED_FRAME_MAX_NUM];
-    if (frameIndex >= BUFFERED_FRAME_MAX_NUM)
+    // Per-frame resources are allocated for the deepest queue, a shallower queue just waits for a more recent frame
+    const uint32_t queuedFrameNum = (uint32_t)m_QueuedFrameNum;
+    if (frameIndex >= queuedFrameNum)
     {
-        NRI.Wait(*m_FrameFence, 1 + frameIndex - BUFFERED_FRAME_MAX_NUM);
-        NRI.ResetCommandAllocator(*frame.commandAllocator);
+        const uint32_t completedFrameIndex = frameIndex - queuedFrameNum;
+        NRI.Wait(*m_FrameFence, 1 + completedFrameIndex);
+
+        UpdateLatency();
+        UpdateGpuTimes(completedFrameIndex % BUFFERED_FRAME_MAX_NUM);
+        UpdateSharcStats(completedFrameIndex % BUFFERED_FRAME_MAX_NUM);
+        UpdateTextureFeedback(completedFrameIndex);
     }
+
+    Frame& frame = m_Frames[frameIndex % BUFFERED_FRAME_MAX_NUM];
+    if (frameIndex >= BUFFERED_FRAME_MAX_NUM)
+        NRI.ResetCommandAllocator(*frame.commandAllocator);
+
+    frame.inputTimeStamp = m_Timer.GetTimeStamp(); // input gets sampled right after
 }
 
 void Sample::PrepareFrame(uint32_t frameIndex)
@@ -983,6 +1992,13 @@ void Sample::PrepareFrame(uint32_t frameIndex)
     m_SettingsPrev = m_Settings;
     m_Camera.SavePreviousState();
 
+    m_IsClockEmulated = m_FixedDt != 0.0f;
+    if (m_IsClockEmulated)
+        m_Clock = {double(frameIndex + 1) * m_FixedDt, m_FixedDt, m_FixedDt, m_FixedDt}; // time stamp is never 0, it's "not started" for "motionStartTime"
+
+    if (m_Recording.isReplay && ReplayFrame())
+        m_IsClockEmulated = true;
+
     if (IsKeyToggled(Key::Tab))
         m_ShowUi = !m_ShowUi;
     if (IsKeyToggled(Key::F1))
@@ -1004,17 +2020,16 @@ void Sample::PrepareFrame(uint32_t frameIndex)
             m_Settings.denoiser = DENOISER_REFERENCE;
     }
 
-    BeginUI();
+    if (m_Benchmark.isActive)
+        UpdateBenchmark();
+
+    if (!m_Headless)
+        BeginUI();
+
     if (!IsKeyPressed(Key::LAlt) && m_ShowUi)
     {
         static const char* onScreenModes[] =
         {
-    #if( NRD_MODE == OCCLUSION )
-            "Diffuse occlusion",
-            "Specular occlusion",
-    #elif( NRD_MODE == DIRECTIONAL_OCCLUSION )
-            "Diffuse occlusion",
-    #else
             "Final",
             "Denoised diffuse",
             "Denoised specular",
@@ -1033,9 +2048,16 @@ void Sample::PrepareFrame(uint32_t frameIndex)
             "Curvature",
             "Mip level (primary)",
             "Mip level (specular)",
-    #endif
         };
 
+        // Occlusion modes show only occlusion (see "UpdateConstantBuffer")
+        const uint32_t onScreenModeOffset = m_NrdMode >= OCCLUSION ? SHOW_AMBIENT_OCCLUSION : 0;
+        uint32_t onScreenModeNum = helper::GetCountOf(onScreenModes);
+        if (m_NrdMode == OCCLUSION)
+            onScreenModeNum = 2;
+        else if (m_NrdMode == DIRECTIONAL_OCCLUSION)
+            onScreenModeNum = 1;
+
         const nrd::LibraryDesc& nrdLibraryDesc = nrd::GetLibraryDesc();
 
         char buf[256];
@@ -1064,6 +2086,8 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                 ImGui::PlotLines("##Plot", m_FrameTimes.data(), N, head, buf, lo, hi, ImVec2(0.0f, 70.0f));
             ImGui::PopStyleColor();
 
+            ImGui::Text("Latency: %.1f ms (input - present), %.1f ms (input - GPU)", m_InputToPresentLatency, m_InputToGpuLatency);
+
             if (IsButtonPressed(Button::Right))
             {
                 ImGui::Text("Move - W/S/A/D");
@@ -1096,7 +2120,7 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                         "2.5D",
                     };
 
-                    ImGui::Combo("On screen", &m_Settings.onScreen, onScreenModes, helper::GetCountOf(onScreenModes));
+                    ImGui::Combo("On screen", &m_Settings.onScreen, onScreenModes + onScreenModeOffset, onScreenModeNum);
                     ImGui::Checkbox("Ortho", &m_Settings.ortho);
                     ImGui::SameLine();
                     ImGui::Checkbox("+Z", &m_PositiveZ);
@@ -1115,6 +2139,23 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                     ImGui::SliderFloat("FOV (deg)", &m_Settings.camFov, 1.0f, 160.0f, "%.1f");
                     ImGui::SliderFloat("Exposure", &m_Settings.exposure, 0.0f, 1000.0f, "%.3f", ImGuiSliderFlags_Logarithmic);
 
+                    { // Output resolution, applied in the next frame
+                        static const char* outputResolutionNames[] = { "Startup", "720p", "1080p", "1440p", "2160p" };
+                        const uint2 outputResolutions[] = { GetOutputResolution(), {1280, 720}, {1920, 1080}, {2560, 1440}, {3840, 2160} };
+
+                        int32_t outputResolution = -1;
+                        for (int32_t i = (int32_t)helper::GetCountOf(outputResolutions) - 1; i >= 0; i--)
+                        {
+                            if (outputResolutions[i].x == m_PendingOutputResolution.x && outputResolutions[i].y == m_PendingOutputResolution.y)
+                                outputResolution = i;
+                        }
+
+                        ImGui::BeginDisabled(m_Benchmark.isActive);
+                        if (ImGui::Combo("Output resolution", &outputResolution, outputResolutionNames, helper::GetCountOf(outputResolutionNames)))
+                            m_PendingOutputResolution = outputResolutions[outputResolution];
+                        ImGui::EndDisabled();
+                    }
+
                     if (m_DLSS.HasRR())
                     {
                         ImGui::Checkbox("DLSS-RR", &m_Settings.RR);
@@ -1134,7 +2175,20 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                     if (m_Settings.RR)
                         m_Settings.resolutionScale = 1.0f; // TODO: RR doesn't support DRS
                     else
+                    {
+                        ImGui::BeginDisabled(m_DynamicResolution.isEnabled);
                         ImGui::SliderFloat("Resolution scale (%)", &m_Settings.resolutionScale, m_MinResolutionScale, 1.0f, "%.3f");
+                        ImGui::EndDisabled();
+
+                        if (ImGui::Checkbox("DRS", &m_DynamicResolution.isEnabled))
+                            m_DynamicResolution.smoothedGpuFrameTime = 0.0;
+                        if (m_DynamicResolution.isEnabled)
+                        {
+                            ImGui::SameLine();
+                            ImGui::SetNextItemWidth( ImGui::CalcItemWidth() - ImGui::GetCursorPosX() + ImGui::GetStyle().ItemSpacing.x );
+                            ImGui::SliderFloat("GPU budget (ms)", &m_DynamicResolution.budget, 4.0f, 50.0f, "%.1f");
+                        }
+                    }
 
                     ImGui::SliderFloat("Aperture (cm)", &m_DofAperture, 0.0f, 100.0f, "%.2f");
                     ImGui::SliderFloat("Focal distance (m)", &m_DofFocalDistance, NEAR_Z, 10.0f, "%.3f");
@@ -1147,6 +2201,8 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                         ImGui::SliderFloat("Max FPS", &m_Settings.maxFps, 30.0f, 120.0f, "%.0f");
                     }
 
+                    ImGui::SliderInt("Queued frames", &m_QueuedFrameNum, 1, (int32_t)BUFFERED_FRAME_MAX_NUM);
+
                     ImGui::PushStyleColor(ImGuiCol_Text, m_Settings.motionStartTime > 0.0 ? UI_YELLOW : UI_DEFAULT);
                         bool isPressed = ImGui::Button("Animation");
                     ImGui::PopStyleColor();
@@ -1306,11 +2362,10 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                             "Half",
                         };
 
-                    #if( NRD_MODE < OCCLUSION )
-                        ImGui::SliderInt2("Samples / Bounces", &m_Settings.rpp, 1, 8);
-                    #else
-                        ImGui::SliderInt("Samples", &m_Settings.rpp, 1, 8);
-                    #endif
+                        if (m_NrdMode < OCCLUSION)
+                            ImGui::SliderInt2("Samples / Bounces", &m_Settings.rpp, 1, 8);
+                        else
+                            ImGui::SliderInt("Samples", &m_Settings.rpp, 1, 8);
                         ImGui::SliderFloat("AO / SO range (m)", &m_Settings.hitDistScale, 0.01f, sceneRadiusInMeters, "%.2f");
                         ImGui::PushStyleColor(ImGuiCol_Text, (m_Settings.denoiser == DENOISER_REFERENCE && m_Settings.tracingMode > RESOLUTION_FULL_PROBABILISTIC) ? UI_YELLOW : UI_DEFAULT);
                             ImGui::Combo("Resolution", &m_Settings.tracingMode, resolution, helper::GetCountOf(resolution));
@@ -1324,19 +2379,20 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                         ImGui::SameLine();
                         ImGui::Checkbox("Normal map", &m_Settings.normalMap);
 
-                    #if( NRD_MODE < OCCLUSION )
-                        const float3& sunDirection = GetSunDirection();
-                        ImGui::SameLine();
-                        ImGui::PushStyleColor(ImGuiCol_Text, sunDirection.z > 0.0f ? UI_DEFAULT : (m_Settings.importanceSampling ? UI_GREEN : UI_YELLOW));
-                        ImGui::Checkbox("IS", &m_Settings.importanceSampling);
-                        ImGui::PopStyleColor();
+                        if (m_NrdMode < OCCLUSION)
+                        {
+                            const float3& sunDirection = GetSunDirection();
+                            ImGui::SameLine();
+                            ImGui::PushStyleColor(ImGuiCol_Text, sunDirection.z > 0.0f ? UI_DEFAULT : (m_Settings.importanceSampling ? UI_GREEN : UI_YELLOW));
+                            ImGui::Checkbox("IS", &m_Settings.importanceSampling);
+                            ImGui::PopStyleColor();
 
-                        ImGui::Checkbox("L1 (prev frame)", &m_Settings.usePrevFrame);
-                        ImGui::SameLine();
-                        ImGui::PushStyleColor(ImGuiCol_Text, m_Settings.SHARC ? UI_GREEN : UI_YELLOW);
-                            ImGui::Checkbox("L2 (SHARC)", &m_Settings.SHARC);
-                        ImGui::PopStyleColor();
-                    #endif
+                            ImGui::Checkbox("L1 (prev frame)", &m_Settings.usePrevFrame);
+                            ImGui::SameLine();
+                            ImGui::PushStyleColor(ImGuiCol_Text, m_Settings.SHARC ? UI_GREEN : UI_YELLOW);
+                                ImGui::Checkbox("L2 (SHARC)", &m_Settings.SHARC);
+                            ImGui::PopStyleColor();
+                        }
                         if (m_Settings.tracingMode != RESOLUTION_HALF)
                         {
                             ImGui::SameLine();
@@ -1344,28 +2400,60 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                                 ImGui::Checkbox("PSR", &m_Settings.PSR);
                             ImGui::PopStyleColor();
                         }
+
+                        ImGui::Checkbox("Wavefront", &m_Wavefront);
+                        if (m_Wavefront)
+                        {
+                            // Per stage times lag behind by "BUFFERED_FRAME_MAX_NUM" frames
+                            ImGui::SameLine();
+                            ImGui::Text("Generate %.2f, shadow %.2f, bin %.2f, extend %.2f, shade %.2f ms", m_WavefrontGpuTimes[(size_t)WavefrontStage::Generate],
+                                m_WavefrontGpuTimes[(size_t)WavefrontStage::Shadow], m_WavefrontGpuTimes[(size_t)WavefrontStage::Bin],
+                                m_WavefrontGpuTimes[(size_t)WavefrontStage::Extend], m_WavefrontGpuTimes[(size_t)WavefrontStage::Shade]);
+
+                            static const char* rayBinningModes[] = { "Off", "On", "Every other frame" };
+                            ImGui::Combo("Ray binning", &m_RayBinning, rayBinningModes, helper::GetCountOf(rayBinningModes));
+                        }
+
+                        if (m_Settings.SHARC && m_NrdMode < OCCLUSION)
+                        {
+                            const uint32_t sharcUpdatePathMaxNum = (m_RenderResolution.x / SHARC_DOWNSCALE) * (m_RenderResolution.y / SHARC_DOWNSCALE);
+
+                            ImGui::Text("SHARC: %uK entries, %.1f%% occupied, %uK update paths (%.0f%%)", m_SharcCapacity / 1024, 100.0f * m_SharcOccupancy / m_SharcCapacity,
+                                m_SharcUpdatePathNum / 1024, 100.0f * m_SharcUpdatePathNum / std::max(sharcUpdatePathMaxNum, 1u));
+                            ImGui::SameLine();
+                            ImGui::Checkbox("Adaptive capacity", &m_IsSharcAdaptive);
+                            ImGui::SameLine();
+                            if (ImGui::Button("Save"))
+                                m_IsSharcSavePending = true;
+                            ImGui::SameLine();
+                            if (ImGui::Button("Load"))
+                                m_IsSharcLoadPending = true;
+
+                            // Statistics lag behind by "BUFFERED_FRAME_MAX_NUM" frames
+                            auto getRate = [&](uint32_t statIndex) -> float
+                            { return m_SharcStats[statIndex] ? 100.0f * m_SharcStats[statIndex + 1] / m_SharcStats[statIndex] : 0.0f; };
+
+                            const uint32_t sharcInsertedNum = m_SharcStats[SHARC_STAT_UPDATE_HITS] - m_SharcStats[SHARC_STAT_UPDATE_FAILURES];
+                            const float sharcProbeLength = m_SharcStats[SHARC_STAT_UPDATE_PROBES] / float(std::max(sharcInsertedNum, 1u));
+
+                            ImGui::Text("Hit rate: opaque %.1f%%, composition %.1f%%, transparent %.1f%%", getRate(SHARC_STAT_OPAQUE_QUERIES), getRate(SHARC_STAT_COMPOSITION_QUERIES), getRate(SHARC_STAT_TRANSPARENT_QUERIES));
+                            ImGui::Text("Failed insertions: %u, evictions: %u, probe length: %.2f", m_SharcStats[SHARC_STAT_UPDATE_FAILURES], m_SharcStats[SHARC_STAT_EVICTIONS], sharcProbeLength);
+                            ImGui::Text("Opaque: %.2f bounces per path, %uK LOD queries (hit rate %.1f%%)", m_SharcStatsHistory[(size_t)SharcPlot::BOUNCES_PER_PATH][(m_SharcStatsHead - 1) % SHARC_STATS_HISTORY_SIZE],
+                                m_SharcStats[SHARC_STAT_OPAQUE_LOD_QUERIES] / 1024, getRate(SHARC_STAT_OPAQUE_LOD_QUERIES));
+
+                            ImGui::Combo("Plot", &m_SharcPlot, sharcPlotNames, helper::GetCountOf(sharcPlotNames));
+
+                            const std::array<float, SHARC_STATS_HISTORY_SIZE>& sharcHistory = m_SharcStatsHistory[m_SharcPlot];
+                            const bool isPercentage = m_SharcPlot <= (int32_t)SharcPlot::TRANSPARENT_HIT_RATE;
+                            const float hi = isPercentage ? 100.0f : std::max(*std::max_element(sharcHistory.begin(), sharcHistory.end()), 1.0f);
+
+                            ImGui::PlotLines("##SharcPlot", sharcHistory.data(), SHARC_STATS_HISTORY_SIZE, m_SharcStatsHead % SHARC_STATS_HISTORY_SIZE, nullptr, 0.0f, hi, ImVec2(0.0f, 70.0f));
+                        }
                     }
                     ImGui::PopID();
 
                     // "NRD" section
-                    static const char* denoiser[] =
-                    {
-                    #if( NRD_MODE == OCCLUSION )
-                        "REBLUR_OCCLUSION",
-                        "(unsupported)",
-                    #elif( NRD_MODE == SH )
-                        "REBLUR_SH",
-                        "RELAX_SH",
-                    #elif( NRD_MODE == DIRECTIONAL_OCCLUSION )
-                        "REBLUR_DIRECTIONAL_OCCLUSION",
-                        "(unsupported)",
-                    #else
-                        "REBLUR",
-                        "RELAX",
-                    #endif
-                        "REFERENCE",
-                    };
-                    snprintf(buf, sizeof(buf) - 1, "NRD/%s [PgDown / PgUp]", denoiser[m_Settings.denoiser]);
+                    snprintf(buf, sizeof(buf) - 1, "NRD/%s [PgDown / PgUp]", denoiserNames[m_NrdMode][m_Settings.denoiser]);
 
                     ImGui::PushStyleColor(ImGuiCol_Text, UI_HEADER);
                     ImGui::PushStyleColor(ImGuiCol_Header, UI_HEADER_BACKGROUND);
@@ -1409,6 +2497,11 @@ void Sample::PrepareFrame(uint32_t frameIndex)
 
                         ImGui::SameLine();
                         m_ForceHistoryReset = ImGui::Button("Reset");
+                        ImGui::SameLine();
+                        ImGui::Checkbox("Combined", &m_PendingNrdCombined);
+
+                        // Applied between frames: NRD, DLSS, render targets and pipelines get recreated
+                        ImGui::Combo("Mode", &m_PendingNrdMode, nrdModeNames, helper::GetCountOf(nrdModeNames));
 
                         if (m_Settings.denoiser == DENOISER_REBLUR)
                         {
@@ -1518,18 +2611,18 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                                 ImGui::SameLine();
                                 ImGui::Checkbox("SHARC boost", &m_Settings.boost);
                             }
-                        #if( NRD_MODE == SH || NRD_MODE == DIRECTIONAL_OCCLUSION )
-                            ImGui::SameLine();
-                            ImGui::PushStyleColor(ImGuiCol_Text, m_Resolve ? UI_GREEN : UI_RED);
-                                ImGui::Checkbox("Resolve", &m_Resolve);
-                            ImGui::PopStyleColor();
-                        #endif
+                            if (m_NrdMode == SH || m_NrdMode == DIRECTIONAL_OCCLUSION)
+                            {
+                                ImGui::SameLine();
+                                ImGui::PushStyleColor(ImGuiCol_Text, m_Resolve ? UI_GREEN : UI_RED);
+                                    ImGui::Checkbox("Resolve", &m_Resolve);
+                                ImGui::PopStyleColor();
+                            }
 
                             ImGui::BeginDisabled(m_Settings.adaptiveAccumulation);
                                 ImGui::SliderInt2("Accumulation (frames)", &m_Settings.maxAccumulatedFrameNum, 0, MAX_HISTORY_FRAME_NUM, "%d");
-                            #if( NRD_MODE != OCCLUSION )
-                                ImGui::SliderInt("Stabilization (frames)", (int32_t*)&m_ReblurSettings.maxStabilizedFrameNum, 0, m_Settings.maxAccumulatedFrameNum, "%d");
-                            #endif
+                                if (m_NrdMode != OCCLUSION)
+                                    ImGui::SliderInt("Stabilization (frames)", (int32_t*)&m_ReblurSettings.maxStabilizedFrameNum, 0, m_Settings.maxAccumulatedFrameNum, "%d");
                             ImGui::EndDisabled();
 
                             if (m_Settings.tracingMode == RESOLUTION_FULL_PROBABILISTIC)
@@ -1543,13 +2636,14 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                                 ImGui::PopStyleColor();
                             }
 
-                        #if( NRD_MODE < OCCLUSION )
-                            if (m_Settings.tracingMode == RESOLUTION_FULL_PROBABILISTIC)
-                                ImGui::PushStyleColor(ImGuiCol_Text, m_ReblurSettings.diffusePrepassBlurRadius != 0.0f && m_ReblurSettings.specularPrepassBlurRadius != 0.0f ? UI_GREEN : UI_RED);
-                            ImGui::SliderFloat2("Pre-pass radius (px)", &m_ReblurSettings.diffusePrepassBlurRadius, 0.0f, 75.0f, "%.1f");
-                            if (m_Settings.tracingMode == RESOLUTION_FULL_PROBABILISTIC)
-                                ImGui::PopStyleColor();
-                        #endif
+                            if (m_NrdMode < OCCLUSION)
+                            {
+                                if (m_Settings.tracingMode == RESOLUTION_FULL_PROBABILISTIC)
+                                    ImGui::PushStyleColor(ImGuiCol_Text, m_ReblurSettings.diffusePrepassBlurRadius != 0.0f && m_ReblurSettings.specularPrepassBlurRadius != 0.0f ? UI_GREEN : UI_RED);
+                                ImGui::SliderFloat2("Pre-pass radius (px)", &m_ReblurSettings.diffusePrepassBlurRadius, 0.0f, 75.0f, "%.1f");
+                                if (m_Settings.tracingMode == RESOLUTION_FULL_PROBABILISTIC)
+                                    ImGui::PopStyleColor();
+                            }
 
                             ImGui::PushStyleColor(ImGuiCol_Text, m_ReblurSettings.minBlurRadius < 0.5f ? UI_RED : UI_DEFAULT);
                             ImGui::SliderFloat("Min blur radius (px)", &m_ReblurSettings.minBlurRadius, 0.0f, 10.0f, "%.1f");
@@ -1699,12 +2793,13 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                                 ImGui::SameLine();
                                 ImGui::Checkbox("SHARC boost", &m_Settings.boost);
                             }
-                        #if( NRD_MODE == SH )
-                            ImGui::SameLine();
-                            ImGui::PushStyleColor(ImGuiCol_Text, m_Resolve ? UI_GREEN : UI_RED);
-                                ImGui::Checkbox("Resolve", &m_Resolve);
-                            ImGui::PopStyleColor();
-                        #endif
+                            if (m_NrdMode == SH)
+                            {
+                                ImGui::SameLine();
+                                ImGui::PushStyleColor(ImGuiCol_Text, m_Resolve ? UI_GREEN : UI_RED);
+                                    ImGui::Checkbox("Resolve", &m_Resolve);
+                                ImGui::PopStyleColor();
+                            }
 
                             ImGui::BeginDisabled(m_Settings.adaptiveAccumulation);
                                 ImGui::SliderInt2("Accumulation (frames)", &m_Settings.maxAccumulatedFrameNum, 0, MAX_HISTORY_FRAME_NUM, "%d");
@@ -1721,13 +2816,14 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                                 ImGui::PopStyleColor();
                             }
 
-                        #if( NRD_MODE < OCCLUSION )
-                            if (m_Settings.tracingMode == RESOLUTION_FULL_PROBABILISTIC)
-                                ImGui::PushStyleColor(ImGuiCol_Text, m_RelaxSettings.diffusePrepassBlurRadius != 0.0f && m_RelaxSettings.specularPrepassBlurRadius != 0.0f ? UI_GREEN : UI_RED);
-                            ImGui::SliderFloat2("Pre-pass radius (px)", &m_RelaxSettings.diffusePrepassBlurRadius, 0.0f, 75.0f, "%.1f");
-                            if (m_Settings.tracingMode == RESOLUTION_FULL_PROBABILISTIC)
-                                ImGui::PopStyleColor();
-                        #endif
+                            if (m_NrdMode < OCCLUSION)
+                            {
+                                if (m_Settings.tracingMode == RESOLUTION_FULL_PROBABILISTIC)
+                                    ImGui::PushStyleColor(ImGuiCol_Text, m_RelaxSettings.diffusePrepassBlurRadius != 0.0f && m_RelaxSettings.specularPrepassBlurRadius != 0.0f ? UI_GREEN : UI_RED);
+                                ImGui::SliderFloat2("Pre-pass radius (px)", &m_RelaxSettings.diffusePrepassBlurRadius, 0.0f, 75.0f, "%.1f");
+                                if (m_Settings.tracingMode == RESOLUTION_FULL_PROBABILISTIC)
+                                    ImGui::PopStyleColor();
+                            }
 
                             ImGui::SliderInt("A-trous iterations", (int32_t*)&m_RelaxSettings.atrousIterationNum, 2, 8);
                             ImGui::SliderFloat2("Diff-Spec luma weight", &m_RelaxSettings.diffusePhiLuminance, 0.0f, 10.0f, "%.1f");
@@ -1816,7 +2912,6 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                                     " --shaderModel 6_6"
                                     " --sourceDir Shaders"
                                     " -c Shaders.cfg"
-                                    " -o _Shaders"
                                     " -I Shaders"
                                     " -I External"
                                     " -I " STRINGIFY(ML_SOURCE_DIR)
@@ -1827,6 +2922,9 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                                     " -D NRD_NORMAL_ENCODING=" STRINGIFY(NRD_NORMAL_ENCODING)
                                     " -D NRD_ROUGHNESS_ENCODING=" STRINGIFY(NRD_ROUGHNESS_ENCODING);
 
+                                // Only the current NRD mode
+                                sampleShaders += std::string(" -o _Shaders/") + nrdModeFolders[m_NrdMode] + " -D NRD_MODE=" + std::to_string(m_NrdMode);
+
                                 nrdShaders +=
                                     " --useAPI --flatten --stripReflection --WX --colorize"
                                     " --sRegShift 100 --tRegShift 200 --bRegShift 300 --uRegShift 400"
@@ -1905,11 +3003,7 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                         float buttonWidth = 25.0f * float(GetWindowResolution().x) / float(GetOutputResolution().x);
 
                         char s[64];
-                        std::string sceneName = std::string( utils::GetFileName(m_SceneFile) );
-                        size_t dotPos = sceneName.find_last_of(".");
-                        if (dotPos != std::string::npos)
-                            sceneName = sceneName.substr(0, dotPos) + ".bin";
-                        const std::string path = utils::GetFullPath(sceneName, utils::DataFolder::TESTS);
+                        const std::string path = GetTestsPath();
                         const uint32_t testByteSize = sizeof(m_Settings) + Camera::GetStateSize();
 
                         // Get number of tests
@@ -2001,37 +3095,8 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                             if (ImGui::Button(i == m_LastSelectedTest ? "*" : s, ImVec2(buttonWidth, 0.0f)) || isTestChanged)
                             {
                                 uint32_t test = isTestChanged ? m_LastSelectedTest : i;
-                                FILE* fp = fopen(path.c_str(), "rb");
-
-                                if (fp && fseek(fp, test * testByteSize, SEEK_SET) == 0)
-                                {
-                                    size_t elemNum = fread(&m_Settings, sizeof(m_Settings), 1, fp);
-                                    if (elemNum == 1)
-                                        elemNum = fread(m_Camera.GetState(), Camera::GetStateSize(), 1, fp);
-
-                                    m_LastSelectedTest = test;
-
-                                    // File read error
-                                    if (elemNum != 1)
-                                    {
-                                        m_Camera.Initialize(m_Scene.aabb.GetCenter(), m_Scene.aabb.vMin, CAMERA_RELATIVE);
-                                        m_Settings = m_SettingsDefault;
-                                    }
-
-                                    // Reset some settings to defaults to avoid a potential confusion
-                                    m_Settings.debug = 0.0f;
-                                    m_Settings.denoiser = DENOISER_REBLUR;
-                                    m_Settings.RR = m_DLSS.HasRR();
-                                    m_Settings.SR = m_DLSS.HasSR();
-                                    m_Settings.TAA = true;
-                                    m_Settings.cameraJitter = true;
-                                    m_Settings.onScreen = clamp(m_Settings.onScreen, 0, (int32_t)helper::GetCountOf(onScreenModes));
-
-                                    m_ForceHistoryReset = true;
-                                }
-
-                                if (fp)
-                                    fclose(fp);
+                                if (LoadTest(path, test))
+                                    m_Settings.onScreen = clamp(m_Settings.onScreen, 0, (int32_t)onScreenModeNum);
 
                                 isTestChanged = false;
                             }
@@ -2085,6 +3150,15 @@ void Sample::PrepareFrame(uint32_t frameIndex)
                                 m_TestNum = uint32_t(-1);
                             }
                         }
+
+                        // "Record" button (a flythrough for "--replay")
+                        if (!m_Recording.isReplay && ImGui::Button(m_Recording.file ? "Stop recording" : "Record"))
+                        {
+                            if (m_Recording.file)
+                                StopRecording();
+                            else
+                                StartRecording(GetRecordingPath(), false);
+                        }
                     }
                     ImGui::PopID();
                 }
@@ -2093,7 +3167,9 @@ void Sample::PrepareFrame(uint32_t frameIndex)
         }
         ImGui::End();
     }
-    EndUI(NRI, *m_Streamer);
+
+    if (!m_Headless)
+        EndUI(NRI, *m_Streamer);
 
     // Animate scene and update camera
     cBoxf cameraLimits = m_Scene.aabb;
@@ -2101,7 +3177,7 @@ void Sample::PrepareFrame(uint32_t frameIndex)
 
     CameraDesc desc = {};
     desc.limits = cameraLimits;
-    desc.aspectRatio = float(GetOutputResolution().x) / float(GetOutputResolution().y);
+    desc.aspectRatio = float(m_OutputResolution.x) / float(m_OutputResolution.y);
     desc.horizontalFov = degrees( atan( tan( radians( m_Settings.camFov ) * 0.5f ) *  desc.aspectRatio * 9.0f / 16.0f ) * 2.0f ); // recalculate to ultra-wide if needed
     desc.nearZ = NEAR_Z * m_Settings.meterToUnitsMultiplier;
     desc.farZ = 10000.0f * m_Settings.meterToUnitsMultiplier;
@@ -2114,7 +3190,7 @@ void Sample::PrepareFrame(uint32_t frameIndex)
 
     if (m_Settings.motionStartTime > 0.0)
     {
-        float time = float(m_Timer.GetTimeStamp() - m_Settings.motionStartTime);
+        float time = float(GetTimeStamp() - m_Settings.motionStartTime);
         float amplitude = 40.0f * m_Camera.state.motionScale;
         float period = 0.0003f * time * (m_Settings.emulateMotionSpeed < 0.0f ? 1.0f / (1.0f + abs(m_Settings.emulateMotionSpeed)) : (1.0f + m_Settings.emulateMotionSpeed));
 
@@ -2145,18 +3221,51 @@ void Sample::PrepareFrame(uint32_t frameIndex)
     }
     else if (m_Settings.motionStartTime == -1.0)
     {
-        m_Settings.motionStartTime = m_Timer.GetTimeStamp();
+        m_Settings.motionStartTime = GetTimeStamp();
         m_PrevLocalPos = float3::Zero();
     }
 
-    m_Camera.Update(desc, frameIndex);
+    // Output resolution (UI or benchmark sweep)
+    if (m_PendingOutputResolution.x != m_OutputResolution.x || m_PendingOutputResolution.y != m_OutputResolution.y)
+        ChangeOutputResolution(m_PendingOutputResolution);
+
+    if (m_PendingNrdMode != m_NrdMode || m_PendingNrdCombined != m_NrdCombined)
+        ChangeNrdMode(m_PendingNrdMode, m_PendingNrdCombined);
+
+    if (m_PendingSharcCapacity != m_SharcCapacity)
+        ChangeSharcCapacity(m_PendingSharcCapacity);
+
+    // Wavefront buffers follow the render resolution, they are released if the megakernel is used
+    const uint32_t wavefrontPixelNum = m_Wavefront ? m_RenderResolution.x * m_RenderResolution.y : 0;
+    if (wavefrontPixelNum != m_WavefrontPixelNum)
+        ChangeWavefrontCapacity(wavefrontPixelNum);
+
+    if (m_IsSharcLoadPending)
+    {
+        LoadSharcCache(frameIndex);
+        m_IsSharcLoadPending = false;
+    }
+
+    // Material texture streaming
+    UpdateTextureResidency(frameIndex);
+
+    // Dynamic resolution (before recording to keep replays deterministic)
+    UpdateDynamicResolution(frameIndex);
+
+    if (m_Recording.isReplay)
+        ApplyReplayedFrame();
+    else
+        m_Camera.Update(desc, frameIndex);
+
+    if (m_Recording.file && !m_Recording.isReplay)
+        RecordFrame();
 
     // Animate scene
     const float animationSpeed = m_Settings.pauseAnimation ? 0.0f : (m_Settings.animationSpeed < 0.0f ? 1.0f / (1.0f + abs(m_Settings.animationSpeed)) : (1.0f + m_Settings.animationSpeed));
-    const float animationDelta = animationSpeed * m_Timer.GetFrameTime() * 0.001f;
+    const float animationDelta = animationSpeed * GetFrameTime() * 0.001f;
 
     for (size_t i = 0; i < m_Scene.animations.size(); i++)
-        m_Scene.Animate(animationSpeed, m_Timer.GetFrameTime(), m_Settings.animationProgress, (int32_t)i);
+        m_Scene.Animate(animationSpeed, GetFrameTime(), m_Settings.animationProgress, (int32_t)i);
 
     // Animate sun
     if (m_Settings.animateSun)
@@ -2166,9 +3275,9 @@ void Sample::PrepareFrame(uint32_t frameIndex)
         if (m_Settings.animateSun != m_SettingsPrev.animateSun)
         {
             sunAzimuthPrev = m_Settings.sunAzimuth;
-            sunMotionStartTime = m_Timer.GetTimeStamp();
+            sunMotionStartTime = GetTimeStamp();
         }
-        double t = m_Timer.GetTimeStamp() - sunMotionStartTime;
+        double t = GetTimeStamp() - sunMotionStartTime;
         if (!m_Settings.pauseAnimation)
             m_Settings.sunAzimuth = sunAzimuthPrev + (float)sin(t * animationSpeed * 0.0003) * 10.0f;
     }
@@ -2294,7 +3403,7 @@ void Sample::PrepareFrame(uint32_t frameIndex)
             "  Primary rays  : %ux%u\n"
             "  Indirect rays : %ux%u x %u ray(s)\n"
             "  Indirect rpp  : %.2f\n",
-            GetOutputResolution().x, GetOutputResolution().y,
+            m_OutputResolution.x, m_OutputResolution.y,
             pw, ph,
             iw, ih, rayNum,
             rpp
@@ -2316,6 +3425,8 @@ void Sample::PrepareFrame(uint32_t frameIndex)
         }
     }
 
+    UpdateOptionalTextures();
+
     // Global history reset
     if (m_SettingsPrev.denoiser != m_Settings.denoiser)
         m_ForceHistoryReset = true;
@@ -2346,7 +3457,7 @@ void Sample::PrepareFrame(uint32_t frameIndex)
     if (m_Settings.adaptiveAccumulation)
     {
         bool isFastHistoryEnabled = m_Settings.maxAccumulatedFrameNum > m_Settings.maxFastAccumulatedFrameNum;
-        float fps = 1000.0f / m_Timer.GetVerySmoothedFrameTime();
+        float fps = 1000.0f / GetVerySmoothedFrameTime();
         fps = min(fps, 121.0f);
 
         // REBLUR / RELAX
@@ -2390,11 +3501,653 @@ void Sample::PrepareFrame(uint32_t frameIndex)
     nri::nriEndAnnotation();
 }
 
-void Sample::LoadScene()
+bool Sample::LoadTest(const std::string& path, uint32_t test)
 {
-    // Proxy geometry, which will be instancinated
-    std::string sceneFile = utils::GetFullPath("Cubes/Cubes.gltf", utils::DataFolder::SCENES);
-    NRI_ABORT_ON_FALSE( utils::LoadScene(sceneFile, m_Scene, !ALLOW_BLAS_MERGING) );
+    const uint32_t testByteSize = sizeof(m_Settings) + Camera::GetStateSize();
+
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return false;
+
+    bool result = fseek(fp, test * testByteSize, SEEK_SET) == 0;
+    if (result)
+    {
+        size_t elemNum = fread(&m_Settings, sizeof(m_Settings), 1, fp);
+        if (elemNum == 1)
+            elemNum = fread(m_Camera.GetState(), Camera::GetStateSize(), 1, fp);
+
+        m_LastSelectedTest = test;
+
+        // File read error
+        if (elemNum != 1)
+        {
+            m_Camera.Initialize(m_Scene.aabb.GetCenter(), m_Scene.aabb.vMin, CAMERA_RELATIVE);
+            m_Settings = m_SettingsDefault;
+        }
+
+        // Reset some settings to defaults to avoid a potential confusion
+        m_Settings.debug = 0.0f;
+        m_Settings.denoiser = DENOISER_REBLUR;
+        m_Settings.RR = m_DLSS.HasRR();
+        m_Settings.SR = m_DLSS.HasSR();
+        m_Settings.TAA = true;
+        m_Settings.cameraJitter = true;
+
+        m_ForceHistoryReset = true;
+    }
+
+    fclose(fp);
+
+    return result;
+}
+
+void Sample::UpdateBenchmark()
+{
+    Benchmark& benchmark = m_Benchmark;
+
+    if (benchmark.frame == 0)
+    {
+        // Get number of tests
+        if (benchmark.test == 0 && benchmark.outputResolutionIndex == 0)
+        {
+            FILE* fp = fopen(GetTestsPath().c_str(), "rb");
+            if (fp)
+            {
+                fseek(fp, 0, SEEK_END);
+                benchmark.testNum = ftell(fp) / (sizeof(m_Settings) + Camera::GetStateSize());
+                fclose(fp);
+            }
+
+            printf("Benchmark: %u tests, %u warmup frames, %u measured frames\n", benchmark.testNum, benchmark.warmupFrameNum, benchmark.measuredFrameNum);
+
+            if (!benchmark.testNum)
+            {
+                FinishBenchmark();
+                return;
+            }
+        }
+
+        LoadTest(GetTestsPath(), benchmark.test);
+        m_Settings.limitFps = false;
+
+        benchmark.accumulated = {};
+        benchmark.accumulated.test = benchmark.outputResolutionIndex * benchmark.testNum + benchmark.test + 1;
+        benchmark.accumulated.outputResolution = m_OutputResolution;
+    }
+    else if (benchmark.frame > benchmark.warmupFrameNum)
+    {
+        for (uint32_t i = 0; i < (uint32_t)Timestamp::MAX_NUM; i++)
+            benchmark.accumulated.gpuTimes[i] += m_GpuTimes[i];
+
+        for (uint32_t i = 0; i < (uint32_t)WavefrontStage::MAX_NUM; i++)
+            benchmark.accumulated.wavefrontGpuTimes[i] += m_WavefrontGpuTimes[i];
+
+        // Secondary ray traversal, split by ray binning ("--rayBinning=2" measures both in one run)
+        if (m_Wavefront)
+        {
+            const uint32_t i = m_IsWavefrontGpuTimesBinned ? 1 : 0;
+            benchmark.accumulated.traversalTimes[i] += m_WavefrontGpuTimes[(size_t)WavefrontStage::Bin] + m_WavefrontGpuTimes[(size_t)WavefrontStage::Extend];
+            benchmark.accumulated.traversalFrameNums[i]++;
+        }
+
+        benchmark.accumulated.gpuFrameTime += m_GpuFrameTime;
+        benchmark.accumulated.cpuFrameTime += m_Timer.GetFrameTime();
+    }
+
+    if (benchmark.frame < benchmark.warmupFrameNum + benchmark.measuredFrameNum)
+    {
+        benchmark.frame++;
+        return;
+    }
+
+    // Test is done
+    BenchmarkResult& result = benchmark.accumulated;
+    const double norm = 1.0 / double(benchmark.measuredFrameNum);
+
+    for (double& gpuTime : result.gpuTimes)
+        gpuTime *= norm;
+
+    for (double& gpuTime : result.wavefrontGpuTimes)
+        gpuTime *= norm;
+
+    for (uint32_t i = 0; i < 2; i++)
+        result.traversalTimes[i] /= double(std::max(result.traversalFrameNums[i], 1u));
+
+    result.gpuFrameTime *= norm;
+    result.cpuFrameTime *= norm;
+
+    const uint32_t outputResolutionNum = std::max((uint32_t)m_OutputResolutions.size(), 1u);
+    printf("Benchmark: test %u/%u (%ux%u) - GPU %.3f ms, CPU %.3f ms\n", result.test, benchmark.testNum * outputResolutionNum, result.outputResolution.x, result.outputResolution.y, result.gpuFrameTime, result.cpuFrameTime);
+    if (result.traversalFrameNums[0] && result.traversalFrameNums[1])
+        printf("Benchmark: test %u - traversal %.3f ms, with ray binning %.3f ms (%.2fx)\n", result.test, result.traversalTimes[0], result.traversalTimes[1], result.traversalTimes[0] / std::max(result.traversalTimes[1], 1e-6));
+
+    benchmark.results.push_back(result);
+    benchmark.frame = 0;
+    benchmark.test++;
+
+    if (benchmark.test == benchmark.testNum)
+    {
+        // Sweep: the same tests at the next output resolution, scene and BVH are reused
+        if (++benchmark.outputResolutionIndex < outputResolutionNum)
+        {
+            benchmark.test = 0;
+            m_PendingOutputResolution = m_OutputResolutions[benchmark.outputResolutionIndex];
+        }
+        else
+            FinishBenchmark();
+    }
+}
+
+inline void SkipJsonSpaces(const char*& s)
+{
+    while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r')
+        s++;
+}
+
+inline bool ReadJsonString(const char*& s, std::string& str)
+{
+    if (*s++ != '"')
+        return false;
+
+    // Escapes are kept as is, names in reports don't have them
+    while (*s && *s != '"')
+    {
+        if (*s == '\\' && s[1])
+            str += *s++;
+
+        str += *s++;
+    }
+
+    return *s++ == '"';
+}
+
+// Numeric members of objects with a numeric "test" member are keyed as "<test>/<name>", "isNumber" is set if the value itself is a number
+inline bool ReadJsonValue(const char*& s, std::map<std::string, double>& values, double& number, bool& isNumber)
+{
+    isNumber = false;
+    SkipJsonSpaces(s);
+
+    if (*s == '{')
+    {
+        s++;
+
+        std::map<std::string, double> members;
+        SkipJsonSpaces(s);
+        if (*s == '}')
+        {
+            s++;
+            return true;
+        }
+
+        while (true)
+        {
+            std::string name;
+            SkipJsonSpaces(s);
+            if (!ReadJsonString(s, name))
+                return false;
+
+            SkipJsonSpaces(s);
+            if (*s++ != ':')
+                return false;
+
+            double member = 0.0;
+            bool isMemberNumber = false;
+            if (!ReadJsonValue(s, values, member, isMemberNumber))
+                return false;
+
+            if (isMemberNumber)
+                members[name] = member;
+
+            SkipJsonSpaces(s);
+            if (*s == '}')
+                break;
+
+            if (*s++ != ',')
+                return false;
+        }
+
+        s++;
+
+        auto test = members.find("test");
+        if (test != members.end())
+        {
+            const std::string prefix = std::to_string((uint32_t)test->second) + "/";
+            for (const auto& member : members)
+            {
+                if (member.first != "test")
+                    values[prefix + member.first] = member.second;
+            }
+        }
+    }
+    else if (*s == '[')
+    {
+        s++;
+
+        SkipJsonSpaces(s);
+        if (*s == ']')
+        {
+            s++;
+            return true;
+        }
+
+        while (true)
+        {
+            double element = 0.0;
+            bool isElementNumber = false;
+            if (!ReadJsonValue(s, values, element, isElementNumber))
+                return false;
+
+            SkipJsonSpaces(s);
+            if (*s == ']')
+                break;
+
+            if (*s++ != ',')
+                return false;
+        }
+
+        s++;
+    }
+    else if (*s == '"')
+    {
+        std::string str;
+        if (!ReadJsonString(s, str))
+            return false;
+    }
+    else if (!strncmp(s, "true", 4) || !strncmp(s, "null", 4))
+        s += 4;
+    else if (!strncmp(s, "false", 5))
+        s += 5;
+    else
+    {
+        char* end = nullptr;
+        number = strtod(s, &end);
+        if (end == s)
+            return false;
+
+        s = end;
+        isNumber = true;
+    }
+
+    return true;
+}
+
+inline std::map<std::string, double> LoadBenchmarkReport(const std::string& path)
+{
+    // Any JSON layout is accepted: numeric values of objects having a "test" member (i.e. written by "FinishBenchmark" or "ReplaySharcHits") are keyed as "<test>/<name>"
+    std::map<std::string, double> values;
+
+    std::vector<uint8_t> data;
+    utils::LoadFile(path, data);
+    if (data.empty())
+        return values;
+
+    data.push_back(0);
+
+    const char* s = (const char*)data.data();
+    double number = 0.0;
+    bool isNumber = false;
+    if (!ReadJsonValue(s, values, number, isNumber))
+    {
+        printf("Benchmark: '%s' is not a valid JSON (offset %u)!\n", path.c_str(), uint32_t(s - (const char*)data.data()));
+        values.clear();
+    }
+
+    return values;
+}
+
+void Sample::FinishBenchmark()
+{
+    Benchmark& benchmark = m_Benchmark;
+    benchmark.isActive = false;
+
+    // Ray binning speedup of the scene, over tests traced with and without it ("--rayBinning=2")
+    double traversalTime = 0.0;
+    double traversalBinnedTime = 0.0;
+    uint32_t traversalTestNum = 0;
+    for (const BenchmarkResult& result : benchmark.results)
+    {
+        if (result.traversalFrameNums[0] && result.traversalFrameNums[1])
+        {
+            traversalTime += result.traversalTimes[0];
+            traversalBinnedTime += result.traversalTimes[1];
+            traversalTestNum++;
+        }
+    }
+
+    const double rayBinningSpeedup = traversalBinnedTime != 0.0 ? traversalTime / traversalBinnedTime : 0.0;
+    if (traversalTestNum)
+    {
+        printf("Benchmark: ray binning in '%s' - traversal %.3f ms -> %.3f ms (%.2fx, %u tests)\n", m_SceneFile.c_str(),
+            traversalTime / traversalTestNum, traversalBinnedTime / traversalTestNum, rayBinningSpeedup, traversalTestNum);
+    }
+
+    // Write report
+    FILE* fp = fopen(benchmark.reportPath.c_str(), "w");
+    if (fp)
+    {
+        fprintf(fp, "{\n");
+        fprintf(fp, "    \"scene\": \"%s\",\n", m_SceneFile.c_str());
+        fprintf(fp, "    \"outputResolution\": [%u, %u],\n", m_OutputResolution.x, m_OutputResolution.y);
+        fprintf(fp, "    \"renderResolution\": [%u, %u],\n", m_RenderResolution.x, m_RenderResolution.y);
+        fprintf(fp, "    \"gbufferProfile\": \"%s\",\n", gbufferProfileNames[(size_t)m_GBufferProfile]);
+        fprintf(fp, "    \"wavefront\": %s,\n", m_Wavefront ? "true" : "false");
+        fprintf(fp, "    \"rayBinning\": %d,\n", m_Wavefront ? m_RayBinning : 0);
+        if (traversalTestNum)
+            fprintf(fp, "    \"rayBinningSpeedup\": %.4f,\n", rayBinningSpeedup);
+        fprintf(fp, "    \"warmupFrameNum\": %u,\n", benchmark.warmupFrameNum);
+        fprintf(fp, "    \"measuredFrameNum\": %u,\n", benchmark.measuredFrameNum);
+        fprintf(fp, "    \"tests\":\n");
+        fprintf(fp, "    [\n");
+
+        for (size_t i = 0; i < benchmark.results.size(); i++)
+        {
+            const BenchmarkResult& result = benchmark.results[i];
+
+            fprintf(fp, "        {\"test\": %u, \"outputResolution\": [%u, %u], \"cpuFrameTime\": %.4f, \"gpuFrameTime\": %.4f", result.test, result.outputResolution.x, result.outputResolution.y, result.cpuFrameTime, result.gpuFrameTime);
+            for (uint32_t j = 1; j < (uint32_t)Timestamp::MAX_NUM; j++)
+                fprintf(fp, ", \"%s\": %.4f", timestampNames[j], result.gpuTimes[j]);
+            if (m_Wavefront)
+            {
+                for (uint32_t j = 0; j < (uint32_t)WavefrontStage::MAX_NUM; j++)
+                    fprintf(fp, ", \"%s\": %.4f", wavefrontStageNames[j], result.wavefrontGpuTimes[j]);
+                if (result.traversalFrameNums[0])
+                    fprintf(fp, ", \"traversal\": %.4f", result.traversalTimes[0]);
+                if (result.traversalFrameNums[1])
+                    fprintf(fp, ", \"traversalBinned\": %.4f", result.traversalTimes[1]);
+            }
+            fprintf(fp, "}%s\n", i + 1 == benchmark.results.size() ? "" : ",");
+        }
+
+        fprintf(fp, "    ]\n");
+        fprintf(fp, "}\n");
+        fclose(fp);
+
+        printf("Benchmark: report saved to '%s'\n", benchmark.reportPath.c_str());
+    }
+    else
+        printf("Benchmark: can't write '%s'!\n", benchmark.reportPath.c_str());
+
+    // Compare with baseline
+    uint32_t regressionNum = 0;
+    if (!benchmark.baselinePath.empty())
+    {
+        std::map<std::string, double> baseline = LoadBenchmarkReport(benchmark.baselinePath);
+        if (baseline.empty())
+            printf("Benchmark: can't read baseline '%s'!\n", benchmark.baselinePath.c_str());
+
+        // Average deltas across tests, useful to compare configurations (i.e. "--gbufferProfile")
+        std::map<std::string, std::pair<double, double>> averages;
+
+        auto compare = [&](uint32_t test, const char* name, double value)
+        {
+            auto it = baseline.find(std::to_string(test) + "/" + name);
+            if (it == baseline.end())
+                return;
+
+            std::pair<double, double>& average = averages[name];
+            average.first += it->second;
+            average.second += value;
+
+            double delta = value - it->second;
+            if (delta > benchmark.regressionMinDelta && delta > it->second * benchmark.regressionThreshold * 0.01)
+            {
+                printf("Benchmark: REGRESSION in test %u, %s: %.3f ms -> %.3f ms (+%.1f%%)\n", test, name, it->second, value, 100.0 * delta / it->second);
+                regressionNum++;
+            }
+        };
+
+        for (const BenchmarkResult& result : benchmark.results)
+        {
+            compare(result.test, "cpuFrameTime", result.cpuFrameTime);
+            compare(result.test, "gpuFrameTime", result.gpuFrameTime);
+            for (uint32_t j = 1; j < (uint32_t)Timestamp::MAX_NUM; j++)
+                compare(result.test, timestampNames[j], result.gpuTimes[j]);
+            for (uint32_t j = 0; j < (uint32_t)WavefrontStage::MAX_NUM; j++)
+                compare(result.test, wavefrontStageNames[j], result.wavefrontGpuTimes[j]);
+            if (result.traversalFrameNums[0])
+                compare(result.test, "traversal", result.traversalTimes[0]);
+            if (result.traversalFrameNums[1])
+                compare(result.test, "traversalBinned", result.traversalTimes[1]);
+        }
+
+        // Timestamps, frame time and wavefront stages (if both reports have them)
+        const uint32_t timestampNum = (uint32_t)Timestamp::MAX_NUM;
+        for (uint32_t j = 0; j <= timestampNum + (uint32_t)WavefrontStage::MAX_NUM; j++)
+        {
+            const char* name = j < timestampNum ? timestampNames[j] : (j == timestampNum ? "gpuFrameTime" : wavefrontStageNames[j - timestampNum - 1]);
+            auto it = averages.find(name);
+            if (it == averages.end() || it->second.first == 0.0)
+                continue;
+
+            const double norm = 1.0 / double(benchmark.results.size());
+            const double before = it->second.first * norm;
+            const double after = it->second.second * norm;
+            printf("Benchmark: %-24s %.3f ms -> %.3f ms (%+.1f%%)\n", name, before, after, 100.0 * (after - before) / before);
+        }
+
+        printf("Benchmark: %u regression(s) vs '%s' (threshold %.1f%%, %.3f ms)\n", regressionNum, benchmark.baselinePath.c_str(), benchmark.regressionThreshold, benchmark.regressionMinDelta);
+    }
+
+    // Benchmark is a batch job, the render loop ends after this frame and the exit code reports regressions
+    m_ExitCode = regressionNum ? 1 : 0;
+    m_FrameNum = 0;
+}
+
+void Sample::StartRecording(const std::string& path, bool isReplay)
+{
+    StopRecording();
+
+    Recording& recording = m_Recording;
+    recording.path = path;
+    recording.isReplay = isReplay;
+    recording.gpuFrameTime = 0.0;
+    recording.cpuFrameTime = 0.0;
+    recording.frameNum = 0;
+    recording.flags = 0;
+
+    const char* mode = isReplay ? "Replay" : "Record";
+
+    recording.file = fopen(path.c_str(), isReplay ? "rb" : "wb");
+    if (!recording.file)
+    {
+        printf("%s: can't open '%s'!\n", mode, path.c_str());
+        recording.isReplay = false;
+
+        return;
+    }
+
+    // Header: magic, version, output resolution, scene name and sizes of recorded blocks
+    const std::string sceneName = std::string( utils::GetFileName(m_SceneFile) );
+    const auto blocks = GetRecordedBlocks();
+
+    std::vector<uint32_t> header = {RECORDING_MAGIC, RECORDING_VERSION, m_OutputResolution.x, m_OutputResolution.y, (uint32_t)sceneName.size(), (uint32_t)blocks.size()};
+    for (const auto& block : blocks)
+        header.push_back(block.second);
+
+    uint32_t stateSize = 0;
+    for (const auto& block : blocks)
+        stateSize += block.second;
+
+    bool isValid = stateSize <= UINT16_MAX; // spans use 16-bit offsets
+    if (isReplay)
+    {
+        std::vector<uint32_t> fileHeader(header.size());
+        isValid = isValid && fread(fileHeader.data(), sizeof(uint32_t), fileHeader.size(), recording.file) == fileHeader.size();
+        isValid = isValid && fileHeader[0] == RECORDING_MAGIC && fileHeader[1] == RECORDING_VERSION;
+        isValid = isValid && memcmp(fileHeader.data() + 5, header.data() + 5, (header.size() - 5) * sizeof(uint32_t)) == 0;
+
+        std::string fileSceneName(isValid ? fileHeader[4] : 0, ' ');
+        isValid = isValid && fread(&fileSceneName[0], 1, fileSceneName.size(), recording.file) == fileSceneName.size();
+
+        if (isValid && fileSceneName != sceneName)
+            printf("Replay: '%s' was recorded for a different scene!\n", path.c_str());
+        if (isValid && (fileHeader[2] != header[2] || fileHeader[3] != header[3]))
+            printf("Replay: '%s' was recorded at %ux%u, camera aspect ratio doesn't match!\n", path.c_str(), fileHeader[2], fileHeader[3]);
+    }
+    else if (isValid)
+    {
+        fwrite(header.data(), sizeof(uint32_t), header.size(), recording.file);
+        fwrite(sceneName.data(), 1, sceneName.size(), recording.file);
+    }
+
+    if (!isValid)
+    {
+        printf("%s: '%s' has incompatible format (Settings, Camera or denoiser settings layout has changed)!\n", mode, path.c_str());
+        fclose(recording.file);
+        recording.file = nullptr;
+        recording.isReplay = false;
+
+        return;
+    }
+
+    // Deltas of the first frame are taken against zeros
+    recording.state.assign(stateSize, 0);
+
+    printf("%s: '%s'\n", mode, path.c_str());
+}
+
+void Sample::StopRecording()
+{
+    Recording& recording = m_Recording;
+    if (!recording.file)
+        return;
+
+    fclose(recording.file);
+    recording.file = nullptr;
+    recording.state.clear();
+
+    if (recording.isReplay)
+    {
+        const double norm = 1.0 / double(std::max(recording.frameNum, 2u) - 1);
+        printf("Replay: finished, %u frames - GPU %.3f ms, CPU %.3f ms\n", recording.frameNum, recording.gpuFrameTime * norm, recording.cpuFrameTime * norm);
+
+        recording.isReplay = false;
+    }
+    else
+        printf("Record: %u frames saved to '%s'\n", recording.frameNum, recording.path.c_str());
+}
+
+void Sample::RecordFrame()
+{
+    Recording& recording = m_Recording;
+
+    std::vector<uint8_t> state(recording.state.size());
+    uint8_t* dst = state.data();
+    for (const auto& block : GetRecordedBlocks())
+    {
+        memcpy(dst, block.first, block.second);
+        dst += block.second;
+    }
+
+    // Changed bytes are stored as "offset, size, data" spans, spans separated by a few unchanged bytes get merged
+    constexpr size_t SPAN_MERGE_DISTANCE = 4;
+
+    std::vector<uint16_t> spans;
+    for (size_t i = 0; i < state.size(); )
+    {
+        if (state[i] == recording.state[i])
+        {
+            i++;
+            continue;
+        }
+
+        size_t begin = i;
+        size_t end = i + 1;
+        for (i = end; i < state.size() && i < end + SPAN_MERGE_DISTANCE; i++)
+        {
+            if (state[i] != recording.state[i])
+                end = i + 1;
+        }
+
+        spans.push_back((uint16_t)begin);
+        spans.push_back((uint16_t)(end - begin));
+        i = end;
+    }
+
+    // Frame: flags, clock, spans
+    uint8_t flags = 0;
+    if (m_ForceHistoryReset || recording.frameNum == 0)
+        flags |= RECORDING_FLAG_HISTORY_RESET;
+
+    const FrameClock clock = {GetTimeStamp(), GetFrameTime(), GetSmoothedFrameTime(), GetVerySmoothedFrameTime()};
+    const uint16_t spanNum = uint16_t(spans.size() / 2);
+
+    FILE* fp = recording.file;
+    fwrite(&flags, sizeof(flags), 1, fp);
+    fwrite(&clock, sizeof(clock), 1, fp);
+    fwrite(&spanNum, sizeof(spanNum), 1, fp);
+
+    for (size_t i = 0; i < spans.size(); i += 2)
+    {
+        fwrite(&spans[i], sizeof(uint16_t), 2, fp);
+        fwrite(&state[spans[i]], 1, spans[i + 1], fp);
+    }
+
+    recording.state.swap(state);
+    recording.frameNum++;
+}
+
+bool Sample::ReplayFrame()
+{
+    Recording& recording = m_Recording;
+
+    // The first frame is skipped, since it has no timings yet
+    if (recording.frameNum)
+    {
+        recording.gpuFrameTime += m_GpuFrameTime;
+        recording.cpuFrameTime += m_Timer.GetFrameTime();
+    }
+
+    FILE* fp = recording.file;
+    FrameClock clock = {};
+    uint16_t spanNum = 0;
+    uint8_t flags = 0;
+
+    bool isOk = fread(&flags, sizeof(flags), 1, fp) == 1;
+    isOk = isOk && fread(&clock, sizeof(clock), 1, fp) == 1;
+    isOk = isOk && fread(&spanNum, sizeof(spanNum), 1, fp) == 1;
+
+    for (uint16_t i = 0; i < spanNum && isOk; i++)
+    {
+        uint16_t span[2] = {};
+        isOk = fread(span, sizeof(span), 1, fp) == 1 && size_t(span[0]) + span[1] <= recording.state.size();
+        isOk = isOk && fread(&recording.state[span[0]], 1, span[1], fp) == span[1];
+    }
+
+    // End of the stream (a truncated frame is dropped)
+    if (!isOk)
+    {
+        StopRecording();
+
+        return false;
+    }
+
+    m_Clock = clock;
+    recording.flags = flags;
+    recording.frameNum++;
+
+    return true;
+}
+
+void Sample::ApplyReplayedFrame()
+{
+    // Camera state is restored as is, i.e. "Camera::Update" is not needed
+    const uint8_t* src = m_Recording.state.data();
+    for (const auto& block : GetRecordedBlocks())
+    {
+        memcpy(block.first, src, block.second);
+        src += block.second;
+    }
+
+    if (m_Recording.flags & RECORDING_FLAG_HISTORY_RESET)
+        m_ForceHistoryReset = true;
+}
+
+void Sample::LoadScene()
+{
+    // Proxy geometry, which will be instancinated
+    std::string sceneFile = utils::GetFullPath("Cubes/Cubes.gltf", utils::DataFolder::SCENES);
+    NRI_ABORT_ON_FALSE( utils::LoadScene(sceneFile, m_Scene, !ALLOW_BLAS_MERGING) );
 
     m_ProxyInstancesNum = helper::GetCountOf(m_Scene.instances);
 
@@ -2528,712 +4281,1585 @@ nri::Format Sample::CreateSwapChain()
     return swapChainFormat;
 }
 
-void Sample::CreateCommandBuffers()
+void Sample::CreateReadbackBuffer(nri::Format finalFormat)
 {
-    for (Frame& frame : m_Frames)
-    {
-        NRI_ABORT_ON_FAILURE(NRI.CreateCommandAllocator(*m_GraphicsQueue, frame.commandAllocator));
-        NRI_ABORT_ON_FAILURE(NRI.CreateCommandBuffer(*frame.commandAllocator, frame.commandBuffer));
-    }
-}
+    if (m_NullDevice || m_CaptureFrames.empty())
+        return;
 
-void Sample::CreatePipelineLayoutAndDescriptorPool()
-{
-    // SET_GLOBAL
-    const nri::DescriptorRangeDesc descriptorRanges0[] =
-    {
-        { 0, 3, nri::DescriptorType::SAMPLER, nri::StageBits::COMPUTE_SHADER },
-    };
+    const nri::DeviceDesc& deviceDesc = NRI.GetDeviceDesc(*m_Device);
+    const nri::FormatProps& formatProps = nri::nriGetFormatProps(finalFormat);
 
-    // SET_OTHER
-    const nri::DescriptorRangeDesc descriptorRanges1[] =
-    {
-        { 0, 12, nri::DescriptorType::TEXTURE, nri::StageBits::COMPUTE_SHADER, nri::DescriptorRangeBits::PARTIALLY_BOUND },
-        { 0, 13, nri::DescriptorType::STORAGE_TEXTURE, nri::StageBits::COMPUTE_SHADER, nri::DescriptorRangeBits::PARTIALLY_BOUND },
-    };
+    m_ReadbackRowPitch = helper::Align(GetWindowResolution().x * formatProps.stride, deviceDesc.uploadBufferTextureRowAlignment);
 
-    // SET_RAY_TRACING
-    const uint32_t textureNum = helper::GetCountOf(m_Scene.materials) * TEXTURES_PER_MATERIAL;
-    nri::DescriptorRangeDesc descriptorRanges2[] =
-    {
-        { 0, 2, nri::DescriptorType::ACCELERATION_STRUCTURE, nri::StageBits::COMPUTE_SHADER },
-        { 2, 3, nri::DescriptorType::STRUCTURED_BUFFER, nri::StageBits::COMPUTE_SHADER },
-        { 5, textureNum, nri::DescriptorType::TEXTURE, nri::StageBits::COMPUTE_SHADER, nri::DescriptorRangeBits::PARTIALLY_BOUND | nri::DescriptorRangeBits::VARIABLE_SIZED_ARRAY },
-    };
+    nri::AllocateBufferDesc allocateBufferDesc = {};
+    allocateBufferDesc.desc.size = uint64_t(m_ReadbackRowPitch) * GetWindowResolution().y;
+    allocateBufferDesc.memoryLocation = nri::MemoryLocation::HOST_READBACK;
 
-    // SET_MORPH
-    const nri::DescriptorRangeDesc descriptorRanges3[] =
+    NRI_ABORT_ON_FAILURE(NRI.AllocateBuffer(*m_Device, allocateBufferDesc, m_ReadbackBuffer));
+    NRI.SetDebugName(m_ReadbackBuffer, "Buffer::Readback");
+}
+
+inline uint32_t UpdateCrc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
     {
-        { 0, 3, nri::DescriptorType::STRUCTURED_BUFFER, nri::StageBits::COMPUTE_SHADER, nri::DescriptorRangeBits::PARTIALLY_BOUND },
-        { 0, 2, nri::DescriptorType::STORAGE_STRUCTURED_BUFFER, nri::StageBits::COMPUTE_SHADER, nri::DescriptorRangeBits::PARTIALLY_BOUND },
-    };
+        crc ^= data[i];
+        for (uint32_t k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
 
-    // SET_SHARC
-    const nri::DescriptorRangeDesc descriptorRanges4[] =
+    return ~crc;
+}
+
+inline void WriteBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.push_back(uint8_t(value >> 24));
+    out.push_back(uint8_t(value >> 16));
+    out.push_back(uint8_t(value >> 8));
+    out.push_back(uint8_t(value));
+}
+
+template<typename T>
+inline void WriteLittleEndian(std::vector<uint8_t>& out, T value)
+{
+    const uint8_t* bytes = (const uint8_t*)&value;
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+inline void WritePngChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+{
+    WriteBigEndian(out, (uint32_t)data.size());
+
+    size_t typeOffset = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+
+    WriteBigEndian(out, UpdateCrc32(0, &out[typeOffset], out.size() - typeOffset));
+}
+
+// RGB8, "zlib" stream with "stored" (uncompressed) blocks - no external dependencies needed
+bool SavePng(const std::string& path, const uint8_t* rgba, uint32_t w, uint32_t h, uint32_t rowPitch)
+{
+    std::vector<uint8_t> raw;
+    raw.reserve(size_t(w * 3 + 1) * h);
+    for (uint32_t y = 0; y < h; y++)
     {
-        { 0, 4, nri::DescriptorType::STORAGE_STRUCTURED_BUFFER, nri::StageBits::COMPUTE_SHADER },
-    };
+        raw.push_back(0); // filter: none
 
-    nri::DynamicConstantBufferDesc dynamicConstantBuffer = { 0, nri::StageBits::COMPUTE_SHADER };
+        const uint8_t* row = rgba + size_t(y) * rowPitch;
+        for (uint32_t x = 0; x < w; x++)
+            raw.insert(raw.end(), row + x * 4, row + x * 4 + 3);
+    }
 
-    const nri::DescriptorSetDesc descriptorSetDescs[] =
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    for (size_t offset = 0; offset < raw.size(); )
     {
-        { SET_GLOBAL, descriptorRanges0, helper::GetCountOf(descriptorRanges0), &dynamicConstantBuffer, 1 },
-        { SET_OTHER, descriptorRanges1, helper::GetCountOf(descriptorRanges1), nullptr, 0 },
-        { SET_RAY_TRACING, descriptorRanges2, helper::GetCountOf(descriptorRanges2) },
-        { SET_MORPH, descriptorRanges3, helper::GetCountOf(descriptorRanges3), &dynamicConstantBuffer, 1 },
-        { SET_SHARC, descriptorRanges4, helper::GetCountOf(descriptorRanges4) },
-    };
+        uint16_t blockSize = (uint16_t)std::min(raw.size() - offset, size_t(65535));
+        bool isLast = offset + blockSize == raw.size();
 
-    { // Pipeline layout
-        nri::PipelineLayoutDesc pipelineLayoutDesc = {};
-        pipelineLayoutDesc.descriptorSets = descriptorSetDescs;
-        pipelineLayoutDesc.descriptorSetNum = helper::GetCountOf(descriptorSetDescs);
-        pipelineLayoutDesc.shaderStages = nri::StageBits::COMPUTE_SHADER;
+        zlib.push_back(isLast ? 1 : 0);
+        WriteLittleEndian(zlib, blockSize);
+        WriteLittleEndian(zlib, uint16_t(~blockSize));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
 
-        NRI_ABORT_ON_FAILURE(NRI.CreatePipelineLayout(*m_Device, pipelineLayoutDesc, m_PipelineLayout));
+        offset += blockSize;
+        if (isLast)
+            break;
     }
 
-    { // Descriptor pool
-        nri::DescriptorPoolDesc descriptorPoolDesc = {};
-
-        uint32_t setNum = 1;
-        descriptorPoolDesc.descriptorSetMaxNum += setNum;
-        descriptorPoolDesc.dynamicConstantBufferMaxNum += descriptorSetDescs[SET_GLOBAL].dynamicConstantBufferNum * setNum;
-        descriptorPoolDesc.samplerMaxNum += descriptorSetDescs[SET_GLOBAL].ranges[0].descriptorNum * BUFFERED_FRAME_MAX_NUM * setNum;
+    uint32_t a = 1, b = 0;
+    for (uint8_t v : raw)
+    {
+        a = (a + v) % 65521;
+        b = (b + a) % 65521;
+    }
+    WriteBigEndian(zlib, (b << 16) | a);
 
-        setNum = (uint32_t)DescriptorSet::MAX_NUM - 6; // exclude non-SET_OTHER sets
-        descriptorPoolDesc.descriptorSetMaxNum += setNum;
-        descriptorPoolDesc.textureMaxNum += descriptorSetDescs[SET_OTHER].ranges[0].descriptorNum * setNum;
-        descriptorPoolDesc.storageTextureMaxNum += descriptorSetDescs[SET_OTHER].ranges[1].descriptorNum * setNum;
+    std::vector<uint8_t> header;
+    WriteBigEndian(header, w);
+    WriteBigEndian(header, h);
+    header.insert(header.end(), {8, 2, 0, 0, 0}); // 8 bits, RGB, deflate, adaptive filtering, no interlace
 
-        setNum = 1;
-        descriptorPoolDesc.descriptorSetMaxNum += setNum;
-        descriptorPoolDesc.accelerationStructureMaxNum += descriptorSetDescs[SET_RAY_TRACING].ranges[0].descriptorNum * setNum;
-        descriptorPoolDesc.structuredBufferMaxNum += descriptorSetDescs[SET_RAY_TRACING].ranges[1].descriptorNum * setNum;
-        descriptorPoolDesc.textureMaxNum += descriptorSetDescs[SET_RAY_TRACING].ranges[2].descriptorNum * setNum;
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    WritePngChunk(png, "IHDR", header);
+    WritePngChunk(png, "IDAT", zlib);
+    WritePngChunk(png, "IEND", {});
 
-        setNum = 2;
-        descriptorPoolDesc.descriptorSetMaxNum += setNum;
-        descriptorPoolDesc.dynamicConstantBufferMaxNum += descriptorSetDescs[SET_MORPH].dynamicConstantBufferNum * setNum;
-        descriptorPoolDesc.structuredBufferMaxNum += descriptorSetDescs[SET_MORPH].ranges[0].descriptorNum * setNum;
-        descriptorPoolDesc.storageStructuredBufferMaxNum += descriptorSetDescs[SET_MORPH].ranges[1].descriptorNum * setNum;
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
 
-        setNum = 2;
-        descriptorPoolDesc.descriptorSetMaxNum += setNum;
-        descriptorPoolDesc.storageStructuredBufferMaxNum += descriptorSetDescs[SET_SHARC].ranges[0].descriptorNum * setNum;
+    size_t elemNum = fwrite(png.data(), png.size(), 1, fp);
+    fclose(fp);
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateDescriptorPool(*m_Device, descriptorPoolDesc, m_DescriptorPool));
-    }
+    return elemNum == 1;
 }
 
-void Sample::CreatePipelines()
+// RGB16F, scanline, no compression
+bool SaveExr(const std::string& path, const uint16_t* rgba, uint32_t w, uint32_t h, uint32_t rowPitch)
 {
-    if (!m_Pipelines.empty())
+    auto writeAttribute = [](std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value)
     {
-        NRI.WaitForIdle(*m_GraphicsQueue);
+        out.insert(out.end(), name, name + strlen(name) + 1);
+        out.insert(out.end(), type, type + strlen(type) + 1);
+        WriteLittleEndian(out, (int32_t)value.size());
+        out.insert(out.end(), value.begin(), value.end());
+    };
 
-        for (uint32_t i = 0; i < m_Pipelines.size(); i++)
-            NRI.DestroyPipeline(*m_Pipelines[i]);
-        m_Pipelines.clear();
+    std::vector<uint8_t> exr;
+    WriteLittleEndian(exr, 20000630); // magic
+    WriteLittleEndian(exr, 2); // version, single part scanline
 
-        m_NRD.CreatePipelines();
+    std::vector<uint8_t> value;
+    for (const char* channel : {"B", "G", "R"}) // alphabetical order
+    {
+        value.push_back(channel[0]);
+        value.push_back(0);
+        WriteLittleEndian(value, 1); // HALF
+        WriteLittleEndian(value, 0); // pLinear + reserved
+        WriteLittleEndian(value, 1); // xSampling
+        WriteLittleEndian(value, 1); // ySampling
     }
+    value.push_back(0);
+    writeAttribute(exr, "channels", "chlist", value);
 
-    utils::ShaderCodeStorage shaderCodeStorage;
+    writeAttribute(exr, "compression", "compression", {0});
 
-    nri::ComputePipelineDesc pipelineDesc = {};
-    pipelineDesc.pipelineLayout = m_PipelineLayout;
+    value.clear();
+    WriteLittleEndian(value, 0);
+    WriteLittleEndian(value, 0);
+    WriteLittleEndian(value, int32_t(w - 1));
+    WriteLittleEndian(value, int32_t(h - 1));
+    writeAttribute(exr, "dataWindow", "box2i", value);
+    writeAttribute(exr, "displayWindow", "box2i", value);
 
-    nri::Pipeline* pipeline = nullptr;
-    const nri::DeviceDesc& deviceDesc = NRI.GetDeviceDesc(*m_Device);
+    writeAttribute(exr, "lineOrder", "lineOrder", {0});
 
-    { // Pipeline::MorphMeshUpdateVertices
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "MorphMeshUpdateVertices.cs", shaderCodeStorage);
+    value.clear();
+    WriteLittleEndian(value, 1.0f);
+    writeAttribute(exr, "pixelAspectRatio", "float", value);
+    writeAttribute(exr, "screenWindowWidth", "float", value);
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
-    }
+    value.clear();
+    WriteLittleEndian(value, 0.0f);
+    WriteLittleEndian(value, 0.0f);
+    writeAttribute(exr, "screenWindowCenter", "v2f", value);
 
-    { // Pipeline::MorphMeshUpdatePrimitives
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "MorphMeshUpdatePrimitives.cs", shaderCodeStorage);
+    exr.push_back(0); // end of header
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
-    }
+    const uint32_t lineSize = w * 3 * sizeof(uint16_t);
+    const uint64_t firstLineOffset = exr.size() + h * sizeof(uint64_t);
+    for (uint32_t y = 0; y < h; y++)
+        WriteLittleEndian(exr, firstLineOffset + uint64_t(y) * (lineSize + 8));
 
-    { // Pipeline::SharcClear
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "SharcClear.cs", shaderCodeStorage);
+    for (uint32_t y = 0; y < h; y++)
+    {
+        WriteLittleEndian(exr, (int32_t)y);
+        WriteLittleEndian(exr, lineSize);
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
+        const uint16_t* row = (const uint16_t*)((const uint8_t*)rgba + size_t(y) * rowPitch);
+        for (uint32_t channel = 3; channel-- > 0; )
+        {
+            for (uint32_t x = 0; x < w; x++)
+                WriteLittleEndian(exr, row[x * 4 + channel]);
+        }
     }
 
-    { // Pipeline::SharcUpdate
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "SharcUpdate.cs", shaderCodeStorage);
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
-    }
+    size_t elemNum = fwrite(exr.data(), exr.size(), 1, fp);
+    fclose(fp);
 
-    { // Pipeline::SharcResolve
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "SharcResolve.cs", shaderCodeStorage);
+    return elemNum == 1;
+}
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
-    }
+// Block compression: BC1 (RGB), BC3 (RGBA = BC4 alpha + BC1), BC4 (R) and BC5 (RG = BC4 x 2)
+inline uint16_t PackRgb565(const int32_t* rgb)
+{
+    return uint16_t(((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+}
 
-    { // Pipeline::SharcHashCopy
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "SharcHashCopy.cs", shaderCodeStorage);
+inline void UnpackRgb565(uint16_t color, int32_t* rgb)
+{
+    int32_t r = (color >> 11) & 31;
+    int32_t g = (color >> 5) & 63;
+    int32_t b = color & 31;
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Bounding box endpoints, the diagonal is selected by covariance signs, the box is inset by 1/16 (J.M.P. van Waveren, "Real-Time DXT Compression")
+void EncodeBc1(const uint8_t texels[16][4], uint8_t* block)
+{
+    int32_t minColor[3] = {255, 255, 255};
+    int32_t maxColor[3] = {0, 0, 0};
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            minColor[c] = std::min(minColor[c], (int32_t)texels[i][c]);
+            maxColor[c] = std::max(maxColor[c], (int32_t)texels[i][c]);
+        }
     }
 
-    { // Pipeline::TraceOpaque
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "TraceOpaque.cs", shaderCodeStorage);
+    int32_t center[3];
+    for (uint32_t c = 0; c < 3; c++)
+        center[c] = (minColor[c] + maxColor[c]) / 2;
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
+    int32_t covRG = 0;
+    int32_t covBG = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        int32_t dg = texels[i][1] - center[1];
+        covRG += (texels[i][0] - center[0]) * dg;
+        covBG += (texels[i][2] - center[2]) * dg;
     }
 
-    { // Pipeline::Composition
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "Composition.cs", shaderCodeStorage);
+    if (covRG < 0)
+        std::swap(minColor[0], maxColor[0]);
+    if (covBG < 0)
+        std::swap(minColor[2], maxColor[2]);
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        int32_t inset = (maxColor[c] - minColor[c]) / 16;
+        minColor[c] += inset;
+        maxColor[c] -= inset;
     }
 
-    { // Pipeline::TraceTransparent
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "TraceTransparent.cs", shaderCodeStorage);
+    // "color0 > color1" selects 4-color mode (no punch-through alpha)
+    uint16_t color0 = PackRgb565(maxColor);
+    uint16_t color1 = PackRgb565(minColor);
+    if (color0 < color1)
+        std::swap(color0, color1);
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
+    int32_t palette[4][3];
+    UnpackRgb565(color0, palette[0]);
+    UnpackRgb565(color1, palette[1]);
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
     }
 
-    { // Pipeline::Taa
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "TAA.cs", shaderCodeStorage);
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            uint32_t bestIndex = 0;
+            int32_t bestDistance = INT32_MAX;
+            for (uint32_t j = 0; j < 4; j++)
+            {
+                int32_t distance = 0;
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    int32_t d = texels[i][c] - palette[j][c];
+                    distance += d * d;
+                }
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    bestIndex = j;
+                }
+            }
+
+            indices |= bestIndex << (2 * i);
+        }
     }
 
-    { // Pipeline::Nis
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "NIS.cs", shaderCodeStorage);
+    block[0] = uint8_t(color0);
+    block[1] = uint8_t(color0 >> 8);
+    block[2] = uint8_t(color1);
+    block[3] = uint8_t(color1 >> 8);
+    for (uint32_t i = 0; i < 4; i++)
+        block[4 + i] = uint8_t(indices >> (8 * i));
+}
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
+// Min / max endpoints, "max > min" selects 8-value mode
+void EncodeBc4(const uint8_t* values, uint32_t stride, uint8_t* block)
+{
+    int32_t minValue = 255;
+    int32_t maxValue = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        minValue = std::min(minValue, (int32_t)values[i * stride]);
+        maxValue = std::max(maxValue, (int32_t)values[i * stride]);
     }
 
-    { // Pipeline::Final
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "Final.cs", shaderCodeStorage);
+    uint64_t indices = 0;
+    int32_t range = maxValue - minValue;
+    if (range)
+    {
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            // Palette: 0 - max, 1 - min, 2-7 - from max to min
+            int32_t k = ((values[i * stride] - minValue) * 7 + range / 2) / range;
+            uint64_t index = k == 7 ? 0 : (k == 0 ? 1 : 8 - k);
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
+            indices |= index << (3 * i);
+        }
     }
 
-    { // Pipeline::DlssBefore
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "DlssBefore.cs", shaderCodeStorage);
+    block[0] = uint8_t(maxValue);
+    block[1] = uint8_t(minValue);
+    for (uint32_t i = 0; i < 6; i++)
+        block[2 + i] = uint8_t(indices >> (8 * i));
+}
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
+// Subresources are tightly packed in "layer * mipNum + mip" order
+void LayoutCompressedTexture(const utils::Texture& texture, CompressedTexture& compressedTexture)
+{
+    const bool isBc1 = compressedTexture.format == nri::Format::BC1_RGBA_UNORM || compressedTexture.format == nri::Format::BC1_RGBA_SRGB;
+    const uint32_t blockSize = isBc1 ? 8 : 16;
+
+    compressedTexture.subresources.clear();
+    size_t size = 0;
+    for (uint32_t layer = 0; layer < texture.GetArraySize(); layer++)
+    {
+        for (uint32_t mip = 0; mip < texture.GetMipNum(); mip++)
+        {
+            uint32_t blocksW = (std::max(uint32_t(texture.GetWidth()) >> mip, 1u) + 3) / 4;
+            uint32_t blocksH = (std::max(uint32_t(texture.GetHeight()) >> mip, 1u) + 3) / 4;
+
+            nri::TextureSubresourceUploadDesc& subresource = compressedTexture.subresources.emplace_back();
+            subresource = {};
+            subresource.sliceNum = 1;
+            subresource.rowPitch = blocksW * blockSize;
+            subresource.slicePitch = subresource.rowPitch * blocksH;
+
+            size += subresource.slicePitch;
+        }
     }
 
-    { // Pipeline::DlssAfter
-        pipelineDesc.shader = utils::LoadShader(deviceDesc.graphicsAPI, "DlssAfter.cs", shaderCodeStorage);
+    compressedTexture.data.resize(size);
 
-        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
-        m_Pipelines.push_back(pipeline);
+    size_t offset = 0;
+    for (nri::TextureSubresourceUploadDesc& subresource : compressedTexture.subresources)
+    {
+        subresource.slices = compressedTexture.data.data() + offset;
+        offset += subresource.slicePitch;
     }
 }
 
-void Sample::CreateAccelerationStructures()
+// FNV-1a (8 bytes at a time) of the source texels and everything affecting encoding
+uint64_t HashTexture(const utils::Texture& texture, TextureRole role)
 {
-    double stamp1 = m_Timer.GetTimeStamp();
-
-    struct Parameters
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto add = [&hash](uint64_t value) { hash = (hash ^ value) * 0x100000001B3ull; };
+
+    add(TEXTURE_CACHE_VERSION);
+    add((uint64_t)role);
+    add((uint64_t)texture.GetFormat());
+    add(texture.GetWidth());
+    add(texture.GetHeight());
+    add(texture.GetMipNum());
+    add(texture.GetArraySize());
+
+    for (uint32_t layer = 0; layer < texture.GetArraySize(); layer++)
     {
-        nri::AccelerationStructure* accelerationStructure;
-        uint64_t scratchOffset;
-        uint32_t geometryObjectBase;
-        uint32_t geometryObjectsNum;
-        nri::AccelerationStructureBuildBits buildBits;
-    };
-
-    uint64_t primitivesNum = 0;
-    std::vector<Parameters> parameters;
-    std::vector<nri::GeometryObject> geometryObjects;
+        for (uint32_t mip = 0; mip < texture.GetMipNum(); mip++)
+        {
+            nri::TextureSubresourceUploadDesc subresource;
+            texture.GetSubresource(subresource, mip, layer);
 
-    geometryObjects.reserve(m_Scene.instances.size()); // reallocation is NOT allowed!
+            const uint32_t rowSize = std::max(uint32_t(texture.GetWidth()) >> mip, 1u) * 4;
+            const uint32_t rowNum = std::max(uint32_t(texture.GetHeight()) >> mip, 1u);
+            for (uint32_t y = 0; y < rowNum; y++)
+            {
+                const uint8_t* row = (const uint8_t*)subresource.slices + size_t(y) * subresource.rowPitch;
 
-    // Calculate temp memory size
-    std::vector<uint32_t> dynamicMeshInstances;
-    uint64_t uploadSize = 0;
-    uint64_t geometryOffset = 0;
+                uint32_t x = 0;
+                for (; x + 8 <= rowSize; x += 8)
+                {
+                    uint64_t value;
+                    memcpy(&value, row + x, sizeof(value));
+                    add(value);
+                }
 
-    for (size_t i = m_ProxyInstancesNum; i < m_Scene.instances.size(); i++)
-    {
-        const utils::Instance& instance = m_Scene.instances[i];
-        const utils::Material& material = m_Scene.materials[instance.materialIndex];
+                for (; x < rowSize; x++)
+                    add(row[x]);
+            }
+        }
+    }
 
-        if (material.IsOff())
-            continue;
+    return hash;
+}
 
-        if (instance.allowUpdate)
+// Returns "false" if the texture is not suitable for compression (already compressed, shared across roles, not a multiple of the block size...)
+bool CompressTexture(const utils::Texture& texture, TextureRole role, const std::string& cacheFolder, CompressedTexture& compressedTexture)
+{
+    const nri::Format format = texture.GetFormat();
+    const bool isSrgb = format == nri::Format::RGBA8_SRGB;
+    if (role == TextureRole::UNUSED || role == TextureRole::MIXED || (format != nri::Format::RGBA8_UNORM && !isSrgb))
+        return false;
+
+    // BC requires the top mip to be a multiple of the block size
+    const uint32_t w = texture.GetWidth();
+    const uint32_t h = texture.GetHeight();
+    if ((w | h) & 3)
+        return false;
+
+    // Normals, roughness and metalness are linear, only two channels are used
+    if ((role == TextureRole::NORMAL || role == TextureRole::ROUGHNESS_METALNESS) && isSrgb)
+        return false;
+
+    // Only alpha-tested and transparent base color needs alpha
+    bool hasAlpha = false;
+    if (role == TextureRole::BASE_COLOR)
+    {
+        for (uint32_t layer = 0; layer < texture.GetArraySize() && !hasAlpha; layer++)
         {
-            if (std::find(dynamicMeshInstances.begin(), dynamicMeshInstances.end(), instance.meshInstanceIndex) != dynamicMeshInstances.end())
-                continue;
-            else
-                dynamicMeshInstances.push_back(instance.meshInstanceIndex);
+            nri::TextureSubresourceUploadDesc subresource;
+            texture.GetSubresource(subresource, 0, layer);
+
+            for (uint32_t y = 0; y < h && !hasAlpha; y++)
+            {
+                const uint8_t* row = (const uint8_t*)subresource.slices + size_t(y) * subresource.rowPitch;
+                for (uint32_t x = 0; x < w && !hasAlpha; x++)
+                    hasAlpha = row[x * 4 + 3] != 255;
+            }
         }
+    }
 
-        const utils::MeshInstance& meshInstance = m_Scene.meshInstances[instance.meshInstanceIndex];
-        const utils::Mesh& mesh = m_Scene.meshes[meshInstance.meshIndex];
+    // Roughness and metalness ("yz") are independent, BC1 endpoints would couple them
+    if (role == TextureRole::NORMAL || role == TextureRole::ROUGHNESS_METALNESS)
+        compressedTexture.format = nri::Format::BC5_RG_UNORM;
+    else if (hasAlpha)
+        compressedTexture.format = isSrgb ? nri::Format::BC3_RGBA_SRGB : nri::Format::BC3_RGBA_UNORM;
+    else
+        compressedTexture.format = isSrgb ? nri::Format::BC1_RGBA_SRGB : nri::Format::BC1_RGBA_UNORM;
 
-        uint64_t vertexDataSize = mesh.vertexNum * sizeof(float[3]);
-        uint64_t indexDataSize = helper::Align(mesh.indexNum * sizeof(utils::Index), 4);
-        uint64_t transformDataSize = instance.allowUpdate ? 0 : sizeof(float[12]);
+    LayoutCompressedTexture(texture, compressedTexture);
 
-        if (material.IsEmissive())
+    // Cache lookup
+    std::string cachePath;
+    if (!cacheFolder.empty())
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bc", (unsigned long long)HashTexture(texture, role));
+        cachePath = cacheFolder + "/" + name;
+
+        FILE* fp = fopen(cachePath.c_str(), "rb");
+        if (fp)
         {
-            // Emissive meshes apper twice: in BLAS_StaticOpaque and in BLAS_StaticEmissive
-            vertexDataSize *= 2;
-            indexDataSize *= 2;
-            transformDataSize *= 2;
+            TextureCacheHeader header = {};
+            bool isValid = fread(&header, sizeof(header), 1, fp) == 1;
+            isValid = isValid && header.magic == TEXTURE_CACHE_MAGIC && header.version == TEXTURE_CACHE_VERSION;
+            isValid = isValid && header.format == (uint32_t)compressedTexture.format && header.dataSize == compressedTexture.data.size();
+            isValid = isValid && fread(compressedTexture.data.data(), compressedTexture.data.size(), 1, fp) == 1;
+            fclose(fp);
+
+            if (isValid)
+            {
+                compressedTexture.isCached = true;
+                return true;
+            }
         }
-
-        uploadSize += vertexDataSize + indexDataSize + transformDataSize;
-        geometryOffset += transformDataSize;
     }
 
-    // Create temp buffer in UPLOAD heap
-    nri::Buffer* uploadBuffer = nullptr;
+    // Encode (edge texels are replicated into partial blocks of small mips)
+    uint8_t* block = compressedTexture.data.data();
+    for (uint32_t layer = 0; layer < texture.GetArraySize(); layer++)
     {
-        nri::AllocateBufferDesc allocateBufferDesc = {};
-        allocateBufferDesc.desc = {uploadSize, 0, nri::BufferUsageBits::ACCELERATION_STRUCTURE_BUILD_INPUT};
-        allocateBufferDesc.memoryLocation = nri::MemoryLocation::HOST_UPLOAD;
+        for (uint32_t mip = 0; mip < texture.GetMipNum(); mip++)
+        {
+            nri::TextureSubresourceUploadDesc subresource;
+            texture.GetSubresource(subresource, mip, layer);
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateBuffer(*m_Device, allocateBufferDesc, uploadBuffer));
-    }
+            const uint8_t* src = (const uint8_t*)subresource.slices;
+            const uint32_t mipW = std::max(w >> mip, 1u);
+            const uint32_t mipH = std::max(h >> mip, 1u);
 
-    { // AccelerationStructure::TLAS_World
-        nri::AllocateAccelerationStructureDesc allocateAccelerationStructureDesc = {};
-        allocateAccelerationStructureDesc.desc.type = nri::AccelerationStructureType::TOP_LEVEL;
-        allocateAccelerationStructureDesc.desc.flags = TLAS_BUILD_BITS;
-        allocateAccelerationStructureDesc.desc.instanceOrGeometryObjectNum = helper::GetCountOf(m_Scene.instances);
-        allocateAccelerationStructureDesc.memoryLocation = nri::MemoryLocation::DEVICE;
+            for (uint32_t by = 0; by < mipH; by += 4)
+            {
+                for (uint32_t bx = 0; bx < mipW; bx += 4)
+                {
+                    uint8_t texels[16][4];
+                    for (uint32_t y = 0; y < 4; y++)
+                    {
+                        for (uint32_t x = 0; x < 4; x++)
+                        {
+                            uint32_t sx = std::min(bx + x, mipW - 1);
+                            uint32_t sy = std::min(by + y, mipH - 1);
+                            memcpy(texels[y * 4 + x], src + size_t(sy) * subresource.rowPitch + sx * 4, 4);
+                        }
+                    }
 
-        nri::AccelerationStructure* accelerationStructure = nullptr;
-        NRI_ABORT_ON_FAILURE(NRI.AllocateAccelerationStructure(*m_Device, allocateAccelerationStructureDesc, accelerationStructure));
-        m_AccelerationStructures.push_back(accelerationStructure);
+                    if (compressedTexture.format == nri::Format::BC5_RG_UNORM)
+                    {
+                        uint32_t channel = role == TextureRole::ROUGHNESS_METALNESS ? 1 : 0;
+                        EncodeBc4(&texels[0][channel], 4, block);
+                        EncodeBc4(&texels[0][channel + 1], 4, block + 8);
+                        block += 16;
+                    }
+                    else if (hasAlpha)
+                    {
+                        EncodeBc4(&texels[0][3], 4, block);
+                        EncodeBc1(texels, block + 8);
+                        block += 16;
+                    }
+                    else
+                    {
+                        EncodeBc1(texels, block);
+                        block += 8;
+                    }
+                }
+            }
+        }
+    }
 
-        // Descriptor::World_AccelerationStructure
-        nri::Descriptor* descriptor = nullptr;
-        NRI.CreateAccelerationStructureDescriptor(*accelerationStructure, descriptor);
-        m_Descriptors.push_back(descriptor);
+    // Write to a temporary file first, an interrupted write must not leave a broken entry
+    if (!cachePath.empty())
+    {
+        std::string tempPath = cachePath + ".tmp";
+        FILE* fp = fopen(tempPath.c_str(), "wb");
+        if (fp)
+        {
+            TextureCacheHeader header = {TEXTURE_CACHE_MAGIC, TEXTURE_CACHE_VERSION, (uint32_t)compressedTexture.format, 0, compressedTexture.data.size()};
+            bool isWritten = fwrite(&header, sizeof(header), 1, fp) == 1;
+            isWritten = isWritten && fwrite(compressedTexture.data.data(), compressedTexture.data.size(), 1, fp) == 1;
+            fclose(fp);
+
+            std::error_code errorCode;
+            if (isWritten)
+                std::filesystem::rename(tempPath, cachePath, errorCode);
+            else
+                std::filesystem::remove(tempPath, errorCode);
+        }
     }
 
-    { // AccelerationStructure::TLAS_Emissive
-        nri::AllocateAccelerationStructureDesc allocateAccelerationStructureDesc = {};
-        allocateAccelerationStructureDesc.desc.type = nri::AccelerationStructureType::TOP_LEVEL;
-        allocateAccelerationStructureDesc.desc.flags = TLAS_BUILD_BITS;
-        allocateAccelerationStructureDesc.desc.instanceOrGeometryObjectNum = helper::GetCountOf(m_Scene.instances);
-        allocateAccelerationStructureDesc.memoryLocation = nri::MemoryLocation::DEVICE;
+    return true;
+}
 
-        nri::AccelerationStructure* accelerationStructure = nullptr;
-        NRI_ABORT_ON_FAILURE(NRI.AllocateAccelerationStructure(*m_Device, allocateAccelerationStructureDesc, accelerationStructure));
-        m_AccelerationStructures.push_back(accelerationStructure);
+void Sample::CompressMaterialTextures()
+{
+    m_CompressedTextures.resize(m_Scene.textures.size());
+    m_IsRoughnessMetalnessXy.assign(m_Scene.materials.size(), false);
+    if (!m_TextureCompression)
+        return;
 
-        // Descriptor::Light_AccelerationStructure
-        nri::Descriptor* descriptor = nullptr;
-        NRI.CreateAccelerationStructureDescriptor(*accelerationStructure, descriptor);
-        m_Descriptors.push_back(descriptor);
+    // Roles
+    std::vector<TextureRole> roles(m_Scene.textures.size(), TextureRole::UNUSED);
+    auto setRole = [&roles](uint32_t textureIndex, TextureRole role)
+    {
+        TextureRole& textureRole = roles[textureIndex];
+        textureRole = (textureRole == TextureRole::UNUSED || textureRole == role) ? role : TextureRole::MIXED;
+    };
+
+    for (const utils::Material& material : m_Scene.materials)
+    {
+        setRole(material.baseColorTexIndex, TextureRole::BASE_COLOR);
+        setRole(material.roughnessMetalnessTexIndex, TextureRole::ROUGHNESS_METALNESS);
+        setRole(material.normalTexIndex, TextureRole::NORMAL);
+        setRole(material.emissiveTexIndex, TextureRole::EMISSION);
     }
 
-    // Create BOTTOM_LEVEL acceleration structures for static geometry
-    const nri::DeviceDesc& deviceDesc = NRI.GetDeviceDesc(*m_Device);
-    uint64_t scratchSize = 0;
+    if (!m_TextureCacheFolder.empty())
+    {
+        std::error_code errorCode;
+        std::filesystem::create_directories(m_TextureCacheFolder, errorCode);
+    }
 
-    uint8_t* uploadData = (uint8_t*)NRI.MapBuffer(*uploadBuffer, 0, nri::WHOLE_SIZE);
+    // A texture per thread at a time
+    double begin = m_Timer.GetTimeStamp();
 
-    for (uint32_t mode = (uint32_t)AccelerationStructure::BLAS_StaticOpaque; mode <= (uint32_t)AccelerationStructure::BLAS_StaticEmissive; mode++)
+    std::atomic<uint32_t> nextTextureIndex{0};
+    auto worker = [&]()
     {
-        size_t geometryObjectBase = geometryObjects.size();
-
-        for (size_t i = m_ProxyInstancesNum; i < m_Scene.instances.size(); i++)
+        for (uint32_t i = nextTextureIndex++; i < (uint32_t)m_Scene.textures.size(); i = nextTextureIndex++)
         {
-            const utils::Instance& instance = m_Scene.instances[i];
-            const utils::Material& material = m_Scene.materials[instance.materialIndex];
+            if (!CompressTexture(*m_Scene.textures[i], roles[i], m_TextureCacheFolder, m_CompressedTextures[i]))
+                m_CompressedTextures[i] = {};
+        }
+    };
 
-            if (material.IsOff())
-                continue;
+    std::vector<std::thread> threads(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    for (std::thread& thread : threads)
+        thread = std::thread(worker);
 
-            if (instance.allowUpdate)
-                continue;
+    worker();
 
-            if (mode == (uint32_t)AccelerationStructure::BLAS_StaticOpaque)
-            {
-                if (material.IsTransparent())
-                    continue;
+    for (std::thread& thread : threads)
+        thread.join();
 
-                m_OpaqueObjectsNum++;
-            }
-            else if (mode == (uint32_t)AccelerationStructure::BLAS_StaticTransparent)
-            {
-                if (!material.IsTransparent())
-                    continue;
+    for (size_t i = 0; i < m_Scene.materials.size(); i++)
+        m_IsRoughnessMetalnessXy[i] = m_CompressedTextures[m_Scene.materials[i].roughnessMetalnessTexIndex].format == nri::Format::BC5_RG_UNORM;
 
-                m_TransparentObjectsNum++;
-            }
-            else if (mode == (uint32_t)AccelerationStructure::BLAS_StaticEmissive)
-            {
-                if (!material.IsEmissive())
-                    continue;
+    // Statistics
+    uint64_t originalSize = 0;
+    uint64_t compressedSize = 0;
+    uint32_t compressedNum = 0;
+    uint32_t cachedNum = 0;
+    for (size_t i = 0; i < m_Scene.textures.size(); i++)
+    {
+        const CompressedTexture& compressedTexture = m_CompressedTextures[i];
+        if (compressedTexture.format == nri::Format::UNKNOWN)
+            continue;
 
-                m_EmissiveObjectsNum++;
-            }
+        const utils::Texture* texture = m_Scene.textures[i];
+        for (uint32_t mip = 0; mip < texture->GetMipNum(); mip++)
+            originalSize += uint64_t(std::max(uint32_t(texture->GetWidth()) >> mip, 1u)) * std::max(uint32_t(texture->GetHeight()) >> mip, 1u) * 4 * texture->GetArraySize();
 
-            const utils::MeshInstance& meshInstance = m_Scene.meshInstances[instance.meshInstanceIndex];
-            const utils::Mesh& mesh = m_Scene.meshes[meshInstance.meshIndex];
+        compressedSize += compressedTexture.data.size();
+        compressedNum++;
+        cachedNum += compressedTexture.isCached ? 1 : 0;
+    }
 
-            // Copy geometry to temp buffer
-            assert( !mesh.HasMorphTargets() );
-            uint64_t vertexDataSize = mesh.vertexNum * sizeof(float[3]);
-            uint64_t indexDataSize = mesh.indexNum * sizeof(utils::Index);
+    printf("Texture compression: %u of %u textures, %.2f Mb -> %.2f Mb (%u from cache, %.1f ms)\n", compressedNum, (uint32_t)m_Scene.textures.size(),
+        originalSize / (1024.0f * 1024.0f), compressedSize / (1024.0f * 1024.0f), cachedNum, m_Timer.GetTimeStamp() - begin);
+}
 
-            if (uploadData)
-            {
-                uint8_t* p = uploadData + geometryOffset;
-                for (uint32_t v = 0; v < mesh.vertexNum; v++)
-                {
-                    memcpy(p, m_Scene.vertices[mesh.vertexOffset + v].pos, sizeof(float[3]));
-                    p += sizeof(float[3]);
-                }
+void Sample::SaveCapturedFrame(uint32_t frameIndex)
+{
+    const uint32_t w = GetWindowResolution().x;
+    const uint32_t h = GetWindowResolution().y;
+    const bool isHdr = NRI.GetTextureDesc(*Get(Texture::Final)).format == nri::Format::RGBA16_SFLOAT;
 
-                memcpy(p, &m_Scene.indices[mesh.indexOffset], indexDataSize);
-            }
+    char name[32];
+    snprintf(name, sizeof(name), "_%05u.%s", frameIndex, isHdr ? "exr" : "png");
+    std::string path = m_CapturePrefix + name;
 
-            // Copy transform to temp buffer
-            float4x4 mObjectToWorld = instance.rotation;
-            if (any(instance.scale != 1.0f))
-            {
-                float4x4 translation;
-                translation.SetupByTranslation( float3(instance.position) - mesh.aabb.GetCenter() );
+    const void* data = NRI.MapBuffer(*m_ReadbackBuffer, 0, nri::WHOLE_SIZE);
+    bool result = isHdr ? SaveExr(path, (const uint16_t*)data, w, h, m_ReadbackRowPitch) : SavePng(path, (const uint8_t*)data, w, h, m_ReadbackRowPitch);
+    NRI.UnmapBuffer(*m_ReadbackBuffer);
 
-                float4x4 translationInv = translation;
-                translationInv.InvertOrtho();
+    printf("Frame %u: %s '%s'\n", frameIndex, result ? "saved to" : "failed to save", path.c_str());
+}
 
-                float4x4 scale;
-                scale.SetupByScale(instance.scale);
+void Sample::CreateCommandBuffers()
+{
+    for (Frame& frame : m_Frames)
+    {
+        NRI_ABORT_ON_FAILURE(NRI.CreateCommandAllocator(*m_GraphicsQueue, frame.commandAllocator));
+        NRI_ABORT_ON_FAILURE(NRI.CreateCommandBuffer(*frame.commandAllocator, frame.commandBuffer));
+    }
+}
 
-                mObjectToWorld = mObjectToWorld * translationInv * scale * translation;
-            }
-            mObjectToWorld.AddTranslation( float3(instance.position) );
+void Sample::CreateTimestampQueries()
+{
+    nri::QueryPoolDesc queryPoolDesc = {};
+    queryPoolDesc.queryType = nri::QueryType::TIMESTAMP;
+    queryPoolDesc.capacity = BUFFERED_FRAME_MAX_NUM * (uint32_t)Timestamp::MAX_NUM;
 
-            mObjectToWorld.Transpose3x4();
+    NRI_ABORT_ON_FAILURE(NRI.CreateQueryPool(*m_Device, queryPoolDesc, m_TimestampQueryPool));
 
-            uint64_t transformOffset = geometryObjects.size() * sizeof(float[12]);
-            if (uploadData)
-                memcpy(uploadData + transformOffset, mObjectToWorld.a, sizeof(float[12]));
+    nri::AllocateBufferDesc allocateBufferDesc = {};
+    allocateBufferDesc.desc.size = queryPoolDesc.capacity * sizeof(uint64_t);
+    allocateBufferDesc.memoryLocation = nri::MemoryLocation::HOST_READBACK;
 
-            // Add geometry object
-            nri::GeometryObject& geometryObject = geometryObjects.emplace_back();
-            geometryObject = {};
-            geometryObject.type = nri::GeometryType::TRIANGLES;
-            geometryObject.flags = material.IsAlphaOpaque() ? nri::BottomLevelGeometryBits::NONE : nri::BottomLevelGeometryBits::OPAQUE_GEOMETRY;
-            geometryObject.geometry.triangles.vertexBuffer = uploadBuffer;
-            geometryObject.geometry.triangles.vertexOffset = geometryOffset;
-            geometryObject.geometry.triangles.vertexNum = mesh.vertexNum;
-            geometryObject.geometry.triangles.vertexStride = sizeof(float[3]);
-            geometryObject.geometry.triangles.vertexFormat = nri::Format::RGB32_SFLOAT;
-            geometryObject.geometry.triangles.indexBuffer = uploadBuffer;
-            geometryObject.geometry.triangles.indexOffset = geometryOffset + vertexDataSize;
-            geometryObject.geometry.triangles.indexNum = mesh.indexNum;
-            geometryObject.geometry.triangles.indexType = sizeof(utils::Index) == 2 ? nri::IndexType::UINT16 : nri::IndexType::UINT32;
-            geometryObject.geometry.triangles.transformBuffer = uploadBuffer;
-            geometryObject.geometry.triangles.transformOffset = transformOffset;
+    NRI_ABORT_ON_FAILURE(NRI.AllocateBuffer(*m_Device, allocateBufferDesc, m_TimestampBuffer));
+    NRI.SetDebugName(m_TimestampBuffer, "Buffer::Timestamps");
 
-            // Update geometry offset
-            geometryOffset += vertexDataSize + helper::Align(indexDataSize, 4);
-            primitivesNum += mesh.indexNum / 3;
-        }
+    // Wavefront stages
+    queryPoolDesc.capacity = BUFFERED_FRAME_MAX_NUM * WAVEFRONT_QUERY_MAX_NUM;
 
-        uint32_t geometryObjectsNum = (uint32_t)(geometryObjects.size() - geometryObjectBase);
-        if (geometryObjectsNum)
-        {
-            // Create BLAS
-            nri::AllocateAccelerationStructureDesc allocateAccelerationStructureDesc = {};
-            allocateAccelerationStructureDesc.desc.type = nri::AccelerationStructureType::BOTTOM_LEVEL;
-            allocateAccelerationStructureDesc.desc.flags = BLAS_RIGID_MESH_BUILD_BITS;
-            allocateAccelerationStructureDesc.desc.instanceOrGeometryObjectNum = geometryObjectsNum;
-            allocateAccelerationStructureDesc.desc.geometryObjects = &geometryObjects[geometryObjectBase];
-            allocateAccelerationStructureDesc.memoryLocation = nri::MemoryLocation::DEVICE;
+    NRI_ABORT_ON_FAILURE(NRI.CreateQueryPool(*m_Device, queryPoolDesc, m_WavefrontQueryPool));
 
-            nri::AccelerationStructure* accelerationStructure = nullptr;
-            NRI_ABORT_ON_FAILURE(NRI.AllocateAccelerationStructure(*m_Device, allocateAccelerationStructureDesc, accelerationStructure));
-            m_AccelerationStructures.push_back(accelerationStructure);
+    allocateBufferDesc.desc.size = queryPoolDesc.capacity * sizeof(uint64_t);
 
-            // Update parameters
-            parameters.push_back( {accelerationStructure, scratchSize, (uint32_t)geometryObjectBase, geometryObjectsNum, allocateAccelerationStructureDesc.desc.flags} );
+    NRI_ABORT_ON_FAILURE(NRI.AllocateBuffer(*m_Device, allocateBufferDesc, m_WavefrontTimestampBuffer));
+    NRI.SetDebugName(m_WavefrontTimestampBuffer, "Buffer::WavefrontTimestamps");
+}
 
-            uint64_t size = NRI.GetAccelerationStructureBuildScratchBufferSize(*accelerationStructure);
-            scratchSize += helper::Align(size, deviceDesc.scratchBufferOffsetAlignment);
-        }
-        else
-        {
-            // Needed only to preserve order
-            m_AccelerationStructures.push_back(nullptr);
-        }
+void Sample::CreateSharcStatsBuffer()
+{
+    nri::AllocateBufferDesc allocateBufferDesc = {};
+    allocateBufferDesc.desc.size = BUFFERED_FRAME_MAX_NUM * SHARC_STATS_NUM * sizeof(uint32_t);
+    allocateBufferDesc.memoryLocation = nri::MemoryLocation::HOST_READBACK;
+
+    NRI_ABORT_ON_FAILURE(NRI.AllocateBuffer(*m_Device, allocateBufferDesc, m_SharcStatsBuffer));
+    NRI.SetDebugName(m_SharcStatsBuffer, "Buffer::SharcStatsReadback");
+}
+
+void Sample::InitializeTextureStreaming()
+{
+    if (!m_TextureBudget)
+        return;
+
+    // Only material textures are streamed
+    std::vector<bool> isStreamed(m_Scene.textures.size(), false);
+    for (const utils::Material& material : m_Scene.materials)
+    {
+        isStreamed[material.baseColorTexIndex] = true;
+        isStreamed[material.roughnessMetalnessTexIndex] = true;
+        isStreamed[material.normalTexIndex] = true;
+        isStreamed[material.emissiveTexIndex] = true;
     }
 
-    // Create BOTTOM_LEVEL acceleration structures for dynamic geometry
-    for (uint32_t dynamicMeshInstanceIndex : dynamicMeshInstances)
+    m_TextureResidency.resize(m_Scene.textures.size());
+    for (uint32_t i = 0; i < (uint32_t)m_Scene.textures.size(); i++)
     {
-        utils::MeshInstance& meshInstance = m_Scene.meshInstances[dynamicMeshInstanceIndex];
-        const utils::Mesh& mesh = m_Scene.meshes[meshInstance.meshIndex];
+        const utils::Texture* texture = m_Scene.textures[i];
+        const nri::FormatProps& formatProps = nri::nriGetFormatProps(GetMaterialTextureDesc(i, 0).format);
 
-        meshInstance.blasIndex = (uint32_t)m_AccelerationStructures.size();
+        // The coarsest top mip must be a whole number of blocks
+        uint32_t maxResidentMip = 0;
+        while (isStreamed[i] && maxResidentMip + 1 < texture->GetMipNum())
+        {
+            const uint32_t w = std::max(uint32_t(texture->GetWidth()) >> (maxResidentMip + 1), 1u);
+            const uint32_t h = std::max(uint32_t(texture->GetHeight()) >> (maxResidentMip + 1), 1u);
+            if (std::max(w, h) < TEXTURE_STREAMING_MIN_SIZE || w % formatProps.blockWidth != 0 || h % formatProps.blockHeight != 0)
+                break;
 
-        // Copy geometry to temp buffer
-        uint64_t vertexStride = mesh.HasMorphTargets() ? sizeof(float16_t4) : sizeof(float[3]);
-        uint64_t vertexDataSize = mesh.vertexNum * vertexStride;
-        uint64_t indexDataSize = mesh.indexNum * sizeof(utils::Index);
+            maxResidentMip++;
+        }
 
-        if (uploadData)
+        TextureResidency& residency = m_TextureResidency[i];
+        residency.sizes.resize(maxResidentMip + 1);
+        for (uint32_t mip = 0; mip <= maxResidentMip; mip++)
         {
-            uint8_t* p = uploadData + geometryOffset;
-            for (uint32_t v = 0; v < mesh.vertexNum; v++)
-            {
-                if (mesh.HasMorphTargets())
-                    memcpy(p, &m_Scene.morphVertices[mesh.morphTargetVertexOffset + v].pos, vertexStride);
-                else
-                    memcpy(p, m_Scene.vertices[mesh.vertexOffset + v].pos, vertexStride);
-                p += vertexStride;
-            }
+            nri::MemoryDesc memoryDesc = {};
+            NRI.GetTextureMemoryDesc(*m_Device, GetMaterialTextureDesc(i, mip), nri::MemoryLocation::DEVICE, memoryDesc);
 
-            memcpy(p, &m_Scene.indices[mesh.indexOffset], indexDataSize);
+            residency.sizes[mip] = memoryDesc.size;
         }
 
-        // Add geometry object
-        nri::GeometryObject& geometryObject = geometryObjects.emplace_back();
-        geometryObject = {};
-        geometryObject.type = nri::GeometryType::TRIANGLES;
-        geometryObject.flags = nri::BottomLevelGeometryBits::NONE; // will be set in TLAS instance
-        geometryObject.geometry.triangles.vertexBuffer = uploadBuffer;
-        geometryObject.geometry.triangles.vertexOffset = geometryOffset;
-        geometryObject.geometry.triangles.vertexNum = mesh.vertexNum;
-        geometryObject.geometry.triangles.vertexStride = vertexStride;
-        geometryObject.geometry.triangles.vertexFormat = mesh.HasMorphTargets() ? nri::Format::RGBA16_SFLOAT : nri::Format::RGB32_SFLOAT;
-        geometryObject.geometry.triangles.indexBuffer = uploadBuffer;
-        geometryObject.geometry.triangles.indexOffset = geometryOffset + vertexDataSize;
-        geometryObject.geometry.triangles.indexNum = mesh.indexNum;
-        geometryObject.geometry.triangles.indexType = sizeof(utils::Index) == 2 ? nri::IndexType::UINT16 : nri::IndexType::UINT32;
+        // Start coarse, requested mips get streamed in
+        residency.residentMip = maxResidentMip;
+        residency.maxResidentMip = maxResidentMip;
+        residency.requestedMip = maxResidentMip;
+        residency.lastRequestFrameIndex = 0;
+    }
 
-        // Create BLAS
-        nri::AllocateAccelerationStructureDesc allocateAccelerationStructureDesc = {};
-        allocateAccelerationStructureDesc.desc.type = nri::AccelerationStructureType::BOTTOM_LEVEL;
-        allocateAccelerationStructureDesc.desc.flags = mesh.HasMorphTargets() ? BLAS_DEFORMABLE_MESH_BUILD_BITS : BLAS_RIGID_MESH_BUILD_BITS;
-        allocateAccelerationStructureDesc.desc.instanceOrGeometryObjectNum = 1;
-        allocateAccelerationStructureDesc.desc.geometryObjects = &geometryObject;
-        allocateAccelerationStructureDesc.memoryLocation = nri::MemoryLocation::DEVICE;
+    // Feedback readback
+    nri::AllocateBufferDesc allocateBufferDesc = {};
+    allocateBufferDesc.desc.size = BUFFERED_FRAME_MAX_NUM * std::max(helper::GetCountOf(m_Scene.materials) * TEXTURES_PER_MATERIAL, 1u) * sizeof(uint32_t);
+    allocateBufferDesc.memoryLocation = nri::MemoryLocation::HOST_READBACK;
 
-        nri::AccelerationStructure* accelerationStructure = nullptr;
-        NRI_ABORT_ON_FAILURE(NRI.AllocateAccelerationStructure(*m_Device, allocateAccelerationStructureDesc, accelerationStructure));
-        m_AccelerationStructures.push_back(accelerationStructure);
+    NRI_ABORT_ON_FAILURE(NRI.AllocateBuffer(*m_Device, allocateBufferDesc, m_TextureFeedbackBuffer));
+    NRI.SetDebugName(m_TextureFeedbackBuffer, "Buffer::TextureFeedbackReadback");
+}
 
-        // Update parameters
-        parameters.push_back( {accelerationStructure, scratchSize, (uint32_t)(geometryObjects.size() - 1), 1, allocateAccelerationStructureDesc.desc.flags } );
+nri::TextureDesc Sample::GetMaterialTextureDesc(uint32_t textureIndex, uint32_t firstMip) const
+{
+    const utils::Texture* texture = m_Scene.textures[textureIndex];
+    const CompressedTexture& compressedTexture = m_CompressedTextures[textureIndex];
+
+    nri::TextureDesc textureDesc = {};
+    textureDesc.type = nri::TextureType::TEXTURE_2D;
+    textureDesc.usage = nri::TextureUsageBits::SHADER_RESOURCE;
+    textureDesc.format = compressedTexture.format != nri::Format::UNKNOWN ? compressedTexture.format : texture->GetFormat();
+    textureDesc.width = (nri::Dim_t)std::max(uint32_t(texture->GetWidth()) >> firstMip, 1u);
+    textureDesc.height = (nri::Dim_t)std::max(uint32_t(texture->GetHeight()) >> firstMip, 1u);
+    textureDesc.depth = 1;
+    textureDesc.mipNum = (nri::Mip_t)(texture->GetMipNum() - firstMip);
+    textureDesc.layerNum = texture->GetArraySize();
+    textureDesc.sampleNum = 1;
+
+    return textureDesc;
+}
 
-        uint64_t buildSize = NRI.GetAccelerationStructureBuildScratchBufferSize(*accelerationStructure);
-        scratchSize += helper::Align(buildSize, deviceDesc.scratchBufferOffsetAlignment);
+void Sample::GatherMaterialTextureSubresources(uint32_t textureIndex, uint32_t firstMip, std::vector<nri::TextureSubresourceUploadDesc>& subresources) const
+{
+    const utils::Texture* texture = m_Scene.textures[textureIndex];
+    const CompressedTexture& compressedTexture = m_CompressedTextures[textureIndex];
 
-        if (mesh.HasMorphTargets())
+    for (uint32_t layer = 0; layer < texture->GetArraySize(); layer++)
+    {
+        for (uint32_t mip = firstMip; mip < texture->GetMipNum(); mip++)
         {
-            uint64_t updateSize = NRI.GetAccelerationStructureUpdateScratchBufferSize(*accelerationStructure);
-            m_MorphMeshScratchSize += helper::Align(max(buildSize, updateSize), deviceDesc.scratchBufferOffsetAlignment);
-        }
+            if (compressedTexture.format != nri::Format::UNKNOWN)
+                subresources.push_back(compressedTexture.subresources[layer * texture->GetMipNum() + mip]);
+            else
+            {
+                nri::TextureSubresourceUploadDesc subresource;
+                texture->GetSubresource(subresource, mip, layer);
 
-        // Update geometry offset
-        geometryOffset += vertexDataSize + helper::Align(indexDataSize, 4);
-        primitivesNum += mesh.indexNum / 3;
+                subresources.push_back(subresource);
+            }
+        }
     }
+}
 
-    // Allocate scratch memory
-    nri::Buffer* scratchBuffer = nullptr;
+void Sample::CreatePipelineLayoutAndDescriptorPool()
+{
+    // SET_GLOBAL
+    const nri::DescriptorRangeDesc descriptorRanges0[] =
     {
-        nri::AllocateBufferDesc allocateBufferDesc = {};
-        allocateBufferDesc.desc = {scratchSize, 0, nri::BufferUsageBits::SCRATCH_BUFFER};
-        allocateBufferDesc.memoryLocation = nri::MemoryLocation::DEVICE;
+        { 0, 3, nri::DescriptorType::SAMPLER, nri::StageBits::COMPUTE_SHADER },
+    };
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateBuffer(*m_Device, allocateBufferDesc, scratchBuffer));
-    }
+    // SET_OTHER
+    const nri::DescriptorRangeDesc descriptorRanges1[] =
+    {
+        { 0, 12, nri::DescriptorType::TEXTURE, nri::StageBits::COMPUTE_SHADER, nri::DescriptorRangeBits::PARTIALLY_BOUND },
+        { 0, 13, nri::DescriptorType::STORAGE_TEXTURE, nri::StageBits::COMPUTE_SHADER, nri::DescriptorRangeBits::PARTIALLY_BOUND },
+    };
 
-    // Create command allocator and command buffer
-    nri::CommandAllocator* commandAllocator = nullptr;
-    NRI.CreateCommandAllocator(*m_GraphicsQueue, commandAllocator);
+    // SET_RAY_TRACING
+    const uint32_t textureNum = helper::GetCountOf(m_Scene.materials) * TEXTURES_PER_MATERIAL;
+    nri::DescriptorRangeDesc descriptorRanges2[] =
+    {
+        { 0, 2, nri::DescriptorType::ACCELERATION_STRUCTURE, nri::StageBits::COMPUTE_SHADER },
+        { 2, 3, nri::DescriptorType::STRUCTURED_BUFFER, nri::StageBits::COMPUTE_SHADER },
+        { 0, 1, nri::DescriptorType::STORAGE_STRUCTURED_BUFFER, nri::StageBits::COMPUTE_SHADER },
+        { 5, textureNum, nri::DescriptorType::TEXTURE, nri::StageBits::COMPUTE_SHADER, nri::DescriptorRangeBits::PARTIALLY_BOUND | nri::DescriptorRangeBits::VARIABLE_SIZED_ARRAY },
+    };
 
-    nri::CommandBuffer* commandBuffer = nullptr;
-    NRI.CreateCommandBuffer(*commandAllocator, commandBuffer);
+    // SET_MORPH
+    const nri::DescriptorRangeDesc descriptorRanges3[] =
+    {
+        { 0, 3, nri::DescriptorType::STRUCTURED_BUFFER, nri::StageBits::COMPUTE_SHADER, nri::DescriptorRangeBits::PARTIALLY_BOUND },
+        { 0, 2, nri::DescriptorType::STORAGE_STRUCTURED_BUFFER, nri::StageBits::COMPUTE_SHADER, nri::DescriptorRangeBits::PARTIALLY_BOUND },
+    };
 
-    double stamp2 = m_Timer.GetTimeStamp();
+    // SET_SHARC
+    const nri::DescriptorRangeDesc descriptorRanges4[] =
+    {
+        { 0, 12, nri::DescriptorType::STORAGE_STRUCTURED_BUFFER, nri::StageBits::COMPUTE_SHADER },
+    };
 
-    // Record
-    NRI.BeginCommandBuffer(*commandBuffer, nullptr);
+    // SET_WAVEFRONT
+    const nri::DescriptorRangeDesc descriptorRanges5[] =
     {
-        for (const Parameters& params : parameters)
-            NRI.CmdBuildBottomLevelAccelerationStructure(*commandBuffer, params.geometryObjectsNum, &geometryObjects[params.geometryObjectBase], params.buildBits, *params.accelerationStructure, *scratchBuffer, params.scratchOffset);
-    }
-    NRI.EndCommandBuffer(*commandBuffer);
+        { 0, 11, nri::DescriptorType::STORAGE_STRUCTURED_BUFFER, nri::StageBits::COMPUTE_SHADER },
+    };
 
-    // Submit
-    nri::QueueSubmitDesc queueSubmitDesc = {};
-    queueSubmitDesc.commandBuffers = &commandBuffer;
-    queueSubmitDesc.commandBufferNum = 1;
+    nri::DynamicConstantBufferDesc dynamicConstantBuffer = { 0, nri::StageBits::COMPUTE_SHADER };
 
-    NRI.QueueSubmit(*m_GraphicsQueue, queueSubmitDesc);
+    const nri::DescriptorSetDesc descriptorSetDescs[] =
+    {
+        { SET_GLOBAL, descriptorRanges0, helper::GetCountOf(descriptorRanges0), &dynamicConstantBuffer, 1 },
+        { SET_OTHER, descriptorRanges1, helper::GetCountOf(descriptorRanges1), nullptr, 0 },
+        { SET_RAY_TRACING, descriptorRanges2, helper::GetCountOf(descriptorRanges2) },
+        { SET_MORPH, descriptorRanges3, helper::GetCountOf(descriptorRanges3), &dynamicConstantBuffer, 1 },
+        { SET_SHARC, descriptorRanges4, helper::GetCountOf(descriptorRanges4) },
+        { SET_WAVEFRONT, descriptorRanges5, helper::GetCountOf(descriptorRanges5), &dynamicConstantBuffer, 1 },
+    };
 
-    // Wait idle
-    NRI.WaitForIdle(*m_GraphicsQueue);
+    { // Pipeline layout
+        nri::PipelineLayoutDesc pipelineLayoutDesc = {};
+        pipelineLayoutDesc.descriptorSets = descriptorSetDescs;
+        pipelineLayoutDesc.descriptorSetNum = helper::GetCountOf(descriptorSetDescs);
+        pipelineLayoutDesc.shaderStages = nri::StageBits::COMPUTE_SHADER;
 
-    double buildTime = m_Timer.GetTimeStamp() - stamp2;
+        NRI_ABORT_ON_FAILURE(NRI.CreatePipelineLayout(*m_Device, pipelineLayoutDesc, m_PipelineLayout));
+    }
 
-    // Cleanup
-    NRI.UnmapBuffer(*uploadBuffer);
+    { // Descriptor pool
+        nri::DescriptorPoolDesc descriptorPoolDesc = {};
 
-    NRI.DestroyBuffer(*scratchBuffer);
-    NRI.DestroyBuffer(*uploadBuffer);
+        uint32_t setNum = 1;
+        descriptorPoolDesc.descriptorSetMaxNum += setNum;
+        descriptorPoolDesc.dynamicConstantBufferMaxNum += descriptorSetDescs[SET_GLOBAL].dynamicConstantBufferNum * setNum;
+        descriptorPoolDesc.samplerMaxNum += descriptorSetDescs[SET_GLOBAL].ranges[0].descriptorNum * BUFFERED_FRAME_MAX_NUM * setNum;
 
-    NRI.DestroyCommandBuffer(*commandBuffer);
-    NRI.DestroyCommandAllocator(*commandAllocator);
+        setNum = (uint32_t)DescriptorSet::MAX_NUM - 8; // exclude non-SET_OTHER sets
+        descriptorPoolDesc.descriptorSetMaxNum += setNum;
+        descriptorPoolDesc.textureMaxNum += descriptorSetDescs[SET_OTHER].ranges[0].descriptorNum * setNum;
+        descriptorPoolDesc.storageTextureMaxNum += descriptorSetDescs[SET_OTHER].ranges[1].descriptorNum * setNum;
 
-    double totalTime = m_Timer.GetTimeStamp() - stamp1;
+        setNum = 1;
+        descriptorPoolDesc.descriptorSetMaxNum += setNum;
+        descriptorPoolDesc.accelerationStructureMaxNum += descriptorSetDescs[SET_RAY_TRACING].ranges[0].descriptorNum * setNum;
+        descriptorPoolDesc.structuredBufferMaxNum += descriptorSetDescs[SET_RAY_TRACING].ranges[1].descriptorNum * setNum;
+        descriptorPoolDesc.storageStructuredBufferMaxNum += descriptorSetDescs[SET_RAY_TRACING].ranges[2].descriptorNum * setNum;
+        descriptorPoolDesc.textureMaxNum += descriptorSetDescs[SET_RAY_TRACING].ranges[3].descriptorNum * setNum;
 
-    printf(
-        "Scene stats:\n"
-        "  Instances     : %zu\n"
-        "  Meshes        : %zu\n"
-        "  Vertices      : %zu\n"
-        "  Primitives    : %zu\n"
-        "BVH stats:\n"
-        "  Total time    : %.2f ms\n"
-        "  Building time : %.2f ms\n"
-        "  Scratch size  : %.2f Mb\n"
-        "  BLAS num      : %zu\n"
-        "  Geometries    : %zu\n"
-        "  Primitives    : %zu\n"
-        , m_Scene.instances.size()
-        , m_Scene.meshes.size()
-        , m_Scene.primitives.size()
-        , m_Scene.vertices.size()
-        , totalTime
-        , buildTime
-        , scratchSize / (1024.0 * 1024.0)
-        , m_AccelerationStructures.size() - (size_t)AccelerationStructure::BLAS_StaticOpaque
-        , geometryObjects.size()
-        , primitivesNum
-   );
+        setNum = 2;
+        descriptorPoolDesc.descriptorSetMaxNum += setNum;
+        descriptorPoolDesc.dynamicConstantBufferMaxNum += descriptorSetDescs[SET_MORPH].dynamicConstantBufferNum * setNum;
+        descriptorPoolDesc.structuredBufferMaxNum += descriptorSetDescs[SET_MORPH].ranges[0].descriptorNum * setNum;
+        descriptorPoolDesc.storageStructuredBufferMaxNum += descriptorSetDescs[SET_MORPH].ranges[1].descriptorNum * setNum;
+
+        setNum = 2;
+        descriptorPoolDesc.descriptorSetMaxNum += setNum;
+        descriptorPoolDesc.storageStructuredBufferMaxNum += descriptorSetDescs[SET_SHARC].ranges[0].descriptorNum * setNum;
+
+        setNum = 2;
+        descriptorPoolDesc.descriptorSetMaxNum += setNum;
+        descriptorPoolDesc.dynamicConstantBufferMaxNum += descriptorSetDescs[SET_WAVEFRONT].dynamicConstantBufferNum * setNum;
+        descriptorPoolDesc.storageStructuredBufferMaxNum += descriptorSetDescs[SET_WAVEFRONT].ranges[0].descriptorNum * setNum;
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateDescriptorPool(*m_Device, descriptorPoolDesc, m_DescriptorPool));
+    }
 }
 
-void Sample::CreateSamplers()
+void Sample::CreatePipelines()
 {
-    nri::Descriptor* descriptor = nullptr;
+    if (!m_Pipelines.empty())
+    {
+        NRI.WaitForIdle(*m_GraphicsQueue);
 
-    { // Descriptor::LinearMipmapLinear_Sampler
-        nri::SamplerDesc samplerDesc = {};
-        samplerDesc.addressModes = {nri::AddressMode::REPEAT, nri::AddressMode::REPEAT};
-        samplerDesc.filters = {nri::Filter::LINEAR, nri::Filter::LINEAR, nri::Filter::LINEAR};
-        samplerDesc.mipMax = 16.0f;
+        for (uint32_t i = 0; i < m_Pipelines.size(); i++)
+            NRI.DestroyPipeline(*m_Pipelines[i]);
+        m_Pipelines.clear();
 
-        NRI_ABORT_ON_FAILURE( NRI.CreateSampler(*m_Device, samplerDesc, descriptor) );
-        m_Descriptors.push_back(descriptor);
+        m_NRD.CreatePipelines();
     }
 
-    { // Descriptor::LinearMipmapNearest_Sampler
-        nri::SamplerDesc samplerDesc = {};
-        samplerDesc.addressModes = {nri::AddressMode::REPEAT, nri::AddressMode::REPEAT};
-        samplerDesc.filters = {nri::Filter::LINEAR, nri::Filter::LINEAR, nri::Filter::NEAREST};
-        samplerDesc.mipMax = 16.0f;
+    utils::ShaderCodeStorage shaderCodeStorage;
 
-        NRI_ABORT_ON_FAILURE( NRI.CreateSampler(*m_Device, samplerDesc, descriptor) );
-        m_Descriptors.push_back(descriptor);
-    }
+    nri::ComputePipelineDesc pipelineDesc = {};
+    pipelineDesc.pipelineLayout = m_PipelineLayout;
 
-    { // Descriptor::NearestMipmapNearest_Sampler
-        nri::SamplerDesc samplerDesc = {};
-        samplerDesc.addressModes = {nri::AddressMode::REPEAT, nri::AddressMode::REPEAT};
-        samplerDesc.filters = {nri::Filter::NEAREST, nri::Filter::NEAREST, nri::Filter::NEAREST};
-        samplerDesc.mipMax = 16.0f;
+    nri::Pipeline* pipeline = nullptr;
+    const nri::DeviceDesc& deviceDesc = NRI.GetDeviceDesc(*m_Device);
 
-        NRI_ABORT_ON_FAILURE( NRI.CreateSampler(*m_Device, samplerDesc, descriptor) );
-        m_Descriptors.push_back(descriptor);
+    // All shaders depend on "NRD_MODE"
+    const std::string shaderFolder = nrdModeFolders[m_NrdMode];
+    auto LoadShader = [&](const char* shaderName) -> nri::ShaderDesc
+    { return utils::LoadShader(deviceDesc.graphicsAPI, (shaderFolder + shaderName).c_str(), shaderCodeStorage); };
+
+    { // Pipeline::MorphMeshUpdateVertices
+        pipelineDesc.shader = LoadShader("MorphMeshUpdateVertices.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
     }
-}
 
-inline nri::Format ConvertFormatToTextureStorageCompatible(nri::Format format)
-{
-    switch (format)
-    {
-        case nri::Format::D16_UNORM:                return nri::Format::R16_UNORM;
-        case nri::Format::D24_UNORM_S8_UINT:        return nri::Format::R24_UNORM_X8;
-        case nri::Format::D32_SFLOAT:               return nri::Format::R32_SFLOAT;
-        case nri::Format::D32_SFLOAT_S8_UINT_X24:   return nri::Format::R32_SFLOAT_X8_X24;
-        case nri::Format::RGBA8_SRGB:               return nri::Format::RGBA8_UNORM;
-        case nri::Format::BGRA8_SRGB:               return nri::Format::BGRA8_UNORM;
-        default:                                    return format;
+    { // Pipeline::MorphMeshUpdatePrimitives
+        pipelineDesc.shader = LoadShader("MorphMeshUpdatePrimitives.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
     }
-}
 
-void Sample::CreateResources(nri::Format swapChainFormat)
-{
-    // TODO: DLSS doesn't support R16 UNORM/SNORM
-#if( NRD_MODE == OCCLUSION )
-    const nri::Format dataFormat = m_DlssQuality != -1 ? nri::Format::R16_SFLOAT : nri::Format::R16_UNORM;
-#elif( NRD_MODE == DIRECTIONAL_OCCLUSION )
-    const nri::Format dataFormat = m_DlssQuality != -1 ? nri::Format::RGBA16_SFLOAT : nri::Format::RGBA16_SNORM;
-#else
-    const nri::Format dataFormat = nri::Format::RGBA16_SFLOAT;
-#endif
+    { // Pipeline::SharcClear
+        pipelineDesc.shader = LoadShader("SharcClear.cs");
 
-#if( NRD_NORMAL_ENCODING == 0 )
-    const nri::Format normalFormat = nri::Format::RGBA8_UNORM;
-#elif( NRD_NORMAL_ENCODING == 1 )
-    const nri::Format normalFormat = nri::Format::RGBA8_SNORM;
-#elif( NRD_NORMAL_ENCODING == 2 )
-    const nri::Format normalFormat = nri::Format::R10_G10_B10_A2_UNORM;
-#elif( NRD_NORMAL_ENCODING == 3 )
-    const nri::Format normalFormat = nri::Format::RGBA16_UNORM;
-#elif( NRD_NORMAL_ENCODING == 4 )
-    const nri::Format normalFormat = nri::Format::RGBA16_SFLOAT; // TODO: RGBA16_SNORM can't be used, because NGX doesn't support it
-#endif
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
 
-    const nri::Format taaFormat = nri::Format::RGBA16_SFLOAT; // required for new TAA even in LDR mode (RGBA16_UNORM can't be used)
-    const nri::Format colorFormat = USE_LOW_PRECISION_FP_FORMATS ? nri::Format::R11_G11_B10_UFLOAT : nri::Format::RGBA16_SFLOAT;
-    const nri::Format criticalColorFormat = nri::Format::RGBA16_SFLOAT; // TODO: R9_G9_B9_E5_UFLOAT?
-    const nri::Format shadowFormat = SIGMA_TRANSLUCENT ? nri::Format::RGBA8_UNORM : nri::Format::R8_UNORM;
+    { // Pipeline::SharcUpdate
+        pipelineDesc.shader = LoadShader("SharcUpdate.cs");
 
-    const uint16_t w = (uint16_t)m_RenderResolution.x;
-    const uint16_t h = (uint16_t)m_RenderResolution.y;
-    const uint64_t instanceNum = m_Scene.instances.size() + MAX_ANIMATED_INSTANCE_NUM;
-    const uint64_t instanceDataSize = instanceNum * sizeof(InstanceData);
-    const uint64_t worldScratchBufferSize = NRI.GetAccelerationStructureBuildScratchBufferSize(*Get(AccelerationStructure::TLAS_World));
-    const uint64_t lightScratchBufferSize = NRI.GetAccelerationStructureBuildScratchBufferSize(*Get(AccelerationStructure::TLAS_Emissive));
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
 
-    std::vector<DescriptorDesc> descriptorDescs;
+    { // Pipeline::SharcResolve
+        pipelineDesc.shader = LoadShader("SharcResolve.cs");
 
-    m_InstanceData.resize(instanceNum);
-    m_WorldTlasData.resize(instanceNum);
-    m_LightTlasData.resize(instanceNum);
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
 
-    // Buffers (DEVICE, read-only)
-    CreateBuffer(descriptorDescs, "Buffer::InstanceData", nri::Format::UNKNOWN, instanceDataSize / sizeof(InstanceData), sizeof(InstanceData),
-        nri::BufferUsageBits::SHADER_RESOURCE);
-    CreateBuffer(descriptorDescs, "Buffer::MorphMeshIndices", nri::Format::UNKNOWN, m_Scene.morphMeshTotalIndicesNum, sizeof(utils::Index),
-        nri::BufferUsageBits::SHADER_RESOURCE | nri::BufferUsageBits::ACCELERATION_STRUCTURE_BUILD_INPUT);
-    CreateBuffer(descriptorDescs, "Buffer::MorphMeshVertices", nri::Format::UNKNOWN, m_Scene.morphVertices.size(), sizeof(utils::MorphVertex),
-        nri::BufferUsageBits::SHADER_RESOURCE);
+    { // Pipeline::SharcHashCopy
+        pipelineDesc.shader = LoadShader("SharcHashCopy.cs");
 
-    // Buffers (DEVICE)
-    CreateBuffer(descriptorDescs, "Buffer::MorphedPositions", nri::Format::UNKNOWN, m_Scene.morphedVerticesNum * MAX_ANIMATION_HISTORY_FRAME_NUM, sizeof(float16_t4),
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::SharcCompact
+        pipelineDesc.shader = LoadShader("SharcCompact.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::TraceOpaque
+        pipelineDesc.shader = LoadShader("TraceOpaque.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::TraceOpaqueProbabilistic
+        pipelineDesc.shader = LoadShader("TraceOpaqueProbabilistic.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::TraceOpaqueHalf
+        pipelineDesc.shader = LoadShader("TraceOpaqueHalf.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::TraceOpaqueFull
+        pipelineDesc.shader = LoadShader("TraceOpaqueFull.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::TraceOpaqueGenerate
+        pipelineDesc.shader = LoadShader("TraceOpaqueGenerate.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::TraceOpaqueShadow
+        pipelineDesc.shader = LoadShader("TraceOpaqueShadow.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::TraceOpaqueExtend
+        pipelineDesc.shader = LoadShader("TraceOpaqueExtend.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::TraceOpaqueShade
+        pipelineDesc.shader = LoadShader("TraceOpaqueShade.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::TraceOpaqueBinScan
+        pipelineDesc.shader = LoadShader("TraceOpaqueBinScan.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::TraceOpaqueBinScatter
+        pipelineDesc.shader = LoadShader("TraceOpaqueBinScatter.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::Composition
+        pipelineDesc.shader = LoadShader("Composition.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::TraceTransparent
+        pipelineDesc.shader = LoadShader("TraceTransparent.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::Taa
+        pipelineDesc.shader = LoadShader("TAA.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::Nis
+        pipelineDesc.shader = LoadShader("NIS.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::Final
+        pipelineDesc.shader = LoadShader("Final.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::DlssBefore
+        pipelineDesc.shader = LoadShader("DlssBefore.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+
+    { // Pipeline::DlssAfter
+        pipelineDesc.shader = LoadShader("DlssAfter.cs");
+
+        NRI_ABORT_ON_FAILURE(NRI.CreateComputePipeline(*m_Device, pipelineDesc, pipeline));
+        m_Pipelines.push_back(pipeline);
+    }
+}
+
+void Sample::CreateAccelerationStructures()
+{
+    double stamp1 = m_Timer.GetTimeStamp();
+
+    struct Parameters
+    {
+        nri::AccelerationStructure* accelerationStructure;
+        uint64_t scratchOffset;
+        uint32_t geometryObjectBase;
+        uint32_t geometryObjectsNum;
+        nri::AccelerationStructureBuildBits buildBits;
+    };
+
+    uint64_t primitivesNum = 0;
+    std::vector<Parameters> parameters;
+    std::vector<nri::GeometryObject> geometryObjects;
+
+    geometryObjects.reserve(m_Scene.instances.size()); // reallocation is NOT allowed!
+
+    // Calculate temp memory size
+    std::vector<uint32_t> dynamicMeshInstances;
+    uint64_t uploadSize = 0;
+    uint64_t geometryOffset = 0;
+
+    for (size_t i = m_ProxyInstancesNum; i < m_Scene.instances.size(); i++)
+    {
+        const utils::Instance& instance = m_Scene.instances[i];
+        const utils::Material& material = m_Scene.materials[instance.materialIndex];
+
+        if (material.IsOff())
+            continue;
+
+        if (instance.allowUpdate)
+        {
+            if (std::find(dynamicMeshInstances.begin(), dynamicMeshInstances.end(), instance.meshInstanceIndex) != dynamicMeshInstances.end())
+                continue;
+            else
+                dynamicMeshInstances.push_back(instance.meshInstanceIndex);
+        }
+
+        const utils::MeshInstance& meshInstance = m_Scene.meshInstances[instance.meshInstanceIndex];
+        const utils::Mesh& mesh = m_Scene.meshes[meshInstance.meshIndex];
+
+        uint64_t vertexDataSize = mesh.vertexNum * sizeof(float[3]);
+        uint64_t indexDataSize = helper::Align(mesh.indexNum * sizeof(utils::Index), 4);
+        uint64_t transformDataSize = instance.allowUpdate ? 0 : sizeof(float[12]);
+
+        if (material.IsEmissive())
+        {
+            // Emissive meshes apper twice: in BLAS_StaticOpaque and in BLAS_StaticEmissive
+            vertexDataSize *= 2;
+            indexDataSize *= 2;
+            transformDataSize *= 2;
+        }
+
+        uploadSize += vertexDataSize + indexDataSize + transformDataSize;
+        geometryOffset += transformDataSize;
+    }
+
+    // Create temp buffer in UPLOAD heap
+    nri::Buffer* uploadBuffer = nullptr;
+    {
+        nri::AllocateBufferDesc allocateBufferDesc = {};
+        allocateBufferDesc.desc = {uploadSize, 0, nri::BufferUsageBits::ACCELERATION_STRUCTURE_BUILD_INPUT};
+        allocateBufferDesc.memoryLocation = nri::MemoryLocation::HOST_UPLOAD;
+
+        NRI_ABORT_ON_FAILURE(NRI.AllocateBuffer(*m_Device, allocateBufferDesc, uploadBuffer));
+    }
+
+    { // AccelerationStructure::TLAS_World
+        nri::AllocateAccelerationStructureDesc allocateAccelerationStructureDesc = {};
+        allocateAccelerationStructureDesc.desc.type = nri::AccelerationStructureType::TOP_LEVEL;
+        allocateAccelerationStructureDesc.desc.flags = TLAS_BUILD_BITS;
+        allocateAccelerationStructureDesc.desc.instanceOrGeometryObjectNum = helper::GetCountOf(m_Scene.instances);
+        allocateAccelerationStructureDesc.memoryLocation = nri::MemoryLocation::DEVICE;
+
+        nri::AccelerationStructure* accelerationStructure = nullptr;
+        NRI_ABORT_ON_FAILURE(NRI.AllocateAccelerationStructure(*m_Device, allocateAccelerationStructureDesc, accelerationStructure));
+        m_AccelerationStructures.push_back(accelerationStructure);
+
+        // Descriptor::World_AccelerationStructure
+        nri::Descriptor* descriptor = nullptr;
+        NRI.CreateAccelerationStructureDescriptor(*accelerationStructure, descriptor);
+        m_Descriptors.push_back(descriptor);
+    }
+
+    { // AccelerationStructure::TLAS_Emissive
+        nri::AllocateAccelerationStructureDesc allocateAccelerationStructureDesc = {};
+        allocateAccelerationStructureDesc.desc.type = nri::AccelerationStructureType::TOP_LEVEL;
+        allocateAccelerationStructureDesc.desc.flags = TLAS_BUILD_BITS;
+        allocateAccelerationStructureDesc.desc.instanceOrGeometryObjectNum = helper::GetCountOf(m_Scene.instances);
+        allocateAccelerationStructureDesc.memoryLocation = nri::MemoryLocation::DEVICE;
+
+        nri::AccelerationStructure* accelerationStructure = nullptr;
+        NRI_ABORT_ON_FAILURE(NRI.AllocateAccelerationStructure(*m_Device, allocateAccelerationStructureDesc, accelerationStructure));
+        m_AccelerationStructures.push_back(accelerationStructure);
+
+        // Descriptor::Light_AccelerationStructure
+        nri::Descriptor* descriptor = nullptr;
+        NRI.CreateAccelerationStructureDescriptor(*accelerationStructure, descriptor);
+        m_Descriptors.push_back(descriptor);
+    }
+
+    // Create BOTTOM_LEVEL acceleration structures for static geometry
+    const nri::DeviceDesc& deviceDesc = NRI.GetDeviceDesc(*m_Device);
+    uint64_t scratchSize = 0;
+
+    uint8_t* uploadData = (uint8_t*)NRI.MapBuffer(*uploadBuffer, 0, nri::WHOLE_SIZE);
+
+    for (uint32_t mode = (uint32_t)AccelerationStructure::BLAS_StaticOpaque; mode <= (uint32_t)AccelerationStructure::BLAS_StaticEmissive; mode++)
+    {
+        size_t geometryObjectBase = geometryObjects.size();
+
+        for (size_t i = m_ProxyInstancesNum; i < m_Scene.instances.size(); i++)
+        {
+            const utils::Instance& instance = m_Scene.instances[i];
+            const utils::Material& material = m_Scene.materials[instance.materialIndex];
+
+            if (material.IsOff())
+                continue;
+
+            if (instance.allowUpdate)
+                continue;
+
+            if (mode == (uint32_t)AccelerationStructure::BLAS_StaticOpaque)
+            {
+                if (material.IsTransparent())
+                    continue;
+
+                m_OpaqueObjectsNum++;
+            }
+            else if (mode == (uint32_t)AccelerationStructure::BLAS_StaticTransparent)
+            {
+                if (!material.IsTransparent())
+                    continue;
+
+                m_TransparentObjectsNum++;
+            }
+            else if (mode == (uint32_t)AccelerationStructure::BLAS_StaticEmissive)
+            {
+                if (!material.IsEmissive())
+                    continue;
+
+                m_EmissiveObjectsNum++;
+            }
+
+            const utils::MeshInstance& meshInstance = m_Scene.meshInstances[instance.meshInstanceIndex];
+            const utils::Mesh& mesh = m_Scene.meshes[meshInstance.meshIndex];
+
+            // Copy geometry to temp buffer
+            assert( !mesh.HasMorphTargets() );
+            uint64_t vertexDataSize = mesh.vertexNum * sizeof(float[3]);
+            uint64_t indexDataSize = mesh.indexNum * sizeof(utils::Index);
+
+            if (uploadData)
+            {
+                uint8_t* p = uploadData + geometryOffset;
+                for (uint32_t v = 0; v < mesh.vertexNum; v++)
+                {
+                    memcpy(p, m_Scene.vertices[mesh.vertexOffset + v].pos, sizeof(float[3]));
+                    p += sizeof(float[3]);
+                }
+
+                memcpy(p, &m_Scene.indices[mesh.indexOffset], indexDataSize);
+            }
+
+            // Copy transform to temp buffer
+            float4x4 mObjectToWorld = instance.rotation;
+            if (any(instance.scale != 1.0f))
+            {
+                float4x4 translation;
+                translation.SetupByTranslation( float3(instance.position) - mesh.aabb.GetCenter() );
+
+                float4x4 translationInv = translation;
+                translationInv.InvertOrtho();
+
+                float4x4 scale;
+                scale.SetupByScale(instance.scale);
+
+                mObjectToWorld = mObjectToWorld * translationInv * scale * translation;
+            }
+            mObjectToWorld.AddTranslation( float3(instance.position) );
+
+            mObjectToWorld.Transpose3x4();
+
+            uint64_t transformOffset = geometryObjects.size() * sizeof(float[12]);
+            if (uploadData)
+                memcpy(uploadData + transformOffset, mObjectToWorld.a, sizeof(float[12]));
+
+            // Add geometry object
+            nri::GeometryObject& geometryObject = geometryObjects.emplace_back();
+            geometryObject = {};
+            geometryObject.type = nri::GeometryType::TRIANGLES;
+            geometryObject.flags = material.IsAlphaOpaque() ? nri::BottomLevelGeometryBits::NONE : nri::BottomLevelGeometryBits::OPAQUE_GEOMETRY;
+            geometryObject.geometry.triangles.vertexBuffer = uploadBuffer;
+            geometryObject.geometry.triangles.vertexOffset = geometryOffset;
+            geometryObject.geometry.triangles.vertexNum = mesh.vertexNum;
+            geometryObject.geometry.triangles.vertexStride = sizeof(float[3]);
+            geometryObject.geometry.triangles.vertexFormat = nri::Format::RGB32_SFLOAT;
+            geometryObject.geometry.triangles.indexBuffer = uploadBuffer;
+            geometryObject.geometry.triangles.indexOffset = geometryOffset + vertexDataSize;
+            geometryObject.geometry.triangles.indexNum = mesh.indexNum;
+            geometryObject.geometry.triangles.indexType = sizeof(utils::Index) == 2 ? nri::IndexType::UINT16 : nri::IndexType::UINT32;
+            geometryObject.geometry.triangles.transformBuffer = uploadBuffer;
+            geometryObject.geometry.triangles.transformOffset = transformOffset;
+
+            // Update geometry offset
+            geometryOffset += vertexDataSize + helper::Align(indexDataSize, 4);
+            primitivesNum += mesh.indexNum / 3;
+        }
+
+        uint32_t geometryObjectsNum = (uint32_t)(geometryObjects.size() - geometryObjectBase);
+        if (geometryObjectsNum)
+        {
+            // Create BLAS
+            nri::AllocateAccelerationStructureDesc allocateAccelerationStructureDesc = {};
+            allocateAccelerationStructureDesc.desc.type = nri::AccelerationStructureType::BOTTOM_LEVEL;
+            allocateAccelerationStructureDesc.desc.flags = BLAS_RIGID_MESH_BUILD_BITS;
+            allocateAccelerationStructureDesc.desc.instanceOrGeometryObjectNum = geometryObjectsNum;
+            allocateAccelerationStructureDesc.desc.geometryObjects = &geometryObjects[geometryObjectBase];
+            allocateAccelerationStructureDesc.memoryLocation = nri::MemoryLocation::DEVICE;
+
+            nri::AccelerationStructure* accelerationStructure = nullptr;
+            NRI_ABORT_ON_FAILURE(NRI.AllocateAccelerationStructure(*m_Device, allocateAccelerationStructureDesc, accelerationStructure));
+            m_AccelerationStructures.push_back(accelerationStructure);
+
+            // Update parameters
+            parameters.push_back( {accelerationStructure, scratchSize, (uint32_t)geometryObjectBase, geometryObjectsNum, allocateAccelerationStructureDesc.desc.flags} );
+
+            uint64_t size = NRI.GetAccelerationStructureBuildScratchBufferSize(*accelerationStructure);
+            scratchSize += helper::Align(size, deviceDesc.scratchBufferOffsetAlignment);
+        }
+        else
+        {
+            // Needed only to preserve order
+            m_AccelerationStructures.push_back(nullptr);
+        }
+    }
+
+    // Create BOTTOM_LEVEL acceleration structures for dynamic geometry
+    for (uint32_t dynamicMeshInstanceIndex : dynamicMeshInstances)
+    {
+        utils::MeshInstance& meshInstance = m_Scene.meshInstances[dynamicMeshInstanceIndex];
+        const utils::Mesh& mesh = m_Scene.meshes[meshInstance.meshIndex];
+
+        meshInstance.blasIndex = (uint32_t)m_AccelerationStructures.size();
+
+        // Copy geometry to temp buffer
+        uint64_t vertexStride = mesh.HasMorphTargets() ? sizeof(float16_t4) : sizeof(float[3]);
+        uint64_t vertexDataSize = mesh.vertexNum * vertexStride;
+        uint64_t indexDataSize = mesh.indexNum * sizeof(utils::Index);
+
+        if (uploadData)
+        {
+            uint8_t* p = uploadData + geometryOffset;
+            for (uint32_t v = 0; v < mesh.vertexNum; v++)
+            {
+                if (mesh.HasMorphTargets())
+                    memcpy(p, &m_Scene.morphVertices[mesh.morphTargetVertexOffset + v].pos, vertexStride);
+                else
+                    memcpy(p, m_Scene.vertices[mesh.vertexOffset + v].pos, vertexStride);
+                p += vertexStride;
+            }
+
+            memcpy(p, &m_Scene.indices[mesh.indexOffset], indexDataSize);
+        }
+
+        // Add geometry object
+        nri::GeometryObject& geometryObject = geometryObjects.emplace_back();
+        geometryObject = {};
+        geometryObject.type = nri::GeometryType::TRIANGLES;
+        geometryObject.flags = nri::BottomLevelGeometryBits::NONE; // will be set in TLAS instance
+        geometryObject.geometry.triangles.vertexBuffer = uploadBuffer;
+        geometryObject.geometry.triangles.vertexOffset = geometryOffset;
+        geometryObject.geometry.triangles.vertexNum = mesh.vertexNum;
+        geometryObject.geometry.triangles.vertexStride = vertexStride;
+        geometryObject.geometry.triangles.vertexFormat = mesh.HasMorphTargets() ? nri::Format::RGBA16_SFLOAT : nri::Format::RGB32_SFLOAT;
+        geometryObject.geometry.triangles.indexBuffer = uploadBuffer;
+        geometryObject.geometry.triangles.indexOffset = geometryOffset + vertexDataSize;
+        geometryObject.geometry.triangles.indexNum = mesh.indexNum;
+        geometryObject.geometry.triangles.indexType = sizeof(utils::Index) == 2 ? nri::IndexType::UINT16 : nri::IndexType::UINT32;
+
+        // Create BLAS
+        nri::AllocateAccelerationStructureDesc allocateAccelerationStructureDesc = {};
+        allocateAccelerationStructureDesc.desc.type = nri::AccelerationStructureType::BOTTOM_LEVEL;
+        allocateAccelerationStructureDesc.desc.flags = mesh.HasMorphTargets() ? BLAS_DEFORMABLE_MESH_BUILD_BITS : BLAS_RIGID_MESH_BUILD_BITS;
+        allocateAccelerationStructureDesc.desc.instanceOrGeometryObjectNum = 1;
+        allocateAccelerationStructureDesc.desc.geometryObjects = &geometryObject;
+        allocateAccelerationStructureDesc.memoryLocation = nri::MemoryLocation::DEVICE;
+
+        nri::AccelerationStructure* accelerationStructure = nullptr;
+        NRI_ABORT_ON_FAILURE(NRI.AllocateAccelerationStructure(*m_Device, allocateAccelerationStructureDesc, accelerationStructure));
+        m_AccelerationStructures.push_back(accelerationStructure);
+
+        // Update parameters
+        parameters.push_back( {accelerationStructure, scratchSize, (uint32_t)(geometryObjects.size() - 1), 1, allocateAccelerationStructureDesc.desc.flags } );
+
+        uint64_t buildSize = NRI.GetAccelerationStructureBuildScratchBufferSize(*accelerationStructure);
+        scratchSize += helper::Align(buildSize, deviceDesc.scratchBufferOffsetAlignment);
+
+        if (mesh.HasMorphTargets())
+        {
+            uint64_t updateSize = NRI.GetAccelerationStructureUpdateScratchBufferSize(*accelerationStructure);
+            m_MorphMeshScratchSize += helper::Align(max(buildSize, updateSize), deviceDesc.scratchBufferOffsetAlignment);
+        }
+
+        // Update geometry offset
+        geometryOffset += vertexDataSize + helper::Align(indexDataSize, 4);
+        primitivesNum += mesh.indexNum / 3;
+    }
+
+    // Allocate scratch memory
+    nri::Buffer* scratchBuffer = nullptr;
+    {
+        nri::AllocateBufferDesc allocateBufferDesc = {};
+        allocateBufferDesc.desc = {scratchSize, 0, nri::BufferUsageBits::SCRATCH_BUFFER};
+        allocateBufferDesc.memoryLocation = nri::MemoryLocation::DEVICE;
+
+        NRI_ABORT_ON_FAILURE(NRI.AllocateBuffer(*m_Device, allocateBufferDesc, scratchBuffer));
+    }
+
+    // Create command allocator and command buffer
+    nri::CommandAllocator* commandAllocator = nullptr;
+    NRI.CreateCommandAllocator(*m_GraphicsQueue, commandAllocator);
+
+    nri::CommandBuffer* commandBuffer = nullptr;
+    NRI.CreateCommandBuffer(*commandAllocator, commandBuffer);
+
+    double stamp2 = m_Timer.GetTimeStamp();
+
+    // Record
+    NRI.BeginCommandBuffer(*commandBuffer, nullptr);
+    {
+        for (const Parameters& params : parameters)
+            NRI.CmdBuildBottomLevelAccelerationStructure(*commandBuffer, params.geometryObjectsNum, &geometryObjects[params.geometryObjectBase], params.buildBits, *params.accelerationStructure, *scratchBuffer, params.scratchOffset);
+    }
+    NRI.EndCommandBuffer(*commandBuffer);
+
+    // Submit
+    nri::QueueSubmitDesc queueSubmitDesc = {};
+    queueSubmitDesc.commandBuffers = &commandBuffer;
+    queueSubmitDesc.commandBufferNum = 1;
+
+    NRI.QueueSubmit(*m_GraphicsQueue, queueSubmitDesc);
+
+    // Wait idle
+    NRI.WaitForIdle(*m_GraphicsQueue);
+
+    double buildTime = m_Timer.GetTimeStamp() - stamp2;
+
+    // Cleanup
+    NRI.UnmapBuffer(*uploadBuffer);
+
+    NRI.DestroyBuffer(*scratchBuffer);
+    NRI.DestroyBuffer(*uploadBuffer);
+
+    NRI.DestroyCommandBuffer(*commandBuffer);
+    NRI.DestroyCommandAllocator(*commandAllocator);
+
+    double totalTime = m_Timer.GetTimeStamp() - stamp1;
+
+    printf(
+        "Scene stats:\n"
+        "  Instances     : %zu\n"
+        "  Meshes        : %zu\n"
+        "  Vertices      : %zu\n"
+        "  Primitives    : %zu\n"
+        "BVH stats:\n"
+        "  Total time    : %.2f ms\n"
+        "  Building time : %.2f ms\n"
+        "  Scratch size  : %.2f Mb\n"
+        "  BLAS num      : %zu\n"
+        "  Geometries    : %zu\n"
+        "  Primitives    : %zu\n"
+        , m_Scene.instances.size()
+        , m_Scene.meshes.size()
+        , m_Scene.primitives.size()
+        , m_Scene.vertices.size()
+        , totalTime
+        , buildTime
+        , scratchSize / (1024.0 * 1024.0)
+        , m_AccelerationStructures.size() - (size_t)AccelerationStructure::BLAS_StaticOpaque
+        , geometryObjects.size()
+        , primitivesNum
+   );
+}
+
+void Sample::CreateSamplers()
+{
+    nri::Descriptor* descriptor = nullptr;
+
+    { // Descriptor::LinearMipmapLinear_Sampler
+        nri::SamplerDesc samplerDesc = {};
+        samplerDesc.addressModes = {nri::AddressMode::REPEAT, nri::AddressMode::REPEAT};
+        samplerDesc.filters = {nri::Filter::LINEAR, nri::Filter::LINEAR, nri::Filter::LINEAR};
+        samplerDesc.mipMax = 16.0f;
+
+        NRI_ABORT_ON_FAILURE( NRI.CreateSampler(*m_Device, samplerDesc, descriptor) );
+        m_Descriptors.push_back(descriptor);
+    }
+
+    { // Descriptor::LinearMipmapNearest_Sampler
+        nri::SamplerDesc samplerDesc = {};
+        samplerDesc.addressModes = {nri::AddressMode::REPEAT, nri::AddressMode::REPEAT};
+        samplerDesc.filters = {nri::Filter::LINEAR, nri::Filter::LINEAR, nri::Filter::NEAREST};
+        samplerDesc.mipMax = 16.0f;
+
+        NRI_ABORT_ON_FAILURE( NRI.CreateSampler(*m_Device, samplerDesc, descriptor) );
+        m_Descriptors.push_back(descriptor);
+    }
+
+    { // Descriptor::NearestMipmapNearest_Sampler
+        nri::SamplerDesc samplerDesc = {};
+        samplerDesc.addressModes = {nri::AddressMode::REPEAT, nri::AddressMode::REPEAT};
+        samplerDesc.filters = {nri::Filter::NEAREST, nri::Filter::NEAREST, nri::Filter::NEAREST};
+        samplerDesc.mipMax = 16.0f;
+
+        NRI_ABORT_ON_FAILURE( NRI.CreateSampler(*m_Device, samplerDesc, descriptor) );
+        m_Descriptors.push_back(descriptor);
+    }
+}
+
+inline nri::Format ConvertFormatToTextureStorageCompatible(nri::Format format)
+{
+    switch (format)
+    {
+        case nri::Format::D16_UNORM:                return nri::Format::R16_UNORM;
+        case nri::Format::D24_UNORM_S8_UINT:        return nri::Format::R24_UNORM_X8;
+        case nri::Format::D32_SFLOAT:               return nri::Format::R32_SFLOAT;
+        case nri::Format::D32_SFLOAT_S8_UINT_X24:   return nri::Format::R32_SFLOAT_X8_X24;
+        case nri::Format::RGBA8_SRGB:               return nri::Format::RGBA8_UNORM;
+        case nri::Format::BGRA8_SRGB:               return nri::Format::BGRA8_UNORM;
+        default:                                    return format;
+    }
+}
+
+nri::Format Sample::GetGBufferFormat(Texture texture, GBufferProfile profile) const
+{
+    // Only textures affected by the profile are listed. Not valid encodings:
+    // - "Mv" can't be RG16 even for "MV_2D", because ".w" carries FP16 viewZ and TAA mask for "Taa" and "TraceTransparent"
+    // - R9_G9_B9_E5_UFLOAT can't be used for storage, R11_G11_B10_UFLOAT is used for colors instead
+    const bool isCompact = profile == GBufferProfile::BANDWIDTH_SAVER;
+
+    switch (texture)
+    {
+        case Texture::ViewZ:
+            // "viewZ * FP16_VIEWZ_SCALE", but "DlssBefore" stores depth for SR in the same texture
+            return (isCompact && m_DlssQuality == -1) ? nri::Format::R16_SFLOAT : nri::Format::R32_SFLOAT;
+        case Texture::DirectLighting:
+        case Texture::DirectEmission:
+        case Texture::ComposedDiff:
+            return (isCompact || USE_LOW_PRECISION_FP_FORMATS) ? nri::Format::R11_G11_B10_UFLOAT : nri::Format::RGBA16_SFLOAT;
+        case Texture::Composed:
+            // HDR radiance, TAA and upscalers don't need sign and alpha
+            return isCompact ? nri::Format::R11_G11_B10_UFLOAT : nri::Format::RGBA16_SFLOAT;
+        default:
+            return nri::Format::UNKNOWN;
+    }
+}
+
+void Sample::CreateResources(nri::Format swapChainFormat)
+{
+    const uint64_t instanceNum = m_Scene.instances.size() + MAX_ANIMATED_INSTANCE_NUM;
+    const uint64_t instanceDataSize = instanceNum * sizeof(InstanceData);
+    const uint64_t worldScratchBufferSize = NRI.GetAccelerationStructureBuildScratchBufferSize(*Get(AccelerationStructure::TLAS_World));
+    const uint64_t lightScratchBufferSize = NRI.GetAccelerationStructureBuildScratchBufferSize(*Get(AccelerationStructure::TLAS_Emissive));
+
+    std::vector<DescriptorDesc> descriptorDescs;
+
+    m_InstanceData.resize(instanceNum);
+    m_WorldTlasData.resize(instanceNum);
+    m_LightTlasData.resize(instanceNum);
+
+    // Buffers (DEVICE, read-only)
+    CreateBuffer(descriptorDescs, "Buffer::InstanceData", nri::Format::UNKNOWN, instanceDataSize / sizeof(InstanceData), sizeof(InstanceData),
+        nri::BufferUsageBits::SHADER_RESOURCE);
+    CreateBuffer(descriptorDescs, "Buffer::MorphMeshIndices", nri::Format::UNKNOWN, m_Scene.morphMeshTotalIndicesNum, sizeof(utils::Index),
+        nri::BufferUsageBits::SHADER_RESOURCE | nri::BufferUsageBits::ACCELERATION_STRUCTURE_BUILD_INPUT);
+    CreateBuffer(descriptorDescs, "Buffer::MorphMeshVertices", nri::Format::UNKNOWN, m_Scene.morphVertices.size(), sizeof(utils::MorphVertex),
+        nri::BufferUsageBits::SHADER_RESOURCE);
+
+    // Buffers (DEVICE)
+    CreateBuffer(descriptorDescs, "Buffer::MorphedPositions", nri::Format::UNKNOWN, m_Scene.morphedVerticesNum * MAX_ANIMATION_HISTORY_FRAME_NUM, sizeof(float16_t4),
         nri::BufferUsageBits::SHADER_RESOURCE | nri::BufferUsageBits::SHADER_RESOURCE_STORAGE | nri::BufferUsageBits::ACCELERATION_STRUCTURE_BUILD_INPUT);
     CreateBuffer(descriptorDescs, "Buffer::MorphedAttributes", nri::Format::UNKNOWN, m_Scene.morphedVerticesNum, sizeof(MorphedAttributes),
         nri::BufferUsageBits::SHADER_RESOURCE | nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
@@ -3241,660 +5867,2126 @@ void Sample::CreateResources(nri::Format swapChainFormat)
         nri::BufferUsageBits::SHADER_RESOURCE | nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
     CreateBuffer(descriptorDescs, "Buffer::PrimitiveData", nri::Format::UNKNOWN, m_Scene.totalInstancedPrimitivesNum, sizeof(PrimitiveData),
         nri::BufferUsageBits::SHADER_RESOURCE | nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
-    CreateBuffer(descriptorDescs, "Buffer::SharcHashEntries", nri::Format::UNKNOWN, SHARC_CAPACITY, sizeof(uint64_t),
+    CreateSharcBuffers(descriptorDescs);
+    CreateBuffer(descriptorDescs, "Buffer::SharcStats", nri::Format::UNKNOWN, SHARC_STATS_NUM, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateBuffer(descriptorDescs, "Buffer::SharcLiveBucketsPing", nri::Format::UNKNOWN, 1 + SHARC_CAPACITY_MAX / SHARC_BUCKET_SIZE, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateBuffer(descriptorDescs, "Buffer::SharcLiveBucketsPong", nri::Format::UNKNOWN, 1 + SHARC_CAPACITY_MAX / SHARC_BUCKET_SIZE, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateBuffer(descriptorDescs, "Buffer::SharcLiveArgsPing", nri::Format::UNKNOWN, 4, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE | nri::BufferUsageBits::ARGUMENT_BUFFER);
+    CreateBuffer(descriptorDescs, "Buffer::SharcLiveArgsPong", nri::Format::UNKNOWN, 4, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE | nri::BufferUsageBits::ARGUMENT_BUFFER);
+    CreateBuffer(descriptorDescs, "Buffer::SharcBucketMask", nri::Format::UNKNOWN, SHARC_CAPACITY_MAX / SHARC_BUCKET_SIZE / 32, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateBuffer(descriptorDescs, "Buffer::SharcHits", nri::Format::UNKNOWN, m_SharcHitsFile ? 1 + SHARC_HIT_RECORD_MAX_NUM * SHARC_HIT_RECORD_STRIDE : 1, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateBuffer(descriptorDescs, "Buffer::SharcUpdateLevels", nri::Format::UNKNOWN, SHARC_UPDATE_TILE_MAX_NUM, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateBuffer(descriptorDescs, "Buffer::TextureFeedback", nri::Format::UNKNOWN, std::max(helper::GetCountOf(m_Scene.materials) * TEXTURES_PER_MATERIAL, 1u), sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateBuffer(descriptorDescs, "Buffer::WavefrontArgsPing", nri::Format::UNKNOWN, 4, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE | nri::BufferUsageBits::ARGUMENT_BUFFER);
+    CreateBuffer(descriptorDescs, "Buffer::WavefrontArgsPong", nri::Format::UNKNOWN, 4, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE | nri::BufferUsageBits::ARGUMENT_BUFFER);
+    CreateBuffer(descriptorDescs, "Buffer::WavefrontShadowArgs", nri::Format::UNKNOWN, 4, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE | nri::BufferUsageBits::ARGUMENT_BUFFER);
+    CreateBuffer(descriptorDescs, "Buffer::WavefrontBins", nri::Format::UNKNOWN, WAVEFRONT_BIN_NUM, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateBuffer(descriptorDescs, "Buffer::WavefrontBinOffsets", nri::Format::UNKNOWN, WAVEFRONT_BIN_NUM, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateWavefrontBuffers(descriptorDescs);
+    CreateBuffer(descriptorDescs, "Buffer::WorldScratch", nri::Format::UNKNOWN, worldScratchBufferSize, 1,
+        nri::BufferUsageBits::SCRATCH_BUFFER);
+    CreateBuffer(descriptorDescs, "Buffer::LightScratch", nri::Format::UNKNOWN, lightScratchBufferSize, 1,
+        nri::BufferUsageBits::SCRATCH_BUFFER);
+    CreateBuffer(descriptorDescs, "Buffer::MorphMeshScratch", nri::Format::UNKNOWN, m_MorphMeshScratchSize, 1,
+        nri::BufferUsageBits::SCRATCH_BUFFER);
+
+    // Textures (DEVICE)
+    CreateRenderTargets(descriptorDescs, swapChainFormat);
+
+    CreateTexture(descriptorDescs, "Texture::NisData1", nri::Format::RGBA16_SFLOAT, kFilterSize / 4, kPhaseCount, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE, nri::AccessBits::UNKNOWN);
+    CreateTexture(descriptorDescs, "Texture::NisData2", nri::Format::RGBA16_SFLOAT, kFilterSize / 4, kPhaseCount, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE, nri::AccessBits::UNKNOWN);
+
+    for (uint32_t i = 0; i < (uint32_t)m_Scene.textures.size(); i++)
+    {
+        const uint32_t residentMip = m_TextureResidency.empty() ? 0 : m_TextureResidency[i].residentMip;
+        const nri::TextureDesc textureDesc = GetMaterialTextureDesc(i, residentMip);
+
+        CreateTexture(descriptorDescs, "", textureDesc.format, textureDesc.width, textureDesc.height, textureDesc.mipNum, textureDesc.layerNum, nri::TextureUsageBits::SHADER_RESOURCE, nri::AccessBits::UNKNOWN);
+    }
+
+    if (ALLOW_TRANSIENT_ALIASING)
+        BindTransientTextures();
+
+    if (ALLOW_PLACED_RESOURCES)
+    {
+        BindPlacedResources();
+        ReportPlacedHeaps();
+    }
+
+    // Create descriptors
+    {
+        nri::Descriptor* descriptor = nullptr;
+
+        const nri::DeviceDesc& deviceDesc = NRI.GetDeviceDesc(*m_Device);
+
+        nri::BufferViewDesc constantBufferViewDesc = {};
+        constantBufferViewDesc.viewType = nri::BufferViewType::CONSTANT;
+        constantBufferViewDesc.buffer = NRI.GetStreamerConstantBuffer(*m_Streamer);
+
+        constantBufferViewDesc.size = helper::Align(sizeof(GlobalConstants), deviceDesc.constantBufferOffsetAlignment);
+        NRI_ABORT_ON_FAILURE(NRI.CreateBufferView(constantBufferViewDesc, descriptor));
+        m_Descriptors.push_back(descriptor);
+
+        constantBufferViewDesc.size = helper::Align(sizeof(MorphMeshUpdateVerticesConstants), deviceDesc.constantBufferOffsetAlignment);
+        NRI_ABORT_ON_FAILURE(NRI.CreateBufferView(constantBufferViewDesc, descriptor));
+        m_Descriptors.push_back(descriptor);
+
+        constantBufferViewDesc.size = helper::Align(sizeof(MorphMeshUpdatePrimitivesConstants), deviceDesc.constantBufferOffsetAlignment);
+        NRI_ABORT_ON_FAILURE(NRI.CreateBufferView(constantBufferViewDesc, descriptor));
+        m_Descriptors.push_back(descriptor);
+
+        constantBufferViewDesc.size = helper::Align(sizeof(WavefrontConstants), deviceDesc.constantBufferOffsetAlignment);
+        NRI_ABORT_ON_FAILURE(NRI.CreateBufferView(constantBufferViewDesc, descriptor));
+        m_Descriptors.push_back(descriptor);
+    }
+
+    CreateViews(descriptorDescs);
+}
+
+void Sample::CreateRenderTargets(std::vector<DescriptorDesc>& descriptorDescs, nri::Format swapChainFormat)
+{
+    // Resolution dependent textures precede static textures ("NisData" and materials), they get recreated in "ChangeOutputResolution"
+
+    // TODO: DLSS doesn't support R16 UNORM/SNORM
+    nri::Format dataFormat = nri::Format::RGBA16_SFLOAT;
+    if (m_NrdMode == OCCLUSION)
+        dataFormat = m_DlssQuality != -1 ? nri::Format::R16_SFLOAT : nri::Format::R16_UNORM;
+    else if (m_NrdMode == DIRECTIONAL_OCCLUSION)
+        dataFormat = m_DlssQuality != -1 ? nri::Format::RGBA16_SFLOAT : nri::Format::RGBA16_SNORM;
+
+#if( NRD_NORMAL_ENCODING == 0 )
+    const nri::Format normalFormat = nri::Format::RGBA8_UNORM;
+#elif( NRD_NORMAL_ENCODING == 1 )
+    const nri::Format normalFormat = nri::Format::RGBA8_SNORM;
+#elif( NRD_NORMAL_ENCODING == 2 )
+    const nri::Format normalFormat = nri::Format::R10_G10_B10_A2_UNORM;
+#elif( NRD_NORMAL_ENCODING == 3 )
+    const nri::Format normalFormat = nri::Format::RGBA16_UNORM;
+#elif( NRD_NORMAL_ENCODING == 4 )
+    const nri::Format normalFormat = nri::Format::RGBA16_SFLOAT; // TODO: RGBA16_SNORM can't be used, because NGX doesn't support it
+#endif
+
+    const nri::Format taaFormat = nri::Format::RGBA16_SFLOAT; // required for new TAA even in LDR mode (RGBA16_UNORM can't be used)
+    const nri::Format criticalColorFormat = nri::Format::RGBA16_SFLOAT; // TODO: R9_G9_B9_E5_UFLOAT?
+    const nri::Format shadowFormat = SIGMA_TRANSLUCENT ? nri::Format::RGBA8_UNORM : nri::Format::R8_UNORM;
+
+    const uint16_t w = (uint16_t)m_RenderResolution.x;
+    const uint16_t h = (uint16_t)m_RenderResolution.y;
+
+    m_ViewZScale = GetGBufferFormat(Texture::ViewZ, m_GBufferProfile) == nri::Format::R16_SFLOAT ? FP16_VIEWZ_SCALE : 1.0f;
+
+    m_OptionalTextureDescs.resize(helper::GetCountOf(optionalTextures));
+
+    CreateTexture(descriptorDescs, "Texture::ViewZ", GetGBufferFormat(Texture::ViewZ, m_GBufferProfile), w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::Mv", nri::Format::RGBA16_SFLOAT, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::Normal_Roughness", normalFormat, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::PsrThroughput", nri::Format::R10_G10_B10_A2_UNORM, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::BaseColor_Metalness", nri::Format::RGBA8_SRGB, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::DirectLighting", GetGBufferFormat(Texture::DirectLighting, m_GBufferProfile), w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::DirectEmission", GetGBufferFormat(Texture::DirectEmission, m_GBufferProfile), w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::Shadow", shadowFormat, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::Diff", dataFormat, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::Spec", dataFormat, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::Unfiltered_Penumbra", nri::Format::R16_SFLOAT, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::Unfiltered_Diff", dataFormat, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::Unfiltered_Spec", dataFormat, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::Unfiltered_Translucency", shadowFormat, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::Validation", nri::Format::RGBA8_UNORM, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::Composed", GetGBufferFormat(Texture::Composed, m_GBufferProfile), w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
+    CreateTexture(descriptorDescs, "Texture::ComposedDiff", GetGBufferFormat(Texture::ComposedDiff, m_GBufferProfile), w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
+    CreateTexture(descriptorDescs, "Texture::ComposedSpec_ViewZ", nri::Format::RGBA16_SFLOAT, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
+    CreateTexture(descriptorDescs, "Texture::TaaHistory", taaFormat, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::TaaHistoryPrev", taaFormat, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
+
+    // Created on demand, if DLSS is enabled
+    CreateTexture(descriptorDescs, "Texture::RRGuide_DiffAlbedo", nri::Format::R10_G10_B10_A2_UNORM, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
+    CreateTexture(descriptorDescs, "Texture::RRGuide_SpecAlbedo", nri::Format::R10_G10_B10_A2_UNORM, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
+    CreateTexture(descriptorDescs, "Texture::RRGuide_SpecHitDistance", nri::Format::R16_SFLOAT, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
+    CreateTexture(descriptorDescs, "Texture::RRGuide_Normal_Roughness", nri::Format::RGBA16_SFLOAT, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
+    CreateTexture(descriptorDescs, "Texture::DlssOutput", criticalColorFormat, (uint16_t)m_OutputResolution.x, (uint16_t)m_OutputResolution.y, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
+
+    CreateTexture(descriptorDescs, "Texture::PreFinal", criticalColorFormat, (uint16_t)m_OutputResolution.x, (uint16_t)m_OutputResolution.y, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
+    CreateTexture(descriptorDescs, "Texture::Final", swapChainFormat, (uint16_t)GetWindowResolution().x, (uint16_t)GetWindowResolution().y, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::COPY_SOURCE);
+
+    // Created on demand, if NRD mode is "SH"
+    CreateTexture(descriptorDescs, "Texture::Unfiltered_DiffSh", dataFormat, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::Unfiltered_SpecSh", dataFormat, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::DiffSh", dataFormat, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+    CreateTexture(descriptorDescs, "Texture::SpecSh", dataFormat, w, h, 1, 1,
+        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
+}
+
+void Sample::CreateViews(const std::vector<DescriptorDesc>& descriptorDescs)
+{
+    nri::Descriptor* descriptor = nullptr;
+
+    for (const DescriptorDesc& desc : descriptorDescs)
+    {
+        if (desc.textureUsage == nri::TextureUsageBits::NONE)
+        {
+            if (desc.bufferUsage == nri::BufferUsageBits::CONSTANT_BUFFER)
+            {
+                // Constant buffer views are not stored in m_Descriptors
+            }
+            else
+            {
+                NRI.SetDebugName((nri::Object*)desc.resource, desc.debugName);
+
+                if (desc.bufferUsage & nri::BufferUsageBits::SHADER_RESOURCE)
+                {
+                    const nri::BufferViewDesc viewDesc = { (nri::Buffer*)desc.resource, nri::BufferViewType::SHADER_RESOURCE, desc.format };
+                    NRI_ABORT_ON_FAILURE(NRI.CreateBufferView(viewDesc, descriptor));
+                    m_Descriptors.push_back(descriptor);
+                }
+                if (desc.bufferUsage & nri::BufferUsageBits::SHADER_RESOURCE_STORAGE)
+                {
+                    const nri::BufferViewDesc viewDesc = { (nri::Buffer*)desc.resource, nri::BufferViewType::SHADER_RESOURCE_STORAGE, desc.format };
+                    NRI_ABORT_ON_FAILURE(NRI.CreateBufferView(viewDesc, descriptor));
+                    m_Descriptors.push_back(descriptor);
+                }
+            }
+        }
+        else if (!desc.resource)
+        {
+            // Optional textures get views in "UpdateOptionalTextures"
+            m_Descriptors.push_back(nullptr);
+
+            if (desc.textureUsage & nri::TextureUsageBits::SHADER_RESOURCE_STORAGE)
+                m_Descriptors.push_back(nullptr);
+        }
+        else
+        {
+            NRI.SetDebugName((nri::Object*)desc.resource, desc.debugName);
+
+            nri::Texture2DViewDesc viewDesc = {(nri::Texture*)desc.resource, desc.isArray ? nri::Texture2DViewType::SHADER_RESOURCE_2D_ARRAY : nri::Texture2DViewType::SHADER_RESOURCE_2D, desc.format};
+            NRI_ABORT_ON_FAILURE(NRI.CreateTexture2DView(viewDesc, descriptor));
+            m_Descriptors.push_back(descriptor);
+
+            if (desc.textureUsage & nri::TextureUsageBits::SHADER_RESOURCE_STORAGE)
+            {
+                viewDesc.format = ConvertFormatToTextureStorageCompatible(desc.format);
+                viewDesc.viewType = desc.isArray ? nri::Texture2DViewType::SHADER_RESOURCE_STORAGE_2D_ARRAY : nri::Texture2DViewType::SHADER_RESOURCE_STORAGE_2D;
+                NRI_ABORT_ON_FAILURE(NRI.CreateTexture2DView(viewDesc, descriptor));
+                m_Descriptors.push_back(descriptor);
+            }
+        }
+    }
+}
+
+void Sample::ChangeOutputResolution(const uint2& outputResolution)
+{
+    NRI.WaitForIdle(*m_GraphicsQueue);
+
+    m_OutputResolution = outputResolution;
+    m_PendingOutputResolution = outputResolution;
+
+    printf("Output resolution (%u, %u)\n", m_OutputResolution.x, m_OutputResolution.y);
+
+    // DLSS and NRD, keep user choices
+    const bool SR = m_Settings.SR;
+    const bool RR = m_Settings.RR;
+
+    m_DLSS.Shutdown();
+    m_NRD.Destroy();
+
+    InitializeDlss();
+    InitializeNrd();
+
+    m_Settings.SR = SR && m_DLSS.HasSR();
+    m_Settings.RR = RR && m_DLSS.HasRR();
+    m_Settings.resolutionScale = std::max(m_Settings.resolutionScale, m_MinResolutionScale);
+
+    // Destroy resolution dependent textures and their views
+    const nri::Format swapChainFormat = NRI.GetTextureDesc(*Get(Texture::Final)).format;
+    const uint32_t textureNum = (uint32_t)Texture::NisData1;
+    const uint32_t descriptorOffset = (uint32_t)Descriptor::ViewZ_Texture;
+    const uint32_t descriptorNum = (uint32_t)Descriptor::NisData1 - descriptorOffset;
+
+    for (uint32_t i = 0; i < textureNum; i++)
+    {
+        if (m_Textures[i])
+        {
+            ReleasePlacedResource(m_Textures[i]);
+            NRI.DestroyTexture(*m_Textures[i]);
+        }
+    }
+
+    for (uint32_t i = descriptorOffset; i < descriptorOffset + descriptorNum; i++)
+    {
+        if (m_Descriptors[i])
+            NRI.DestroyDescriptor(*m_Descriptors[i]);
+    }
+
+    for (const TransientHeap& transientHeap : m_TransientHeaps)
+    {
+        if (transientHeap.memory)
+            NRI.FreeMemory(*transientHeap.memory);
+    }
+
+    m_TransientHeaps.clear();
+    m_TransientHeapIndices.clear();
+    m_AliasedTextures.clear();
+
+    DefragmentPlacedHeaps();
+
+    // Recreate them in place, static textures and views follow
+    std::vector<nri::Texture*> staticTextures(m_Textures.begin() + textureNum, m_Textures.end());
+    std::vector<nri::Descriptor*> staticDescriptors(m_Descriptors.begin() + descriptorOffset + descriptorNum, m_Descriptors.end());
+
+    m_Textures.clear();
+    m_TextureStates.clear();
+    m_Descriptors.resize(descriptorOffset);
+
+    std::vector<DescriptorDesc> descriptorDescs;
+    CreateRenderTargets(descriptorDescs, swapChainFormat);
+
+    if (ALLOW_TRANSIENT_ALIASING)
+        BindTransientTextures();
+
+    if (ALLOW_PLACED_RESOURCES)
+    {
+        BindPlacedResources();
+        ReportPlacedHeaps();
+    }
+
+    CreateViews(descriptorDescs);
+
+    // Record initial states of recreated textures (as "UploadStaticData" does), since render passes transition from them
+    std::vector<nri::TextureUploadDesc> textureUploadDescs;
+    for (const nri::TextureBarrierDesc& state : m_TextureStates)
+    {
+        if (!state.texture)
+            continue; // optional, created in "UpdateOptionalTextures"
+
+        nri::TextureUploadDesc desc = {};
+        desc.after = {state.after.access, state.after.layout};
+        desc.texture = (nri::Texture*)state.texture;
+
+        textureUploadDescs.push_back(desc);
+    }
+
+    NRI_ABORT_ON_FAILURE(NRI.UploadData(*m_GraphicsQueue, textureUploadDescs.data(), helper::GetCountOf(textureUploadDescs), nullptr, 0));
+
+    m_Textures.insert(m_Textures.end(), staticTextures.begin(), staticTextures.end());
+    m_Descriptors.insert(m_Descriptors.end(), staticDescriptors.begin(), staticDescriptors.end());
+
+    // Descriptor sets reference destroyed views. Optional textures are created and patched into sets in "UpdateOptionalTextures"
+    NRI.ResetDescriptorPool(*m_DescriptorPool);
+    m_DescriptorSets.clear();
+    CreateDescriptorSets();
+
+    m_ForceHistoryReset = true;
+    m_IsGBufferProfileReported = false;
+    m_DynamicResolution.smoothedGpuFrameTime = 0.0;
+
+    nri::VideoMemoryInfo videoMemoryInfo = {};
+    NRI.QueryVideoMemoryInfo(*m_Device, nri::MemoryLocation::DEVICE, videoMemoryInfo);
+    printf("Allocated %.2f Mb\n", videoMemoryInfo.usageSize / (1024.0f * 1024.0f));
+}
+
+void Sample::ChangeNrdMode(int32_t nrdMode, bool nrdCombined)
+{
+    m_NrdMode = nrdMode;
+    m_NrdCombined = nrdCombined;
+    m_PendingNrdMode = nrdMode;
+    m_PendingNrdCombined = nrdCombined;
+
+    printf("NRD mode: %s%s\n", nrdModeNames[m_NrdMode], m_NrdCombined ? " (combined)" : "");
+
+    // The mode affects the NRD instance, DLSS HDR flag, data formats and SH textures: reuse the output resolution path
+    ChangeOutputResolution(m_OutputResolution);
+
+    // All shaders are mode specific
+    CreatePipelines();
+
+    // Settings and on-screen modes differ between modes
+    m_ReblurSettings = GetDefaultReblurSettings();
+    m_RelaxSettings = GetDefaultRelaxSettings();
+    m_Settings.onScreen = 0;
+}
+
+void Sample::CreateSharcBuffers(std::vector<DescriptorDesc>& descriptorDescs)
+{
+    CreateBuffer(descriptorDescs, "Buffer::SharcHashEntries", nri::Format::UNKNOWN, m_SharcCapacity, sizeof(uint64_t),
         nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
-    CreateBuffer(descriptorDescs, "Buffer::SharcHashCopyOffset", nri::Format::UNKNOWN, SHARC_CAPACITY, sizeof(uint32_t),
+    CreateBuffer(descriptorDescs, "Buffer::SharcHashCopyOffset", nri::Format::UNKNOWN, m_SharcCapacity, sizeof(uint32_t),
         nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
-    CreateBuffer(descriptorDescs, "Buffer::SharcVoxelDataPing", nri::Format::UNKNOWN, SHARC_CAPACITY, sizeof(uint32_t) * 4,
+    CreateBuffer(descriptorDescs, "Buffer::SharcVoxelDataPing", nri::Format::UNKNOWN, m_SharcCapacity, sizeof(uint32_t) * 4,
         nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
-    CreateBuffer(descriptorDescs, "Buffer::SharcVoxelDataPong", nri::Format::UNKNOWN, SHARC_CAPACITY, sizeof(uint32_t) * 4,
+    CreateBuffer(descriptorDescs, "Buffer::SharcVoxelDataPong", nri::Format::UNKNOWN, m_SharcCapacity, sizeof(uint32_t) * 4,
         nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
-    CreateBuffer(descriptorDescs, "Buffer::WorldScratch", nri::Format::UNKNOWN, worldScratchBufferSize, 1,
-        nri::BufferUsageBits::SCRATCH_BUFFER);
-    CreateBuffer(descriptorDescs, "Buffer::LightScratch", nri::Format::UNKNOWN, lightScratchBufferSize, 1,
-        nri::BufferUsageBits::SCRATCH_BUFFER);
-    CreateBuffer(descriptorDescs, "Buffer::MorphMeshScratch", nri::Format::UNKNOWN, m_MorphMeshScratchSize, 1,
-        nri::BufferUsageBits::SCRATCH_BUFFER);
+}
+
+void Sample::ChangeSharcCapacity(uint32_t capacity)
+{
+    NRI.WaitForIdle(*m_GraphicsQueue);
+
+    printf("SHARC capacity: %u -> %u entries (%.1f%% occupied)\n", m_SharcCapacity, capacity, 100.0f * m_SharcOccupancy / m_SharcCapacity);
+
+    m_SharcCapacity = capacity;
+    m_PendingSharcCapacity = capacity;
+
+    // Destroy hash table buffers and their views (hashes depend on the capacity, i.e. contents can't be preserved)
+    const uint32_t bufferOffset = (uint32_t)Buffer::SharcHashEntries;
+    const uint32_t descriptorOffset = (uint32_t)Descriptor::SharcHashEntries_StorageBuffer;
+
+    for (uint32_t i = 0; i < SHARC_BUFFER_NUM; i++)
+    {
+        ReleasePlacedResource(m_Buffers[bufferOffset + i]);
+        NRI.DestroyBuffer(*m_Buffers[bufferOffset + i]);
+        NRI.DestroyDescriptor(*m_Descriptors[descriptorOffset + i]);
+    }
+
+    DefragmentPlacedHeaps();
+
+    // Recreate them in place, other buffers and views follow
+    std::vector<nri::Buffer*> otherBuffers(m_Buffers.begin() + bufferOffset + SHARC_BUFFER_NUM, m_Buffers.end());
+    std::vector<nri::Descriptor*> otherDescriptors(m_Descriptors.begin() + descriptorOffset + SHARC_BUFFER_NUM, m_Descriptors.end());
+
+    m_Buffers.resize(bufferOffset);
+    m_Descriptors.resize(descriptorOffset);
+
+    std::vector<DescriptorDesc> descriptorDescs;
+    CreateSharcBuffers(descriptorDescs);
+
+    if (ALLOW_PLACED_RESOURCES)
+        BindPlacedResources();
+
+    CreateViews(descriptorDescs);
+
+    m_Buffers.insert(m_Buffers.end(), otherBuffers.begin(), otherBuffers.end());
+    m_Descriptors.insert(m_Descriptors.end(), otherDescriptors.begin(), otherDescriptors.end());
+
+    // Descriptor sets are not in flight after "WaitForIdle", thus can be patched in place
+    UpdateSharcDescriptorSets();
+
+    m_SharcOccupancy = 0;
+    m_SharcLowLoadFrameNum = 0;
+    m_IsSharcResetPending = true;
+}
+
+void Sample::CreateWavefrontBuffers(std::vector<DescriptorDesc>& descriptorDescs)
+{
+    // A path per pixel is in flight, queues store the counter in the first element
+    const uint32_t pixelNum = std::max(m_WavefrontPixelNum, 1u);
+
+    CreateBuffer(descriptorDescs, "Buffer::WavefrontPixels", nri::Format::UNKNOWN, pixelNum, sizeof(WavefrontPixel),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateBuffer(descriptorDescs, "Buffer::WavefrontPaths", nri::Format::UNKNOWN, pixelNum, sizeof(WavefrontPath),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateBuffer(descriptorDescs, "Buffer::WavefrontQueuePing", nri::Format::UNKNOWN, 1 + pixelNum, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateBuffer(descriptorDescs, "Buffer::WavefrontQueuePong", nri::Format::UNKNOWN, 1 + pixelNum, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateBuffer(descriptorDescs, "Buffer::WavefrontShadowQueue", nri::Format::UNKNOWN, 1 + pixelNum, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+    CreateBuffer(descriptorDescs, "Buffer::WavefrontSortedQueue", nri::Format::UNKNOWN, pixelNum, sizeof(uint32_t),
+        nri::BufferUsageBits::SHADER_RESOURCE_STORAGE);
+}
+
+void Sample::ChangeWavefrontCapacity(uint32_t pixelNum)
+{
+    NRI.WaitForIdle(*m_GraphicsQueue);
+
+    const double bytesPerPixel = double(sizeof(WavefrontPixel) + sizeof(WavefrontPath) + 4 * sizeof(uint32_t));
+    printf("Wavefront: %u pixels (%.1f Mb)\n", pixelNum, double(pixelNum) * bytesPerPixel / (1024.0 * 1024.0));
+
+    m_WavefrontPixelNum = pixelNum;
+
+    // Destroy per pixel buffers and their views (not allocated if the megakernel is used)
+    const uint32_t bufferOffset = (uint32_t)Buffer::WavefrontPixels;
+    const uint32_t descriptorOffset = (uint32_t)Descriptor::WavefrontPixels_StorageBuffer;
+
+    for (uint32_t i = 0; i < WAVEFRONT_BUFFER_NUM; i++)
+    {
+        ReleasePlacedResource(m_Buffers[bufferOffset + i]);
+        NRI.DestroyBuffer(*m_Buffers[bufferOffset + i]);
+        NRI.DestroyDescriptor(*m_Descriptors[descriptorOffset + i]);
+    }
+
+    DefragmentPlacedHeaps();
+
+    // Recreate them in place, other buffers and views follow
+    std::vector<nri::Buffer*> otherBuffers(m_Buffers.begin() + bufferOffset + WAVEFRONT_BUFFER_NUM, m_Buffers.end());
+    std::vector<nri::Descriptor*> otherDescriptors(m_Descriptors.begin() + descriptorOffset + WAVEFRONT_BUFFER_NUM, m_Descriptors.end());
+
+    m_Buffers.resize(bufferOffset);
+    m_Descriptors.resize(descriptorOffset);
+
+    std::vector<DescriptorDesc> descriptorDescs;
+    CreateWavefrontBuffers(descriptorDescs);
+
+    if (ALLOW_PLACED_RESOURCES)
+        BindPlacedResources();
+
+    CreateViews(descriptorDescs);
+
+    m_Buffers.insert(m_Buffers.end(), otherBuffers.begin(), otherBuffers.end());
+    m_Descriptors.insert(m_Descriptors.end(), otherDescriptors.begin(), otherDescriptors.end());
+
+    // Descriptor sets are not in flight after "WaitForIdle", thus can be patched in place
+    UpdateWavefrontDescriptorSets();
+}
+
+std::string Sample::GetSharcCachePath(uint32_t capacity) const
+{
+    std::string sceneName = std::string( utils::GetFileName(m_SceneFile) );
+    size_t dotPos = sceneName.find_last_of(".");
+    if (dotPos != std::string::npos)
+        sceneName = sceneName.substr(0, dotPos);
+
+    return m_SharcCacheFolder + "/" + sceneName + "_" + std::to_string(capacity / 1024) + "K.sharc";
+}
+
+uint64_t HashSharcScene(const std::string& sceneFile)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (char c : sceneFile)
+        hash = (hash ^ (uint8_t)c) * 0x100000001B3ull;
+
+    return hash;
+}
+
+void Sample::CopySharcCache(nri::CommandBuffer& commandBuffer, bool isEven)
+{
+    // Hash entries and voxel data resolved in this frame (the other voxel data buffer gets cleared in the next frame)
+    nri::Buffer* voxelData = Get(isEven ? Buffer::SharcVoxelDataPing : Buffer::SharcVoxelDataPong);
+    const uint64_t hashEntriesSize = uint64_t(m_SharcCapacity) * sizeof(uint64_t);
+    const uint64_t voxelDataSize = uint64_t(m_SharcCapacity) * sizeof(uint32_t) * 4;
+
+    if (m_SharcCacheReadbackBuffer)
+        NRI.DestroyBuffer(*m_SharcCacheReadbackBuffer);
+
+    nri::AllocateBufferDesc allocateBufferDesc = {};
+    allocateBufferDesc.desc.size = hashEntriesSize + voxelDataSize;
+    allocateBufferDesc.memoryLocation = nri::MemoryLocation::HOST_READBACK;
+
+    NRI_ABORT_ON_FAILURE(NRI.AllocateBuffer(*m_Device, allocateBufferDesc, m_SharcCacheReadbackBuffer));
+    NRI.SetDebugName(m_SharcCacheReadbackBuffer, "Buffer::SharcCacheReadback");
+
+    m_SharcCacheCapacity = m_SharcCapacity;
+
+    nri::BufferBarrierDesc transitions[] = {
+        {Get(Buffer::SharcHashEntries), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_SOURCE}},
+        {voxelData, {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_SOURCE}},
+    };
+
+    nri::BarrierGroupDesc barrierGroupDesc = {};
+    barrierGroupDesc.buffers = transitions;
+    barrierGroupDesc.bufferNum = (uint16_t)helper::GetCountOf(transitions);
+
+    NRI.CmdBarrier(commandBuffer, barrierGroupDesc);
+    NRI.CmdCopyBuffer(commandBuffer, *m_SharcCacheReadbackBuffer, 0, *Get(Buffer::SharcHashEntries), 0, hashEntriesSize);
+    NRI.CmdCopyBuffer(commandBuffer, *m_SharcCacheReadbackBuffer, hashEntriesSize, *voxelData, 0, voxelDataSize);
+
+    for (nri::BufferBarrierDesc& transition : transitions)
+        std::swap(transition.before, transition.after);
+
+    NRI.CmdBarrier(commandBuffer, barrierGroupDesc);
+}
+
+void Sample::SaveSharcCache()
+{
+    const uint64_t dataSize = uint64_t(m_SharcCacheCapacity) * (sizeof(uint64_t) + sizeof(uint32_t) * 4);
+    const void* data = NRI.MapBuffer(*m_SharcCacheReadbackBuffer, 0, nri::WHOLE_SIZE);
+
+    if (data)
+    {
+        std::error_code errorCode;
+        std::filesystem::create_directories(m_SharcCacheFolder, errorCode);
+
+        const std::string path = GetSharcCachePath(m_SharcCacheCapacity);
+        const std::string tempPath = path + ".tmp";
+
+        SharcCacheHeader header = {};
+        header.magic = SHARC_CACHE_MAGIC;
+        header.version = SHARC_CACHE_VERSION;
+        header.capacity = m_SharcCacheCapacity;
+        header.sceneScale = SHARC_SCENE_SCALE;
+        header.logarithmBase = SharcCpu::GRID_LOGARITHM_BASE;
+        header.levelBias = SharcCpu::GRID_LEVEL_BIAS;
+        header.lodLevelMax = SHARC_LOD_LEVEL_MAX;
+        header.hashKeyLayoutVersion = SharcCpu::HASH_KEY_LAYOUT_VERSION;
+        header.sceneHash = HashSharcScene(m_SceneFile);
+
+        // Written to a temporary file first, an interrupted save must not leave a broken cache
+        bool result = false;
+        FILE* fp = fopen(tempPath.c_str(), "wb");
+        if (fp)
+        {
+            result = fwrite(&header, sizeof(header), 1, fp) == 1;
+            result = result && fwrite(data, dataSize, 1, fp) == 1;
+            result = fclose(fp) == 0 && result;
+        }
+
+        if (result)
+            std::filesystem::rename(tempPath, path, errorCode);
+        else
+            std::filesystem::remove(tempPath, errorCode);
+
+        printf("SHARC cache: %s '%s' (%u entries, %u occupied)\n", result && !errorCode ? "saved" : "failed to save", path.c_str(), m_SharcCacheCapacity, m_SharcOccupancy);
+
+        NRI.UnmapBuffer(*m_SharcCacheReadbackBuffer);
+    }
+
+    NRI.DestroyBuffer(*m_SharcCacheReadbackBuffer);
+    m_SharcCacheReadbackBuffer = nullptr;
+}
+
+bool Sample::LoadSharcCache(uint32_t frameIndex)
+{
+    // The current capacity is preferred, an adaptive table switches to a capacity with a cache
+    uint32_t capacity = m_SharcCapacity;
+    if (m_IsSharcAdaptive && !std::filesystem::exists(GetSharcCachePath(capacity)))
+    {
+        for (uint32_t c = SHARC_CAPACITY_MIN; c <= SHARC_CAPACITY_MAX; c <<= 1)
+        {
+            if (std::filesystem::exists(GetSharcCachePath(c)))
+            {
+                capacity = c;
+                break;
+            }
+        }
+    }
+
+    const std::string path = GetSharcCachePath(capacity);
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp)
+    {
+        printf("SHARC cache: '%s' not found\n", path.c_str());
+        return false;
+    }
+
+    std::vector<uint64_t> hashEntries(capacity);
+    std::vector<uint32_t> voxelData(size_t(capacity) * 4);
+
+    SharcCacheHeader header = {};
+    bool isValid = fread(&header, sizeof(header), 1, fp) == 1;
+    isValid = isValid && header.magic == SHARC_CACHE_MAGIC && header.version == SHARC_CACHE_VERSION;
+    isValid = isValid && header.capacity == capacity && header.sceneScale == SHARC_SCENE_SCALE && header.sceneHash == HashSharcScene(m_SceneFile);
+    isValid = isValid && header.logarithmBase == SharcCpu::GRID_LOGARITHM_BASE && header.levelBias == SharcCpu::GRID_LEVEL_BIAS;
+    isValid = isValid && header.lodLevelMax == SHARC_LOD_LEVEL_MAX && header.hashKeyLayoutVersion == SharcCpu::HASH_KEY_LAYOUT_VERSION;
+    isValid = isValid && fread(hashEntries.data(), helper::GetByteSizeOf(hashEntries), 1, fp) == 1;
+    isValid = isValid && fread(voxelData.data(), helper::GetByteSizeOf(voxelData), 1, fp) == 1;
+    fclose(fp);
+
+    if (!isValid)
+    {
+        printf("SHARC cache: '%s' is incompatible or corrupted\n", path.c_str());
+        return false;
+    }
+
+    if (capacity != m_SharcCapacity)
+        ChangeSharcCapacity(capacity);
+
+    // Live buckets (see "SharcCompact"): occupied buckets are listed, voxel data of empty buckets must be zero
+    const uint32_t bucketNum = capacity / SHARC_BUCKET_SIZE;
+    std::vector<uint32_t> liveBuckets(1, 0);
+    std::vector<uint32_t> bucketMask(SHARC_CAPACITY_MAX / SHARC_BUCKET_SIZE / 32, 0);
+
+    uint32_t occupiedNum = 0;
+    for (uint32_t bucket = 0; bucket < bucketNum; bucket++)
+    {
+        uint32_t bucketOccupiedNum = 0;
+        for (uint32_t i = 0; i < SHARC_BUCKET_SIZE; i++)
+            bucketOccupiedNum += hashEntries[bucket * SHARC_BUCKET_SIZE + i] != SharcCpu::INVALID_HASH_KEY ? 1 : 0;
+
+        if (bucketOccupiedNum)
+        {
+            liveBuckets.push_back(bucket);
+            bucketMask[bucket / 32] |= 1u << (bucket % 32);
+        }
+        else
+            memset(&voxelData[size_t(bucket) * SHARC_BUCKET_SIZE * 4], 0, SHARC_BUCKET_SIZE * sizeof(uint32_t) * 4);
+
+        occupiedNum += bucketOccupiedNum;
+    }
+
+    liveBuckets[0] = (uint32_t)liveBuckets.size() - 1;
+
+    const uint32_t bucketsPerGroup = LINEAR_BLOCK_SIZE / SHARC_BUCKET_SIZE;
+    const uint32_t liveArgs[] = {(liveBuckets[0] + bucketsPerGroup - 1) / bucketsPerGroup, 1, 1, 0};
+
+    // The next frame reads loaded data as "previous" and clears its "current" voxel data
+    const bool isEven = !(frameIndex & 0x1);
+    std::vector<uint32_t> zeros(size_t(capacity) * 4, 0);
+
+    NRI.WaitForIdle(*m_GraphicsQueue);
+
+    const nri::BufferUploadDesc bufferUploadDescs[] =
+    {
+        {hashEntries.data(), helper::GetByteSizeOf(hashEntries), Get(Buffer::SharcHashEntries), 0, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {zeros.data(), capacity * sizeof(uint32_t), Get(Buffer::SharcHashCopyOffset), 0, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {voxelData.data(), helper::GetByteSizeOf(voxelData), Get(isEven ? Buffer::SharcVoxelDataPong : Buffer::SharcVoxelDataPing), 0, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {zeros.data(), helper::GetByteSizeOf(zeros), Get(isEven ? Buffer::SharcVoxelDataPing : Buffer::SharcVoxelDataPong), 0, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {liveBuckets.data(), helper::GetByteSizeOf(liveBuckets), Get(isEven ? Buffer::SharcLiveBucketsPing : Buffer::SharcLiveBucketsPong), 0, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {liveArgs, sizeof(liveArgs), Get(isEven ? Buffer::SharcLiveArgsPing : Buffer::SharcLiveArgsPong), 0, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {bucketMask.data(), helper::GetByteSizeOf(bucketMask), Get(Buffer::SharcBucketMask), 0, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+    };
+
+    NRI_ABORT_ON_FAILURE(NRI.UploadData(*m_GraphicsQueue, nullptr, 0, bufferUploadDescs, helper::GetCountOf(bufferUploadDescs)));
+
+    m_SharcOccupancy = occupiedNum;
+    m_SharcLowLoadFrameNum = 0;
+    m_IsSharcResetPending = false;
+
+    printf("SHARC cache: loaded '%s' (%u entries, %u occupied)\n", path.c_str(), capacity, occupiedNum);
+
+    return true;
+}
+
+void Sample::StartSharcHitRecording()
+{
+    if (m_SharcHitsPath.empty())
+        return;
+
+    m_SharcHitsFile = fopen(m_SharcHitsPath.c_str(), "wb");
+    if (!m_SharcHitsFile)
+    {
+        printf("SHARC hits: can't open '%s'!\n", m_SharcHitsPath.c_str());
+        return;
+    }
+
+    SharcHitsHeader header = {};
+    header.magic = SHARC_HITS_MAGIC;
+    header.version = SHARC_HITS_VERSION;
+    header.downscale = SHARC_DOWNSCALE;
+    header.stride = SHARC_HIT_RECORD_STRIDE;
+
+    fwrite(&header, sizeof(header), 1, m_SharcHitsFile);
+
+    nri::AllocateBufferDesc allocateBufferDesc = {};
+    allocateBufferDesc.desc.size = (1 + uint64_t(SHARC_HIT_RECORD_MAX_NUM) * SHARC_HIT_RECORD_STRIDE) * sizeof(uint32_t);
+    allocateBufferDesc.memoryLocation = nri::MemoryLocation::HOST_READBACK;
+
+    NRI_ABORT_ON_FAILURE(NRI.AllocateBuffer(*m_Device, allocateBufferDesc, m_SharcHitsReadbackBuffer));
+    NRI.SetDebugName(m_SharcHitsReadbackBuffer, "Buffer::SharcHitsReadback");
+}
+
+void Sample::SaveSharcHits()
+{
+    m_IsSharcHitsReadbackPending = false;
+
+    const uint32_t* hits = (uint32_t*)NRI.MapBuffer(*m_SharcHitsReadbackBuffer, 0, nri::WHOLE_SIZE);
+    if (!hits)
+        return;
+
+    // "Update" used the camera of this frame
+    const float3 cameraPosition = float3(m_Camera.state.globalPosition);
+
+    SharcHitsFrame frame = {};
+    frame.cameraPosition[0] = cameraPosition.x;
+    frame.cameraPosition[1] = cameraPosition.y;
+    frame.cameraPosition[2] = cameraPosition.z;
+    frame.hitNum = std::min(hits[0], (uint32_t)SHARC_HIT_RECORD_MAX_NUM);
+
+    if (hits[0] > frame.hitNum)
+        printf("SHARC hits: %u of %u hits recorded, increase 'SHARC_HIT_RECORD_MAX_NUM'!\n", frame.hitNum, hits[0]);
+
+    fwrite(&frame, sizeof(frame), 1, m_SharcHitsFile);
+    fwrite(hits + 1, sizeof(uint32_t), size_t(frame.hitNum) * SHARC_HIT_RECORD_STRIDE, m_SharcHitsFile);
+
+    NRI.UnmapBuffer(*m_SharcHitsReadbackBuffer);
+}
+
+void ReplaySharcFrame(SharcReplayState& state, const SharcHitsFrame& frame, const std::vector<uint32_t>& hits, uint32_t recordedDownscale)
+{
+    SharcCpu::GridParameters gridParameters;
+    gridParameters.cameraPosition = float3(frame.cameraPosition[0], frame.cameraPosition[1], frame.cameraPosition[2]);
+
+    // A coarser downscale keeps every N-th recorded pixel in both dimensions
+    const uint32_t pixelStep = state.downscale / recordedDownscale;
+
+    for (size_t i = 0; i < hits.size(); i += SHARC_HIT_RECORD_STRIDE)
+    {
+        const uint32_t* hit = &hits[i];
+        if ((hit[3] & 0xFFFF) % pixelStep || (hit[3] >> 16) % pixelStep)
+            continue;
+
+        float position[3];
+        float normal[3];
+        memcpy(position, hit, sizeof(position));
+        memcpy(normal, hit + 4, sizeof(normal));
+
+        // Coarse levels: "2 ^ lod" times larger voxels, keys match the native level "level + lod" (as in "SharcUpdate")
+        const uint32_t lod = hit[7] >> 16;
+        gridParameters.sceneScale = state.sceneScale / float(1u << lod);
+        gridParameters.levelBias = SharcCpu::GRID_LEVEL_BIAS + float(lod);
+
+        uint64_t hashKey = SharcCpu::ComputeSpatialHash(float3(position[0], position[1], position[2]), float3(normal[0], normal[1], normal[2]), gridParameters);
+        uint32_t entryIndex = state.hashGrid.Insert(hashKey);
+        state.hashGrid.MarkSampled(entryIndex);
+    }
+
+    state.hashGrid.Resolve(SHARC_STALE_FRAME_NUM_MIN);
+    state.hashGrid.Compact();
+
+    double loadFactor = double(state.hashGrid.GetOccupiedNum()) / double(state.capacity);
+    state.loadFactorSum += loadFactor;
+    state.loadFactorMax = std::max(state.loadFactorMax, loadFactor);
+    state.liveBucketSum += double(state.hashGrid.GetLiveBucketNum());
+}
+
+int32_t Sample::ReplaySharcHits()
+{
+    const std::string& path = m_SharcReplayPath;
+
+    FILE* fp = fopen(path.c_str(), "rb");
+    SharcHitsHeader header = {};
+    bool isValid = fp && fread(&header, sizeof(header), 1, fp) == 1;
+    isValid = isValid && header.magic == SHARC_HITS_MAGIC && header.version == SHARC_HITS_VERSION && header.stride == SHARC_HIT_RECORD_STRIDE && header.downscale;
+
+    if (!isValid)
+    {
+        printf("SHARC replay: can't read '%s'!\n", path.c_str());
+        if (fp)
+            fclose(fp);
+
+        return 1;
+    }
+
+    // Sweep: capacities, scene scales and downscales around the current settings
+    const float sceneScaleFactors[] = {0.5f, 1.0f, 2.0f};
+    const uint32_t downscaleFactors[] = {1, 2};
+
+    std::vector<SharcReplayState> states;
+    for (uint32_t capacity = SHARC_CAPACITY_MIN; capacity <= SHARC_CAPACITY_MAX; capacity <<= 1)
+    {
+        for (float sceneScaleFactor : sceneScaleFactors)
+        {
+            for (uint32_t downscaleFactor : downscaleFactors)
+            {
+                SharcReplayState& state = states.emplace_back();
+                state.sceneScale = float(SHARC_SCENE_SCALE) * sceneScaleFactor;
+                state.capacity = capacity;
+                state.downscale = header.downscale * downscaleFactor;
+                state.hashGrid.Initialize(capacity);
+            }
+        }
+    }
+
+    // Frames are replayed in order, a configuration per thread at a time
+    double begin = m_Timer.GetTimeStamp();
+
+    std::vector<uint32_t> hits;
+    uint64_t hitNum = 0;
+    uint32_t frameNum = 0;
+    SharcHitsFrame frame = {};
+    while (fread(&frame, sizeof(frame), 1, fp) == 1)
+    {
+        hits.resize(size_t(frame.hitNum) * SHARC_HIT_RECORD_STRIDE);
+        if (fread(hits.data(), sizeof(uint32_t), hits.size(), fp) != hits.size())
+            break;
+
+        std::atomic<uint32_t> nextStateIndex{0};
+        auto worker = [&]()
+        {
+            for (uint32_t i = nextStateIndex++; i < (uint32_t)states.size(); i = nextStateIndex++)
+                ReplaySharcFrame(states[i], frame, hits, header.downscale);
+        };
+
+        std::vector<std::thread> threads(std::min(std::max(std::thread::hardware_concurrency(), 2u), (uint32_t)states.size()) - 1);
+        for (std::thread& thread : threads)
+            thread = std::thread(worker);
+
+        worker();
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        hitNum += frame.hitNum;
+        frameNum++;
+    }
+
+    fclose(fp);
+
+    if (!frameNum)
+    {
+        printf("SHARC replay: '%s' has no frames!\n", path.c_str());
+        return 1;
+    }
+
+    printf("SHARC replay: %u frames, %llu hits, %.1f s\n", frameNum, (unsigned long long)hitNum, (m_Timer.GetTimeStamp() - begin) * 0.001);
+    printf("SHARC replay: %9s %10s %9s %9s %9s %9s %9s %9s %9s\n", "capacity", "sceneScale", "downscale", "load, %", "max, %", "probes", "max", "failed, %", "miss, %");
+
+    // Report ("LoadBenchmarkReport" compatible)
+    const Benchmark& benchmark = m_Benchmark;
+    std::map<std::string, double> baseline;
+    if (!benchmark.baselinePath.empty())
+    {
+        baseline = LoadBenchmarkReport(benchmark.baselinePath);
+        if (baseline.empty())
+            printf("SHARC replay: can't read baseline '%s'!\n", benchmark.baselinePath.c_str());
+    }
+
+    fp = fopen(benchmark.reportPath.c_str(), "w");
+    if (fp)
+    {
+        fprintf(fp, "{\n");
+        fprintf(fp, "    \"hits\": \"%s\",\n", path.c_str());
+        fprintf(fp, "    \"frameNum\": %u,\n", frameNum);
+        fprintf(fp, "    \"tests\":\n");
+        fprintf(fp, "    [\n");
+    }
+
+    uint32_t regressionNum = 0;
+    for (uint32_t i = 0; i < (uint32_t)states.size(); i++)
+    {
+        const SharcReplayState& state = states[i];
+        const SharcCpu::Stats& stats = state.hashGrid.GetStats();
+        const double queryNorm = stats.queryNum ? 100.0 / double(stats.queryNum) : 0.0;
+
+        const double loadFactor = 100.0 * state.loadFactorSum / double(frameNum);
+        const double loadFactorMax = 100.0 * state.loadFactorMax;
+        const double probeAvg = stats.queryNum ? double(stats.probeNum) / double(stats.queryNum) : 0.0;
+        const double failedPercent = double(stats.failedNum) * queryNorm;
+        const double missPercent = double(stats.queryNum - stats.hitNum) * queryNorm;
+        const double liveBuckets = state.liveBucketSum / double(frameNum);
+
+        printf("SHARC replay: %9u %10.1f %9u %9.2f %9.2f %9.3f %9u %9.4f %9.2f\n", state.capacity, state.sceneScale, state.downscale, loadFactor, loadFactorMax, probeAvg, stats.probeMaxNum, failedPercent, missPercent);
+
+        if (fp)
+        {
+            fprintf(fp, "        {\"test\": %u, \"capacity\": %u, \"sceneScale\": %.2f, \"downscale\": %u, \"loadFactor\": %.4f, \"loadFactorMax\": %.4f, \"liveBuckets\": %.1f, \"probeAvg\": %.4f, \"probeMax\": %u, \"failedPercent\": %.4f, \"missPercent\": %.4f, \"evictedNum\": %llu}%s\n",
+                i, state.capacity, state.sceneScale, state.downscale, loadFactor, loadFactorMax, liveBuckets, probeAvg, stats.probeMaxNum, failedPercent, missPercent, (unsigned long long)stats.evictedNum, i + 1 == states.size() ? "" : ",");
+        }
+
+        // Only metrics where "more" is "worse" are compared
+        auto compare = [&](const char* name, double value)
+        {
+            auto it = baseline.find(std::to_string(i) + "/" + name);
+            if (it == baseline.end())
+                return;
+
+            double delta = value - it->second;
+            if (delta > 0.001 && delta > it->second * benchmark.regressionThreshold * 0.01)
+            {
+                printf("SHARC replay: REGRESSION in test %u (capacity %u, sceneScale %.1f, downscale %u), %s: %.4f -> %.4f\n", i, state.capacity, state.sceneScale, state.downscale, name, it->second, value);
+                regressionNum++;
+            }
+        };
+
+        compare("probeAvg", probeAvg);
+        compare("failedPercent", failedPercent);
+        compare("missPercent", missPercent);
+    }
+
+    if (fp)
+    {
+        fprintf(fp, "    ]\n");
+        fprintf(fp, "}\n");
+        fclose(fp);
+
+        printf("SHARC replay: report saved to '%s'\n", benchmark.reportPath.c_str());
+    }
+    else
+        printf("SHARC replay: can't write '%s'!\n", benchmark.reportPath.c_str());
+
+    if (!baseline.empty())
+        printf("SHARC replay: %u regression(s) vs '%s' (threshold %.1f%%)\n", regressionNum, benchmark.baselinePath.c_str(), benchmark.regressionThreshold);
+
+    // Batch job, exit code reports regressions
+    return regressionNum ? 1 : 0;
+}
+
+void Sample::CreateDescriptorSets()
+{
+    nri::DescriptorSet* descriptorSet = nullptr;
+
+
+    { // SET_GLOBAL
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_GLOBAL, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
+
+        const nri::Descriptor* samplers[] =
+        {
+            Get(Descriptor::LinearMipmapLinear_Sampler),
+            Get(Descriptor::LinearMipmapNearest_Sampler),
+            Get(Descriptor::NearestMipmapNearest_Sampler),
+        };
+
+        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        {
+            { samplers, helper::GetCountOf(samplers) },
+        };
+
+        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+
+        nri::Descriptor* constantBuffer = Get(Descriptor::Global_ConstantBuffer);
+        NRI.UpdateDynamicConstantBuffers(*descriptorSet, 0, 1, &constantBuffer);
+    }
+
+    { // DescriptorSet::TraceOpaque1
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
+
+        // Ranges are written in "UpdateOptionalDescriptorSets"
+    }
+
+    { // DescriptorSet::Composition1
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
+
+        // Ranges are written in "UpdateOptionalDescriptorSets"
+    }
+
+    // Used in all NRD modes, SH textures are appended if exist
+    UpdateOptionalDescriptorSets(OptionalFeature::Sh);
+
+    { // DescriptorSet::TraceTransparent1
+        const nri::Descriptor* resources[] =
+        {
+            Get(Descriptor::ComposedDiff_Texture),
+            Get(Descriptor::ComposedSpec_ViewZ_Texture),
+        };
+
+        const nri::Descriptor* storageResources[] =
+        {
+            Get(Descriptor::Composed_StorageTexture),
+            Get(Descriptor::Mv_StorageTexture),
+            Get(Descriptor::Normal_Roughness_StorageTexture),
+        };
+
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
+
+        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        {
+            { resources, helper::GetCountOf(resources) },
+            { storageResources, helper::GetCountOf(storageResources) },
+        };
+
+        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+    }
+
+    { // DescriptorSet::Taa1a
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
+
+        // Ranges are written in "UpdateOptionalDescriptorSets"
+    }
+
+    { // DescriptorSet::Taa1b
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
+
+        // Ranges are written in "UpdateOptionalDescriptorSets"
+    }
+
+    { // DescriptorSet::Nis1
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
+
+        // Ranges are written in "UpdateOptionalDescriptorSets"
+    }
+
+    { // DescriptorSet::Nis1a
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
+
+        // Ranges are written in "UpdateOptionalDescriptorSets"
+    }
+
+    { // DescriptorSet::Nis1b
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
+
+        // Ranges are written in "UpdateOptionalDescriptorSets"
+    }
+
+    { // DescriptorSet::Final1
+        const nri::Descriptor* resources[] =
+        {
+            Get(Descriptor::PreFinal_Texture),
+            Get(Descriptor::Composed_Texture),
+            Get(Descriptor::Validation_Texture),
+        };
+
+        const nri::Descriptor* storageResources[] =
+        {
+            Get(Descriptor::Final_StorageTexture),
+        };
+
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
+
+        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        {
+            { resources, helper::GetCountOf(resources) },
+            { storageResources, helper::GetCountOf(storageResources) },
+        };
+
+        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+    }
+
+    { // DescriptorSet::DlssBefore1
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
+
+        // Ranges are written in "UpdateOptionalDescriptorSets"
+    }
+
+    { // DescriptorSet::DlssAfter1
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
+
+        // Ranges are written in "UpdateOptionalDescriptorSets"
+    }
+
+    { // DescriptorSet::RayTracing2
+        const nri::Descriptor* accelerationStructures[] =
+        {
+            Get(Descriptor::World_AccelerationStructure),
+            Get(Descriptor::Light_AccelerationStructure)
+        };
+
+        const nri::Descriptor* structuredBuffers[] =
+        {
+            Get(Descriptor::InstanceData_Buffer),
+            Get(Descriptor::PrimitiveData_Buffer),
+            Get(Descriptor::MorphedPrimitivePrevData_Buffer),
+        };
+
+        const nri::Descriptor* storageStructuredBuffers[] =
+        {
+            Get(Descriptor::TextureFeedback_StorageBuffer),
+        };
+
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_RAY_TRACING, &descriptorSet, 1, helper::GetCountOf(m_Scene.materials) * TEXTURES_PER_MATERIAL));
+        m_DescriptorSets.push_back(descriptorSet);
+
+        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        {
+            { accelerationStructures, helper::GetCountOf(accelerationStructures) },
+            { structuredBuffers, helper::GetCountOf(structuredBuffers) },
+            { storageStructuredBuffers, helper::GetCountOf(storageStructuredBuffers) },
+        };
+
+        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+
+        UpdateMaterialTextureDescriptors();
+    }
+
+    { // DescriptorSet::MorphTargetPose3
+        const nri::Descriptor* resources[] =
+        {
+            Get(Descriptor::MorphMeshVertices_Buffer)
+        };
 
-    // Textures (DEVICE)
-    CreateTexture(descriptorDescs, "Texture::ViewZ", nri::Format::R32_SFLOAT, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::Mv", nri::Format::RGBA16_SFLOAT, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::Normal_Roughness", normalFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::PsrThroughput", nri::Format::R10_G10_B10_A2_UNORM, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::BaseColor_Metalness", nri::Format::RGBA8_SRGB, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::DirectLighting", colorFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::DirectEmission", colorFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::Shadow", shadowFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::Diff", dataFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::Spec", dataFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::Unfiltered_Penumbra", nri::Format::R16_SFLOAT, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::Unfiltered_Diff", dataFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::Unfiltered_Spec", dataFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::Unfiltered_Translucency", shadowFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::Validation", nri::Format::RGBA8_UNORM, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::Composed", criticalColorFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
-    CreateTexture(descriptorDescs, "Texture::ComposedDiff", colorFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
-    CreateTexture(descriptorDescs, "Texture::ComposedSpec_ViewZ", nri::Format::RGBA16_SFLOAT, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
-    CreateTexture(descriptorDescs, "Texture::TaaHistory", taaFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::TaaHistoryPrev", taaFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
+        const nri::Descriptor* storageResources[] =
+        {
+            Get(Descriptor::MorphedPositions_StorageBuffer),
+            Get(Descriptor::MorphedAttributes_StorageBuffer),
+        };
 
-    // Created unconditionally, unfortunately...
-    CreateTexture(descriptorDescs, "Texture::RRGuide_DiffAlbedo", nri::Format::R10_G10_B10_A2_UNORM, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
-    CreateTexture(descriptorDescs, "Texture::RRGuide_SpecAlbedo", nri::Format::R10_G10_B10_A2_UNORM, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
-    CreateTexture(descriptorDescs, "Texture::RRGuide_SpecHitDistance", nri::Format::R16_SFLOAT, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
-    CreateTexture(descriptorDescs, "Texture::RRGuide_Normal_Roughness", nri::Format::RGBA16_SFLOAT, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
-    CreateTexture(descriptorDescs, "Texture::DlssOutput", criticalColorFormat, (uint16_t)GetOutputResolution().x, (uint16_t)GetOutputResolution().y, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_MORPH, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
 
-    CreateTexture(descriptorDescs, "Texture::PreFinal", criticalColorFormat, (uint16_t)GetOutputResolution().x, (uint16_t)GetOutputResolution().y, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE);
-    CreateTexture(descriptorDescs, "Texture::Final", swapChainFormat, (uint16_t)GetWindowResolution().x, (uint16_t)GetWindowResolution().y, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::COPY_SOURCE);
+        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        {
+            { resources, helper::GetCountOf(resources) },
+            { storageResources, helper::GetCountOf(storageResources) }
+        };
 
-#if( NRD_MODE == SH )
-    CreateTexture(descriptorDescs, "Texture::Unfiltered_DiffSh", dataFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::Unfiltered_SpecSh", dataFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::DiffSh", dataFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-    CreateTexture(descriptorDescs, "Texture::SpecSh", dataFormat, w, h, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE | nri::TextureUsageBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE);
-#endif
+        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
 
-    CreateTexture(descriptorDescs, "Texture::NisData1", nri::Format::RGBA16_SFLOAT, kFilterSize / 4, kPhaseCount, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE, nri::AccessBits::UNKNOWN);
-    CreateTexture(descriptorDescs, "Texture::NisData2", nri::Format::RGBA16_SFLOAT, kFilterSize / 4, kPhaseCount, 1, 1,
-        nri::TextureUsageBits::SHADER_RESOURCE, nri::AccessBits::UNKNOWN);
+        nri::Descriptor* constantBuffer = Get(Descriptor::MorphTargetPose_ConstantBuffer);
+        NRI.UpdateDynamicConstantBuffers(*descriptorSet, 0, 1, &constantBuffer);
+    }
+
+    { // DescriptorSet::MorphTargetUpdatePrimitives3
+        const nri::Descriptor* resources[] =
+        {
+            Get(Descriptor::MorphMeshIndices_Buffer),
+            Get(Descriptor::MorphedPositions_Buffer),
+            Get(Descriptor::MorphedAttributes_Buffer)
+        };
+
+        const nri::Descriptor* storageResources[] =
+        {
+            Get(Descriptor::PrimitiveData_StorageBuffer),
+            Get(Descriptor::MorphedPrimitivePrevData_StorageBuffer)
+        };
 
-    for (const utils::Texture* texture : m_Scene.textures)
-        CreateTexture(descriptorDescs, "", texture->GetFormat(), texture->GetWidth(), texture->GetHeight(), texture->GetMipNum(), texture->GetArraySize(), nri::TextureUsageBits::SHADER_RESOURCE, nri::AccessBits::UNKNOWN);
+        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_MORPH, &descriptorSet, 1, 0));
+        m_DescriptorSets.push_back(descriptorSet);
 
-    // Create descriptors
-    nri::Descriptor* descriptor = nullptr;
+        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        {
+            { resources, helper::GetCountOf(resources) },
+            { storageResources, helper::GetCountOf(storageResources) }
+        };
+
+        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+
+        nri::Descriptor* constantBuffer = Get(Descriptor::MorphTargetUpdatePrimitives_ConstantBuffer);
+        NRI.UpdateDynamicConstantBuffers(*descriptorSet, 0, 1, &constantBuffer);
+    }
+
+    { // DescriptorSet::SharcPing4, DescriptorSet::SharcPong4
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_SHARC, &descriptorSet, 1, 0));
+            m_DescriptorSets.push_back(descriptorSet);
+        }
+
+        UpdateSharcDescriptorSets();
+    }
+
+    { // DescriptorSet::WavefrontPing5, DescriptorSet::WavefrontPong5
+        nri::Descriptor* constantBuffer = Get(Descriptor::Wavefront_ConstantBuffer);
+
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_WAVEFRONT, &descriptorSet, 1, 0));
+            m_DescriptorSets.push_back(descriptorSet);
+
+            NRI.UpdateDynamicConstantBuffers(*descriptorSet, 0, 1, &constantBuffer);
+        }
+
+        UpdateWavefrontDescriptorSets();
+    }
+}
+
+void Sample::UpdateMaterialTextureDescriptors()
+{
+    // DescriptorSet::RayTracing2, the last range
+    std::vector<nri::Descriptor*> textures(m_Scene.materials.size() * TEXTURES_PER_MATERIAL);
+    for (size_t i = 0; i < m_Scene.materials.size(); i++)
+    {
+        const size_t index = i * TEXTURES_PER_MATERIAL;
+        const utils::Material& material = m_Scene.materials[i];
+
+        textures[index] = Get( Descriptor((uint32_t)Descriptor::MaterialTextures + material.baseColorTexIndex) );
+        textures[index + 1] = Get( Descriptor((uint32_t)Descriptor::MaterialTextures + material.roughnessMetalnessTexIndex) );
+        textures[index + 2] = Get( Descriptor((uint32_t)Descriptor::MaterialTextures + material.normalTexIndex) );
+        textures[index + 3] = Get( Descriptor((uint32_t)Descriptor::MaterialTextures + material.emissiveTexIndex) );
+    }
+
+    const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+    {
+        { textures.data(), helper::GetCountOf(textures) },
+    };
+
+    NRI.UpdateDescriptorRanges(*Get(DescriptorSet::RayTracing2), 3, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+}
+
+void Sample::UpdateSharcDescriptorSets()
+{
+    { // DescriptorSet::SharcPing4
+        const nri::Descriptor* storageResources[] =
+        {
+            Get(Descriptor::SharcHashEntries_StorageBuffer),
+            Get(Descriptor::SharcHashCopyOffset_StorageBuffer),
+            Get(Descriptor::SharcVoxelDataPing_StorageBuffer),
+            Get(Descriptor::SharcVoxelDataPong_StorageBuffer),
+            Get(Descriptor::SharcStats_StorageBuffer),
+            Get(Descriptor::SharcLiveBucketsPing_StorageBuffer),
+            Get(Descriptor::SharcLiveBucketsPong_StorageBuffer),
+            Get(Descriptor::SharcLiveArgsPing_StorageBuffer),
+            Get(Descriptor::SharcLiveArgsPong_StorageBuffer),
+            Get(Descriptor::SharcBucketMask_StorageBuffer),
+            Get(Descriptor::SharcHits_StorageBuffer),
+            Get(Descriptor::SharcUpdateLevels_StorageBuffer),
+        };
+
+        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        {
+            { storageResources, helper::GetCountOf(storageResources) },
+        };
+
+        NRI.UpdateDescriptorRanges(*Get(DescriptorSet::SharcPing4), 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+    }
+
+    { // DescriptorSet::SharcPong4
+        const nri::Descriptor* storageResources[] =
+        {
+            Get(Descriptor::SharcHashEntries_StorageBuffer),
+            Get(Descriptor::SharcHashCopyOffset_StorageBuffer),
+            Get(Descriptor::SharcVoxelDataPong_StorageBuffer),
+            Get(Descriptor::SharcVoxelDataPing_StorageBuffer),
+            Get(Descriptor::SharcStats_StorageBuffer),
+            Get(Descriptor::SharcLiveBucketsPong_StorageBuffer),
+            Get(Descriptor::SharcLiveBucketsPing_StorageBuffer),
+            Get(Descriptor::SharcLiveArgsPong_StorageBuffer),
+            Get(Descriptor::SharcLiveArgsPing_StorageBuffer),
+            Get(Descriptor::SharcBucketMask_StorageBuffer),
+            Get(Descriptor::SharcHits_StorageBuffer),
+            Get(Descriptor::SharcUpdateLevels_StorageBuffer),
+        };
+
+        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        {
+            { storageResources, helper::GetCountOf(storageResources) },
+        };
+
+        NRI.UpdateDescriptorRanges(*Get(DescriptorSet::SharcPong4), 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+    }
+}
+
+void Sample::UpdateWavefrontDescriptorSets()
+{
+    { // DescriptorSet::WavefrontPing5
+        const nri::Descriptor* storageResources[] =
+        {
+            Get(Descriptor::WavefrontPixels_StorageBuffer),
+            Get(Descriptor::WavefrontPaths_StorageBuffer),
+            Get(Descriptor::WavefrontQueuePing_StorageBuffer),
+            Get(Descriptor::WavefrontQueuePong_StorageBuffer),
+            Get(Descriptor::WavefrontArgsPing_StorageBuffer),
+            Get(Descriptor::WavefrontArgsPong_StorageBuffer),
+            Get(Descriptor::WavefrontShadowQueue_StorageBuffer),
+            Get(Descriptor::WavefrontShadowArgs_StorageBuffer),
+            Get(Descriptor::WavefrontBins_StorageBuffer),
+            Get(Descriptor::WavefrontBinOffsets_StorageBuffer),
+            Get(Descriptor::WavefrontSortedQueue_StorageBuffer),
+        };
+
+        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        {
+            { storageResources, helper::GetCountOf(storageResources) },
+        };
+
+        NRI.UpdateDescriptorRanges(*Get(DescriptorSet::WavefrontPing5), 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+    }
+
+    { // DescriptorSet::WavefrontPong5
+        const nri::Descriptor* storageResources[] =
+        {
+            Get(Descriptor::WavefrontPixels_StorageBuffer),
+            Get(Descriptor::WavefrontPaths_StorageBuffer),
+            Get(Descriptor::WavefrontQueuePong_StorageBuffer),
+            Get(Descriptor::WavefrontQueuePing_StorageBuffer),
+            Get(Descriptor::WavefrontArgsPong_StorageBuffer),
+            Get(Descriptor::WavefrontArgsPing_StorageBuffer),
+            Get(Descriptor::WavefrontShadowQueue_StorageBuffer),
+            Get(Descriptor::WavefrontShadowArgs_StorageBuffer),
+            Get(Descriptor::WavefrontBins_StorageBuffer),
+            Get(Descriptor::WavefrontBinOffsets_StorageBuffer),
+            Get(Descriptor::WavefrontSortedQueue_StorageBuffer),
+        };
+
+        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        {
+            { storageResources, helper::GetCountOf(storageResources) },
+        };
+
+        NRI.UpdateDescriptorRanges(*Get(DescriptorSet::WavefrontPong5), 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+    }
+}
+
+void Sample::UpdateOptionalDescriptorSets(OptionalFeature feature)
+{
+    if (feature == OptionalFeature::Taa)
+    {
+        { // DescriptorSet::Taa1a
+            const nri::Descriptor* resources[] =
+            {
+                Get(Descriptor::Mv_Texture),
+                Get(Descriptor::Composed_Texture),
+                Get(Descriptor::TaaHistoryPrev_Texture),
+            };
+
+            const nri::Descriptor* storageResources[] =
+            {
+                Get(Descriptor::TaaHistory_StorageTexture),
+            };
+
+            const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+            {
+                { resources, helper::GetCountOf(resources) },
+                { storageResources, helper::GetCountOf(storageResources) },
+            };
+
+            NRI.UpdateDescriptorRanges(*Get(DescriptorSet::Taa1a), 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+        }
+
+        { // DescriptorSet::Taa1b
+            const nri::Descriptor* resources[] =
+            {
+                Get(Descriptor::Mv_Texture),
+                Get(Descriptor::Composed_Texture),
+                Get(Descriptor::TaaHistory_Texture),
+            };
+
+            const nri::Descriptor* storageResources[] =
+            {
+                Get(Descriptor::TaaHistoryPrev_StorageTexture),
+            };
+
+            const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+            {
+                { resources, helper::GetCountOf(resources) },
+                { storageResources, helper::GetCountOf(storageResources) },
+            };
+
+            NRI.UpdateDescriptorRanges(*Get(DescriptorSet::Taa1b), 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+        }
+
+        { // DescriptorSet::Nis1a
+            const nri::Descriptor* resources[] =
+            {
+                Get(Descriptor::TaaHistory_Texture),
+                Get(Descriptor::NisData1),
+                Get(Descriptor::NisData2),
+            };
+
+            const nri::Descriptor* storageResources[] =
+            {
+                Get(Descriptor::PreFinal_StorageTexture),
+            };
+
+            const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+            {
+                { resources, helper::GetCountOf(resources) },
+                { storageResources, helper::GetCountOf(storageResources) },
+            };
+
+            NRI.UpdateDescriptorRanges(*Get(DescriptorSet::Nis1a), 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+        }
+
+        { // DescriptorSet::Nis1b
+            const nri::Descriptor* resources[] =
+            {
+                Get(Descriptor::TaaHistoryPrev_Texture),
+                Get(Descriptor::NisData1),
+                Get(Descriptor::NisData2),
+            };
+
+            const nri::Descriptor* storageResources[] =
+            {
+                Get(Descriptor::PreFinal_StorageTexture),
+            };
+
+            const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+            {
+                { resources, helper::GetCountOf(resources) },
+                { storageResources, helper::GetCountOf(storageResources) },
+            };
+
+            NRI.UpdateDescriptorRanges(*Get(DescriptorSet::Nis1b), 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+        }
+    }
+    else if (feature == OptionalFeature::Sh)
+    {
+        const bool isSh = Get(Texture::DiffSh) != nullptr;
+
+        { // DescriptorSet::TraceOpaque1
+            const nri::Descriptor* resources[] =
+            {
+                Get(Descriptor::ComposedDiff_Texture),
+                Get(Descriptor::ComposedSpec_ViewZ_Texture),
+                Get(Descriptor((uint32_t)Descriptor::MaterialTextures + utils::StaticTexture::ScramblingRanking)),
+                Get(Descriptor((uint32_t)Descriptor::MaterialTextures + utils::StaticTexture::SobolSequence)),
+            };
+
+            const nri::Descriptor* storageResources[] =
+            {
+                Get(Descriptor::Mv_StorageTexture),
+                Get(Descriptor::ViewZ_StorageTexture),
+                Get(Descriptor::Normal_Roughness_StorageTexture),
+                Get(Descriptor::BaseColor_Metalness_StorageTexture),
+                Get(Descriptor::DirectLighting_StorageTexture),
+                Get(Descriptor::DirectEmission_StorageTexture),
+                Get(Descriptor::PsrThroughput_StorageTexture),
+                Get(Descriptor::Unfiltered_Penumbra_StorageTexture),
+                Get(Descriptor::Unfiltered_Translucency_StorageTexture),
+                Get(Descriptor::Unfiltered_Diff_StorageTexture),
+                Get(Descriptor::Unfiltered_Spec_StorageTexture),
+                // SH (must be last)
+                Get(Descriptor::Unfiltered_DiffSh_StorageTexture),
+                Get(Descriptor::Unfiltered_SpecSh_StorageTexture),
+            };
+
+            const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+            {
+                { resources, helper::GetCountOf(resources) },
+                { storageResources, helper::GetCountOf(storageResources) - (isSh ? 0 : 2) },
+            };
+
+            NRI.UpdateDescriptorRanges(*Get(DescriptorSet::TraceOpaque1), 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+        }
+
+        { // DescriptorSet::Composition1
+            const nri::Descriptor* resources[] =
+            {
+                Get(Descriptor::ViewZ_Texture),
+                Get(Descriptor::Normal_Roughness_Texture),
+                Get(Descriptor::BaseColor_Metalness_Texture),
+                Get(Descriptor::DirectLighting_Texture),
+                Get(Descriptor::DirectEmission_Texture),
+                Get(Descriptor::PsrThroughput_Texture),
+                Get(Descriptor::Shadow_Texture),
+                Get(Descriptor::Diff_Texture),
+                Get(Descriptor::Spec_Texture),
+                // SH (must be last)
+                Get(Descriptor::DiffSh_Texture),
+                Get(Descriptor::SpecSh_Texture),
+            };
+
+            const nri::Descriptor* storageResources[] =
+            {
+                Get(Descriptor::ComposedDiff_StorageTexture),
+                Get(Descriptor::ComposedSpec_ViewZ_StorageTexture),
+            };
+
+            const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+            {
+                { resources, helper::GetCountOf(resources) - (isSh ? 0 : 2) },
+                { storageResources, helper::GetCountOf(storageResources) },
+            };
+
+            NRI.UpdateDescriptorRanges(*Get(DescriptorSet::Composition1), 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+        }
+    }
+    else if (feature == OptionalFeature::Dlss)
     {
-        const nri::DeviceDesc& deviceDesc = NRI.GetDeviceDesc(*m_Device);
+        { // DescriptorSet::Nis1
+            const nri::Descriptor* resources[] =
+            {
+                Get(Descriptor::DlssOutput_Texture),
+                Get(Descriptor::NisData1),
+                Get(Descriptor::NisData2),
+            };
 
-        nri::BufferViewDesc constantBufferViewDesc = {};
-        constantBufferViewDesc.viewType = nri::BufferViewType::CONSTANT;
-        constantBufferViewDesc.buffer = NRI.GetStreamerConstantBuffer(*m_Streamer);
+            const nri::Descriptor* storageResources[] =
+            {
+                Get(Descriptor::PreFinal_StorageTexture),
+            };
 
-        constantBufferViewDesc.size = helper::Align(sizeof(GlobalConstants), deviceDesc.constantBufferOffsetAlignment);
-        NRI_ABORT_ON_FAILURE(NRI.CreateBufferView(constantBufferViewDesc, descriptor));
-        m_Descriptors.push_back(descriptor);
+            const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+            {
+                { resources, helper::GetCountOf(resources) },
+                { storageResources, helper::GetCountOf(storageResources) },
+            };
 
-        constantBufferViewDesc.size = helper::Align(sizeof(MorphMeshUpdateVerticesConstants), deviceDesc.constantBufferOffsetAlignment);
-        NRI_ABORT_ON_FAILURE(NRI.CreateBufferView(constantBufferViewDesc, descriptor));
-        m_Descriptors.push_back(descriptor);
+            NRI.UpdateDescriptorRanges(*Get(DescriptorSet::Nis1), 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+        }
 
-        constantBufferViewDesc.size = helper::Align(sizeof(MorphMeshUpdatePrimitivesConstants), deviceDesc.constantBufferOffsetAlignment);
-        NRI_ABORT_ON_FAILURE(NRI.CreateBufferView(constantBufferViewDesc, descriptor));
-        m_Descriptors.push_back(descriptor);
-    }
+        { // DescriptorSet::DlssBefore1
+            const nri::Descriptor* resources[] =
+            {
+                Get(Descriptor::Normal_Roughness_Texture),
+                Get(Descriptor::BaseColor_Metalness_Texture),
+                Get(Descriptor::Unfiltered_Spec_Texture),
+            };
 
-    for (const DescriptorDesc& desc : descriptorDescs)
-    {
-        if (desc.textureUsage == nri::TextureUsageBits::NONE)
-        {
-            if (desc.bufferUsage == nri::BufferUsageBits::CONSTANT_BUFFER)
+            const nri::Descriptor* storageResources[] =
             {
-                // Constant buffer views are not stored in m_Descriptors
-            }
-            else
+                Get(Descriptor::ViewZ_StorageTexture),
+                Get(Descriptor::RRGuide_DiffAlbedo_StorageTexture),
+                Get(Descriptor::RRGuide_SpecAlbedo_StorageTexture),
+                Get(Descriptor::RRGuide_SpecHitDistance_StorageTexture),
+                Get(Descriptor::RRGuide_Normal_Roughness_StorageTexture),
+            };
+
+            const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
             {
-                NRI.SetDebugName((nri::Object*)desc.resource, desc.debugName);
+                { resources, helper::GetCountOf(resources) },
+                { storageResources, helper::GetCountOf(storageResources) },
+            };
 
-                if (desc.bufferUsage & nri::BufferUsageBits::SHADER_RESOURCE)
-                {
-                    const nri::BufferViewDesc viewDesc = { (nri::Buffer*)desc.resource, nri::BufferViewType::SHADER_RESOURCE, desc.format };
-                    NRI_ABORT_ON_FAILURE(NRI.CreateBufferView(viewDesc, descriptor));
-                    m_Descriptors.push_back(descriptor);
-                }
-                if (desc.bufferUsage & nri::BufferUsageBits::SHADER_RESOURCE_STORAGE)
-                {
-                    const nri::BufferViewDesc viewDesc = { (nri::Buffer*)desc.resource, nri::BufferViewType::SHADER_RESOURCE_STORAGE, desc.format };
-                    NRI_ABORT_ON_FAILURE(NRI.CreateBufferView(viewDesc, descriptor));
-                    m_Descriptors.push_back(descriptor);
-                }
-            }
+            NRI.UpdateDescriptorRanges(*Get(DescriptorSet::DlssBefore1), 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
         }
-        else
-        {
-            NRI.SetDebugName((nri::Object*)desc.resource, desc.debugName);
 
-            nri::Texture2DViewDesc viewDesc = {(nri::Texture*)desc.resource, desc.isArray ? nri::Texture2DViewType::SHADER_RESOURCE_2D_ARRAY : nri::Texture2DViewType::SHADER_RESOURCE_2D, desc.format};
-            NRI_ABORT_ON_FAILURE(NRI.CreateTexture2DView(viewDesc, descriptor));
-            m_Descriptors.push_back(descriptor);
+        { // DescriptorSet::DlssAfter1
+            const nri::Descriptor* storageResources[] =
+            {
+                Get(Descriptor::DlssOutput_StorageTexture),
+            };
 
-            if (desc.textureUsage & nri::TextureUsageBits::SHADER_RESOURCE_STORAGE)
+            const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
             {
-                viewDesc.format = ConvertFormatToTextureStorageCompatible(desc.format);
-                viewDesc.viewType = desc.isArray ? nri::Texture2DViewType::SHADER_RESOURCE_STORAGE_2D_ARRAY : nri::Texture2DViewType::SHADER_RESOURCE_STORAGE_2D;
-                NRI_ABORT_ON_FAILURE(NRI.CreateTexture2DView(viewDesc, descriptor));
-                m_Descriptors.push_back(descriptor);
-            }
+                { storageResources, helper::GetCountOf(storageResources) },
+            };
+
+            NRI.UpdateDescriptorRanges(*Get(DescriptorSet::DlssAfter1), 1, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
         }
     }
 }
 
-void Sample::CreateDescriptorSets()
+void Sample::CreateTexture(std::vector<DescriptorDesc>& descriptorDescs, const char* debugName, nri::Format format, nri::Dim_t width, nri::Dim_t height, nri::Mip_t mipNum, nri::Dim_t arraySize, nri::TextureUsageBits usage, nri::AccessBits access)
 {
-    nri::DescriptorSet* descriptorSet = nullptr;
-
-
-    { // SET_GLOBAL
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_GLOBAL, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
-
-        const nri::Descriptor* samplers[] =
-        {
-            Get(Descriptor::LinearMipmapLinear_Sampler),
-            Get(Descriptor::LinearMipmapNearest_Sampler),
-            Get(Descriptor::NearestMipmapNearest_Sampler),
-        };
-
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
-        {
-            { samplers, helper::GetCountOf(samplers) },
-        };
+    nri::AllocateTextureDesc allocateTextureDesc = {};
+    allocateTextureDesc.desc.type = nri::TextureType::TEXTURE_2D;
+    allocateTextureDesc.desc.usage = usage;
+    allocateTextureDesc.desc.format = format;
+    allocateTextureDesc.desc.width = width;
+    allocateTextureDesc.desc.height = height;
+    allocateTextureDesc.desc.depth = 1;
+    allocateTextureDesc.desc.mipNum = mipNum;
+    allocateTextureDesc.desc.layerNum = arraySize;
+    allocateTextureDesc.desc.sampleNum = 1;
+    allocateTextureDesc.memoryLocation = nri::MemoryLocation::DEVICE;
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+    const Texture index = (Texture)m_Textures.size();
+    const uint32_t optionalIndex = FindOptionalTexture(index);
+    const bool isTransient = FindTransientTexture(index) != NOT_FOUND;
 
-        nri::Descriptor* constantBuffer = Get(Descriptor::Global_ConstantBuffer);
-        NRI.UpdateDynamicConstantBuffers(*descriptorSet, 0, 1, &constantBuffer);
+    // Optional textures are created in "UpdateOptionalTextures", memory for transient and placed textures is bound in "BindTransientTextures" and "BindPlacedResources"
+    nri::Texture* texture = nullptr;
+    if (optionalIndex != NOT_FOUND)
+        m_OptionalTextureDescs[optionalIndex] = {allocateTextureDesc.desc, debugName};
+    else if (ALLOW_TRANSIENT_ALIASING && isTransient)
+        NRI_ABORT_ON_FAILURE(NRI.CreateTexture(*m_Device, allocateTextureDesc.desc, texture));
+    else if (ALLOW_PLACED_RESOURCES)
+    {
+        NRI_ABORT_ON_FAILURE(NRI.CreateTexture(*m_Device, allocateTextureDesc.desc, texture));
+        AddPlacedTexture(texture, allocateTextureDesc.desc);
     }
+    else
+        NRI_ABORT_ON_FAILURE(NRI.AllocateTexture(*m_Device, allocateTextureDesc, texture));
+    m_Textures.push_back(texture);
 
-    { // DescriptorSet::TraceOpaque1
-        const nri::Descriptor* resources[] =
-        {
-            Get(Descriptor::ComposedDiff_Texture),
-            Get(Descriptor::ComposedSpec_ViewZ_Texture),
-            Get(Descriptor((uint32_t)Descriptor::MaterialTextures + utils::StaticTexture::ScramblingRanking)),
-            Get(Descriptor((uint32_t)Descriptor::MaterialTextures + utils::StaticTexture::SobolSequence)),
-        };
+    if (access != nri::AccessBits::UNKNOWN)
+    {
+        nri::Layout layout = nri::Layout::SHADER_RESOURCE;
+        if (access & nri::AccessBits::COPY_SOURCE)
+            layout = nri::Layout::COPY_SOURCE;
+        else if (access & nri::AccessBits::COPY_DESTINATION)
+            layout = nri::Layout::COPY_DESTINATION;
+        else if (access & nri::AccessBits::SHADER_RESOURCE_STORAGE)
+            layout = nri::Layout::SHADER_RESOURCE_STORAGE;
 
-        const nri::Descriptor* storageResources[] =
-        {
-            Get(Descriptor::Mv_StorageTexture),
-            Get(Descriptor::ViewZ_StorageTexture),
-            Get(Descriptor::Normal_Roughness_StorageTexture),
-            Get(Descriptor::BaseColor_Metalness_StorageTexture),
-            Get(Descriptor::DirectLighting_StorageTexture),
-            Get(Descriptor::DirectEmission_StorageTexture),
-            Get(Descriptor::PsrThroughput_StorageTexture),
-            Get(Descriptor::Unfiltered_Penumbra_StorageTexture),
-            Get(Descriptor::Unfiltered_Translucency_StorageTexture),
-            Get(Descriptor::Unfiltered_Diff_StorageTexture),
-            Get(Descriptor::Unfiltered_Spec_StorageTexture),
-#if( NRD_MODE == SH )
-            Get(Descriptor::Unfiltered_DiffSh_StorageTexture),
-            Get(Descriptor::Unfiltered_SpecSh_StorageTexture),
-#endif
-        };
+        nri::TextureBarrierDesc transition = nri::TextureBarrierFromUnknown(texture, {access, layout});
+        m_TextureStates.push_back(transition);
+    }
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+    descriptorDescs.push_back( {debugName, texture, format, usage, nri::BufferUsageBits::NONE, arraySize > 1} );
+}
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
-        {
-            { resources, helper::GetCountOf(resources) },
-            { storageResources, helper::GetCountOf(storageResources) },
-        };
+void Sample::BindTransientTextures()
+{
+    struct Item
+    {
+        const TransientTexture* transientTexture;
+        nri::MemoryDesc memoryDesc;
+    };
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
-    }
+    struct Slot
+    {
+        std::vector<const TransientTexture*> transientTextures;
+        uint64_t size;
+        nri::MemoryType type;
+        bool isDedicated;
+    };
 
-    { // DescriptorSet::Composition1
-        const nri::Descriptor* resources[] =
-        {
-            Get(Descriptor::ViewZ_Texture),
-            Get(Descriptor::Normal_Roughness_Texture),
-            Get(Descriptor::BaseColor_Metalness_Texture),
-            Get(Descriptor::DirectLighting_Texture),
-            Get(Descriptor::DirectEmission_Texture),
-            Get(Descriptor::PsrThroughput_Texture),
-            Get(Descriptor::Shadow_Texture),
-            Get(Descriptor::Diff_Texture),
-            Get(Descriptor::Spec_Texture),
-#if( NRD_MODE == SH )
-            Get(Descriptor::DiffSh_Texture),
-            Get(Descriptor::SpecSh_Texture),
-#endif
-        };
+    std::vector<Item> items;
+    uint64_t totalSize = 0;
+    for (const TransientTexture& transientTexture : transientTextures)
+    {
+        // Optional textures are not created yet, but their descs are known
+        const uint32_t optionalIndex = FindOptionalTexture(transientTexture.texture);
+        const nri::TextureDesc& textureDesc = optionalIndex != NOT_FOUND ? m_OptionalTextureDescs[optionalIndex].desc : NRI.GetTextureDesc(*Get(transientTexture.texture));
 
-        const nri::Descriptor* storageResources[] =
-        {
-            Get(Descriptor::ComposedDiff_StorageTexture),
-            Get(Descriptor::ComposedSpec_ViewZ_StorageTexture),
-        };
+        Item& item = items.emplace_back();
+        item.transientTexture = &transientTexture;
+        NRI.GetTextureMemoryDesc(*m_Device, textureDesc, nri::MemoryLocation::DEVICE, item.memoryDesc);
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+        totalSize += item.memoryDesc.size;
+    }
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
-        {
-            { resources, helper::GetCountOf(resources) },
-            { storageResources, helper::GetCountOf(storageResources) },
-        };
+    // Greedy packing: bigger textures go first, a texture joins the first slot without lifetime overlaps
+    std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.memoryDesc.size > b.memoryDesc.size; });
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
-    }
+    std::vector<Slot> slots;
+    for (const Item& item : items)
+    {
+        const TransientTexture* transientTexture = item.transientTexture;
 
-    { // DescriptorSet::TraceTransparent1
-        const nri::Descriptor* resources[] =
+        Slot* slot = nullptr;
+        for (Slot& candidate : slots)
         {
-            Get(Descriptor::ComposedDiff_Texture),
-            Get(Descriptor::ComposedSpec_ViewZ_Texture),
-        };
+            if (candidate.isDedicated || item.memoryDesc.mustBeDedicated || candidate.type != item.memoryDesc.type)
+                continue;
 
-        const nri::Descriptor* storageResources[] =
-        {
-            Get(Descriptor::Composed_StorageTexture),
-            Get(Descriptor::Mv_StorageTexture),
-            Get(Descriptor::Normal_Roughness_StorageTexture),
-        };
+            bool isOverlapped = false;
+            for (const TransientTexture* other : candidate.transientTextures)
+                isOverlapped |= transientTexture->firstStage <= other->lastStage && other->firstStage <= transientTexture->lastStage;
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+            if (!isOverlapped)
+            {
+                slot = &candidate;
+                break;
+            }
+        }
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        if (!slot)
         {
-            { resources, helper::GetCountOf(resources) },
-            { storageResources, helper::GetCountOf(storageResources) },
-        };
+            slot = &slots.emplace_back();
+            slot->size = 0;
+            slot->type = item.memoryDesc.type;
+            slot->isDedicated = item.memoryDesc.mustBeDedicated;
+        }
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+        slot->transientTextures.push_back(transientTexture);
+        slot->size = std::max(slot->size, item.memoryDesc.size);
     }
 
-    { // DescriptorSet::Taa1a
-        const nri::Descriptor* resources[] =
-        {
-            Get(Descriptor::Mv_Texture),
-            Get(Descriptor::Composed_Texture),
-            Get(Descriptor::TaaHistoryPrev_Texture),
-        };
-
-        const nri::Descriptor* storageResources[] =
-        {
-            Get(Descriptor::TaaHistory_StorageTexture),
-        };
+    // Each slot is a memory heap shared by its textures
+    m_TransientHeapIndices.resize(helper::GetCountOf(transientTextures));
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+    uint64_t aliasedSize = 0;
+    for (const Slot& slot : slots)
+    {
+        const uint32_t heapIndex = (uint32_t)m_TransientHeaps.size();
+        m_TransientHeaps.push_back( {nullptr, slot.size, slot.type} );
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        for (const TransientTexture* transientTexture : slot.transientTextures)
         {
-            { resources, helper::GetCountOf(resources) },
-            { storageResources, helper::GetCountOf(storageResources) },
-        };
+            m_TransientHeapIndices[transientTexture - transientTextures] = heapIndex;
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
-    }
+            if (slot.transientTextures.size() > 1)
+                m_AliasedTextures.push_back(transientTexture->texture);
+        }
 
-    { // DescriptorSet::Taa1b
-        const nri::Descriptor* resources[] =
-        {
-            Get(Descriptor::Mv_Texture),
-            Get(Descriptor::Composed_Texture),
-            Get(Descriptor::TaaHistory_Texture),
-        };
+        aliasedSize += slot.size;
+    }
 
-        const nri::Descriptor* storageResources[] =
-        {
-            Get(Descriptor::TaaHistoryPrev_StorageTexture),
-        };
+    // Bind created textures, heaps used only by optional textures are allocated on demand
+    std::vector<nri::TextureMemoryBindingDesc> textureMemoryBindingDescs;
+    uint64_t allocatedSize = 0;
+    for (uint32_t heapIndex = 0; heapIndex < m_TransientHeaps.size(); heapIndex++)
+    {
+        if (!IsTransientHeapUsed(heapIndex))
+            continue;
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+        AllocateTransientHeap(heapIndex);
+        allocatedSize += m_TransientHeaps[heapIndex].size;
+    }
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
-        {
-            { resources, helper::GetCountOf(resources) },
-            { storageResources, helper::GetCountOf(storageResources) },
-        };
+    for (uint32_t i = 0; i < helper::GetCountOf(transientTextures); i++)
+    {
+        nri::Texture* texture = Get(transientTextures[i].texture);
+        if (!texture)
+            continue;
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+        nri::TextureMemoryBindingDesc& textureMemoryBindingDesc = textureMemoryBindingDescs.emplace_back();
+        textureMemoryBindingDesc = {};
+        textureMemoryBindingDesc.memory = m_TransientHeaps[m_TransientHeapIndices[i]].memory;
+        textureMemoryBindingDesc.texture = texture;
     }
 
-    { // DescriptorSet::Nis1
-        const nri::Descriptor* resources[] =
-        {
-            Get(Descriptor::DlssOutput_Texture),
-            Get(Descriptor::NisData1),
-            Get(Descriptor::NisData2),
-        };
+    NRI_ABORT_ON_FAILURE(NRI.BindTextureMemory(*m_Device, textureMemoryBindingDescs.data(), (uint32_t)textureMemoryBindingDescs.size()));
 
-        const nri::Descriptor* storageResources[] =
-        {
-            Get(Descriptor::PreFinal_StorageTexture),
-        };
+    printf("Transient textures: %.2f Mb -> %.2f Mb in %u heaps (saved %.2f Mb, %.2f Mb allocated upfront)\n", totalSize / (1024.0f * 1024.0f), aliasedSize / (1024.0f * 1024.0f), (uint32_t)slots.size(), (totalSize - aliasedSize) / (1024.0f * 1024.0f), allocatedSize / (1024.0f * 1024.0f));
+}
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+void Sample::AllocateTransientHeap(uint32_t heapIndex)
+{
+    TransientHeap& transientHeap = m_TransientHeaps[heapIndex];
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
-        {
-            { resources, helper::GetCountOf(resources) },
-            { storageResources, helper::GetCountOf(storageResources) },
-        };
+    nri::AllocateMemoryDesc allocateMemoryDesc = {};
+    allocateMemoryDesc.size = transientHeap.size;
+    allocateMemoryDesc.type = transientHeap.type;
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+    NRI_ABORT_ON_FAILURE(NRI.AllocateMemory(*m_Device, allocateMemoryDesc, transientHeap.memory));
+}
+
+bool Sample::IsTransientHeapUsed(uint32_t heapIndex)
+{
+    for (uint32_t i = 0; i < helper::GetCountOf(transientTextures); i++)
+    {
+        if (m_TransientHeapIndices[i] == heapIndex && Get(transientTextures[i].texture))
+            return true;
     }
 
-    { // DescriptorSet::Nis1a
-        const nri::Descriptor* resources[] =
-        {
-            Get(Descriptor::TaaHistory_Texture),
-            Get(Descriptor::NisData1),
-            Get(Descriptor::NisData2),
-        };
+    return false;
+}
+
+void Sample::DiscardTransientTextures()
+{
+    // Aliased textures don't preserve contents. The first transition in a frame waits for all previous work, i.e. for the last use of the previous alias
+    for (Texture texture : m_AliasedTextures)
+        GetState(texture).after = {nri::AccessBits::UNKNOWN, nri::Layout::UNKNOWN, nri::StageBits::ALL};
+}
 
-        const nri::Descriptor* storageResources[] =
-        {
-            Get(Descriptor::PreFinal_StorageTexture),
-        };
+void Sample::AddPlacedTexture(nri::Texture* texture, const nri::TextureDesc& textureDesc)
+{
+    PlacedResource& placedResource = m_PlacedResources.emplace_back();
+    placedResource = {};
+    placedResource.texture = texture;
+    placedResource.heapIndex = NOT_FOUND;
+    placedResource.placedClass = textureDesc.usage == nri::TextureUsageBits::SHADER_RESOURCE ? PlacedClass::READ_ONLY_TEXTURE : PlacedClass::RENDER_TARGET;
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+    NRI.GetTextureMemoryDesc(*m_Device, textureDesc, nri::MemoryLocation::DEVICE, placedResource.memoryDesc);
+}
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
-        {
-            { resources, helper::GetCountOf(resources) },
-            { storageResources, helper::GetCountOf(storageResources) },
-        };
+void Sample::AddPlacedBuffer(nri::Buffer* buffer, const nri::BufferDesc& bufferDesc)
+{
+    PlacedResource& placedResource = m_PlacedResources.emplace_back();
+    placedResource = {};
+    placedResource.buffer = buffer;
+    placedResource.heapIndex = NOT_FOUND;
+    placedResource.placedClass = PlacedClass::BUFFER;
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
-    }
+    NRI.GetBufferMemoryDesc(*m_Device, bufferDesc, nri::MemoryLocation::DEVICE, placedResource.memoryDesc);
+}
 
-    { // DescriptorSet::Nis1b
-        const nri::Descriptor* resources[] =
-        {
-            Get(Descriptor::TaaHistoryPrev_Texture),
-            Get(Descriptor::NisData1),
-            Get(Descriptor::NisData2),
-        };
+void Sample::BindPlacedResources()
+{
+    // Bigger resources go first, smaller ones fill the gaps
+    std::vector<uint32_t> indices;
+    for (uint32_t i = 0; i < m_PlacedResources.size(); i++)
+    {
+        if (m_PlacedResources[i].heapIndex == NOT_FOUND)
+            indices.push_back(i);
+    }
 
-        const nri::Descriptor* storageResources[] =
-        {
-            Get(Descriptor::PreFinal_StorageTexture),
-        };
+    std::stable_sort(indices.begin(), indices.end(), [&](uint32_t a, uint32_t b) { return m_PlacedResources[a].memoryDesc.size > m_PlacedResources[b].memoryDesc.size; });
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+    std::vector<nri::TextureMemoryBindingDesc> textureMemoryBindingDescs;
+    std::vector<nri::BufferMemoryBindingDesc> bufferMemoryBindingDescs;
+    for (uint32_t i : indices)
+    {
+        PlacedResource& placedResource = m_PlacedResources[i];
+        AllocatePlacedRange(placedResource);
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        nri::Memory* memory = m_PlacedHeaps[placedResource.heapIndex].memory;
+        if (placedResource.texture)
         {
-            { resources, helper::GetCountOf(resources) },
-            { storageResources, helper::GetCountOf(storageResources) },
-        };
-
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+            nri::TextureMemoryBindingDesc& textureMemoryBindingDesc = textureMemoryBindingDescs.emplace_back();
+            textureMemoryBindingDesc = {};
+            textureMemoryBindingDesc.memory = memory;
+            textureMemoryBindingDesc.texture = placedResource.texture;
+            textureMemoryBindingDesc.offset = placedResource.offset;
+        }
+        else
+        {
+            nri::BufferMemoryBindingDesc& bufferMemoryBindingDesc = bufferMemoryBindingDescs.emplace_back();
+            bufferMemoryBindingDesc = {};
+            bufferMemoryBindingDesc.memory = memory;
+            bufferMemoryBindingDesc.buffer = placedResource.buffer;
+            bufferMemoryBindingDesc.offset = placedResource.offset;
+        }
     }
 
-    { // DescriptorSet::Final1
-        const nri::Descriptor* resources[] =
-        {
-            Get(Descriptor::PreFinal_Texture),
-            Get(Descriptor::Composed_Texture),
-            Get(Descriptor::Validation_Texture),
-        };
+    if (!textureMemoryBindingDescs.empty())
+        NRI_ABORT_ON_FAILURE(NRI.BindTextureMemory(*m_Device, textureMemoryBindingDescs.data(), (uint32_t)textureMemoryBindingDescs.size()));
 
-        const nri::Descriptor* storageResources[] =
-        {
-            Get(Descriptor::Final_StorageTexture),
-        };
+    if (!bufferMemoryBindingDescs.empty())
+        NRI_ABORT_ON_FAILURE(NRI.BindBufferMemory(*m_Device, bufferMemoryBindingDescs.data(), (uint32_t)bufferMemoryBindingDescs.size()));
+}
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+void Sample::AllocatePlacedRange(PlacedResource& placedResource)
+{
+    const nri::MemoryDesc& memoryDesc = placedResource.memoryDesc;
+    const uint64_t alignment = std::max<uint64_t>(memoryDesc.alignment, 1);
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+    // First fit in a heap of the same type and class
+    if (!memoryDesc.mustBeDedicated)
+    {
+        for (uint32_t heapIndex = 0; heapIndex < m_PlacedHeaps.size(); heapIndex++)
         {
-            { resources, helper::GetCountOf(resources) },
-            { storageResources, helper::GetCountOf(storageResources) },
-        };
+            PlacedHeap& placedHeap = m_PlacedHeaps[heapIndex];
+            if (placedHeap.isDedicated || placedHeap.type != memoryDesc.type || placedHeap.placedClass != placedResource.placedClass)
+                continue;
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
-    }
+            for (size_t i = 0; i < placedHeap.freeRanges.size(); i++)
+            {
+                const MemoryRange range = placedHeap.freeRanges[i];
+                const uint64_t offset = helper::Align(range.offset, alignment);
+                if (offset + memoryDesc.size > range.offset + range.size)
+                    continue;
 
-    { // DescriptorSet::DlssBefore1
-        const nri::Descriptor* resources[] =
-        {
-            Get(Descriptor::Normal_Roughness_Texture),
-            Get(Descriptor::BaseColor_Metalness_Texture),
-            Get(Descriptor::Unfiltered_Spec_Texture),
-        };
+                // Split the range, keeping the alignment padding in front
+                const MemoryRange head = {range.offset, offset - range.offset};
+                const MemoryRange tail = {offset + memoryDesc.size, range.offset + range.size - offset - memoryDesc.size};
 
-        const nri::Descriptor* storageResources[] =
-        {
-            Get(Descriptor::ViewZ_StorageTexture),
-            Get(Descriptor::RRGuide_DiffAlbedo_StorageTexture),
-            Get(Descriptor::RRGuide_SpecAlbedo_StorageTexture),
-            Get(Descriptor::RRGuide_SpecHitDistance_StorageTexture),
-            Get(Descriptor::RRGuide_Normal_Roughness_StorageTexture),
-        };
+                placedHeap.freeRanges.erase(placedHeap.freeRanges.begin() + i);
+                if (tail.size)
+                    placedHeap.freeRanges.insert(placedHeap.freeRanges.begin() + i, tail);
+                if (head.size)
+                    placedHeap.freeRanges.insert(placedHeap.freeRanges.begin() + i, head);
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+                placedHeap.resourceNum++;
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
-        {
-            { resources, helper::GetCountOf(resources) },
-            { storageResources, helper::GetCountOf(storageResources) },
-        };
+                placedResource.heapIndex = heapIndex;
+                placedResource.offset = offset;
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+                return;
+            }
+        }
     }
 
-    { // DescriptorSet::DlssAfter1
-        const nri::Descriptor* storageResources[] =
-        {
-            Get(Descriptor::DlssOutput_StorageTexture),
-        };
+    // A new heap
+    PlacedHeap& placedHeap = m_PlacedHeaps.emplace_back();
+    placedHeap = {};
+    placedHeap.size = memoryDesc.mustBeDedicated ? memoryDesc.size : std::max(PLACED_HEAP_SIZE, memoryDesc.size);
+    placedHeap.type = memoryDesc.type;
+    placedHeap.placedClass = placedResource.placedClass;
+    placedHeap.resourceNum = 1;
+    placedHeap.isDedicated = memoryDesc.mustBeDedicated;
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_OTHER, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+    if (memoryDesc.size < placedHeap.size)
+        placedHeap.freeRanges.push_back( {memoryDesc.size, placedHeap.size - memoryDesc.size} );
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
-        {
-            { storageResources, helper::GetCountOf(storageResources) },
-        };
+    nri::AllocateMemoryDesc allocateMemoryDesc = {};
+    allocateMemoryDesc.size = placedHeap.size;
+    allocateMemoryDesc.type = placedHeap.type;
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 1, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
-    }
+    NRI_ABORT_ON_FAILURE(NRI.AllocateMemory(*m_Device, allocateMemoryDesc, placedHeap.memory));
 
-    { // DescriptorSet::RayTracing2
-        const nri::Descriptor* accelerationStructures[] =
-        {
-            Get(Descriptor::World_AccelerationStructure),
-            Get(Descriptor::Light_AccelerationStructure)
-        };
+    placedResource.heapIndex = (uint32_t)m_PlacedHeaps.size() - 1;
+    placedResource.offset = 0;
+}
 
-        const nri::Descriptor* structuredBuffers[] =
-        {
-            Get(Descriptor::InstanceData_Buffer),
-            Get(Descriptor::PrimitiveData_Buffer),
-            Get(Descriptor::MorphedPrimitivePrevData_Buffer),
-        };
+void Sample::ReleasePlacedResource(const void* resource)
+{
+    for (size_t i = 0; i < m_PlacedResources.size(); i++)
+    {
+        const PlacedResource& placedResource = m_PlacedResources[i];
+        if (placedResource.texture != resource && placedResource.buffer != resource)
+            continue;
 
-        std::vector<nri::Descriptor*> textures(m_Scene.materials.size() * TEXTURES_PER_MATERIAL);
-        for (size_t i = 0; i < m_Scene.materials.size(); i++)
+        // Return the range to the heap, merging it with adjacent free ranges
+        if (placedResource.heapIndex != NOT_FOUND)
         {
-            const size_t index = i * TEXTURES_PER_MATERIAL;
-            const utils::Material& material = m_Scene.materials[i];
+            PlacedHeap& placedHeap = m_PlacedHeaps[placedResource.heapIndex];
+            placedHeap.resourceNum--;
+
+            MemoryRange range = {placedResource.offset, placedResource.memoryDesc.size};
+            auto next = std::lower_bound(placedHeap.freeRanges.begin(), placedHeap.freeRanges.end(), range, [](const MemoryRange& a, const MemoryRange& b) { return a.offset < b.offset; });
+
+            if (next != placedHeap.freeRanges.end() && range.offset + range.size == next->offset)
+            {
+                range.size += next->size;
+                next = placedHeap.freeRanges.erase(next);
+            }
 
-            textures[index] = Get( Descriptor((uint32_t)Descriptor::MaterialTextures + material.baseColorTexIndex) );
-            textures[index + 1] = Get( Descriptor((uint32_t)Descriptor::MaterialTextures + material.roughnessMetalnessTexIndex) );
-            textures[index + 2] = Get( Descriptor((uint32_t)Descriptor::MaterialTextures + material.normalTexIndex) );
-            textures[index + 3] = Get( Descriptor((uint32_t)Descriptor::MaterialTextures + material.emissiveTexIndex) );
+            if (next != placedHeap.freeRanges.begin())
+            {
+                auto prev = next - 1;
+                if (prev->offset + prev->size == range.offset)
+                {
+                    range.offset = prev->offset;
+                    range.size += prev->size;
+                    next = placedHeap.freeRanges.erase(prev);
+                }
+            }
+
+            placedHeap.freeRanges.insert(next, range);
         }
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_RAY_TRACING, &descriptorSet, 1, helper::GetCountOf(textures)));
-        m_DescriptorSets.push_back(descriptorSet);
+        m_PlacedResources[i] = m_PlacedResources.back();
+        m_PlacedResources.pop_back();
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        return;
+    }
+}
+
+void Sample::DefragmentPlacedHeaps()
+{
+    // Resources can't be moved without a copy, but render targets are recreated together on output resolution change. It leaves their heaps empty, which get freed here,
+    // and "BindPlacedResources" repacks new render targets tightly from scratch
+    std::vector<uint32_t> heapRemap(m_PlacedHeaps.size(), NOT_FOUND);
+    std::vector<PlacedHeap> placedHeaps;
+
+    for (uint32_t heapIndex = 0; heapIndex < m_PlacedHeaps.size(); heapIndex++)
+    {
+        PlacedHeap& placedHeap = m_PlacedHeaps[heapIndex];
+        if (placedHeap.resourceNum)
         {
-            { accelerationStructures, helper::GetCountOf(accelerationStructures) },
-            { structuredBuffers, helper::GetCountOf(structuredBuffers) },
-            { textures.data(), helper::GetCountOf(textures) },
-        };
+            heapRemap[heapIndex] = (uint32_t)placedHeaps.size();
+            placedHeaps.push_back(std::move(placedHeap));
+        }
+        else
+            NRI.FreeMemory(*placedHeap.memory);
+    }
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+    for (PlacedResource& placedResource : m_PlacedResources)
+    {
+        if (placedResource.heapIndex != NOT_FOUND)
+            placedResource.heapIndex = heapRemap[placedResource.heapIndex];
     }
 
-    { // DescriptorSet::MorphTargetPose3
-        const nri::Descriptor* resources[] =
-        {
-            Get(Descriptor::MorphMeshVertices_Buffer)
-        };
+    m_PlacedHeaps = std::move(placedHeaps);
+}
 
-        const nri::Descriptor* storageResources[] =
-        {
-            Get(Descriptor::MorphedPositions_StorageBuffer),
-            Get(Descriptor::MorphedAttributes_StorageBuffer),
-        };
+void Sample::ReportPlacedHeaps()
+{
+    // Fragmentation = 1 - largest free range / total free size, i.e. 0 if all free memory is contiguous
+    uint64_t reservedSize = 0;
+    uint64_t freeSize = 0;
+    uint64_t largestFreeSize = 0;
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_MORPH, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+    for (const PlacedHeap& placedHeap : m_PlacedHeaps)
+    {
+        reservedSize += placedHeap.size;
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        for (const MemoryRange& range : placedHeap.freeRanges)
         {
-            { resources, helper::GetCountOf(resources) },
-            { storageResources, helper::GetCountOf(storageResources) }
-        };
+            freeSize += range.size;
+            largestFreeSize = std::max(largestFreeSize, range.size);
+        }
+    }
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+    const double fragmentation = freeSize ? 1.0 - double(largestFreeSize) / double(freeSize) : 0.0;
 
-        nri::Descriptor* constantBuffer = Get(Descriptor::MorphTargetPose_ConstantBuffer);
-        NRI.UpdateDynamicConstantBuffers(*descriptorSet, 0, 1, &constantBuffer);
-    }
+    printf("Placed resources: %u in %u heaps (%.2f Mb used, %.2f Mb reserved, fragmentation %.1f%%)\n", (uint32_t)m_PlacedResources.size(), (uint32_t)m_PlacedHeaps.size(),
+        (reservedSize - freeSize) / (1024.0f * 1024.0f), reservedSize / (1024.0f * 1024.0f), fragmentation * 100.0);
+}
 
-    { // DescriptorSet::MorphTargetUpdatePrimitives3
-        const nri::Descriptor* resources[] =
-        {
-            Get(Descriptor::MorphMeshIndices_Buffer),
-            Get(Descriptor::MorphedPositions_Buffer),
-            Get(Descriptor::MorphedAttributes_Buffer)
-        };
+void Sample::UpdateOptionalTextures()
+{
+    bool isNeeded[(size_t)OptionalFeature::MAX_NUM] = {};
+    isNeeded[(size_t)OptionalFeature::Taa] = !IsDlssEnabled();
+    isNeeded[(size_t)OptionalFeature::Dlss] = IsDlssEnabled();
+    isNeeded[(size_t)OptionalFeature::Sh] = m_NrdMode == SH;
+
+    // Destroy textures of disabled features
+    bool isIdle = false;
+    for (const OptionalTexture& optionalTexture : optionalTextures)
+    {
+        nri::Texture*& texture = Get(optionalTexture.texture);
+        if (!texture || isNeeded[(size_t)optionalTexture.feature])
+            continue;
 
-        const nri::Descriptor* storageResources[] =
+        if (!isIdle)
         {
-            Get(Descriptor::PrimitiveData_StorageBuffer),
-            Get(Descriptor::MorphedPrimitivePrevData_StorageBuffer)
-        };
-
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_MORPH, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+            NRI.WaitForIdle(*m_GraphicsQueue);
+            isIdle = true;
+        }
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        for (uint32_t i = 0; i < 2; i++) // "_Texture" and "_StorageTexture"
         {
-            { resources, helper::GetCountOf(resources) },
-            { storageResources, helper::GetCountOf(storageResources) }
-        };
+            nri::Descriptor*& descriptor = Get( Descriptor((uint32_t)optionalTexture.descriptor + i) );
+            NRI.DestroyDescriptor(*descriptor);
+            descriptor = nullptr;
+        }
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
+        ReleasePlacedResource(texture);
+        NRI.DestroyTexture(*texture);
+        texture = nullptr;
 
-        nri::Descriptor* constantBuffer = Get(Descriptor::MorphTargetUpdatePrimitives_ConstantBuffer);
-        NRI.UpdateDynamicConstantBuffers(*descriptorSet, 0, 1, &constantBuffer);
+        GetState(optionalTexture.texture).texture = nullptr;
     }
 
-    { // DescriptorSet::SharcPing4
-        const nri::Descriptor* storageResources[] =
+    // Free heaps, which are not used anymore
+    for (uint32_t heapIndex = 0; heapIndex < m_TransientHeaps.size(); heapIndex++)
+    {
+        TransientHeap& transientHeap = m_TransientHeaps[heapIndex];
+        if (transientHeap.memory && !IsTransientHeapUsed(heapIndex))
         {
-            Get(Descriptor::SharcHashEntries_StorageBuffer),
-            Get(Descriptor::SharcHashCopyOffset_StorageBuffer),
-            Get(Descriptor::SharcVoxelDataPing_StorageBuffer),
-            Get(Descriptor::SharcVoxelDataPong_StorageBuffer),
-        };
+            NRI.FreeMemory(*transientHeap.memory);
+            transientHeap.memory = nullptr;
+        }
+    }
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_SHARC, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+    // Create textures of enabled features
+    bool isCreated[(size_t)OptionalFeature::MAX_NUM] = {};
+    for (uint32_t i = 0; i < helper::GetCountOf(optionalTextures); i++)
+    {
+        const OptionalTexture& optionalTexture = optionalTextures[i];
+        const OptionalTextureDesc& optionalTextureDesc = m_OptionalTextureDescs[i];
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
+        nri::Texture*& texture = Get(optionalTexture.texture);
+        if (texture || !isNeeded[(size_t)optionalTexture.feature])
+            continue;
+
+        const uint32_t transientIndex = FindTransientTexture(optionalTexture.texture);
+        if (ALLOW_TRANSIENT_ALIASING && transientIndex != NOT_FOUND)
         {
-            { storageResources, helper::GetCountOf(storageResources) },
-        };
+            const uint32_t heapIndex = m_TransientHeapIndices[transientIndex];
+            if (!m_TransientHeaps[heapIndex].memory)
+                AllocateTransientHeap(heapIndex);
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
-    }
+            NRI_ABORT_ON_FAILURE(NRI.CreateTexture(*m_Device, optionalTextureDesc.desc, texture));
 
-    { // DescriptorSet::SharcPong4
-        const nri::Descriptor* storageResources[] =
+            nri::TextureMemoryBindingDesc textureMemoryBindingDesc = {};
+            textureMemoryBindingDesc.memory = m_TransientHeaps[heapIndex].memory;
+            textureMemoryBindingDesc.texture = texture;
+
+            NRI_ABORT_ON_FAILURE(NRI.BindTextureMemory(*m_Device, &textureMemoryBindingDesc, 1));
+        }
+        else if (ALLOW_PLACED_RESOURCES)
         {
-            Get(Descriptor::SharcHashEntries_StorageBuffer),
-            Get(Descriptor::SharcHashCopyOffset_StorageBuffer),
-            Get(Descriptor::SharcVoxelDataPong_StorageBuffer),
-            Get(Descriptor::SharcVoxelDataPing_StorageBuffer),
-        };
+            NRI_ABORT_ON_FAILURE(NRI.CreateTexture(*m_Device, optionalTextureDesc.desc, texture));
+            AddPlacedTexture(texture, optionalTextureDesc.desc);
+            BindPlacedResources();
+        }
+        else
+        {
+            nri::AllocateTextureDesc allocateTextureDesc = {};
+            allocateTextureDesc.desc = optionalTextureDesc.desc;
+            allocateTextureDesc.memoryLocation = nri::MemoryLocation::DEVICE;
 
-        NRI_ABORT_ON_FAILURE(NRI.AllocateDescriptorSets(*m_DescriptorPool, *m_PipelineLayout, SET_SHARC, &descriptorSet, 1, 0));
-        m_DescriptorSets.push_back(descriptorSet);
+            NRI_ABORT_ON_FAILURE(NRI.AllocateTexture(*m_Device, allocateTextureDesc, texture));
+        }
 
-        const nri::DescriptorRangeUpdateDesc descriptorRangeUpdateDesc[] =
-        {
-            { storageResources, helper::GetCountOf(storageResources) },
-        };
+        NRI.SetDebugName((nri::Object*)texture, optionalTextureDesc.debugName);
 
-        NRI.UpdateDescriptorRanges(*descriptorSet, 0, helper::GetCountOf(descriptorRangeUpdateDesc), descriptorRangeUpdateDesc);
-    }
-}
+        // Views (all optional textures are 2D with storage usage)
+        nri::Texture2DViewDesc viewDesc = {texture, nri::Texture2DViewType::SHADER_RESOURCE_2D, optionalTextureDesc.desc.format};
+        NRI_ABORT_ON_FAILURE(NRI.CreateTexture2DView(viewDesc, Get(optionalTexture.descriptor)));
 
-void Sample::CreateTexture(std::vector<DescriptorDesc>& descriptorDescs, const char* debugName, nri::Format format, nri::Dim_t width, nri::Dim_t height, nri::Mip_t mipNum, nri::Dim_t arraySize, nri::TextureUsageBits usage, nri::AccessBits access)
-{
-    nri::AllocateTextureDesc allocateTextureDesc = {};
-    allocateTextureDesc.desc.type = nri::TextureType::TEXTURE_2D;
-    allocateTextureDesc.desc.usage = usage;
-    allocateTextureDesc.desc.format = format;
-    allocateTextureDesc.desc.width = width;
-    allocateTextureDesc.desc.height = height;
-    allocateTextureDesc.desc.depth = 1;
-    allocateTextureDesc.desc.mipNum = mipNum;
-    allocateTextureDesc.desc.layerNum = arraySize;
-    allocateTextureDesc.desc.sampleNum = 1;
-    allocateTextureDesc.memoryLocation = nri::MemoryLocation::DEVICE;
+        viewDesc.format = ConvertFormatToTextureStorageCompatible(optionalTextureDesc.desc.format);
+        viewDesc.viewType = nri::Texture2DViewType::SHADER_RESOURCE_STORAGE_2D;
+        NRI_ABORT_ON_FAILURE(NRI.CreateTexture2DView(viewDesc, Get( Descriptor((uint32_t)optionalTexture.descriptor + 1) )));
 
-    nri::Texture* texture = nullptr;
-    NRI_ABORT_ON_FAILURE(NRI.AllocateTexture(*m_Device, allocateTextureDesc, texture));
-    m_Textures.push_back(texture);
+        // Contents are undefined
+        nri::TextureBarrierDesc& state = GetState(optionalTexture.texture);
+        state.texture = texture;
+        state.after = {nri::AccessBits::UNKNOWN, nri::Layout::UNKNOWN, nri::StageBits::ALL};
 
-    if (access != nri::AccessBits::UNKNOWN)
-    {
-        nri::Layout layout = nri::Layout::SHADER_RESOURCE;
-        if (access & nri::AccessBits::COPY_SOURCE)
-            layout = nri::Layout::COPY_SOURCE;
-        else if (access & nri::AccessBits::COPY_DESTINATION)
-            layout = nri::Layout::COPY_DESTINATION;
-        else if (access & nri::AccessBits::SHADER_RESOURCE_STORAGE)
-            layout = nri::Layout::SHADER_RESOURCE_STORAGE;
+        isCreated[(size_t)optionalTexture.feature] = true;
+    }
 
-        nri::TextureBarrierDesc transition = nri::TextureBarrierFromUnknown(texture, {access, layout});
-        m_TextureStates.push_back(transition);
+    // Patch descriptor sets in place. Sets of a disabled feature are not used, thus stale descriptors are harmless
+    for (uint32_t i = 0; i < (uint32_t)OptionalFeature::MAX_NUM; i++)
+    {
+        if (isCreated[i])
+        {
+            UpdateOptionalDescriptorSets((OptionalFeature)i);
+            m_ForceHistoryReset = true;
+        }
     }
-
-    descriptorDescs.push_back( {debugName, texture, format, usage, nri::BufferUsageBits::NONE, arraySize > 1} );
 }
 
 void Sample::CreateBuffer(std::vector<DescriptorDesc>& descriptorDescs, const char* debugName, nri::Format format, uint64_t elements, uint32_t stride, nri::BufferUsageBits usage)
@@ -3908,8 +8000,15 @@ void Sample::CreateBuffer(std::vector<DescriptorDesc>& descriptorDescs, const ch
     allocateBufferDesc.desc.usage = usage;
     allocateBufferDesc.memoryLocation = nri::MemoryLocation::DEVICE;
 
+    // Memory for placed buffers is bound in "BindPlacedResources"
     nri::Buffer* buffer = nullptr;
-    NRI_ABORT_ON_FAILURE( NRI.AllocateBuffer(*m_Device, allocateBufferDesc, buffer) );
+    if (ALLOW_PLACED_RESOURCES)
+    {
+        NRI_ABORT_ON_FAILURE( NRI.CreateBuffer(*m_Device, allocateBufferDesc.desc, buffer) );
+        AddPlacedBuffer(buffer, allocateBufferDesc.desc);
+    }
+    else
+        NRI_ABORT_ON_FAILURE( NRI.AllocateBuffer(*m_Device, allocateBufferDesc, buffer) );
     m_Buffers.push_back(buffer);
 
     if (!(usage & nri::BufferUsageBits::SCRATCH_BUFFER))
@@ -3967,19 +8066,8 @@ void Sample::UploadStaticData()
     std::vector<nri::TextureSubresourceUploadDesc> subresources;
     subresources.push_back( {coef_scale_fp16, 1, (kFilterSize / 4) * 8, (kFilterSize / 4) * kPhaseCount * 8} );
     subresources.push_back( {coef_usm_fp16, 1, (kFilterSize / 4) * 8, (kFilterSize / 4) * kPhaseCount * 8} );
-    for (const utils::Texture* texture : m_Scene.textures)
-    {
-        for (uint32_t layer = 0; layer < texture->GetArraySize(); layer++)
-        {
-            for (uint32_t mip = 0; mip < texture->GetMipNum(); mip++)
-            {
-                nri::TextureSubresourceUploadDesc subresource;
-                texture->GetSubresource(subresource, mip, layer);
-
-                subresources.push_back(subresource);
-            }
-        }
-    }
+    for (uint32_t i = 0; i < (uint32_t)m_Scene.textures.size(); i++)
+        GatherMaterialTextureSubresources(i, m_TextureResidency.empty() ? 0 : m_TextureResidency[i].residentMip, subresources);
 
     // Gather upload data for read-only textures
     std::vector<nri::TextureUploadDesc> textureUploadDescs;
@@ -3992,7 +8080,7 @@ void Sample::UploadStaticData()
         const utils::Texture* texture = m_Scene.textures[i];
         textureUploadDescs.push_back( {&subresources[subresourceOffset], Get( (Texture)((size_t)Texture::MaterialTextures + i) ), {nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE}} );
 
-        nri::Mip_t mipNum = texture->GetMipNum();
+        nri::Mip_t mipNum = texture->GetMipNum() - (m_TextureResidency.empty() ? 0 : (nri::Mip_t)m_TextureResidency[i].residentMip);
         nri::Dim_t arraySize = texture->GetArraySize();
         subresourceOffset += size_t(arraySize) * size_t(mipNum);
     }
@@ -4000,6 +8088,9 @@ void Sample::UploadStaticData()
     // Append textures without data to initialize initial state
     for (const nri::TextureBarrierDesc& state : m_TextureStates)
     {
+        if (!state.texture)
+            continue; // not created yet
+
         nri::TextureUploadDesc desc = {};
         desc.after = {state.after.access, state.after.layout};
         desc.texture = (nri::Texture*)state.texture;
@@ -4018,9 +8109,17 @@ void Sample::UploadStaticData()
         morphMeshIndexOffset += mesh.indexNum;
     }
 
+    // Indirect args of SHARC live bucket lists and wavefront queues: "x" is accumulated on GPU, "y" and "z" are constant
+    const uint32_t indirectArgs[] = {0, 1, 1, 0};
+
     // Buffer data
     nri::BufferUploadDesc bufferUploadDescs[] =
     {
+        {indirectArgs, sizeof(indirectArgs), Get(Buffer::SharcLiveArgsPing), 0, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {indirectArgs, sizeof(indirectArgs), Get(Buffer::SharcLiveArgsPong), 0, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {indirectArgs, sizeof(indirectArgs), Get(Buffer::WavefrontArgsPing), 0, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {indirectArgs, sizeof(indirectArgs), Get(Buffer::WavefrontArgsPong), 0, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {indirectArgs, sizeof(indirectArgs), Get(Buffer::WavefrontShadowArgs), 0, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
         {primitiveData.data(), helper::GetByteSizeOf(primitiveData), Get(Buffer::PrimitiveData), 0, {nri::AccessBits::SHADER_RESOURCE}},
         {morphMeshIndices.data(), helper::GetByteSizeOf(morphMeshIndices), Get(Buffer::MorphMeshIndices), 0, {nri::AccessBits::SHADER_RESOURCE}},
         {m_Scene.morphVertices.data(), helper::GetByteSizeOf(m_Scene.morphVertices), Get(Buffer::MorphMeshVertices), 0, {nri::AccessBits::SHADER_RESOURCE}}
@@ -4028,6 +8127,10 @@ void Sample::UploadStaticData()
 
     // Upload data and apply states
     NRI_ABORT_ON_FAILURE(NRI.UploadData(*m_GraphicsQueue, textureUploadDescs.data(), helper::GetCountOf(textureUploadDescs), bufferUploadDescs, helper::GetCountOf(bufferUploadDescs)));
+
+    // Compressed copies are not needed anymore, unless mips get streamed in later
+    if (m_TextureResidency.empty())
+        m_CompressedTextures = {};
 }
 
 void Sample::GatherInstanceData()
@@ -4035,7 +8138,7 @@ void Sample::GatherInstanceData()
     bool isAnimatedObjects = m_Settings.animatedObjects;
     if (m_Settings.blink)
     {
-        double period = 0.0003 * m_Timer.GetTimeStamp() * (m_Settings.animationSpeed < 0.0f ? 1.0f / (1.0f + abs(m_Settings.animationSpeed)) : (1.0f + m_Settings.animationSpeed));
+        double period = 0.0003 * GetTimeStamp() * (m_Settings.animationSpeed < 0.0f ? 1.0f / (1.0f + abs(m_Settings.animationSpeed)) : (1.0f + m_Settings.animationSpeed));
         isAnimatedObjects &= WaveTriangle(period) > 0.5;
     }
 
@@ -4204,6 +8307,8 @@ void Sample::GatherInstanceData()
                 flags |= FLAG_HAIR;
             if (material.isLeaf)
                 flags |= FLAG_LEAF;
+            if (m_IsRoughnessMetalnessXy[instance.materialIndex])
+                flags |= FLAG_ROUGHNESS_METALNESS_XY;
             if (material.IsTransparent())
                 flags |= FLAG_TRANSPARENT;
             if (i >= staticInstanceCount)
@@ -4297,7 +8402,7 @@ void Sample::UpdateConstantBuffer(uint32_t frameIndex, float resetHistoryFactor)
     uint32_t rectHprev = uint32_t(m_RenderResolution.y * m_SettingsPrev.resolutionScale + 0.5f);
 
     float2 renderSize = float2(float(m_RenderResolution.x), float(m_RenderResolution.y));
-    float2 outputSize = float2(float(GetOutputResolution().x), float(GetOutputResolution().y));
+    float2 outputSize = float2(float(m_OutputResolution.x), float(m_OutputResolution.y));
     float2 windowSize = float2(float(GetWindowResolution().x), float(GetWindowResolution().y));
     float2 rectSize = float2( float(rectW), float(rectH) );
     float2 rectSizePrev = float2( float(rectWprev), float(rectHprev) );
@@ -4312,15 +8417,23 @@ void Sample::UpdateConstantBuffer(uint32_t frameIndex, float resetHistoryFactor)
     float baseMipBias = ((m_Settings.TAA || IsDlssEnabled()) ? -0.5f : 0.0f) + log2f(m_Settings.resolutionScale);
     float mipBias = baseMipBias + log2f(renderSize.x / outputSize.x);
 
-    uint32_t onScreen = m_Settings.onScreen + (NRD_MODE >= OCCLUSION ? SHOW_AMBIENT_OCCLUSION : 0); // preserve original mapping
+    uint32_t onScreen = m_Settings.onScreen + (m_NrdMode >= OCCLUSION ? SHOW_AMBIENT_OCCLUSION : 0); // preserve original mapping
 
-    float fps = 1000.0f / m_Timer.GetSmoothedFrameTime();
+    float fps = 1000.0f / GetSmoothedFrameTime();
     fps = min(fps, 121.0f);
     float otherMaxAccumulatedFrameNum = fps * ACCUMULATION_TIME;
     otherMaxAccumulatedFrameNum = min(otherMaxAccumulatedFrameNum, float(MAX_HISTORY_FRAME_NUM));
     otherMaxAccumulatedFrameNum *= resetHistoryFactor;
 
     uint32_t sharcMaxAccumulatedFrameNum = (uint32_t)(otherMaxAccumulatedFrameNum * (m_Settings.boost ? 0.667f : 1.0f) + 0.5f);
+
+    // SHARC update density: camera motion in update pixels per frame (translation as for a surface 1 m away) limits how sparse tiles can get
+    float3 viewDirPrev = float3(m_Camera.statePrev.mViewToWorld[2].xyz) * (m_PositiveZ ? -1.0f : 1.0f);
+    float cameraRotation = acosf( clamp(dot(viewDir, viewDirPrev), -1.0f, 1.0f) );
+    float cameraTranslation = length(cameraGlobalPos - cameraGlobalPosPrev) / m_Settings.meterToUnitsMultiplier;
+    float sharcUpdatePixelAngle = SHARC_DOWNSCALE * radians(m_Settings.camFov) / float(rectW);
+    float sharcUpdateMotion = (cameraRotation + cameraTranslation) / sharcUpdatePixelAngle;
+    uint32_t sharcUpdateLevelMax = SHARC_UPDATE_LEVEL_MAX - std::min((uint32_t)log2f(1.0f + sharcUpdateMotion), (uint32_t)SHARC_UPDATE_LEVEL_MAX);
     float taaMaxAccumulatedFrameNum = otherMaxAccumulatedFrameNum * 0.5f;
     float prevFrameMaxAccumulatedFrameNum = otherMaxAccumulatedFrameNum * 0.3f;
 
@@ -4349,17 +8462,20 @@ void Sample::UpdateConstantBuffer(uint32_t frameIndex, float resetHistoryFactor)
     DecomposeProjection(STYLE_D3D, STYLE_D3D, m_Camera.state.mViewToClip, &flags, nullptr, nullptr, frustum.a, project, nullptr);
     float orthoMode = ( flags & PROJ_ORTHO ) == 0 ? 0.0f : -1.0f;
 
-    nri::DisplayDesc displayDesc = {};
-    NRI.GetDisplayDesc(*m_SwapChain, displayDesc);
+    if (!m_Headless)
+    {
+        nri::DisplayDesc displayDesc = {};
+        NRI.GetDisplayDesc(*m_SwapChain, displayDesc);
 
-    m_SdrScale = displayDesc.sdrLuminance / 80.0f;
+        m_SdrScale = displayDesc.sdrLuminance / 80.0f;
+    }
 
     // NIS
     NISConfig config = {};
     {
         float sharpness = m_Settings.sharpness + lerp( (1.0f - m_Settings.sharpness) * 0.25f, 0.0f, (m_Settings.resolutionScale - 0.5f) * 2.0f );
 
-        uint4 dimsOut = uint4(GetOutputResolution().x, GetOutputResolution().y, GetOutputResolution().x, GetOutputResolution().y);
+        uint4 dimsOut = uint4(m_OutputResolution.x, m_OutputResolution.y, m_OutputResolution.x, m_OutputResolution.y);
         uint4 dimsIn = uint4(rectW, rectH, m_RenderResolution.x, m_RenderResolution.y);
         if (IsDlssEnabled())
             dimsIn = dimsOut;
@@ -4412,7 +8528,7 @@ void Sample::UpdateConstantBuffer(uint32_t frameIndex, float resetHistoryFactor)
         constants.gTanSunAngularRadius                          = tan( radians( m_Settings.sunAngularDiameter * 0.5f ) );
         constants.gTanPixelAngularRadius                        = tan( 0.5f * radians(m_Settings.camFov) / rectSize.x );
         constants.gDebug                                        = m_Settings.debug;
-        constants.gPrevFrameConfidence                          = (m_Settings.usePrevFrame && NRD_MODE < OCCLUSION && !m_Settings.RR) ? prevFrameMaxAccumulatedFrameNum / (1.0f + prevFrameMaxAccumulatedFrameNum) : 0.0f;
+        constants.gPrevFrameConfidence                          = (m_Settings.usePrevFrame && m_NrdMode < OCCLUSION && !m_Settings.RR) ? prevFrameMaxAccumulatedFrameNum / (1.0f + prevFrameMaxAccumulatedFrameNum) : 0.0f;
         constants.gMinProbability                               = minProbability;
         constants.gUnproject                                    = 1.0f / (0.5f * rectH * project[1]);
         constants.gAperture                                     = m_DofAperture * 0.01f;
@@ -4423,9 +8539,14 @@ void Sample::UpdateConstantBuffer(uint32_t frameIndex, float resetHistoryFactor)
         constants.gExposure                                     = m_Settings.exposure;
         constants.gMipBias                                      = mipBias;
         constants.gOrthoMode                                    = orthoMode;
+        constants.gViewZScale                                   = m_ViewZScale;
         constants.gSharcMaxAccumulatedFrameNum                  = sharcMaxAccumulatedFrameNum;
+        constants.gSharcCapacity                                = m_SharcCapacity;
+        constants.gTextureFeedback                              = m_TextureResidency.empty() ? 0 : 1;
+        constants.gSharcRecordHits                              = m_SharcHitsFile ? 1 : 0;
+        constants.gSharcUpdateLevelMax                          = sharcUpdateLevelMax;
         constants.gDenoiserType                                 = (uint32_t)m_Settings.denoiser;
-        constants.gDisableShadowsAndEnableImportanceSampling    = (sunDirection.z < 0.0f && m_Settings.importanceSampling && NRD_MODE < OCCLUSION) ? 1 : 0;
+        constants.gDisableShadowsAndEnableImportanceSampling    = (sunDirection.z < 0.0f && m_Settings.importanceSampling && m_NrdMode < OCCLUSION) ? 1 : 0;
         constants.gOnScreen                                     = onScreen;
         constants.gFrameIndex                                   = frameIndex;
         constants.gForcedMaterial                               = m_Settings.forcedMaterial;
@@ -4469,25 +8590,669 @@ void Sample::UpdateConstantBuffer(uint32_t frameIndex, float resetHistoryFactor)
         constants.gNisOutputViewportHeight                      = config.kOutputViewportHeight;
     }
 
-    m_GlobalConstantBufferOffset = NRI.UpdateStreamerConstantBuffer(*m_Streamer, &constants, sizeof(constants));
+    m_GlobalConstantBufferOffset = NRI.UpdateStreamerConstantBuffer(*m_Streamer, &constants, sizeof(constants));
+}
+
+void Sample::AddRenderPass(RenderPassType type, const char* name, const TextureState* textures, uint32_t textureNum, std::function<void()>&& execute)
+{
+    RenderPass& renderPass = m_RenderPasses.emplace_back();
+    renderPass.textures.assign(textures, textures + textureNum);
+    renderPass.execute = std::move(execute);
+    renderPass.name = name;
+    renderPass.type = type;
+    renderPass.isCulled = false;
+}
+
+void Sample::ExecuteRenderPasses(nri::CommandBuffer& commandBuffer)
+{
+    CullRenderPasses(m_RenderPasses, m_Textures.size());
+    m_RenderPassMergedTextures.clear();
+
+    if (!m_IsGBufferProfileReported)
+    {
+        ReportGBufferProfileBandwidth();
+        m_IsGBufferProfileReported = true;
+    }
+
+    // Execute
+    for (size_t i = 0; i < m_RenderPasses.size(); i++)
+    {
+        const RenderPass& renderPass = m_RenderPasses[i];
+        if (renderPass.isCulled)
+            continue;
+
+        if (renderPass.type == RenderPassType::MARKER)
+        {
+            renderPass.execute();
+            continue;
+        }
+
+        helper::Annotation annotation(NRI, commandBuffer, renderPass.name);
+
+        if (renderPass.type != RenderPassType::EXTERNAL)
+        {
+            m_RenderPassBarriers.clear();
+            GatherRenderPassBarriers(m_RenderPasses, i, m_TextureStates, m_AliasedTextures, m_RenderPassMergedTextures, m_RenderPassBarriers);
+
+            if (!m_RenderPassBarriers.empty())
+            {
+                nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, m_RenderPassBarriers.data(), (uint16_t)m_RenderPassBarriers.size()};
+                NRI.CmdBarrier(commandBuffer, transitionBarriers);
+            }
+        }
+
+        renderPass.execute();
+    }
+}
+
+void Sample::ReportGBufferProfileBandwidth()
+{
+    if (m_GBufferProfile == GBufferProfile::DEFAULT)
+        return;
+
+    // Estimation: each declared texture is touched once at full render resolution
+    auto GetSize = [](const nri::TextureDesc& textureDesc, nri::Format format)
+    { return double(textureDesc.width) * double(textureDesc.height) * double(nri::nriGetFormatProps(format).stride) / (1024.0 * 1024.0); };
+
+    printf("G-buffer profile '%s', estimated texture traffic vs '%s':\n", gbufferProfileNames[(size_t)m_GBufferProfile], gbufferProfileNames[(size_t)GBufferProfile::DEFAULT]);
+
+    double totalSize = 0.0;
+    double totalDefaultSize = 0.0;
+    for (const RenderPass& renderPass : m_RenderPasses)
+    {
+        if (renderPass.isCulled || renderPass.type == RenderPassType::MARKER)
+            continue;
+
+        double size = 0.0;
+        double defaultSize = 0.0;
+        for (const TextureState& textureState : renderPass.textures)
+        {
+            const nri::Texture* texture = Get(textureState.texture);
+            if (!texture)
+                continue;
+
+            const nri::TextureDesc& textureDesc = NRI.GetTextureDesc(*texture);
+            nri::Format defaultFormat = GetGBufferFormat(textureState.texture, GBufferProfile::DEFAULT);
+
+            size += GetSize(textureDesc, textureDesc.format);
+            defaultSize += GetSize(textureDesc, defaultFormat == nri::Format::UNKNOWN ? textureDesc.format : defaultFormat);
+        }
+
+        if (size != defaultSize)
+            printf("  %-24s: %.1f Mb -> %.1f Mb (%+.1f%%)\n", renderPass.name, defaultSize, size, 100.0 * (size - defaultSize) / defaultSize);
+
+        totalSize += size;
+        totalDefaultSize += defaultSize;
+    }
+
+    printf("  %-24s: %.1f Mb -> %.1f Mb (%+.1f%%)\n", "Total", totalDefaultSize, totalSize, 100.0 * (totalSize - totalDefaultSize) / totalDefaultSize);
+    printf("  Timing deltas: run '--benchmark' with '--gbufferProfile=0' and use its report as '--benchmarkBaseline'\n");
+}
+
+void Sample::WriteTimestamp(nri::CommandBuffer& commandBuffer, uint32_t bufferedFrameIndex, Timestamp timestamp)
+{
+    NRI.CmdEndQuery(commandBuffer, *m_TimestampQueryPool, bufferedFrameIndex * (uint32_t)Timestamp::MAX_NUM + (uint32_t)timestamp);
+}
+
+void Sample::WriteWavefrontTimestamp(nri::CommandBuffer& commandBuffer, uint32_t bufferedFrameIndex, WavefrontStage stage)
+{
+    // "MAX_NUM" opens the sequence, other queries close an interval of "stage"
+    Frame& frame = m_Frames[bufferedFrameIndex];
+    if (frame.wavefrontQueryNum == WAVEFRONT_QUERY_MAX_NUM)
+        return;
+
+    NRI.CmdEndQuery(commandBuffer, *m_WavefrontQueryPool, bufferedFrameIndex * WAVEFRONT_QUERY_MAX_NUM + frame.wavefrontQueryNum);
+    frame.wavefrontStages[frame.wavefrontQueryNum++] = (uint8_t)stage;
+}
+
+void Sample::UpdateLatency()
+{
+    if (m_NullDevice)
+        return;
+
+    // Frames complete in order, the CPU time of fence observation is used as GPU completion time. It's exact if "LatencySleep" had to wait
+    const uint64_t completedFrameNum = NRI.GetFenceValue(*m_FrameFence);
+    const double timeStamp = m_Timer.GetTimeStamp();
+
+    for (; m_LatencyFrameNum < completedFrameNum; m_LatencyFrameNum++)
+    {
+        const Frame& frame = m_Frames[m_LatencyFrameNum % BUFFERED_FRAME_MAX_NUM];
+
+        float inputToPresent = float(frame.presentTimeStamp - frame.inputTimeStamp);
+        float inputToGpu = float(timeStamp - frame.inputTimeStamp);
+
+        m_InputToPresentLatency = m_LatencyFrameNum ? lerp(m_InputToPresentLatency, inputToPresent, 0.1f) : inputToPresent;
+        m_InputToGpuLatency = m_LatencyFrameNum ? lerp(m_InputToGpuLatency, inputToGpu, 0.1f) : inputToGpu;
+    }
+}
+
+void Sample::UpdateGpuTimes(uint32_t bufferedFrameIndex)
+{
+    const uint64_t size = (uint32_t)Timestamp::MAX_NUM * sizeof(uint64_t);
+    const uint64_t* timestamps = (uint64_t*)NRI.MapBuffer(*m_TimestampBuffer, bufferedFrameIndex * size, size);
+    if (!timestamps) // NONE backend
+        return;
+
+    const double toMs = 1000.0 / double(NRI.GetDeviceDesc(*m_Device).timestampFrequencyHz);
+
+    m_GpuTimes[0] = 0.0;
+    for (uint32_t i = 1; i < (uint32_t)Timestamp::MAX_NUM; i++)
+        m_GpuTimes[i] = double(timestamps[i] - timestamps[i - 1]) * toMs;
+
+    m_GpuFrameTime = double(timestamps[(uint32_t)Timestamp::MAX_NUM - 1] - timestamps[0]) * toMs;
+
+    NRI.UnmapBuffer(*m_TimestampBuffer);
+
+    // Wavefront stages (see "WriteWavefrontTimestamp")
+    const Frame& frame = m_Frames[bufferedFrameIndex];
+
+    m_WavefrontGpuTimes = {};
+    m_IsWavefrontGpuTimesBinned = frame.rayBinning;
+    if (!frame.wavefrontQueryNum)
+        return;
+
+    const uint64_t wavefrontSize = WAVEFRONT_QUERY_MAX_NUM * sizeof(uint64_t);
+    const uint64_t* wavefrontTimestamps = (uint64_t*)NRI.MapBuffer(*m_WavefrontTimestampBuffer, bufferedFrameIndex * wavefrontSize, frame.wavefrontQueryNum * sizeof(uint64_t));
+
+    for (uint32_t i = 1; i < frame.wavefrontQueryNum; i++)
+        m_WavefrontGpuTimes[frame.wavefrontStages[i]] += double(wavefrontTimestamps[i] - wavefrontTimestamps[i - 1]) * toMs;
+
+    NRI.UnmapBuffer(*m_WavefrontTimestampBuffer);
+}
+
+Pipeline Sample::GetTraceOpaquePipeline() const
+{
+    // Permutations bake settings of common configurations (see "TraceOpaque.cs.hlsl"), must match "UpdateConstantBuffer"
+    const int32_t tracingMode = m_Settings.RR ? RESOLUTION_FULL_PROBABILISTIC : m_Settings.tracingMode;
+    if (m_Settings.rpp != 1)
+        return Pipeline::TraceOpaque;
+
+    if (tracingMode == RESOLUTION_FULL_PROBABILISTIC)
+        return m_Settings.bounceNum == 1 ? Pipeline::TraceOpaqueProbabilistic : Pipeline::TraceOpaque;
+
+    return tracingMode == RESOLUTION_HALF ? Pipeline::TraceOpaqueHalf : Pipeline::TraceOpaqueFull;
+}
+
+void Sample::DispatchWavefront(nri::CommandBuffer& commandBuffer, uint32_t bufferedFrameIndex)
+{
+    // See "TraceOpaqueWavefront.hlsli". Paths of a pixel are traced one after another, bounces of a path ping-pong queues and their indirect args
+    const int32_t tracingMode = m_Settings.RR ? RESOLUTION_FULL_PROBABILISTIC : m_Settings.tracingMode;
+    const uint32_t pathNum = uint32_t(m_Settings.rpp) << (tracingMode == RESOLUTION_FULL ? 1 : 0);
+    const uint32_t bounceNum = (uint32_t)m_Settings.bounceNum;
+
+    const bool rayBinning = m_Frames[bufferedFrameIndex].rayBinning;
+
+    const uint32_t rectWmod = uint32_t(m_RenderResolution.x * m_Settings.resolutionScale + 0.5f);
+    const uint32_t rectHmod = uint32_t(m_RenderResolution.y * m_Settings.resolutionScale + 0.5f);
+
+    const nri::BufferBarrierDesc transitions[] = {
+        {Get(Buffer::WavefrontPixels), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {Get(Buffer::WavefrontPaths), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {Get(Buffer::WavefrontQueuePing), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {Get(Buffer::WavefrontQueuePong), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {Get(Buffer::WavefrontShadowQueue), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {Get(Buffer::WavefrontBins), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {Get(Buffer::WavefrontBinOffsets), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+        {Get(Buffer::WavefrontSortedQueue), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+    };
+
+    nri::BarrierGroupDesc barrierGroupDesc = {};
+    barrierGroupDesc.buffers = transitions;
+    barrierGroupDesc.bufferNum = (uint16_t)helper::GetCountOf(transitions);
+
+    // Only the counter of a queue and the group count of its args are zeroed, "y" and "z" args stay 1
+    auto ResetQueue = [&](Buffer queue, Buffer args)
+    {
+        nri::BufferBarrierDesc resetTransitions[] = {
+            {Get(queue), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+            {Get(args), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+        };
+
+        nri::BarrierGroupDesc resetBarrierGroupDesc = {};
+        resetBarrierGroupDesc.buffers = resetTransitions;
+        resetBarrierGroupDesc.bufferNum = (uint16_t)helper::GetCountOf(resetTransitions);
+
+        NRI.CmdBarrier(commandBuffer, resetBarrierGroupDesc);
+        NRI.CmdZeroBuffer(commandBuffer, *Get(queue), 0, sizeof(uint32_t));
+        NRI.CmdZeroBuffer(commandBuffer, *Get(args), 0, sizeof(uint32_t));
+
+        for (nri::BufferBarrierDesc& transition : resetTransitions)
+            std::swap(transition.before, transition.after);
+        NRI.CmdBarrier(commandBuffer, resetBarrierGroupDesc);
+    };
+
+    // Args are accumulated by the previous stage
+    auto DispatchQueue = [&](Buffer args)
+    {
+        nri::BufferBarrierDesc argsTransition = {Get(args), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::ARGUMENT_BUFFER}};
+
+        nri::BarrierGroupDesc argsBarrierGroupDesc = {};
+        argsBarrierGroupDesc.buffers = &argsTransition;
+        argsBarrierGroupDesc.bufferNum = 1;
+
+        NRI.CmdBarrier(commandBuffer, argsBarrierGroupDesc);
+        NRI.CmdDispatchIndirect(commandBuffer, *Get(args), 0);
+
+        std::swap(argsTransition.before, argsTransition.after);
+        NRI.CmdBarrier(commandBuffer, argsBarrierGroupDesc);
+    };
+
+    auto SetConstants = [&](uint32_t path, uint32_t bounce)
+    {
+        WavefrontConstants constants = {};
+        constants.gWavefrontPath = path;
+        constants.gWavefrontBounce = bounce;
+        constants.gWavefrontBinning = rayBinning ? 1 : 0;
+
+        const bool isPing = (bounce & 0x1) == 0;
+        uint32_t dynamicConstantBufferOffset = NRI.UpdateStreamerConstantBuffer(*m_Streamer, &constants, sizeof(constants));
+        NRI.CmdSetDescriptorSet(commandBuffer, SET_WAVEFRONT, *Get(isPing ? DescriptorSet::WavefrontPing5 : DescriptorSet::WavefrontPong5), &dynamicConstantBufferOffset);
+    };
+
+    WriteWavefrontTimestamp(commandBuffer, bufferedFrameIndex, WavefrontStage::MAX_NUM);
+
+    { // Generate
+        helper::Annotation annotation(NRI, commandBuffer, "Wavefront - Generate");
+
+        ResetQueue(Buffer::WavefrontShadowQueue, Buffer::WavefrontShadowArgs);
+        SetConstants(0, 0);
+
+        if (rayBinning)
+        { // Bins get cleared by "Scan", but not initialized
+            nri::BufferBarrierDesc binsTransition = {Get(Buffer::WavefrontBins), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}};
+
+            nri::BarrierGroupDesc binsBarrierGroupDesc = {};
+            binsBarrierGroupDesc.buffers = &binsTransition;
+            binsBarrierGroupDesc.bufferNum = 1;
+
+            NRI.CmdBarrier(commandBuffer, binsBarrierGroupDesc);
+            NRI.CmdZeroBuffer(commandBuffer, *Get(Buffer::WavefrontBins), 0, nri::WHOLE_SIZE);
+
+            std::swap(binsTransition.before, binsTransition.after);
+            NRI.CmdBarrier(commandBuffer, binsBarrierGroupDesc);
+        }
+
+        NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::TraceOpaqueGenerate));
+        NRI.CmdDispatch(commandBuffer, {(rectWmod + 15) / 16, (rectHmod + 15) / 16, 1});
+
+        WriteWavefrontTimestamp(commandBuffer, bufferedFrameIndex, WavefrontStage::Generate);
+    }
+
+    { // Shadow
+        helper::Annotation annotation(NRI, commandBuffer, "Wavefront - Shadow");
+
+        NRI.CmdBarrier(commandBuffer, barrierGroupDesc);
+        NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::TraceOpaqueShadow));
+        DispatchQueue(Buffer::WavefrontShadowArgs);
+
+        WriteWavefrontTimestamp(commandBuffer, bufferedFrameIndex, WavefrontStage::Shadow);
+    }
+
+    for (uint32_t path = 0; path < pathNum; path++)
+    {
+        for (uint32_t bounce = 0; bounce <= bounceNum; bounce++)
+        {
+            const bool isPing = (bounce & 0x1) == 0;
+            const Buffer args = isPing ? Buffer::WavefrontArgsPing : Buffer::WavefrontArgsPong;
+            const Buffer queueNext = isPing ? Buffer::WavefrontQueuePong : Buffer::WavefrontQueuePing;
+            const Buffer argsNext = isPing ? Buffer::WavefrontArgsPong : Buffer::WavefrontArgsPing;
+
+            SetConstants(path, bounce);
+
+            if (bounce != 0 && rayBinning)
+            { // Bin (counting sort of rays queued by the previous "Shade", which also fills bins)
+                helper::Annotation annotation(NRI, commandBuffer, "Wavefront - Bin");
+
+                NRI.CmdBarrier(commandBuffer, barrierGroupDesc);
+                NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::TraceOpaqueBinScan));
+                NRI.CmdDispatch(commandBuffer, {1, 1, 1});
+
+                NRI.CmdBarrier(commandBuffer, barrierGroupDesc);
+                NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::TraceOpaqueBinScatter));
+                DispatchQueue(args);
+
+                WriteWavefrontTimestamp(commandBuffer, bufferedFrameIndex, WavefrontStage::Bin);
+            }
+
+            if (bounce != 0)
+            { // Extend (rays queued by the previous "Shade")
+                helper::Annotation annotation(NRI, commandBuffer, "Wavefront - Extend");
+
+                NRI.CmdBarrier(commandBuffer, barrierGroupDesc);
+                NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::TraceOpaqueExtend));
+                DispatchQueue(args);
+
+                WriteWavefrontTimestamp(commandBuffer, bufferedFrameIndex, WavefrontStage::Extend);
+            }
+
+            { // Shade (all pixels at the path origin)
+                helper::Annotation annotation(NRI, commandBuffer, "Wavefront - Shade");
+
+                ResetQueue(queueNext, argsNext);
+
+                NRI.CmdBarrier(commandBuffer, barrierGroupDesc);
+                NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::TraceOpaqueShade));
+
+                if (bounce == 0)
+                    NRI.CmdDispatch(commandBuffer, {(rectWmod * rectHmod + LINEAR_BLOCK_SIZE - 1) / LINEAR_BLOCK_SIZE, 1, 1});
+                else
+                    DispatchQueue(args);
+
+                WriteWavefrontTimestamp(commandBuffer, bufferedFrameIndex, WavefrontStage::Shade);
+            }
+        }
+    }
+}
+
+void Sample::UpdateSharcStats(uint32_t bufferedFrameIndex)
+{
+    // Counters are accumulated by SHARC passes and queries (see "SHARC_STAT_*"). Readbacks of frames without SHARC or with another capacity are ignored
+    if (m_Frames[bufferedFrameIndex].sharcCapacity != m_SharcCapacity)
+        return;
+
+    const uint32_t* stats = (uint32_t*)NRI.MapBuffer(*m_SharcStatsBuffer, bufferedFrameIndex * SHARC_STATS_NUM * sizeof(uint32_t), SHARC_STATS_NUM * sizeof(uint32_t));
+    if (!stats) // NONE backend
+        return;
+
+    memcpy(m_SharcStats.data(), stats, sizeof(m_SharcStats));
+
+    NRI.UnmapBuffer(*m_SharcStatsBuffer);
+
+    m_SharcOccupancy = m_SharcStats[SHARC_STAT_OCCUPIED];
+    m_SharcUpdatePathNum = m_SharcStats[SHARC_STAT_UPDATE_PATHS];
+
+    // History for plots
+    auto getRate = [&](uint32_t statIndex) -> float
+    { return m_SharcStats[statIndex] ? 100.0f * m_SharcStats[statIndex + 1] / m_SharcStats[statIndex] : 0.0f; };
+
+    const uint32_t head = m_SharcStatsHead++ % SHARC_STATS_HISTORY_SIZE;
+    m_SharcStatsHistory[(size_t)SharcPlot::LOAD_FACTOR][head] = 100.0f * m_SharcOccupancy / m_SharcCapacity;
+    m_SharcStatsHistory[(size_t)SharcPlot::OPAQUE_HIT_RATE][head] = getRate(SHARC_STAT_OPAQUE_QUERIES);
+    m_SharcStatsHistory[(size_t)SharcPlot::TRANSPARENT_HIT_RATE][head] = getRate(SHARC_STAT_TRANSPARENT_QUERIES);
+    m_SharcStatsHistory[(size_t)SharcPlot::EVICTIONS][head] = float(m_SharcStats[SHARC_STAT_EVICTIONS]);
+    m_SharcStatsHistory[(size_t)SharcPlot::FAILURES][head] = float(m_SharcStats[SHARC_STAT_UPDATE_FAILURES]);
+    m_SharcStatsHistory[(size_t)SharcPlot::BOUNCES_PER_PATH][head] = m_SharcStats[SHARC_STAT_OPAQUE_BOUNCES] / float(std::max(m_SharcStats[SHARC_STAT_OPAQUE_BOUNCES + 1], 1u));
+
+    if (!m_IsSharcAdaptive || m_PendingSharcCapacity != m_SharcCapacity)
+        return;
+
+    // Grow immediately (eviction hurts quality), shrink only if the load stays low (the table gets empty after any change)
+    const float loadFactor = m_SharcOccupancy / float(m_SharcCapacity);
+    if (loadFactor > SHARC_LOAD_FACTOR_MAX && m_SharcCapacity < SHARC_CAPACITY_MAX)
+        m_PendingSharcCapacity = m_SharcCapacity << 1;
+    else if (loadFactor < SHARC_LOAD_FACTOR_MIN && m_SharcCapacity > SHARC_CAPACITY_MIN)
+    {
+        if (++m_SharcLowLoadFrameNum >= SHARC_SHRINK_FRAME_NUM)
+            m_PendingSharcCapacity = m_SharcCapacity >> 1;
+    }
+    else
+        m_SharcLowLoadFrameNum = 0;
+}
+
+void Sample::UpdateTextureFeedback(uint32_t frameIndex)
+{
+    if (m_TextureResidency.empty())
+        return;
+
+    // Feedback stores "log2( requested size ) + 1" per material texture slot, slots are mapped to scene textures here
+    const uint32_t slotNum = helper::GetCountOf(m_Scene.materials) * TEXTURES_PER_MATERIAL;
+    const uint32_t bufferedFrameIndex = frameIndex % BUFFERED_FRAME_MAX_NUM;
+
+    const uint32_t* levels = (uint32_t*)NRI.MapBuffer(*m_TextureFeedbackBuffer, bufferedFrameIndex * slotNum * sizeof(uint32_t), slotNum * sizeof(uint32_t));
+    if (!levels) // NONE backend
+        return;
+
+    for (uint32_t i = 0; i < slotNum; i++)
+    {
+        if (!levels[i])
+            continue;
+
+        const utils::Material& material = m_Scene.materials[i / TEXTURES_PER_MATERIAL];
+        const uint32_t textureIndices[TEXTURES_PER_MATERIAL] = {material.baseColorTexIndex, material.roughnessMetalnessTexIndex, material.normalTexIndex, material.emissiveTexIndex};
+        const uint32_t textureIndex = textureIndices[i % TEXTURES_PER_MATERIAL];
+
+        const utils::Texture* texture = m_Scene.textures[textureIndex];
+        const uint32_t maxSize = std::max(uint32_t(texture->GetWidth()), uint32_t(texture->GetHeight()));
+
+        uint32_t log2Size = 0;
+        while (maxSize >> (log2Size + 1))
+            log2Size++;
+
+        TextureResidency& residency = m_TextureResidency[textureIndex];
+        const uint32_t requestedMip = log2Size + 1 > levels[i] ? log2Size + 1 - levels[i] : 0;
+
+        residency.requestedMip = std::min(residency.requestedMip, requestedMip);
+        residency.lastRequestFrameIndex = frameIndex;
+    }
+
+    NRI.UnmapBuffer(*m_TextureFeedbackBuffer);
+}
+
+void Sample::UpdateTextureResidency(uint32_t frameIndex)
+{
+    if (m_TextureResidency.empty() || frameIndex % TEXTURE_STREAMING_PERIOD != 0)
+        return;
+
+    // Targets: requested mips, already resident finer mips are kept until there is memory pressure
+    const uint32_t textureNum = (uint32_t)m_TextureResidency.size();
+
+    std::vector<uint32_t> targetMips(textureNum);
+    uint64_t totalSize = 0;
+    for (uint32_t i = 0; i < textureNum; i++)
+    {
+        const TextureResidency& residency = m_TextureResidency[i];
+
+        targetMips[i] = std::min(residency.requestedMip, residency.residentMip);
+        totalSize += residency.sizes[targetMips[i]];
+    }
+
+    // Over budget: drop a top mip of a texture finer than requested (least recently requested first), otherwise of the biggest texture
+    while (totalSize > m_TextureBudget)
+    {
+        uint32_t victim = NOT_FOUND;
+        bool isVictimExcessive = false;
+
+        for (uint32_t i = 0; i < textureNum; i++)
+        {
+            const TextureResidency& residency = m_TextureResidency[i];
+            if (targetMips[i] >= residency.maxResidentMip)
+                continue;
+
+            const bool isExcessive = targetMips[i] < residency.requestedMip;
+
+            bool isBetter = victim == NOT_FOUND;
+            if (!isBetter)
+            {
+                const TextureResidency& victimResidency = m_TextureResidency[victim];
+
+                if (isExcessive != isVictimExcessive)
+                    isBetter = isExcessive;
+                else if (isExcessive && residency.lastRequestFrameIndex != victimResidency.lastRequestFrameIndex)
+                    isBetter = residency.lastRequestFrameIndex < victimResidency.lastRequestFrameIndex;
+                else
+                    isBetter = residency.sizes[targetMips[i]] > victimResidency.sizes[targetMips[victim]];
+            }
+
+            if (isBetter)
+            {
+                victim = i;
+                isVictimExcessive = isExcessive;
+            }
+        }
+
+        if (victim == NOT_FOUND)
+            break; // the budget can't hold even the coarsest mips
+
+        const TextureResidency& residency = m_TextureResidency[victim];
+        totalSize -= residency.sizes[targetMips[victim]] - residency.sizes[targetMips[victim] + 1];
+        targetMips[victim]++;
+    }
+
+    // Evictions go first, then uploads within the per-update limit (the rest gets streamed in by next updates)
+    std::vector<uint32_t> changedTextures;
+    for (uint32_t i = 0; i < textureNum; i++)
+    {
+        if (targetMips[i] > m_TextureResidency[i].residentMip)
+            changedTextures.push_back(i);
+    }
+
+    uint64_t uploadSize = 0;
+    for (uint32_t i = 0; i < textureNum; i++)
+    {
+        const TextureResidency& residency = m_TextureResidency[i];
+        if (targetMips[i] < residency.residentMip && (uploadSize == 0 || uploadSize + residency.sizes[targetMips[i]] <= TEXTURE_STREAMING_UPLOAD_SIZE))
+        {
+            changedTextures.push_back(i);
+            uploadSize += residency.sizes[targetMips[i]];
+        }
+    }
+
+    // A new feedback window
+    for (TextureResidency& residency : m_TextureResidency)
+        residency.requestedMip = residency.maxResidentMip;
+
+    if (changedTextures.empty())
+        return;
+
+    // Recreate changed textures in place (mips can't be added to or removed from an existing texture)
+    NRI.WaitForIdle(*m_GraphicsQueue);
+
+    for (uint32_t i : changedTextures)
+    {
+        nri::Texture*& texture = m_Textures[(uint32_t)Texture::MaterialTextures + i];
+        nri::Descriptor*& descriptor = m_Descriptors[(uint32_t)Descriptor::MaterialTextures + i];
+
+        NRI.DestroyDescriptor(*descriptor);
+
+        if (ALLOW_PLACED_RESOURCES)
+            ReleasePlacedResource(texture);
+        NRI.DestroyTexture(*texture);
+
+        m_TextureResidency[i].residentMip = targetMips[i];
+
+        const nri::TextureDesc textureDesc = GetMaterialTextureDesc(i, targetMips[i]);
+        if (ALLOW_PLACED_RESOURCES)
+        {
+            NRI_ABORT_ON_FAILURE(NRI.CreateTexture(*m_Device, textureDesc, texture));
+            AddPlacedTexture(texture, textureDesc);
+        }
+        else
+        {
+            nri::AllocateTextureDesc allocateTextureDesc = {};
+            allocateTextureDesc.desc = textureDesc;
+            allocateTextureDesc.memoryLocation = nri::MemoryLocation::DEVICE;
+
+            NRI_ABORT_ON_FAILURE(NRI.AllocateTexture(*m_Device, allocateTextureDesc, texture));
+        }
+    }
+
+    if (ALLOW_PLACED_RESOURCES)
+    {
+        DefragmentPlacedHeaps();
+        BindPlacedResources();
+    }
+
+    // Views and data
+    std::vector<nri::TextureSubresourceUploadDesc> subresources;
+    std::vector<size_t> subresourceOffsets;
+    for (uint32_t i : changedTextures)
+    {
+        nri::Texture* texture = m_Textures[(uint32_t)Texture::MaterialTextures + i];
+        const nri::TextureDesc textureDesc = GetMaterialTextureDesc(i, targetMips[i]);
+
+        nri::Texture2DViewDesc viewDesc = {texture, textureDesc.layerNum > 1 ? nri::Texture2DViewType::SHADER_RESOURCE_2D_ARRAY : nri::Texture2DViewType::SHADER_RESOURCE_2D, textureDesc.format};
+        NRI_ABORT_ON_FAILURE(NRI.CreateTexture2DView(viewDesc, m_Descriptors[(uint32_t)Descriptor::MaterialTextures + i]));
+
+        subresourceOffsets.push_back(subresources.size());
+        GatherMaterialTextureSubresources(i, targetMips[i], subresources);
+    }
+
+    std::vector<nri::TextureUploadDesc> textureUploadDescs;
+    for (size_t j = 0; j < changedTextures.size(); j++)
+        textureUploadDescs.push_back( {&subresources[subresourceOffsets[j]], Get( (Texture)((uint32_t)Texture::MaterialTextures + changedTextures[j]) ), {nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE}} );
+
+    NRI_ABORT_ON_FAILURE(NRI.UploadData(*m_GraphicsQueue, textureUploadDescs.data(), helper::GetCountOf(textureUploadDescs), nullptr, 0));
+
+    // Descriptor sets are not in flight after "WaitForIdle", thus can be patched in place
+    UpdateMaterialTextureDescriptors();
+
+    uint64_t residentSize = 0;
+    for (const TextureResidency& residency : m_TextureResidency)
+        residentSize += residency.sizes[residency.residentMip];
+
+    printf("Texture streaming: %u textures updated, %.2f Mb uploaded, %.2f / %.2f Mb resident\n", helper::GetCountOf(changedTextures),
+        uploadSize / (1024.0f * 1024.0f), residentSize / (1024.0f * 1024.0f), m_TextureBudget / (1024.0f * 1024.0f));
 }
 
-uint16_t Sample::BuildOptimizedTransitions(const TextureState* states, uint32_t stateNum, std::array<nri::TextureBarrierDesc, MAX_TEXTURE_TRANSITIONS_NUM>& transitions)
+void Sample::UpdateDynamicResolution(uint32_t frameIndex)
 {
-    uint32_t n = 0;
+    DynamicResolution& drs = m_DynamicResolution;
+
+    // Benchmarks and replays must run at the requested resolution
+    if (!drs.isEnabled || m_Settings.RR || m_Benchmark.isActive || m_Recording.isReplay)
+    {
+        drs.smoothedGpuFrameTime = 0.0;
+        return;
+    }
+
+    // A measured GPU frame time lags behind by the queue depth, skip frames rendered before the last change
+    const uint32_t measurementLag = (uint32_t)m_QueuedFrameNum + 1;
+    if (frameIndex < drs.lastChangeFrameIndex + measurementLag || m_GpuFrameTime <= 0.0)
+        return;
 
-    for (uint32_t i = 0; i < stateNum; i++)
+    const double gpuFrameTime = m_GpuFrameTime;
+    if (drs.smoothedGpuFrameTime == 0.0)
     {
-        const TextureState& state = states[i];
-        nri::TextureBarrierDesc& transition = GetState(state.texture);
+        drs.smoothedGpuFrameTime = gpuFrameTime;
+        drs.headroomFrameNum = 0;
+    }
+    else
+        drs.smoothedGpuFrameTime += (gpuFrameTime - drs.smoothedGpuFrameTime) * DRS_SMOOTHING;
 
-        bool isStateChanged = transition.after.access != state.after.access || transition.after.layout != state.after.layout;
-        bool isStorageBarrier = transition.after.access == nri::AccessBits::SHADER_RESOURCE_STORAGE && state.after.access == nri::AccessBits::SHADER_RESOURCE_STORAGE;
-        if (isStateChanged || isStorageBarrier)
-            transitions[n++] = nri::TextureBarrierFromState(transition, {state.after.access, state.after.layout});
+    // Cost is roughly proportional to the pixel count, i.e. to the squared scale
+    const double target = drs.budget * DRS_HEADROOM;
+    const float scale = m_Settings.resolutionScale;
+    float newScale = scale;
+    const char* reason = nullptr;
+
+    if (gpuFrameTime > drs.budget)
+    {
+        // Hard ceiling: react to a single frame over budget
+        newScale = scale * (float)sqrt(target / gpuFrameTime);
+        newScale = std::max(newScale, scale - DRS_MAX_STEP_DOWN);
+        reason = "over budget";
+        drs.headroomFrameNum = 0;
+    }
+    else if (drs.smoothedGpuFrameTime > target)
+    {
+        newScale = scale * (float)sqrt(target / drs.smoothedGpuFrameTime);
+        newScale = std::max(newScale, scale - DRS_MAX_STEP_DOWN_SMOOTHED);
+        reason = "over target";
+        drs.headroomFrameNum = 0;
     }
+    else if (drs.smoothedGpuFrameTime < target * (1.0 - DRS_HYSTERESIS))
+    {
+        // Upscale only after a stable period with headroom
+        if (++drs.headroomFrameNum >= DRS_UPSCALE_FRAME_NUM)
+        {
+            newScale = scale * (float)sqrt(target / drs.smoothedGpuFrameTime);
+            newScale = std::min(newScale, scale + DRS_MAX_STEP_UP);
+            reason = "headroom";
+            drs.headroomFrameNum = 0;
+        }
+    }
+    else
+        drs.headroomFrameNum = 0;
 
-    return (uint16_t)n;
+    newScale = clamp(newScale, m_MinResolutionScale, 1.0f);
+    if (!reason || abs(newScale - scale) < DRS_MIN_STEP)
+        return;
+
+    printf("DRS: %.3f -> %.3f (GPU %.2f ms, smoothed %.2f ms, budget %.2f ms, %s)\n", scale, newScale, gpuFrameTime, drs.smoothedGpuFrameTime, drs.budget, reason);
+
+    m_Settings.resolutionScale = newScale;
+    drs.smoothedGpuFrameTime *= (newScale * newScale) / (scale * scale);
+    drs.lastChangeFrameIndex = frameIndex;
 }
 
 void Sample::RestoreBindings(nri::CommandBuffer& commandBuffer, bool isEven)
@@ -4503,12 +9268,10 @@ void Sample::RenderFrame(uint32_t frameIndex)
 {
     nri::nriBeginAnnotation("Render frame", nri::BGRA_UNUSED);
 
-    std::array<nri::TextureBarrierDesc, MAX_TEXTURE_TRANSITIONS_NUM> optimizedTransitions = {};
-
     bool wantPrintf = IsButtonPressed(Button::Middle) || IsKeyToggled(Key::P);
     bool isEven = !(frameIndex & 0x1);
     uint32_t bufferedFrameIndex = frameIndex % BUFFERED_FRAME_MAX_NUM;
-    const Frame& frame = m_Frames[bufferedFrameIndex];
+    Frame& frame = m_Frames[bufferedFrameIndex];
     nri::CommandBuffer& commandBuffer = *frame.commandBuffer;
 
     // Sizes
@@ -4516,8 +9279,8 @@ void Sample::RenderFrame(uint32_t frameIndex)
     uint32_t rectH = uint32_t(m_RenderResolution.y * m_Settings.resolutionScale + 0.5f);
     uint32_t rectGridW = (rectW + 15) / 16;
     uint32_t rectGridH = (rectH + 15) / 16;
-    uint32_t outputGridW = (GetOutputResolution().x + 15) / 16;
-    uint32_t outputGridH = (GetOutputResolution().y + 15) / 16;
+    uint32_t outputGridW = (m_OutputResolution.x + 15) / 16;
+    uint32_t outputGridH = (m_OutputResolution.y + 15) / 16;
     uint32_t windowGridW = (GetWindowResolution().x + 15) / 16;
     uint32_t windowGridH = (GetWindowResolution().y + 15) / 16;
 
@@ -4540,42 +9303,47 @@ void Sample::RenderFrame(uint32_t frameIndex)
         nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_DIFF_RADIANCE_HITDIST, &GetState(Texture::Diff));
 
         // Diffuse occlusion
-    #if( NRD_MODE == OCCLUSION )
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_DIFF_HITDIST, &GetState(Texture::Unfiltered_Diff));
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_DIFF_HITDIST, &GetState(Texture::Diff));
-    #endif
+        if (m_NrdMode == OCCLUSION)
+        {
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_DIFF_HITDIST, &GetState(Texture::Unfiltered_Diff));
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_DIFF_HITDIST, &GetState(Texture::Diff));
+        }
 
         // Diffuse SH
-    #if( NRD_MODE == SH )
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_DIFF_SH0, &GetState(Texture::Unfiltered_Diff));
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_DIFF_SH1, &GetState(Texture::Unfiltered_DiffSh));
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_DIFF_SH0, &GetState(Texture::Diff));
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_DIFF_SH1, &GetState(Texture::DiffSh));
-    #endif
+        if (m_NrdMode == SH)
+        {
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_DIFF_SH0, &GetState(Texture::Unfiltered_Diff));
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_DIFF_SH1, &GetState(Texture::Unfiltered_DiffSh));
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_DIFF_SH0, &GetState(Texture::Diff));
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_DIFF_SH1, &GetState(Texture::DiffSh));
+        }
 
         // Diffuse directional occlusion
-    #if( NRD_MODE == DIRECTIONAL_OCCLUSION )
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_DIFF_DIRECTION_HITDIST, &GetState(Texture::Unfiltered_Diff));
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_DIFF_DIRECTION_HITDIST, &GetState(Texture::Diff));
-    #endif
+        if (m_NrdMode == DIRECTIONAL_OCCLUSION)
+        {
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_DIFF_DIRECTION_HITDIST, &GetState(Texture::Unfiltered_Diff));
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_DIFF_DIRECTION_HITDIST, &GetState(Texture::Diff));
+        }
 
         // Specular
         nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_SPEC_RADIANCE_HITDIST, &GetState(Texture::Unfiltered_Spec));
         nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_SPEC_RADIANCE_HITDIST, &GetState(Texture::Spec));
 
         // Specular occlusion
-    #if( NRD_MODE == OCCLUSION )
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_SPEC_HITDIST, &GetState(Texture::Unfiltered_Spec));
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_SPEC_HITDIST, &GetState(Texture::Spec));
-    #endif
+        if (m_NrdMode == OCCLUSION)
+        {
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_SPEC_HITDIST, &GetState(Texture::Unfiltered_Spec));
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_SPEC_HITDIST, &GetState(Texture::Spec));
+        }
 
         // Specular SH
-    #if( NRD_MODE == SH )
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_SPEC_SH0, &GetState(Texture::Unfiltered_Spec));
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_SPEC_SH1, &GetState(Texture::Unfiltered_SpecSh));
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_SPEC_SH0, &GetState(Texture::Spec));
-        nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_SPEC_SH1, &GetState(Texture::SpecSh));
-    #endif
+        if (m_NrdMode == SH)
+        {
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_SPEC_SH0, &GetState(Texture::Unfiltered_Spec));
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_SPEC_SH1, &GetState(Texture::Unfiltered_SpecSh));
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_SPEC_SH0, &GetState(Texture::Spec));
+            nrd::Integration_SetResource(userPool, nrd::ResourceType::OUT_SPEC_SH1, &GetState(Texture::SpecSh));
+        }
 
         // SIGMA
         nrd::Integration_SetResource(userPool, nrd::ResourceType::IN_PENUMBRA, &GetState(Texture::Unfiltered_Penumbra));
@@ -4608,7 +9376,7 @@ void Sample::RenderFrame(uint32_t frameIndex)
     commonSettings.rectSize[1] = (uint16_t)(m_RenderResolution.y * m_Settings.resolutionScale + 0.5f);
     commonSettings.rectSizePrev[0] = (uint16_t)(m_RenderResolution.x * m_SettingsPrev.resolutionScale + 0.5f);
     commonSettings.rectSizePrev[1] = (uint16_t)(m_RenderResolution.y * m_SettingsPrev.resolutionScale + 0.5f);
-    commonSettings.viewZScale = 1.0f;
+    commonSettings.viewZScale = 1.0f / m_ViewZScale;
     commonSettings.denoisingRange = GetDenoisingRange();
     commonSettings.disocclusionThreshold = 0.01f;
     commonSettings.disocclusionThresholdAlternate = 0.05f;
@@ -4636,8 +9404,18 @@ void Sample::RenderFrame(uint32_t frameIndex)
 
     const uint32_t dummyDynamicConstantOffset = 0;
 
+    DiscardTransientTextures();
+
     NRI.BeginCommandBuffer(commandBuffer, m_DescriptorPool);
     {
+        NRI.CmdResetQueries(commandBuffer, *m_TimestampQueryPool, bufferedFrameIndex * (uint32_t)Timestamp::MAX_NUM, (uint32_t)Timestamp::MAX_NUM);
+        WriteTimestamp(commandBuffer, bufferedFrameIndex, Timestamp::Begin);
+
+        frame.wavefrontQueryNum = 0;
+        frame.rayBinning = m_Wavefront && (m_RayBinning == 1 || (m_RayBinning == 2 && (frameIndex & 0x1)));
+        if (m_Wavefront)
+            NRI.CmdResetQueries(commandBuffer, *m_WavefrontQueryPool, bufferedFrameIndex * WAVEFRONT_QUERY_MAX_NUM, WAVEFRONT_QUERY_MAX_NUM);
+
         //======================================================================================================================================
         // Resolution independent
         //======================================================================================================================================
@@ -4834,58 +9612,177 @@ void Sample::RenderFrame(uint32_t frameIndex)
             }
         }
 
+        WriteTimestamp(commandBuffer, bufferedFrameIndex, Timestamp::AccelerationStructures);
+
         // Must be bound here, after updating "Buffer::InstanceData"
         NRI.CmdSetDescriptorSet(commandBuffer, SET_RAY_TRACING, *Get(DescriptorSet::RayTracing2), nullptr);
         NRI.CmdSetDescriptorSet(commandBuffer, SET_SHARC, isEven ? *Get(DescriptorSet::SharcPing4) : *Get(DescriptorSet::SharcPong4), nullptr);
 
+        if (!m_TextureResidency.empty())
+        { // Texture streaming feedback reset
+            nri::BufferBarrierDesc feedbackTransition = {Get(Buffer::TextureFeedback), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}};
+
+            nri::BarrierGroupDesc feedbackBarrierGroupDesc = {};
+            feedbackBarrierGroupDesc.buffers = &feedbackTransition;
+            feedbackBarrierGroupDesc.bufferNum = 1;
+
+            NRI.CmdBarrier(commandBuffer, feedbackBarrierGroupDesc);
+            NRI.CmdZeroBuffer(commandBuffer, *Get(Buffer::TextureFeedback), 0, nri::WHOLE_SIZE);
+
+            std::swap(feedbackTransition.before, feedbackTransition.after);
+            NRI.CmdBarrier(commandBuffer, feedbackBarrierGroupDesc);
+        }
+
         //======================================================================================================================================
         // Render resolution
         //======================================================================================================================================
 
         // SHARC
-        if (m_Settings.SHARC && NRD_MODE < OCCLUSION)
+        frame.sharcCapacity = (m_Settings.SHARC && m_NrdMode < OCCLUSION) ? m_SharcCapacity : 0;
+
+        if (m_Settings.SHARC && m_NrdMode < OCCLUSION)
         {
             helper::Annotation sharc(NRI, commandBuffer, "Radiance cache");
 
+            // Maintenance passes run over buckets listed in "SharcLiveBuckets" (occupied or hit by "Update"), lists are ping-ponged like voxel data
+            nri::Buffer* liveBuckets = Get(isEven ? Buffer::SharcLiveBucketsPing : Buffer::SharcLiveBucketsPong);
+            nri::Buffer* liveBucketsNext = Get(isEven ? Buffer::SharcLiveBucketsPong : Buffer::SharcLiveBucketsPing);
+            nri::Buffer* liveArgs = Get(isEven ? Buffer::SharcLiveArgsPing : Buffer::SharcLiveArgsPong);
+            nri::Buffer* liveArgsNext = Get(isEven ? Buffer::SharcLiveArgsPong : Buffer::SharcLiveArgsPing);
+
             const nri::BufferBarrierDesc transitions[] = {
                 {Get(Buffer::SharcHashEntries), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
                 {Get(Buffer::SharcVoxelDataPing), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
                 {Get(Buffer::SharcVoxelDataPong), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
                 {Get(Buffer::SharcHashCopyOffset), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+                {Get(Buffer::SharcStats), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+                {liveBuckets, {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+                {liveBucketsNext, {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+                {liveArgsNext, {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+                {Get(Buffer::SharcBucketMask), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+                {Get(Buffer::SharcHits), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
+                {Get(Buffer::SharcUpdateLevels), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::SHADER_RESOURCE_STORAGE}},
             };
 
             nri::BarrierGroupDesc barrierGroupDesc = {};
             barrierGroupDesc.buffers = transitions;
             barrierGroupDesc.bufferNum = (uint16_t)helper::GetCountOf(transitions);
 
+            // "Update" appends to the current list, indirect dispatches read it
+            nri::BufferBarrierDesc argsTransition = {liveArgs, {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::ARGUMENT_BUFFER}};
+
+            nri::BarrierGroupDesc argsBarrierGroupDesc = {};
+            argsBarrierGroupDesc.buffers = &argsTransition;
+            argsBarrierGroupDesc.bufferNum = 1;
+
+            { // Reset (statistics, hit counter and the next list every frame, update density after a history reset, the hash table and the current list after a capacity change)
+                helper::Annotation annotation(NRI, commandBuffer, "SHARC - Reset");
+
+                nri::BufferBarrierDesc resetTransitions[] = {
+                    {Get(Buffer::SharcStats), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+                    {liveBucketsNext, {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+                    {liveArgsNext, {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+                    {Get(Buffer::SharcHits), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+                    {Get(Buffer::SharcUpdateLevels), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+                    {liveBuckets, {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+                    {liveArgs, {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+                    {Get(Buffer::SharcBucketMask), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+                    {Get(Buffer::SharcHashEntries), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+                    {Get(Buffer::SharcHashCopyOffset), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+                    {Get(Buffer::SharcVoxelDataPing), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+                    {Get(Buffer::SharcVoxelDataPong), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_DESTINATION}},
+                };
+
+                // Only the bucket counter of a list and the group count of its args are zeroed, "y" and "z" args stay 1
+                const uint64_t resetSizes[] = {
+                    nri::WHOLE_SIZE,
+                    sizeof(uint32_t),
+                    sizeof(uint32_t),
+                    sizeof(uint32_t),
+                    nri::WHOLE_SIZE,
+                    sizeof(uint32_t),
+                    sizeof(uint32_t),
+                    nri::WHOLE_SIZE,
+                    nri::WHOLE_SIZE,
+                    nri::WHOLE_SIZE,
+                    nri::WHOLE_SIZE,
+                    nri::WHOLE_SIZE,
+                };
+
+                uint32_t resetBufferNum = m_ForceHistoryReset ? 5 : 4;
+                if (m_IsSharcResetPending)
+                    resetBufferNum = helper::GetCountOf(resetTransitions);
+
+                nri::BarrierGroupDesc resetBarrierGroupDesc = {};
+                resetBarrierGroupDesc.buffers = resetTransitions;
+                resetBarrierGroupDesc.bufferNum = (uint16_t)resetBufferNum;
+
+                NRI.CmdBarrier(commandBuffer, resetBarrierGroupDesc);
+
+                for (uint32_t i = 0; i < resetBufferNum; i++)
+                {
+                    NRI.CmdZeroBuffer(commandBuffer, *resetTransitions[i].buffer, 0, resetSizes[i]);
+
+                    std::swap(resetTransitions[i].before, resetTransitions[i].after);
+                }
+
+                NRI.CmdBarrier(commandBuffer, resetBarrierGroupDesc);
+
+                m_IsSharcResetPending = false;
+            }
+
             { // Clear
                 helper::Annotation annotation(NRI, commandBuffer, "SHARC - Clear");
 
                 NRI.CmdBarrier(commandBuffer, barrierGroupDesc);
+                NRI.CmdBarrier(commandBuffer, argsBarrierGroupDesc);
                 NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::SharcClear));
 
-                NRI.CmdDispatch(commandBuffer, {(SHARC_CAPACITY + LINEAR_BLOCK_SIZE - 1) / LINEAR_BLOCK_SIZE, 1, 1});
+                NRI.CmdDispatchIndirect(commandBuffer, *liveArgs, 0);
             }
 
             { // Update
                 helper::Annotation annotation(NRI, commandBuffer, "SHARC - Update");
 
+                std::swap(argsTransition.before, argsTransition.after);
+
                 NRI.CmdBarrier(commandBuffer, barrierGroupDesc);
+                NRI.CmdBarrier(commandBuffer, argsBarrierGroupDesc);
                 NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::SharcUpdate));
 
-                uint32_t w = (m_RenderResolution.x / SHARC_DOWNSCALE + 15) / 16;
-                uint32_t h = (m_RenderResolution.y / SHARC_DOWNSCALE + 15) / 16;
+                uint32_t w = (m_RenderResolution.x / SHARC_DOWNSCALE + SHARC_UPDATE_TILE_SIZE - 1) / SHARC_UPDATE_TILE_SIZE;
+                uint32_t h = (m_RenderResolution.y / SHARC_DOWNSCALE + SHARC_UPDATE_TILE_SIZE - 1) / SHARC_UPDATE_TILE_SIZE;
 
                 NRI.CmdDispatch(commandBuffer, {w, h, 1});
             }
 
+            if (m_SharcHitsFile)
+            { // Hit recording readback
+                nri::BufferBarrierDesc hitsTransition = {Get(Buffer::SharcHits), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_SOURCE}};
+
+                nri::BarrierGroupDesc hitsBarrierGroupDesc = {};
+                hitsBarrierGroupDesc.buffers = &hitsTransition;
+                hitsBarrierGroupDesc.bufferNum = 1;
+
+                NRI.CmdBarrier(commandBuffer, hitsBarrierGroupDesc);
+                NRI.CmdCopyBuffer(commandBuffer, *m_SharcHitsReadbackBuffer, 0, *Get(Buffer::SharcHits), 0, nri::WHOLE_SIZE);
+
+                std::swap(hitsTransition.before, hitsTransition.after);
+                NRI.CmdBarrier(commandBuffer, hitsBarrierGroupDesc);
+
+                m_IsSharcHitsReadbackPending = true;
+            }
+
             { // Resolve
                 helper::Annotation annotation(NRI, commandBuffer, "SHARC - Resolve");
 
+                std::swap(argsTransition.before, argsTransition.after);
+
                 NRI.CmdBarrier(commandBuffer, barrierGroupDesc);
+                NRI.CmdBarrier(commandBuffer, argsBarrierGroupDesc);
                 NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::SharcResolve));
 
-                NRI.CmdDispatch(commandBuffer, {(SHARC_CAPACITY + LINEAR_BLOCK_SIZE - 1) / LINEAR_BLOCK_SIZE, 1, 1});
+                NRI.CmdDispatchIndirect(commandBuffer, *liveArgs, 0);
             }
 
             { // Hash copy
@@ -4894,14 +9791,41 @@ void Sample::RenderFrame(uint32_t frameIndex)
                 NRI.CmdBarrier(commandBuffer, barrierGroupDesc);
                 NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::SharcHashCopy));
 
-                NRI.CmdDispatch(commandBuffer, {(SHARC_CAPACITY + LINEAR_BLOCK_SIZE - 1) / LINEAR_BLOCK_SIZE, 1, 1});
+                NRI.CmdDispatchIndirect(commandBuffer, *liveArgs, 0);
+            }
+
+            { // Compact (empty buckets leave the list)
+                helper::Annotation annotation(NRI, commandBuffer, "SHARC - Compact");
+
+                NRI.CmdBarrier(commandBuffer, barrierGroupDesc);
+                NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::SharcCompact));
+
+                NRI.CmdDispatchIndirect(commandBuffer, *liveArgs, 0);
+
+                // The current list becomes the next one in the next frame
+                std::swap(argsTransition.before, argsTransition.after);
+                NRI.CmdBarrier(commandBuffer, argsBarrierGroupDesc);
+            }
+
+            if (m_IsSharcSavePending)
+            {
+                CopySharcCache(commandBuffer, isEven);
+                m_IsSharcSavePending = false;
             }
         }
+        else
+            m_IsSharcResetPending = true; // lists of live buckets follow the frame parity
 
-        { // Trace opaque
-            helper::Annotation annotation(NRI, commandBuffer, "Trace opaque");
+        WriteTimestamp(commandBuffer, bufferedFrameIndex, Timestamp::Sharc);
+
+        //======================================================================================================================================
+        // Render graph (see "AddRenderPass")
+        //======================================================================================================================================
+
+        m_RenderPasses.clear();
 
-            const TextureState transitions[] =
+        { // Trace opaque
+            const TextureState textures[] =
             {
                 // Input
                 {Texture::ComposedDiff, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
@@ -4918,121 +9842,160 @@ void Sample::RenderFrame(uint32_t frameIndex)
                 {Texture::Unfiltered_Translucency, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
                 {Texture::Unfiltered_Diff, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
                 {Texture::Unfiltered_Spec, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
-#if( NRD_MODE == SH )
+                // SH (must be last)
                 {Texture::Unfiltered_DiffSh, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
                 {Texture::Unfiltered_SpecSh, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
-#endif
             };
-            nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, optimizedTransitions.data(), BuildOptimizedTransitions(transitions, helper::GetCountOf(transitions), optimizedTransitions)};
-            NRI.CmdBarrier(commandBuffer, transitionBarriers);
 
-            NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::TraceOpaque));
-            NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::TraceOpaque1), &dummyDynamicConstantOffset);
+            const uint32_t textureNum = helper::GetCountOf(textures) - (m_NrdMode == SH ? 0 : 2); // SH textures exist only in "SH" mode
+
+            if (m_Wavefront)
+            {
+                AddRenderPass(RenderPassType::DEFAULT, "Trace opaque (wavefront)", textures, textureNum, [&]()
+                {
+                    NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::TraceOpaque1), &dummyDynamicConstantOffset);
+
+                    DispatchWavefront(commandBuffer, bufferedFrameIndex);
+                });
+            }
+            else
+            {
+                AddRenderPass(RenderPassType::DEFAULT, "Trace opaque", textures, textureNum, [&]()
+                {
+                    NRI.CmdSetPipeline(commandBuffer, *Get(GetTraceOpaquePipeline()));
+                    NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::TraceOpaque1), &dummyDynamicConstantOffset);
 
-            uint32_t rectWmod = uint32_t(m_RenderResolution.x * m_Settings.resolutionScale + 0.5f);
-            uint32_t rectHmod = uint32_t(m_RenderResolution.y * m_Settings.resolutionScale + 0.5f);
-            uint32_t rectGridWmod = (rectWmod + 15) / 16;
-            uint32_t rectGridHmod = (rectHmod + 15) / 16;
+                    uint32_t rectWmod = uint32_t(m_RenderResolution.x * m_Settings.resolutionScale + 0.5f);
+                    uint32_t rectHmod = uint32_t(m_RenderResolution.y * m_Settings.resolutionScale + 0.5f);
+                    uint32_t rectGridWmod = (rectWmod + 15) / 16;
+                    uint32_t rectGridHmod = (rectHmod + 15) / 16;
 
-            NRI.CmdDispatch(commandBuffer, {rectGridWmod, rectGridHmod, 1});
+                    NRI.CmdDispatch(commandBuffer, {rectGridWmod, rectGridHmod, 1});
+                });
+            }
         }
 
-    #if( NRD_MODE < OCCLUSION )
+        AddRenderPass(RenderPassType::MARKER, nullptr, nullptr, 0, [&]()
+        {
+            WriteTimestamp(commandBuffer, bufferedFrameIndex, Timestamp::TraceOpaque);
+        });
+
+        if (m_NrdMode < OCCLUSION)
         { // Shadow denoising
-            helper::Annotation annotation(NRI, commandBuffer, "Shadow denoising");
+            const TextureState textures[] =
+            {
+                // Input
+                {Texture::Mv, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                {Texture::ViewZ, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                {Texture::Normal_Roughness, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                {Texture::Unfiltered_Penumbra, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                {Texture::Unfiltered_Translucency, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                // Output
+                {Texture::Shadow, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
+                {Texture::Validation, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
+            };
 
-            float3 sunDir = GetSunDirection();
+            AddRenderPass(RenderPassType::EXTERNAL, "Shadow denoising", textures, helper::GetCountOf(textures), [&]()
+            {
+                float3 sunDir = GetSunDirection();
 
-            m_SigmaSettings.lightDirection[0] = sunDir.x;
-            m_SigmaSettings.lightDirection[1] = sunDir.y;
-            m_SigmaSettings.lightDirection[2] = sunDir.z;
+                m_SigmaSettings.lightDirection[0] = sunDir.x;
+                m_SigmaSettings.lightDirection[1] = sunDir.y;
+                m_SigmaSettings.lightDirection[2] = sunDir.z;
 
-            nrd::Identifier denoiser = NRD_ID(SIGMA_SHADOW);
+                nrd::Identifier denoiser = NRD_ID(SIGMA_SHADOW);
 
-            m_NRD.SetDenoiserSettings(denoiser, &m_SigmaSettings);
-            m_NRD.Denoise(&denoiser, 1, commandBuffer, userPool, NRD_RESTORE_INITIAL_STATE);
+                m_NRD.SetDenoiserSettings(denoiser, &m_SigmaSettings);
+                m_NRD.Denoise(&denoiser, 1, commandBuffer, userPool, NRD_RESTORE_INITIAL_STATE);
+            });
         }
-    #endif
 
-        { // Opaque Denoising
-            helper::Annotation annotation(NRI, commandBuffer, "Opaque denoising");
+        AddRenderPass(RenderPassType::MARKER, nullptr, nullptr, 0, [&]()
+        {
+            WriteTimestamp(commandBuffer, bufferedFrameIndex, Timestamp::ShadowDenoising);
+        });
 
-            if (m_Settings.denoiser == DENOISER_REBLUR || m_Settings.denoiser == DENOISER_REFERENCE)
+        { // Opaque Denoising
+            const TextureState textures[] =
             {
-                nrd::HitDistanceParameters hitDistanceParameters = {};
-                hitDistanceParameters.A = m_Settings.hitDistScale * m_Settings.meterToUnitsMultiplier;
-                m_ReblurSettings.hitDistanceParameters = hitDistanceParameters;
-
-                nrd::ReblurSettings settings = m_ReblurSettings;
-            #if( NRD_MODE == SH || NRD_MODE == DIRECTIONAL_OCCLUSION )
-                // High quality SG resolve allows to use more relaxed normal weights
-                if (m_Resolve)
-                    settings.lobeAngleFraction *= 1.333f;
-            #endif
-
-        #if( NRD_MODE == OCCLUSION )
-            #if( NRD_COMBINED == 1 )
-                const nrd::Identifier denoisers[] = {NRD_ID(REBLUR_DIFFUSE_SPECULAR_OCCLUSION)};
-            #else
-                const nrd::Identifier denoisers[] = {NRD_ID(REBLUR_DIFFUSE_OCCLUSION), NRD_ID(REBLUR_SPECULAR_OCCLUSION)};
-            #endif
-        #elif( NRD_MODE == SH )
-            #if( NRD_COMBINED == 1 )
-                const nrd::Identifier denoisers[] = {NRD_ID(REBLUR_DIFFUSE_SPECULAR_SH)};
-            #else
-                const nrd::Identifier denoisers[] = {NRD_ID(REBLUR_DIFFUSE_SH), NRD_ID(REBLUR_SPECULAR_SH)};
-            #endif
-        #elif( NRD_MODE == DIRECTIONAL_OCCLUSION )
-                const nrd::Identifier denoisers[] = {NRD_ID(REBLUR_DIFFUSE_DIRECTIONAL_OCCLUSION)};
-        #else
-            #if( NRD_COMBINED == 1 )
-                const nrd::Identifier denoisers[] = {NRD_ID(REBLUR_DIFFUSE_SPECULAR)};
-            #else
-                const nrd::Identifier denoisers[] = {NRD_ID(REBLUR_DIFFUSE), NRD_ID(REBLUR_SPECULAR)};
-            #endif
-        #endif
-
-                for (uint32_t i = 0; i < helper::GetCountOf(denoisers); i++)
-                    m_NRD.SetDenoiserSettings(denoisers[i], &settings);
-
-                m_NRD.Denoise(denoisers, helper::GetCountOf(denoisers), commandBuffer, userPool, NRD_RESTORE_INITIAL_STATE);
-            }
-            else if (m_Settings.denoiser == DENOISER_RELAX)
+                // Input
+                {Texture::Mv, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                {Texture::ViewZ, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                {Texture::Normal_Roughness, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                {Texture::BaseColor_Metalness, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                {Texture::Unfiltered_Diff, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                {Texture::Unfiltered_Spec, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                // Output
+                {Texture::Diff, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
+                {Texture::Spec, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
+                {Texture::Validation, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
+                // SH (must be last)
+                {Texture::Unfiltered_DiffSh, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                {Texture::Unfiltered_SpecSh, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                {Texture::DiffSh, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
+                {Texture::SpecSh, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
+            };
+
+            const uint32_t textureNum = helper::GetCountOf(textures) - (m_NrdMode == SH ? 0 : 4); // SH textures exist only in "SH" mode
+
+            AddRenderPass(RenderPassType::EXTERNAL, "Opaque denoising", textures, textureNum, [&]()
             {
-                nrd::RelaxSettings settings = m_RelaxSettings;
-            #if( NRD_MODE == SH || NRD_MODE == DIRECTIONAL_OCCLUSION )
-                // High quality SG resolve allows to use more relaxed normal weights
-                if (m_Resolve)
-                    settings.lobeAngleFraction *= 1.333f;
-            #endif
-
-                #if( NRD_COMBINED == 1 )
-                    #if( NRD_MODE == SH )
-                        const nrd::Identifier denoisers[] = {NRD_ID(RELAX_DIFFUSE_SPECULAR_SH)};
-                    #else
-                        const nrd::Identifier denoisers[] = {NRD_ID(RELAX_DIFFUSE_SPECULAR)};
-                    #endif
-                #else
-                    #if( NRD_MODE == SH )
-                        const nrd::Identifier denoisers[] = {NRD_ID(RELAX_DIFFUSE_SH), NRD_ID(RELAX_SPECULAR_SH)};
-                    #else
-                        const nrd::Identifier denoisers[] = {NRD_ID(RELAX_DIFFUSE), NRD_ID(RELAX_SPECULAR)};
-                    #endif
-                #endif
-
-                for (uint32_t i = 0; i < helper::GetCountOf(denoisers); i++)
-                    m_NRD.SetDenoiserSettings(denoisers[i], &settings);
-
-                m_NRD.Denoise(denoisers, helper::GetCountOf(denoisers), commandBuffer, userPool, NRD_RESTORE_INITIAL_STATE);
-            }
+                if (m_Settings.denoiser == DENOISER_REBLUR || m_Settings.denoiser == DENOISER_REFERENCE)
+                {
+                    nrd::HitDistanceParameters hitDistanceParameters = {};
+                    hitDistanceParameters.A = m_Settings.hitDistScale * m_Settings.meterToUnitsMultiplier;
+                    m_ReblurSettings.hitDistanceParameters = hitDistanceParameters;
+
+                    nrd::ReblurSettings settings = m_ReblurSettings;
+
+                    // High quality SG resolve allows to use more relaxed normal weights
+                    if ((m_NrdMode == SH || m_NrdMode == DIRECTIONAL_OCCLUSION) && m_Resolve)
+                        settings.lobeAngleFraction *= 1.333f;
+
+                    nrd::Denoiser denoisers[2];
+                    const uint32_t denoiserNum = GetReblurDenoisers(denoisers);
+
+                    nrd::Identifier identifiers[2];
+                    for (uint32_t i = 0; i < denoiserNum; i++)
+                    {
+                        identifiers[i] = nrd::Identifier(denoisers[i]);
+                        m_NRD.SetDenoiserSettings(identifiers[i], &settings);
+                    }
+
+                    m_NRD.Denoise(identifiers, denoiserNum, commandBuffer, userPool, NRD_RESTORE_INITIAL_STATE);
+                }
+                else if (m_Settings.denoiser == DENOISER_RELAX)
+                {
+                    nrd::RelaxSettings settings = m_RelaxSettings;
+
+                    // High quality SG resolve allows to use more relaxed normal weights
+                    if ((m_NrdMode == SH || m_NrdMode == DIRECTIONAL_OCCLUSION) && m_Resolve)
+                        settings.lobeAngleFraction *= 1.333f;
+
+                    nrd::Denoiser denoisers[2];
+                    const uint32_t denoiserNum = GetRelaxDenoisers(denoisers);
+
+                    nrd::Identifier identifiers[2];
+                    for (uint32_t i = 0; i < denoiserNum; i++)
+                    {
+                        identifiers[i] = nrd::Identifier(denoisers[i]);
+                        m_NRD.SetDenoiserSettings(identifiers[i], &settings);
+                    }
+
+                    m_NRD.Denoise(identifiers, denoiserNum, commandBuffer, userPool, NRD_RESTORE_INITIAL_STATE);
+                }
+            });
         }
 
-        RestoreBindings(commandBuffer, isEven);
+        AddRenderPass(RenderPassType::MARKER, nullptr, nullptr, 0, [&]()
+        {
+            WriteTimestamp(commandBuffer, bufferedFrameIndex, Timestamp::OpaqueDenoising);
 
-        { // Composition
-            helper::Annotation annotation(NRI, commandBuffer, "Composition");
+            RestoreBindings(commandBuffer, isEven);
+        });
 
-            const TextureState transitions[] =
+        { // Composition
+            const TextureState textures[] =
             {
                 // Input
                 {Texture::ViewZ, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
@@ -5044,27 +10007,32 @@ void Sample::RenderFrame(uint32_t frameIndex)
                 {Texture::Shadow, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
                 {Texture::Diff, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
                 {Texture::Spec, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
-            #if( NRD_MODE == SH )
-                {Texture::DiffSh, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
-                {Texture::SpecSh, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
-            #endif
                 // Output
                 {Texture::ComposedDiff, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
                 {Texture::ComposedSpec_ViewZ, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
+                // SH (must be last)
+                {Texture::DiffSh, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
+                {Texture::SpecSh, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
             };
-            nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, optimizedTransitions.data(), BuildOptimizedTransitions(transitions, helper::GetCountOf(transitions), optimizedTransitions)};
-            NRI.CmdBarrier(commandBuffer, transitionBarriers);
 
-            NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::Composition));
-            NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::Composition1), &dummyDynamicConstantOffset);
+            const uint32_t textureNum = helper::GetCountOf(textures) - (m_NrdMode == SH ? 0 : 2); // SH textures exist only in "SH" mode
+
+            AddRenderPass(RenderPassType::DEFAULT, "Composition", textures, textureNum, [&]()
+            {
+                NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::Composition));
+                NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::Composition1), &dummyDynamicConstantOffset);
 
-            NRI.CmdDispatch(commandBuffer, {rectGridW, rectGridH, 1});
+                NRI.CmdDispatch(commandBuffer, {rectGridW, rectGridH, 1});
+            });
         }
 
-        { // Trace transparent
-            helper::Annotation annotation(NRI, commandBuffer, "Trace transparent");
+        AddRenderPass(RenderPassType::MARKER, nullptr, nullptr, 0, [&]()
+        {
+            WriteTimestamp(commandBuffer, bufferedFrameIndex, Timestamp::Composition);
+        });
 
-            const TextureState transitions[] =
+        { // Trace transparent
+            const TextureState textures[] =
             {
                 // Input
                 {Texture::ComposedDiff, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
@@ -5074,30 +10042,48 @@ void Sample::RenderFrame(uint32_t frameIndex)
                 {Texture::Mv, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
                 {Texture::Normal_Roughness, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
             };
-            nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, optimizedTransitions.data(), BuildOptimizedTransitions(transitions, helper::GetCountOf(transitions), optimizedTransitions)};
-            NRI.CmdBarrier(commandBuffer, transitionBarriers);
 
-            NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::TraceTransparent));
-            NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::TraceTransparent1), &dummyDynamicConstantOffset);
+            AddRenderPass(RenderPassType::DEFAULT, "Trace transparent", textures, helper::GetCountOf(textures), [&]()
+            {
+                NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::TraceTransparent));
+                NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::TraceTransparent1), &dummyDynamicConstantOffset);
 
-            NRI.CmdDispatch(commandBuffer, {rectGridW, rectGridH, 1});
+                NRI.CmdDispatch(commandBuffer, {rectGridW, rectGridH, 1});
+            });
         }
 
+        AddRenderPass(RenderPassType::MARKER, nullptr, nullptr, 0, [&]()
+        {
+            WriteTimestamp(commandBuffer, bufferedFrameIndex, Timestamp::TraceTransparent);
+        });
+
         if (m_Settings.denoiser == DENOISER_REFERENCE)
         { // Reference
-            helper::Annotation annotation(NRI, commandBuffer, "Reference accumulation");
+            const TextureState textures[] =
+            {
+                // Input / output
+                {Texture::Composed, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
+            };
 
-            nrd::CommonSettings modifiedCommonSettings = commonSettings;
-            modifiedCommonSettings.splitScreen = m_Settings.separator;
+            AddRenderPass(RenderPassType::EXTERNAL, "Reference accumulation", textures, helper::GetCountOf(textures), [&]()
+            {
+                nrd::CommonSettings modifiedCommonSettings = commonSettings;
+                modifiedCommonSettings.splitScreen = m_Settings.separator;
 
-            nrd::Identifier denoiser = NRD_ID(REFERENCE);
+                nrd::Identifier denoiser = NRD_ID(REFERENCE);
 
-            m_NRD.SetCommonSettings(modifiedCommonSettings);
-            m_NRD.SetDenoiserSettings(denoiser, &m_ReferenceSettings);
-            m_NRD.Denoise(&denoiser, 1, commandBuffer, userPool, NRD_RESTORE_INITIAL_STATE);
+                m_NRD.SetCommonSettings(modifiedCommonSettings);
+                m_NRD.SetDenoiserSettings(denoiser, &m_ReferenceSettings);
+                m_NRD.Denoise(&denoiser, 1, commandBuffer, userPool, NRD_RESTORE_INITIAL_STATE);
+            });
         }
 
-        RestoreBindings(commandBuffer, isEven);
+        AddRenderPass(RenderPassType::MARKER, nullptr, nullptr, 0, [&]()
+        {
+            WriteTimestamp(commandBuffer, bufferedFrameIndex, Timestamp::Reference);
+
+            RestoreBindings(commandBuffer, isEven);
+        });
 
         //======================================================================================================================================
         // Output resolution
@@ -5108,12 +10094,9 @@ void Sample::RenderFrame(uint32_t frameIndex)
 
         if (IsDlssEnabled())
         {
-            // Before DLSS
             if (m_Settings.SR)
-            {
-                helper::Annotation annotation(NRI, commandBuffer, "Before DLSS");
-
-                const TextureState transitions[] =
+            { // Before DLSS
+                const TextureState textures[] =
                 {
                     // Input
                     {Texture::Normal_Roughness, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
@@ -5126,19 +10109,18 @@ void Sample::RenderFrame(uint32_t frameIndex)
                     {Texture::RRGuide_SpecHitDistance, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
                     {Texture::RRGuide_Normal_Roughness, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
                 };
-                nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, optimizedTransitions.data(), BuildOptimizedTransitions(transitions, helper::GetCountOf(transitions), optimizedTransitions)};
-                NRI.CmdBarrier(commandBuffer, transitionBarriers);
 
-                NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::DlssBefore));
-                NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::DlssBefore1), &dummyDynamicConstantOffset);
+                AddRenderPass(RenderPassType::DEFAULT, "Before DLSS", textures, helper::GetCountOf(textures), [&]()
+                {
+                    NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::DlssBefore));
+                    NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::DlssBefore1), &dummyDynamicConstantOffset);
 
-                NRI.CmdDispatch(commandBuffer, {rectGridW, rectGridH, 1});
+                    NRI.CmdDispatch(commandBuffer, {rectGridW, rectGridH, 1});
+                });
             }
 
             { // DLSS
-                helper::Annotation annotation(NRI, commandBuffer, "DLSS");
-
-                const TextureState transitions[] =
+                const TextureState textures[] =
                 {
                     // Input
                     {Texture::ViewZ, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
@@ -5152,57 +10134,55 @@ void Sample::RenderFrame(uint32_t frameIndex)
                     // Output
                     {Texture::DlssOutput, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
                 };
-                nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, optimizedTransitions.data(), BuildOptimizedTransitions(transitions, helper::GetCountOf(transitions), optimizedTransitions)};
-                NRI.CmdBarrier(commandBuffer, transitionBarriers);
 
-                DlssDispatchDesc dlssDesc = {};
-                dlssDesc.texOutput = {Get(Texture::DlssOutput), Get(Descriptor::DlssOutput_StorageTexture)};
-                dlssDesc.texInput = {Get(Texture::Composed), Get(Descriptor::Composed_Texture)};
-                dlssDesc.texMv = {Get(Texture::Mv), Get(Descriptor::Mv_Texture)};
-                dlssDesc.texDepth = {Get(Texture::ViewZ), Get(Descriptor::ViewZ_Texture)};
-                dlssDesc.viewportDims = {rectW, rectH};
-                dlssDesc.mvScale[0] = 1.0f;
-                dlssDesc.mvScale[1] = 1.0f;
-                dlssDesc.jitter[0] = -m_Camera.state.viewportJitter.x;
-                dlssDesc.jitter[1] = -m_Camera.state.viewportJitter.y;
-                dlssDesc.reset = m_ForceHistoryReset || m_Settings.SR != m_SettingsPrev.SR || m_Settings.RR != m_SettingsPrev.RR;
-
-                // RR specific
-                dlssDesc.texDiffAlbedo = {Get(Texture::RRGuide_DiffAlbedo), Get(Descriptor::RRGuide_DiffAlbedo_Texture)};
-                dlssDesc.texSpecAlbedo = {Get(Texture::RRGuide_SpecAlbedo), Get(Descriptor::RRGuide_SpecAlbedo_Texture)};
-                dlssDesc.texNormalRoughness = {Get(Texture::RRGuide_Normal_Roughness), Get(Descriptor::RRGuide_Normal_Roughness_Texture)};
-                dlssDesc.texSpecHitDistance = {Get(Texture::RRGuide_SpecHitDistance), Get(Descriptor::RRGuide_SpecHitDistance_Texture)};
-                memcpy(&dlssDesc.mWorldToView, &m_Camera.state.mWorldToView, sizeof(m_Camera.state.mWorldToView));
-                memcpy(&dlssDesc.mViewToClip, &m_Camera.state.mViewToClip, sizeof(m_Camera.state.mViewToClip));
-                dlssDesc.useRR = m_Settings.RR;
-
-                m_DLSS.Evaluate(&commandBuffer, dlssDesc);
+                AddRenderPass(RenderPassType::DEFAULT, "DLSS", textures, helper::GetCountOf(textures), [&]()
+                {
+                    DlssDispatchDesc dlssDesc = {};
+                    dlssDesc.texOutput = {Get(Texture::DlssOutput), Get(Descriptor::DlssOutput_StorageTexture)};
+                    dlssDesc.texInput = {Get(Texture::Composed), Get(Descriptor::Composed_Texture)};
+                    dlssDesc.texMv = {Get(Texture::Mv), Get(Descriptor::Mv_Texture)};
+                    dlssDesc.texDepth = {Get(Texture::ViewZ), Get(Descriptor::ViewZ_Texture)};
+                    dlssDesc.viewportDims = {rectW, rectH};
+                    dlssDesc.mvScale[0] = 1.0f;
+                    dlssDesc.mvScale[1] = 1.0f;
+                    dlssDesc.jitter[0] = -m_Camera.state.viewportJitter.x;
+                    dlssDesc.jitter[1] = -m_Camera.state.viewportJitter.y;
+                    dlssDesc.reset = m_ForceHistoryReset || m_Settings.SR != m_SettingsPrev.SR || m_Settings.RR != m_SettingsPrev.RR;
+
+                    // RR specific
+                    dlssDesc.texDiffAlbedo = {Get(Texture::RRGuide_DiffAlbedo), Get(Descriptor::RRGuide_DiffAlbedo_Texture)};
+                    dlssDesc.texSpecAlbedo = {Get(Texture::RRGuide_SpecAlbedo), Get(Descriptor::RRGuide_SpecAlbedo_Texture)};
+                    dlssDesc.texNormalRoughness = {Get(Texture::RRGuide_Normal_Roughness), Get(Descriptor::RRGuide_Normal_Roughness_Texture)};
+                    dlssDesc.texSpecHitDistance = {Get(Texture::RRGuide_SpecHitDistance), Get(Descriptor::RRGuide_SpecHitDistance_Texture)};
+                    memcpy(&dlssDesc.mWorldToView, &m_Camera.state.mWorldToView, sizeof(m_Camera.state.mWorldToView));
+                    memcpy(&dlssDesc.mViewToClip, &m_Camera.state.mViewToClip, sizeof(m_Camera.state.mViewToClip));
+                    dlssDesc.useRR = m_Settings.RR;
+
+                    m_DLSS.Evaluate(&commandBuffer, dlssDesc);
+
+                    RestoreBindings(commandBuffer, isEven);
+                });
             }
 
-            RestoreBindings(commandBuffer, isEven);
-
             { // After DLSS
-                helper::Annotation annotation(NRI, commandBuffer, "After Dlss");
-
-                const TextureState transitions[] =
+                const TextureState textures[] =
                 {
                     // Output
                     {Texture::DlssOutput, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
                 };
-                nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, optimizedTransitions.data(), BuildOptimizedTransitions(transitions, helper::GetCountOf(transitions), optimizedTransitions)};
-                NRI.CmdBarrier(commandBuffer, transitionBarriers);
 
-                NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::DlssAfter));
-                NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::DlssAfter1), &dummyDynamicConstantOffset);
+                AddRenderPass(RenderPassType::DEFAULT, "After Dlss", textures, helper::GetCountOf(textures), [&]()
+                {
+                    NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::DlssAfter));
+                    NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::DlssAfter1), &dummyDynamicConstantOffset);
 
-                NRI.CmdDispatch(commandBuffer, {outputGridW, outputGridH, 1});
+                    NRI.CmdDispatch(commandBuffer, {outputGridW, outputGridH, 1});
+                });
             }
         }
         else
         { // TAA
-            helper::Annotation annotation(NRI, commandBuffer, "TAA");
-
-            const TextureState transitions[] =
+            const TextureState textures[] =
             {
                 // Input
                 {Texture::Mv, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
@@ -5211,48 +10191,56 @@ void Sample::RenderFrame(uint32_t frameIndex)
                 // Output
                 {taaDst, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
             };
-            nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, optimizedTransitions.data(), BuildOptimizedTransitions(transitions, helper::GetCountOf(transitions), optimizedTransitions)};
-            NRI.CmdBarrier(commandBuffer, transitionBarriers);
 
-            NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::Taa));
-            NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(isEven ? DescriptorSet::Taa1a : DescriptorSet::Taa1b), &dummyDynamicConstantOffset);
+            AddRenderPass(RenderPassType::DEFAULT, "TAA", textures, helper::GetCountOf(textures), [&]()
+            {
+                NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::Taa));
+                NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(isEven ? DescriptorSet::Taa1a : DescriptorSet::Taa1b), &dummyDynamicConstantOffset);
 
-            NRI.CmdDispatch(commandBuffer, {rectGridW, rectGridH, 1});
+                NRI.CmdDispatch(commandBuffer, {rectGridW, rectGridH, 1});
+            });
         }
 
-        { // NIS
-            helper::Annotation annotation(NRI, commandBuffer, "NIS");
+        AddRenderPass(RenderPassType::MARKER, nullptr, nullptr, 0, [&]()
+        {
+            WriteTimestamp(commandBuffer, bufferedFrameIndex, Timestamp::Upscaling);
+        });
 
-            const TextureState transitions[] =
+        { // NIS
+            const TextureState textures[] =
             {
                 // Input
                 {IsDlssEnabled() ? Texture::DlssOutput : taaDst, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
                 // Output
                 {Texture::PreFinal, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
             };
-            nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, optimizedTransitions.data(), BuildOptimizedTransitions(transitions, helper::GetCountOf(transitions), optimizedTransitions)};
-            NRI.CmdBarrier(commandBuffer, transitionBarriers);
 
-            NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::Nis));
-            if (IsDlssEnabled())
-                NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::Nis1), &dummyDynamicConstantOffset);
-            else
-                NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(isEven ? DescriptorSet::Nis1a : DescriptorSet::Nis1b), &dummyDynamicConstantOffset);
+            AddRenderPass(RenderPassType::DEFAULT, "NIS", textures, helper::GetCountOf(textures), [&]()
+            {
+                NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::Nis));
+                if (IsDlssEnabled())
+                    NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::Nis1), &dummyDynamicConstantOffset);
+                else
+                    NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(isEven ? DescriptorSet::Nis1a : DescriptorSet::Nis1b), &dummyDynamicConstantOffset);
 
-            uint32_t w = (GetOutputResolution().x + NIS_BLOCK_WIDTH - 1) / NIS_BLOCK_WIDTH;
-            uint32_t h = (GetOutputResolution().y + NIS_BLOCK_HEIGHT - 1) / NIS_BLOCK_HEIGHT;
+                uint32_t w = (m_OutputResolution.x + NIS_BLOCK_WIDTH - 1) / NIS_BLOCK_WIDTH;
+                uint32_t h = (m_OutputResolution.y + NIS_BLOCK_HEIGHT - 1) / NIS_BLOCK_HEIGHT;
 
-            NRI.CmdDispatch(commandBuffer, {w, h, 1});
+                NRI.CmdDispatch(commandBuffer, {w, h, 1});
+            });
         }
 
+        AddRenderPass(RenderPassType::MARKER, nullptr, nullptr, 0, [&]()
+        {
+            WriteTimestamp(commandBuffer, bufferedFrameIndex, Timestamp::Nis);
+        });
+
         //======================================================================================================================================
         // Window resolution
         //======================================================================================================================================
 
         { // Final
-            helper::Annotation annotation(NRI, commandBuffer, "Final");
-
-            const TextureState transitions[] =
+            const TextureState textures[] =
             {
                 // Input
                 {Texture::PreFinal, nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE},
@@ -5261,52 +10249,130 @@ void Sample::RenderFrame(uint32_t frameIndex)
                 // Output
                 {Texture::Final, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE},
             };
-            nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, optimizedTransitions.data(), BuildOptimizedTransitions(transitions, helper::GetCountOf(transitions), optimizedTransitions)};
-            NRI.CmdBarrier(commandBuffer, transitionBarriers);
 
-            NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::Final));
-            NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::Final1), &dummyDynamicConstantOffset);
+            // "Final" is consumed outside of the graph (back buffer, readback)
+            AddRenderPass(RenderPassType::OUTPUT, "Final", textures, helper::GetCountOf(textures), [&]()
+            {
+                NRI.CmdSetPipeline(commandBuffer, *Get(Pipeline::Final));
+                NRI.CmdSetDescriptorSet(commandBuffer, SET_OTHER, *Get(DescriptorSet::Final1), &dummyDynamicConstantOffset);
 
-            NRI.CmdDispatch(commandBuffer, {windowGridW, windowGridH, 1});
+                NRI.CmdDispatch(commandBuffer, {windowGridW, windowGridH, 1});
+            });
         }
 
-        const uint32_t backBufferIndex = NRI.AcquireNextSwapChainTexture(*m_SwapChain);
-        const BackBuffer* backBuffer = &m_SwapChainBuffers[backBufferIndex];
-
-        { // Copy to back-buffer
-            helper::Annotation annotation(NRI, commandBuffer, "Copy to back buffer");
+        AddRenderPass(RenderPassType::MARKER, nullptr, nullptr, 0, [&]()
+        {
+            WriteTimestamp(commandBuffer, bufferedFrameIndex, Timestamp::Final);
+        });
 
-            const nri::TextureBarrierDesc transitions[] =
+        if (IsCapturedFrame(frameIndex))
+        { // Readback
+            const TextureState textures[] =
             {
-                nri::TextureBarrierFromState(GetState(Texture::Final), {nri::AccessBits::COPY_SOURCE, nri::Layout::COPY_SOURCE}),
-                nri::TextureBarrierFromUnknown(backBuffer->texture, {nri::AccessBits::COPY_DESTINATION, nri::Layout::COPY_DESTINATION}),
+                // Input
+                {Texture::Final, nri::AccessBits::COPY_SOURCE, nri::Layout::COPY_SOURCE},
             };
-            nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, transitions, (uint16_t)helper::GetCountOf(transitions)};
-            NRI.CmdBarrier(commandBuffer, transitionBarriers);
 
-            NRI.CmdCopyTexture(commandBuffer, *backBuffer->texture, nullptr, *Get(Texture::Final), nullptr);
+            AddRenderPass(RenderPassType::OUTPUT, "Readback", textures, helper::GetCountOf(textures), [&]()
+            {
+                nri::TextureDataLayoutDesc dstDataLayout = {};
+                dstDataLayout.rowPitch = m_ReadbackRowPitch;
+                dstDataLayout.slicePitch = m_ReadbackRowPitch * GetWindowResolution().y;
+
+                nri::TextureRegionDesc srcRegion = {};
+                srcRegion.width = (nri::Dim_t)GetWindowResolution().x;
+                srcRegion.height = (nri::Dim_t)GetWindowResolution().y;
+                srcRegion.depth = 1;
+
+                NRI.CmdReadbackTextureToBuffer(commandBuffer, *m_ReadbackBuffer, dstDataLayout, *Get(Texture::Final), srcRegion);
+            });
+        }
+
+        ExecuteRenderPasses(commandBuffer);
+
+        if (!m_Headless)
+        {
+            const uint32_t backBufferIndex = NRI.AcquireNextSwapChainTexture(*m_SwapChain);
+            const BackBuffer* backBuffer = &m_SwapChainBuffers[backBufferIndex];
+
+            { // Copy to back-buffer
+                helper::Annotation annotation(NRI, commandBuffer, "Copy to back buffer");
+
+                const nri::TextureBarrierDesc transitions[] =
+                {
+                    nri::TextureBarrierFromState(GetState(Texture::Final), {nri::AccessBits::COPY_SOURCE, nri::Layout::COPY_SOURCE}),
+                    nri::TextureBarrierFromUnknown(backBuffer->texture, {nri::AccessBits::COPY_DESTINATION, nri::Layout::COPY_DESTINATION}),
+                };
+                nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, transitions, (uint16_t)helper::GetCountOf(transitions)};
+                NRI.CmdBarrier(commandBuffer, transitionBarriers);
+
+                NRI.CmdCopyTexture(commandBuffer, *backBuffer->texture, nullptr, *Get(Texture::Final), nullptr);
+            }
+
+            { // UI
+                nri::TextureBarrierDesc before = {};
+                before.texture = backBuffer->texture;
+                before.before = {nri::AccessBits::COPY_DESTINATION, nri::Layout::COPY_DESTINATION, nri::StageBits::COPY};
+                before.after = {nri::AccessBits::COLOR_ATTACHMENT, nri::Layout::COLOR_ATTACHMENT, nri::StageBits::COLOR_ATTACHMENT};
+
+                nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, &before, 1};
+                NRI.CmdBarrier(commandBuffer, transitionBarriers);
+
+                nri::AttachmentsDesc desc = {};
+                desc.colors = &backBuffer->colorAttachment;
+                desc.colorNum = 1;
+
+                NRI.CmdBeginRendering(commandBuffer, desc);
+                RenderUI(NRI, NRI, *m_Streamer, commandBuffer, m_SdrScale, m_IsSrgb);
+                NRI.CmdEndRendering(commandBuffer);
+
+                const nri::TextureBarrierDesc after = nri::TextureBarrierFromState(before, {nri::AccessBits::UNKNOWN, nri::Layout::PRESENT, nri::StageBits::ALL});
+                transitionBarriers = {nullptr, 0, nullptr, 0, &after, 1};
+                NRI.CmdBarrier(commandBuffer, transitionBarriers);
+            }
+        }
+
+        if (!m_TextureResidency.empty())
+        { // Texture streaming feedback readback
+            nri::BufferBarrierDesc feedbackTransition = {Get(Buffer::TextureFeedback), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_SOURCE}};
+
+            nri::BarrierGroupDesc feedbackBarrierGroupDesc = {};
+            feedbackBarrierGroupDesc.buffers = &feedbackTransition;
+            feedbackBarrierGroupDesc.bufferNum = 1;
+
+            const uint64_t feedbackSize = helper::GetCountOf(m_Scene.materials) * TEXTURES_PER_MATERIAL * sizeof(uint32_t);
+
+            NRI.CmdBarrier(commandBuffer, feedbackBarrierGroupDesc);
+            NRI.CmdCopyBuffer(commandBuffer, *m_TextureFeedbackBuffer, bufferedFrameIndex * feedbackSize, *Get(Buffer::TextureFeedback), 0, feedbackSize);
+
+            std::swap(feedbackTransition.before, feedbackTransition.after);
+            NRI.CmdBarrier(commandBuffer, feedbackBarrierGroupDesc);
         }
 
-        { // UI
-            nri::TextureBarrierDesc before = {};
-            before.texture = backBuffer->texture;
-            before.before = {nri::AccessBits::COPY_DESTINATION, nri::Layout::COPY_DESTINATION, nri::StageBits::COPY};
-            before.after = {nri::AccessBits::COLOR_ATTACHMENT, nri::Layout::COLOR_ATTACHMENT, nri::StageBits::COLOR_ATTACHMENT};
+        if (frame.sharcCapacity)
+        { // SHARC statistics readback (queries in "TraceOpaque", "Composition" and "TraceTransparent" are counted too)
+            nri::BufferBarrierDesc statsTransition = {Get(Buffer::SharcStats), {nri::AccessBits::SHADER_RESOURCE_STORAGE}, {nri::AccessBits::COPY_SOURCE}};
+
+            nri::BarrierGroupDesc statsBarrierGroupDesc = {};
+            statsBarrierGroupDesc.buffers = &statsTransition;
+            statsBarrierGroupDesc.bufferNum = 1;
 
-            nri::BarrierGroupDesc transitionBarriers = {nullptr, 0, nullptr, 0, &before, 1};
-            NRI.CmdBarrier(commandBuffer, transitionBarriers);
+            NRI.CmdBarrier(commandBuffer, statsBarrierGroupDesc);
+            NRI.CmdCopyBuffer(commandBuffer, *m_SharcStatsBuffer, bufferedFrameIndex * SHARC_STATS_NUM * sizeof(uint32_t), *Get(Buffer::SharcStats), 0, SHARC_STATS_NUM * sizeof(uint32_t));
+
+            std::swap(statsTransition.before, statsTransition.after);
+            NRI.CmdBarrier(commandBuffer, statsBarrierGroupDesc);
+        }
 
-            nri::AttachmentsDesc desc = {};
-            desc.colors = &backBuffer->colorAttachment;
-            desc.colorNum = 1;
+        WriteTimestamp(commandBuffer, bufferedFrameIndex, Timestamp::Output);
 
-            NRI.CmdBeginRendering(commandBuffer, desc);
-            RenderUI(NRI, NRI, *m_Streamer, commandBuffer, m_SdrScale, m_IsSrgb);
-            NRI.CmdEndRendering(commandBuffer);
+        uint32_t queryOffset = bufferedFrameIndex * (uint32_t)Timestamp::MAX_NUM;
+        NRI.CmdCopyQueries(commandBuffer, *m_TimestampQueryPool, queryOffset, (uint32_t)Timestamp::MAX_NUM, *m_TimestampBuffer, queryOffset * sizeof(uint64_t));
 
-            const nri::TextureBarrierDesc after = nri::TextureBarrierFromState(before, {nri::AccessBits::UNKNOWN, nri::Layout::PRESENT, nri::StageBits::ALL});
-            transitionBarriers = {nullptr, 0, nullptr, 0, &after, 1};
-            NRI.CmdBarrier(commandBuffer, transitionBarriers);
+        if (frame.wavefrontQueryNum)
+        {
+            queryOffset = bufferedFrameIndex * WAVEFRONT_QUERY_MAX_NUM;
+            NRI.CmdCopyQueries(commandBuffer, *m_WavefrontQueryPool, queryOffset, frame.wavefrontQueryNum, *m_WavefrontTimestampBuffer, queryOffset * sizeof(uint64_t));
         }
     }
     NRI.EndCommandBuffer(commandBuffer);
@@ -5327,12 +10393,41 @@ void Sample::RenderFrame(uint32_t frameIndex)
 
     nri::nriEndAnnotation();
 
-    // Present
-    nri::nriBeginAnnotation("Present", nri::BGRA_UNUSED);
+    // SHARC cache saving is not on the hot path too
+    if (m_SharcCacheReadbackBuffer)
+    {
+        NRI.Wait(*m_FrameFence, 1 + frameIndex);
+        SaveSharcCache();
+    }
+
+    // Hit recording is an offline tool
+    if (m_IsSharcHitsReadbackPending)
+    {
+        NRI.Wait(*m_FrameFence, 1 + frameIndex);
+        SaveSharcHits();
+    }
 
-    NRI.QueuePresent(*m_SwapChain);
+    if (m_Headless)
+    {
+        // Captures are not on the hot path, a stall is acceptable
+        if (IsCapturedFrame(frameIndex))
+        {
+            NRI.Wait(*m_FrameFence, 1 + frameIndex);
+            SaveCapturedFrame(frameIndex);
+        }
+    }
+    else
+    {
+        // Present
+        nri::nriBeginAnnotation("Present", nri::BGRA_UNUSED);
 
-    nri::nriEndAnnotation();
+        NRI.QueuePresent(*m_SwapChain);
+
+        nri::nriEndAnnotation();
+    }
+
+    m_Frames[frameIndex % BUFFERED_FRAME_MAX_NUM].presentTimeStamp = m_Timer.GetTimeStamp();
+    UpdateLatency();
 
     // Cap FPS if requested
     nri::nriBeginAnnotation("FPS cap", nri::BGRA_UNUSED);
@@ -5346,4 +10441,17 @@ void Sample::RenderFrame(uint32_t frameIndex)
     nri::nriEndAnnotation();
 }
 
-SAMPLE_MAIN(Sample, 0);
+// Like "SAMPLE_MAIN", but the exit code of batch jobs is returned after a regular shutdown
+int main(int argc, char** argv)
+{
+    Sample* sample = new Sample;
+
+    bool result = sample->Create(argc, argv, "NRDSample");
+    if (result)
+        sample->RenderLoop();
+
+    int32_t exitCode = result ? sample->GetExitCode() : 1;
+    delete sample;
+
+    return exitCode;
+}
@@ -0,0 +1,137 @@
+/*
+Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+
+NVIDIA CORPORATION and its licensors retain all intellectual property
+and proprietary rights in and to this software, related documentation
+and any modifications thereto. Any use, reproduction, disclosure or
+distribution of this software and related documentation without an express
+license agreement from NVIDIA CORPORATION is strictly prohibited.
+*/
+
+#pragma once
+
+// Render graph of a frame: pass declaration, culling and barrier generation (see "Sample::ExecuteRenderPasses"). It works with
+// texture states only, i.e. doesn't need a GPU and is covered by CPU unit tests (see "Tests/RenderGraphTest.cpp")
+
+// IMPORTANT: these files must be included beforehand:
+//    #include "NRI.h"
+//    #include "Extensions/NRIHelper.h"
+// ("NRIFramework.h" includes both)
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+enum class Texture : uint32_t; // defined by the user, used as an index in texture states
+
+struct TextureState
+{
+    Texture texture;
+    nri::AccessLayoutStage after;
+};
+
+enum class RenderPassType : uint8_t
+{
+    DEFAULT,    // barriers for declared textures are issued by the graph
+    EXTERNAL,   // barriers are issued by the pass itself (NRD), declared textures are used for culling only
+    OUTPUT,     // produces data consumed outside of the graph, never culled
+    MARKER,     // no textures and annotations, never culled (timestamps, bindings)
+};
+
+struct RenderPass
+{
+    std::vector<TextureState> textures;
+    std::function<void()> execute;
+    const char* name;
+    RenderPassType type;
+    bool isCulled;
+};
+
+inline bool IsRenderPassWrite(const TextureState& textureState)
+{ return textureState.after.access == nri::AccessBits::SHADER_RESOURCE_STORAGE || textureState.after.access == nri::AccessBits::COPY_DESTINATION; }
+
+// Culls passes, which don't write anything needed by live passes or the next frame (textures read before the first write carry
+// data across frames). Storage accesses can be read-modify-write, thus all textures of a live pass are needed (conservative)
+inline void CullRenderPasses(std::vector<RenderPass>& renderPasses, size_t textureNum)
+{
+    std::vector<bool> isWritten(textureNum, false);
+    std::vector<bool> isNeeded(textureNum, false);
+    for (const RenderPass& renderPass : renderPasses)
+    {
+        for (const TextureState& textureState : renderPass.textures)
+        {
+            size_t i = (size_t)textureState.texture;
+            if (!IsRenderPassWrite(textureState) && !isWritten[i])
+                isNeeded[i] = true;
+
+            isWritten[i] = isWritten[i] || IsRenderPassWrite(textureState);
+        }
+    }
+
+    for (size_t i = renderPasses.size(); i > 0; i--)
+    {
+        RenderPass& renderPass = renderPasses[i - 1];
+
+        bool isLive = renderPass.type == RenderPassType::OUTPUT || renderPass.type == RenderPassType::MARKER;
+        for (const TextureState& textureState : renderPass.textures)
+            isLive = isLive || (IsRenderPassWrite(textureState) && isNeeded[(size_t)textureState.texture]);
+
+        renderPass.isCulled = !isLive;
+        if (isLive)
+        {
+            for (const TextureState& textureState : renderPass.textures)
+                isNeeded[(size_t)textureState.texture] = true;
+        }
+    }
+}
+
+// Transitions "state" to "textureState". Storage-to-storage (write-after-write) needs a barrier even if the state is not changed
+inline bool AppendTextureBarrier(nri::TextureBarrierDesc& state, const TextureState& textureState, bool isStorageBarrierAllowed, std::vector<nri::TextureBarrierDesc>& barriers)
+{
+    bool isStateChanged = state.after.access != textureState.after.access || state.after.layout != textureState.after.layout;
+    bool isStorageBarrier = state.after.access == nri::AccessBits::SHADER_RESOURCE_STORAGE && textureState.after.access == nri::AccessBits::SHADER_RESOURCE_STORAGE;
+    if (!isStateChanged && !(isStorageBarrier && isStorageBarrierAllowed))
+        return false;
+
+    barriers.push_back( nri::TextureBarrierFromState(state, {textureState.after.access, textureState.after.layout}) );
+
+    return true;
+}
+
+// Gathers barriers to be issued before a not culled "DEFAULT" or "OUTPUT" pass and updates "states". Barriers of the next pass for textures
+// not used by this pass are merged. Storage barriers can't be merged, since the next pass would need them again. Aliased textures are
+// transitioned at the first use, because their memory can be in use. "mergedTextures" carries merged textures to the next call and must
+// be empty at the beginning of a frame: their transitions already wait for preceding work, thus storage barriers for them are dropped
+inline void GatherRenderPassBarriers(const std::vector<RenderPass>& renderPasses, size_t passIndex, std::vector<nri::TextureBarrierDesc>& states,
+    const std::vector<Texture>& aliasedTextures, std::vector<Texture>& mergedTextures, std::vector<nri::TextureBarrierDesc>& barriers)
+{
+    const RenderPass& renderPass = renderPasses[passIndex];
+
+    for (const TextureState& textureState : renderPass.textures)
+    {
+        bool isMerged = std::find(mergedTextures.begin(), mergedTextures.end(), textureState.texture) != mergedTextures.end();
+        AppendTextureBarrier(states[(size_t)textureState.texture], textureState, !isMerged, barriers);
+    }
+
+    mergedTextures.clear();
+
+    const RenderPass* nextRenderPass = nullptr;
+    for (size_t i = passIndex + 1; i < renderPasses.size() && !nextRenderPass; i++)
+    {
+        if (!renderPasses[i].isCulled && renderPasses[i].type != RenderPassType::MARKER)
+            nextRenderPass = &renderPasses[i];
+    }
+
+    if (!nextRenderPass || nextRenderPass->type == RenderPassType::EXTERNAL)
+        return;
+
+    for (const TextureState& textureState : nextRenderPass->textures)
+    {
+        bool isUsed = std::find(aliasedTextures.begin(), aliasedTextures.end(), textureState.texture) != aliasedTextures.end();
+        for (const TextureState& usedTextureState : renderPass.textures)
+            isUsed = isUsed || usedTextureState.texture == textureState.texture;
+
+        if (!isUsed && AppendTextureBarrier(states[(size_t)textureState.texture], textureState, false, barriers))
+            mergedTextures.push_back(textureState.texture);
+    }
+}
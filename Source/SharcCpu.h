@@ -0,0 +1,279 @@
+/*
+Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+
+NVIDIA CORPORATION and its licensors retain all intellectual property
+and proprietary rights in and to this software, related documentation
+and any modifications thereto. Any use, reproduction, disclosure or
+distribution of this software and related documentation without an express
+license agreement from NVIDIA CORPORATION is strictly prohibited.
+*/
+
+#pragma once
+
+// CPU reference of the SHARC hash grid: spatial hashing, insert, lookup, stale entry eviction and in-bucket compaction.
+// It follows "HashGridCommon.h" and "SharcCommon.h" (SHARC SDK) and takes tunables from "Shared.hlsli", it doesn't
+// need a GPU and is used to tune capacity and scale settings on recorded hit streams (see "--sharcReplay")
+
+// IMPORTANT: these files must be included beforehand:
+//    #include "ml.h" (or "NRIFramework.h")
+//    #include "../Shaders/Include/Shared.hlsli"
+// It's covered by CPU unit tests (see "Tests/SharcCpuTest.cpp")
+
+#include <cmath>
+#include <vector>
+
+namespace SharcCpu
+{
+
+// SHARC SDK constants, must match the SDK used by shaders (stored in the SHARC cache header, a cache with other values is rejected)
+constexpr uint32_t HASH_KEY_LAYOUT_VERSION  = 1; // bump if the key layout of "ComputeSpatialHash" changes
+constexpr float GRID_LOGARITHM_BASE         = 2.0f; // "SHARC_GRID_LOGARITHM_BASE"
+constexpr float GRID_LEVEL_BIAS             = 0.0f; // "SHARC_GRID_LEVEL_BIAS"
+constexpr uint32_t POSITION_BIT_NUM         = 17; // "HASH_GRID_POSITION_BIT_NUM"
+constexpr uint32_t LEVEL_BIT_NUM            = 10; // "HASH_GRID_LEVEL_BIT_NUM"
+constexpr uint32_t NORMAL_BIT_NUM           = 3; // "HASH_GRID_NORMAL_BIT_NUM"
+constexpr uint64_t POSITION_BIT_MASK        = (1ull << POSITION_BIT_NUM) - 1;
+constexpr uint64_t LEVEL_BIT_MASK           = (1ull << LEVEL_BIT_NUM) - 1;
+constexpr uint64_t NORMAL_BIT_MASK          = (1ull << NORMAL_BIT_NUM) - 1;
+constexpr float NORMAL_BIAS                 = 1e-3f; // "HASH_GRID_NORMAL_BIAS"
+constexpr uint64_t INVALID_HASH_KEY         = 0; // "HASH_GRID_INVALID_HASH_KEY"
+constexpr uint32_t INVALID_CACHE_INDEX      = 0xFFFFFFFF; // "HASH_GRID_INVALID_CACHE_INDEX"
+
+// Compaction moves entries only within a bucket, lookups stop at the first empty slot
+static_assert(SHARC_BUCKET_SIZE == 32, "SHARC compaction requires 32 entries per bucket");
+
+struct GridParameters
+{
+    float3 cameraPosition = {};
+    float sceneScale = float(SHARC_SCENE_SCALE);
+    float logarithmBase = GRID_LOGARITHM_BASE;
+    float levelBias = GRID_LEVEL_BIAS;
+};
+
+inline uint32_t GetLevel(const float3& position, const GridParameters& gridParameters)
+{
+    float dx = gridParameters.cameraPosition.x - position.x;
+    float dy = gridParameters.cameraPosition.y - position.y;
+    float dz = gridParameters.cameraPosition.z - position.z;
+    float distance2 = dx * dx + dy * dy + dz * dz;
+    float level = 0.5f * std::log(distance2) / std::log(gridParameters.logarithmBase) + gridParameters.levelBias;
+
+    return uint32_t( std::min(std::max(level, 1.0f), float(LEVEL_BIT_MASK)) );
+}
+
+inline float GetVoxelSize(uint32_t level, const GridParameters& gridParameters)
+{ return std::pow(gridParameters.logarithmBase, float(level)) / (gridParameters.sceneScale * std::pow(gridParameters.logarithmBase, gridParameters.levelBias)); }
+
+inline uint64_t ComputeSpatialHash(const float3& position, const float3& normal, const GridParameters& gridParameters)
+{
+    uint32_t level = GetLevel(position, gridParameters);
+    float voxelSize = GetVoxelSize(level, gridParameters);
+
+    int32_t x = int32_t( std::floor(position.x / voxelSize) );
+    int32_t y = int32_t( std::floor(position.y / voxelSize) );
+    int32_t z = int32_t( std::floor(position.z / voxelSize) );
+
+    uint64_t hashKey = (uint64_t(x) & POSITION_BIT_MASK)
+        | ((uint64_t(y) & POSITION_BIT_MASK) << POSITION_BIT_NUM)
+        | ((uint64_t(z) & POSITION_BIT_MASK) << (POSITION_BIT_NUM * 2))
+        | ((uint64_t(level) & LEVEL_BIT_MASK) << (POSITION_BIT_NUM * 3));
+
+    uint32_t normalBits = (normal.x + NORMAL_BIAS >= 0.0f ? 0 : 1) + (normal.y + NORMAL_BIAS >= 0.0f ? 0 : 2) + (normal.z + NORMAL_BIAS >= 0.0f ? 0 : 4);
+    hashKey |= (uint64_t(normalBits) & NORMAL_BIT_MASK) << (POSITION_BIT_NUM * 3 + LEVEL_BIT_NUM);
+
+    return hashKey;
+}
+
+inline uint32_t HashJenkins32(uint32_t a)
+{
+    a = (a + 0x7ed55d16) + (a << 12);
+    a = (a ^ 0xc761c23c) ^ (a >> 19);
+    a = (a + 0x165667b1) + (a << 5);
+    a = (a + 0xd3a2646c) ^ (a << 9);
+    a = (a + 0xfd7046c5) + (a << 3);
+    a = (a ^ 0xb55a4f09) ^ (a >> 16);
+
+    return a;
+}
+
+inline uint32_t Hash32(uint64_t hashKey)
+{ return HashJenkins32(uint32_t(hashKey & 0xFFFFFFFF)) ^ HashJenkins32(uint32_t(hashKey >> 32)); }
+
+struct Stats
+{
+    uint64_t queryNum;
+    uint64_t hitNum; // an existing entry is found
+    uint64_t failedNum; // the bucket is full
+    uint64_t probeNum; // slots visited by all queries
+    uint64_t evictedNum;
+    uint32_t probeMaxNum;
+};
+
+// Frame order on the GPU: "Update" inserts ("MarkSampled"), "Resolve" evicts stale entries, "Hash copy" compacts buckets
+class HashGrid
+{
+public:
+    inline void Initialize(uint32_t capacity)
+    {
+        m_HashEntries.assign(capacity, INVALID_HASH_KEY);
+        m_FrameNums.assign(capacity, 0);
+        m_IsSampled.assign(capacity, 0);
+        m_Stats = {};
+    }
+
+    inline uint32_t GetCapacity() const
+    { return (uint32_t)m_HashEntries.size(); }
+
+    inline const Stats& GetStats() const
+    { return m_Stats; }
+
+    // "HashMapFind"
+    inline uint32_t Find(uint64_t hashKey)
+    {
+        const uint32_t baseSlot = GetBaseSlot(hashKey);
+
+        m_Stats.queryNum++;
+
+        for (uint32_t bucketOffset = 0; bucketOffset < SHARC_BUCKET_SIZE; bucketOffset++)
+        {
+            uint64_t storedHashKey = m_HashEntries[baseSlot + bucketOffset];
+            if (storedHashKey == hashKey || storedHashKey == INVALID_HASH_KEY)
+            {
+                AddProbes(bucketOffset + 1);
+
+                if (storedHashKey == INVALID_HASH_KEY)
+                    return INVALID_CACHE_INDEX;
+
+                m_Stats.hitNum++;
+
+                return baseSlot + bucketOffset;
+            }
+        }
+
+        AddProbes(SHARC_BUCKET_SIZE);
+
+        return INVALID_CACHE_INDEX;
+    }
+
+    // "HashMapInsert"
+    inline uint32_t Insert(uint64_t hashKey)
+    {
+        const uint32_t baseSlot = GetBaseSlot(hashKey);
+
+        m_Stats.queryNum++;
+
+        for (uint32_t bucketOffset = 0; bucketOffset < SHARC_BUCKET_SIZE; bucketOffset++)
+        {
+            uint64_t& storedHashKey = m_HashEntries[baseSlot + bucketOffset];
+            if (storedHashKey == hashKey || storedHashKey == INVALID_HASH_KEY)
+            {
+                AddProbes(bucketOffset + 1);
+
+                if (storedHashKey == hashKey)
+                    m_Stats.hitNum++;
+
+                storedHashKey = hashKey;
+
+                return baseSlot + bucketOffset;
+            }
+        }
+
+        AddProbes(SHARC_BUCKET_SIZE);
+        m_Stats.failedNum++;
+
+        return INVALID_CACHE_INDEX;
+    }
+
+    // "SharcUpdateHit" accumulates a sample
+    inline void MarkSampled(uint32_t entryIndex)
+    {
+        if (entryIndex != INVALID_CACHE_INDEX)
+            m_IsSampled[entryIndex] = 1;
+    }
+
+    // "SharcResolveEntry": entries without samples age, entries older than "staleFrameNumMax" get evicted
+    inline void Resolve(uint32_t staleFrameNumMax)
+    {
+        for (uint32_t i = 0; i < GetCapacity(); i++)
+        {
+            if (m_HashEntries[i] == INVALID_HASH_KEY)
+                continue;
+
+            m_FrameNums[i] = m_IsSampled[i] ? 0 : m_FrameNums[i] + 1;
+            m_IsSampled[i] = 0;
+
+            if (m_FrameNums[i] > staleFrameNumMax)
+            {
+                m_HashEntries[i] = INVALID_HASH_KEY;
+                m_FrameNums[i] = 0;
+                m_Stats.evictedNum++;
+            }
+        }
+    }
+
+    // "SharcCopyHashEntry": survivors move to the beginning of their bucket, preserving the order
+    inline void Compact()
+    {
+        for (uint32_t baseSlot = 0; baseSlot < GetCapacity(); baseSlot += SHARC_BUCKET_SIZE)
+        {
+            uint32_t dst = baseSlot;
+            for (uint32_t src = baseSlot; src < baseSlot + SHARC_BUCKET_SIZE; src++)
+            {
+                if (m_HashEntries[src] == INVALID_HASH_KEY)
+                    continue;
+
+                if (dst != src)
+                {
+                    m_HashEntries[dst] = m_HashEntries[src];
+                    m_FrameNums[dst] = m_FrameNums[src];
+                    m_HashEntries[src] = INVALID_HASH_KEY;
+                    m_FrameNums[src] = 0;
+                }
+
+                dst++;
+            }
+        }
+    }
+
+    inline uint32_t GetOccupiedNum() const
+    {
+        uint32_t occupiedNum = 0;
+        for (uint64_t hashKey : m_HashEntries)
+            occupiedNum += hashKey != INVALID_HASH_KEY ? 1 : 0;
+
+        return occupiedNum;
+    }
+
+    // Buckets listed for maintenance passes
+    inline uint32_t GetLiveBucketNum() const
+    {
+        uint32_t liveBucketNum = 0;
+        for (uint32_t baseSlot = 0; baseSlot < GetCapacity(); baseSlot += SHARC_BUCKET_SIZE)
+            liveBucketNum += m_HashEntries[baseSlot] != INVALID_HASH_KEY ? 1 : 0; // buckets are compacted
+
+        return liveBucketNum;
+    }
+
+private:
+    // "HashGridGetBaseSlot"
+    inline uint32_t GetBaseSlot(uint64_t hashKey) const
+    {
+        uint32_t slot = Hash32(hashKey) % GetCapacity();
+
+        return (slot / SHARC_BUCKET_SIZE) * SHARC_BUCKET_SIZE;
+    }
+
+    inline void AddProbes(uint32_t probeNum)
+    {
+        m_Stats.probeNum += probeNum;
+        m_Stats.probeMaxNum = std::max(m_Stats.probeMaxNum, probeNum);
+    }
+
+private:
+    std::vector<uint64_t> m_HashEntries;
+    std::vector<uint32_t> m_FrameNums; // frames without samples
+    std::vector<uint8_t> m_IsSampled;
+    Stats m_Stats = {};
+};
+
+}
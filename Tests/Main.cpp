@@ -0,0 +1,55 @@
+/*
+Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+
+NVIDIA CORPORATION and its licensors retain all intellectual property
+and proprietary rights in and to this software, related documentation
+and any modifications thereto. Any use, reproduction, disclosure or
+distribution of this software and related documentation without an express
+license agreement from NVIDIA CORPORATION is strictly prohibited.
+*/
+
+#include "Tests.h"
+
+#include <cstring>
+
+uint32_t g_FailedNum = 0;
+
+struct Suite
+{
+    const char* name;
+    void (*run)();
+};
+
+static const Suite g_Suites[] =
+{
+    {"RenderGraph", RunRenderGraphTests},
+    {"SharcCpu", RunSharcCpuTests},
+};
+
+// Runs all suites or the one named by the first argument
+int main(int argc, char** argv)
+{
+    bool isFound = false;
+    for (const Suite& suite : g_Suites)
+    {
+        if (argc > 1 && strcmp(argv[1], suite.name))
+            continue;
+
+        printf("%s\n", suite.name);
+        suite.run();
+        isFound = true;
+    }
+
+    if (!isFound)
+    {
+        printf("Unknown suite '%s'!\n", argv[1]);
+        return 1;
+    }
+
+    if (g_FailedNum)
+        printf("%u check(s) failed\n", g_FailedNum);
+    else
+        printf("All checks passed\n");
+
+    return g_FailedNum ? 1 : 0;
+}
@@ -0,0 +1,202 @@
+/*
+Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+
+NVIDIA CORPORATION and its licensors retain all intellectual property
+and proprietary rights in and to this software, related documentation
+and any modifications thereto. Any use, reproduction, disclosure or
+distribution of this software and related documentation without an express
+license agreement from NVIDIA CORPORATION is strictly prohibited.
+*/
+
+// CPU unit tests of the render graph: barriers emitted for small pass lists and pass culling
+
+#include "NRI.h"
+#include "Extensions/NRIHelper.h"
+
+#include "RenderGraph.h"
+
+#include "Tests.h"
+
+enum class Texture : uint32_t
+{
+    A,
+    B,
+    C,
+    D,
+
+    MAX_NUM
+};
+
+constexpr nri::AccessLayoutStage READ = {nri::AccessBits::SHADER_RESOURCE, nri::Layout::SHADER_RESOURCE};
+constexpr nri::AccessLayoutStage WRITE = {nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::Layout::SHADER_RESOURCE_STORAGE};
+
+struct Graph
+{
+    std::vector<RenderPass> renderPasses;
+    std::vector<nri::TextureBarrierDesc> states;
+    std::vector<Texture> aliasedTextures;
+
+    Graph()
+    {
+        // Fake handles, barriers are matched to textures by them
+        states.resize((size_t)Texture::MAX_NUM);
+        for (size_t i = 0; i < states.size(); i++)
+            states[i] = nri::TextureBarrierFromUnknown((nri::Texture*)(uintptr_t)(i + 1), READ);
+    }
+
+    void Add(RenderPassType type, std::vector<TextureState>&& textures)
+    {
+        RenderPass& renderPass = renderPasses.emplace_back();
+        renderPass.textures = std::move(textures);
+        renderPass.name = "";
+        renderPass.type = type;
+        renderPass.isCulled = false;
+    }
+
+    // Mirrors "Sample::ExecuteRenderPasses", barriers are returned per pass
+    std::vector<std::vector<nri::TextureBarrierDesc>> Execute()
+    {
+        std::vector<std::vector<nri::TextureBarrierDesc>> barriers(renderPasses.size());
+        std::vector<Texture> mergedTextures;
+
+        CullRenderPasses(renderPasses, states.size());
+
+        for (size_t i = 0; i < renderPasses.size(); i++)
+        {
+            const RenderPass& renderPass = renderPasses[i];
+            if (!renderPass.isCulled && (renderPass.type == RenderPassType::DEFAULT || renderPass.type == RenderPassType::OUTPUT))
+                GatherRenderPassBarriers(renderPasses, i, states, aliasedTextures, mergedTextures, barriers[i]);
+        }
+
+        return barriers;
+    }
+};
+
+static bool IsBarrier(const nri::TextureBarrierDesc& barrier, Texture texture, nri::AccessBits before, nri::AccessBits after)
+{ return barrier.texture == (nri::Texture*)(uintptr_t)((size_t)texture + 1) && barrier.before.access == before && barrier.after.access == after; }
+
+static void TestTransitions()
+{
+    Graph graph;
+    graph.Add(RenderPassType::DEFAULT, {{Texture::A, WRITE}});
+    graph.Add(RenderPassType::OUTPUT, {{Texture::A, READ}});
+
+    auto barriers = graph.Execute();
+    CHECK(barriers[0].size() == 1);
+    CHECK(barriers[0].size() == 1 && IsBarrier(barriers[0][0], Texture::A, nri::AccessBits::SHADER_RESOURCE, nri::AccessBits::SHADER_RESOURCE_STORAGE));
+    CHECK(barriers[1].size() == 1);
+    CHECK(barriers[1].size() == 1 && IsBarrier(barriers[1][0], Texture::A, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE));
+    CHECK(graph.states[(size_t)Texture::A].after.access == nri::AccessBits::SHADER_RESOURCE);
+}
+
+static void TestStorageBarriers()
+{
+    // Write-after-write needs a storage barrier even if the state is not changed
+    Graph graph;
+    graph.Add(RenderPassType::DEFAULT, {{Texture::A, WRITE}});
+    graph.Add(RenderPassType::DEFAULT, {{Texture::A, WRITE}});
+    graph.Add(RenderPassType::OUTPUT, {{Texture::A, READ}});
+
+    auto barriers = graph.Execute();
+    CHECK(barriers[1].size() == 1);
+    CHECK(barriers[1].size() == 1 && IsBarrier(barriers[1][0], Texture::A, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE));
+    CHECK(barriers[2].size() == 1);
+}
+
+static void TestMergedBarriers()
+{
+    Graph graph;
+    graph.states[(size_t)Texture::B] = nri::TextureBarrierFromUnknown(graph.states[(size_t)Texture::B].texture, WRITE);
+    graph.Add(RenderPassType::DEFAULT, {{Texture::A, WRITE}});
+    graph.Add(RenderPassType::MARKER, {});
+    graph.Add(RenderPassType::DEFAULT, {{Texture::A, READ}, {Texture::B, WRITE}, {Texture::C, WRITE}});
+    graph.Add(RenderPassType::OUTPUT, {{Texture::B, READ}, {Texture::C, READ}});
+
+    auto barriers = graph.Execute();
+
+    // "C" is hoisted into the first pass (markers are skipped). "B" is already in storage state, a storage barrier can't be hoisted
+    CHECK(barriers[0].size() == 2);
+    CHECK(barriers[0].size() == 2 && IsBarrier(barriers[0][1], Texture::C, nri::AccessBits::SHADER_RESOURCE, nri::AccessBits::SHADER_RESOURCE_STORAGE));
+
+    // The consuming pass doesn't emit a storage barrier for hoisted "C" again, but needs one for "B"
+    CHECK(barriers[2].size() == 2);
+    CHECK(barriers[2].size() == 2 && IsBarrier(barriers[2][0], Texture::A, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE));
+    CHECK(barriers[2].size() == 2 && IsBarrier(barriers[2][1], Texture::B, nri::AccessBits::SHADER_RESOURCE_STORAGE, nri::AccessBits::SHADER_RESOURCE_STORAGE));
+}
+
+static void TestNotMergedBarriers()
+{
+    // Aliased textures are transitioned at the first use
+    {
+        Graph graph;
+        graph.aliasedTextures.push_back(Texture::B);
+        graph.Add(RenderPassType::DEFAULT, {{Texture::A, WRITE}});
+        graph.Add(RenderPassType::OUTPUT, {{Texture::A, READ}, {Texture::B, WRITE}});
+
+        auto barriers = graph.Execute();
+        CHECK(barriers[0].size() == 1);
+        CHECK(barriers[1].size() == 2);
+    }
+
+    // External passes issue barriers themselves
+    {
+        Graph graph;
+        graph.Add(RenderPassType::DEFAULT, {{Texture::A, WRITE}});
+        graph.Add(RenderPassType::EXTERNAL, {{Texture::A, READ}, {Texture::B, WRITE}});
+        graph.Add(RenderPassType::OUTPUT, {{Texture::B, READ}});
+
+        auto barriers = graph.Execute();
+        CHECK(barriers[0].size() == 1);
+        CHECK(barriers[1].empty());
+        CHECK(barriers[2].empty()); // "B" is tracked by the external pass, the state is not changed here
+    }
+}
+
+static void TestCulling()
+{
+    Graph graph;
+    graph.Add(RenderPassType::DEFAULT, {{Texture::A, WRITE}});                      // 0: consumed by the output
+    graph.Add(RenderPassType::DEFAULT, {{Texture::B, WRITE}});                      // 1: never read, culled
+    graph.Add(RenderPassType::DEFAULT, {{Texture::C, READ}, {Texture::D, WRITE}});  // 2: "D" is read by culled pass 3 only, culled
+    graph.Add(RenderPassType::DEFAULT, {{Texture::D, READ}, {Texture::B, WRITE}});  // 3: "B" is not needed, culled
+    graph.Add(RenderPassType::MARKER, {});                                          // 4: never culled
+    graph.Add(RenderPassType::OUTPUT, {{Texture::A, READ}});                        // 5: never culled
+
+    auto barriers = graph.Execute();
+    CHECK(!graph.renderPasses[0].isCulled);
+    CHECK(graph.renderPasses[1].isCulled);
+    CHECK(graph.renderPasses[2].isCulled);
+    CHECK(graph.renderPasses[3].isCulled);
+    CHECK(!graph.renderPasses[4].isCulled);
+    CHECK(!graph.renderPasses[5].isCulled);
+
+    // Culled passes emit nothing and don't receive merged barriers
+    CHECK(barriers[1].empty() && barriers[2].empty() && barriers[3].empty());
+    CHECK(graph.states[(size_t)Texture::B].after.access == nri::AccessBits::SHADER_RESOURCE);
+    CHECK(graph.states[(size_t)Texture::D].after.access == nri::AccessBits::SHADER_RESOURCE);
+}
+
+static void TestHistoryCulling()
+{
+    // "B" is read before the first write (history), thus its writer is live even if nothing reads it later in the frame
+    Graph graph;
+    graph.Add(RenderPassType::DEFAULT, {{Texture::B, READ}, {Texture::A, WRITE}});
+    graph.Add(RenderPassType::DEFAULT, {{Texture::A, READ}, {Texture::B, WRITE}});
+    graph.Add(RenderPassType::DEFAULT, {{Texture::C, WRITE}});
+    graph.Add(RenderPassType::OUTPUT, {{Texture::A, READ}});
+
+    graph.Execute();
+    CHECK(!graph.renderPasses[0].isCulled);
+    CHECK(!graph.renderPasses[1].isCulled);
+    CHECK(graph.renderPasses[2].isCulled);
+}
+
+void RunRenderGraphTests()
+{
+    TestTransitions();
+    TestStorageBarriers();
+    TestMergedBarriers();
+    TestNotMergedBarriers();
+    TestCulling();
+    TestHistoryCulling();
+}
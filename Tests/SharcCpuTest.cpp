@@ -0,0 +1,184 @@
+/*
+Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+
+NVIDIA CORPORATION and its licensors retain all intellectual property
+and proprietary rights in and to this software, related documentation
+and any modifications thereto. Any use, reproduction, disclosure or
+distribution of this software and related documentation without an express
+license agreement from NVIDIA CORPORATION is strictly prohibited.
+*/
+
+// CPU unit tests of the SHARC hash grid reference: hash key layout, insert / find, bucket overflow, eviction and compaction
+
+#include "ml.h"
+#include "../Shaders/Include/Shared.hlsli"
+
+#include "SharcCpu.h"
+
+#include "Tests.h"
+
+// A single bucket: all keys share the base slot, thus slots are predictable
+constexpr uint32_t ONE_BUCKET = SHARC_BUCKET_SIZE;
+
+static void TestSpatialHash()
+{
+    SharcCpu::GridParameters gridParameters;
+    gridParameters.cameraPosition = float3(0.0f, 0.0f, 0.0f);
+    gridParameters.sceneScale = 1.0f;
+    gridParameters.logarithmBase = 2.0f;
+    gridParameters.levelBias = 0.0f;
+
+    constexpr uint32_t LEVEL_SHIFT = SharcCpu::POSITION_BIT_NUM * 3;
+    constexpr uint32_t NORMAL_SHIFT = LEVEL_SHIFT + SharcCpu::LEVEL_BIT_NUM;
+
+    // Distance 3.54: level 1, voxel size 2
+    uint64_t hashKey = SharcCpu::ComputeSpatialHash(float3(3.5f, 0.5f, 0.0f), float3(0.0f, 0.0f, 1.0f), gridParameters);
+    CHECK(hashKey == (1ull | (1ull << LEVEL_SHIFT)));
+
+    // Distance 5: level 2, voxel size 4, negative coordinates wrap within the position mask, normal octant is "-X, +Y, -Z"
+    hashKey = SharcCpu::ComputeSpatialHash(float3(-4.0f, 0.0f, 3.0f), float3(-1.0f, 0.0f, -1.0f), gridParameters);
+    CHECK(hashKey == (SharcCpu::POSITION_BIT_MASK | (2ull << LEVEL_SHIFT) | (5ull << NORMAL_SHIFT)));
+
+    // The level is clamped to 1 next to the camera
+    hashKey = SharcCpu::ComputeSpatialHash(float3(0.1f, 0.0f, 0.0f), float3(0.0f, 1.0f, 0.0f), gridParameters);
+    CHECK(((hashKey >> LEVEL_SHIFT) & SharcCpu::LEVEL_BIT_MASK) == 1);
+
+    // The level bias and the scene scale change the voxel size
+    CHECK(SharcCpu::GetVoxelSize(3, gridParameters) == 8.0f);
+    gridParameters.sceneScale = 4.0f;
+    CHECK(SharcCpu::GetVoxelSize(3, gridParameters) == 2.0f);
+    gridParameters.levelBias = 1.0f;
+    CHECK(SharcCpu::GetVoxelSize(3, gridParameters) == 1.0f);
+}
+
+static void TestInsertFind()
+{
+    SharcCpu::HashGrid hashGrid;
+    hashGrid.Initialize(ONE_BUCKET * 4);
+
+    const uint64_t hashKeys[] = {1, 2, 0x1234567890ull, ~0ull};
+    uint32_t entryIndices[4] = {};
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        entryIndices[i] = hashGrid.Insert(hashKeys[i]);
+        CHECK(entryIndices[i] != SharcCpu::INVALID_CACHE_INDEX);
+    }
+
+    for (uint32_t i = 0; i < 4; i++)
+        CHECK(hashGrid.Find(hashKeys[i]) == entryIndices[i]);
+
+    // Not inserted
+    CHECK(hashGrid.Find(3) == SharcCpu::INVALID_CACHE_INDEX);
+
+    // Inserting an existing key returns the same entry and counts as a hit
+    const uint64_t hitNum = hashGrid.GetStats().hitNum;
+    CHECK(hashGrid.Insert(hashKeys[2]) == entryIndices[2]);
+    CHECK(hashGrid.GetStats().hitNum == hitNum + 1);
+    CHECK(hashGrid.GetOccupiedNum() == 4);
+    CHECK(hashGrid.GetStats().failedNum == 0);
+}
+
+static void TestFullBucket()
+{
+    SharcCpu::HashGrid hashGrid;
+    hashGrid.Initialize(ONE_BUCKET);
+
+    for (uint64_t hashKey = 1; hashKey <= SHARC_BUCKET_SIZE; hashKey++)
+        CHECK(hashGrid.Insert(hashKey) == uint32_t(hashKey - 1));
+
+    CHECK(hashGrid.Insert(SHARC_BUCKET_SIZE + 1) == SharcCpu::INVALID_CACHE_INDEX);
+    CHECK(hashGrid.GetStats().failedNum == 1);
+    CHECK(hashGrid.GetStats().probeMaxNum == SHARC_BUCKET_SIZE);
+
+    // Existing keys are still found in a full bucket
+    CHECK(hashGrid.Insert(SHARC_BUCKET_SIZE) == SHARC_BUCKET_SIZE - 1);
+    CHECK(hashGrid.Find(SHARC_BUCKET_SIZE + 1) == SharcCpu::INVALID_CACHE_INDEX);
+}
+
+static void TestResolve()
+{
+    SharcCpu::HashGrid hashGrid;
+    hashGrid.Initialize(ONE_BUCKET);
+
+    const uint32_t stale = hashGrid.Insert(1);
+    const uint32_t sampled = hashGrid.Insert(2);
+
+    // An entry survives "SHARC_STALE_FRAME_NUM_MIN" frames without samples and gets evicted in the next one
+    for (uint32_t frame = 0; frame < SHARC_STALE_FRAME_NUM_MIN; frame++)
+    {
+        hashGrid.MarkSampled(sampled);
+        hashGrid.Resolve(SHARC_STALE_FRAME_NUM_MIN);
+    }
+
+    CHECK(hashGrid.Find(1) == stale);
+    CHECK(hashGrid.GetStats().evictedNum == 0);
+
+    hashGrid.MarkSampled(sampled);
+    hashGrid.Resolve(SHARC_STALE_FRAME_NUM_MIN);
+
+    CHECK(hashGrid.GetStats().evictedNum == 1);
+    CHECK(hashGrid.GetOccupiedNum() == 1);
+    CHECK(hashGrid.Find(2) == SharcCpu::INVALID_CACHE_INDEX); // lookups stop at the hole left in slot 0 until compaction
+
+    // Compaction closes the hole
+    hashGrid.Compact();
+    CHECK(hashGrid.Find(2) == 0);
+}
+
+static void TestCompact()
+{
+    SharcCpu::HashGrid hashGrid;
+    hashGrid.Initialize(ONE_BUCKET);
+
+    for (uint64_t hashKey = 1; hashKey <= 5; hashKey++)
+        hashGrid.Insert(hashKey);
+
+    CHECK(hashGrid.GetLiveBucketNum() == 1);
+
+    // Evict keys 1, 2 and 4
+    for (uint32_t frame = 0; frame <= SHARC_STALE_FRAME_NUM_MIN; frame++)
+    {
+        hashGrid.MarkSampled(2);
+        hashGrid.MarkSampled(4);
+        hashGrid.Resolve(SHARC_STALE_FRAME_NUM_MIN);
+    }
+
+    CHECK(hashGrid.GetOccupiedNum() == 2);
+    CHECK(hashGrid.GetLiveBucketNum() == 0); // the first slot is empty, the bucket is not compacted yet
+
+    // Survivors move to the beginning of the bucket in the original order
+    hashGrid.Compact();
+    CHECK(hashGrid.Find(3) == 0);
+    CHECK(hashGrid.Find(5) == 1);
+    CHECK(hashGrid.Find(1) == SharcCpu::INVALID_CACHE_INDEX);
+    CHECK(hashGrid.GetOccupiedNum() == 2);
+    CHECK(hashGrid.GetLiveBucketNum() == 1);
+
+    // Moved entries keep aging
+    for (uint32_t frame = 0; frame <= SHARC_STALE_FRAME_NUM_MIN; frame++)
+    {
+        hashGrid.MarkSampled(0);
+        hashGrid.Resolve(SHARC_STALE_FRAME_NUM_MIN);
+    }
+
+    hashGrid.Compact();
+    CHECK(hashGrid.Find(3) == 0);
+    CHECK(hashGrid.GetOccupiedNum() == 1);
+
+    // Empty grid
+    for (uint32_t frame = 0; frame <= SHARC_STALE_FRAME_NUM_MIN; frame++)
+        hashGrid.Resolve(SHARC_STALE_FRAME_NUM_MIN);
+
+    hashGrid.Compact();
+    CHECK(hashGrid.GetOccupiedNum() == 0);
+    CHECK(hashGrid.GetLiveBucketNum() == 0);
+}
+
+void RunSharcCpuTests()
+{
+    TestSpatialHash();
+    TestInsertFind();
+    TestFullBucket();
+    TestResolve();
+    TestCompact();
+}
@@ -0,0 +1,28 @@
+/*
+Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+
+NVIDIA CORPORATION and its licensors retain all intellectual property
+and proprietary rights in and to this software, related documentation
+and any modifications thereto. Any use, reproduction, disclosure or
+distribution of this software and related documentation without an express
+license agreement from NVIDIA CORPORATION is strictly prohibited.
+*/
+
+#pragma once
+
+// CPU unit tests: a failed check is reported and counted, the process exit code is non-zero if any check fails (see "Tests/Main.cpp")
+
+#include <cstdio>
+#include <cstdint>
+
+extern uint32_t g_FailedNum;
+
+#define CHECK(condition) \
+    if (!(condition)) \
+    { \
+        printf("%s(%u): '%s' failed\n", __FILE__, __LINE__, #condition); \
+        g_FailedNum++; \
+    }
+
+void RunRenderGraphTests();
+void RunSharcCpuTests();